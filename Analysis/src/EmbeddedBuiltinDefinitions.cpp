@@ -194,7 +194,7 @@ declare function select<A...>(i: string | number, ...: A...): ...any
 -- (nil, string).
 declare function loadstring<A...>(src: string, chunkname: string?): (((A...) -> any)?, string?)
 
-declare function wait(seconds: number)
+declare function wait(seconds: number?): number
 
 declare function newproxy(mt: boolean?): any
 
@@ -252,6 +252,8 @@ type CprCustomOptions = {
     payload: {}?,
     multipart: {}?,
     parameters: {}?,
+    async: boolean?,
+    stream: ((string) -> boolean?)?,
 }
 
 type CprResponseStatus = {
@@ -264,20 +266,53 @@ type CprResponseError = {
     code: string,
 }
 
-type CprResponse = {
-    elapsed: number,
-    text: string,
-    reason: string,
-    downloaded: number,
-    uploaded: number,
-    redirects: number,
-    status: CprResponseStatus,
-    error: CprResponseError,
-    url: string,
-    rawHeader: string,
-    header: {},
-    cookies: {},
-    certInfo: {},
+declare class CprResponse
+    reason: string
+    redirects: number
+    status: CprResponseStatus
+    text: string
+    url: string
+    rawHeader: string
+    header: {[string]: string}
+    error: CprResponseError
+    downloaded: number
+    uploaded: number
+    elapsed: number
+    cookies: {[string]: string}
+    certInfo: {string}
+
+    function __tostring(self): string
+end
+
+type CprSessionOptions = {
+    followRedirects: number?,
+    maxRedirects: number?,
+    timeout: number?,
+    auth: {}?,
+    digest: {}?,
+    ntlm: {}?,
+    bearer: string?,
+    parameters: {}?,
+    async: boolean?,
+    headers: {}?,
+    poolSize: number?,
+}
+
+type CprSession = {
+    request: (CprSession, string, string?, {}?, string?, CprCustomOptions?) -> CprResponse,
+    get: (CprSession, string?, {}?, string?, CprCustomOptions?) -> CprResponse,
+    post: (CprSession, string?, {}?, string?, CprCustomOptions?) -> CprResponse,
+    patch: (CprSession, string?, {}?, string?, CprCustomOptions?) -> CprResponse,
+    put: (CprSession, string?, {}?, string?, CprCustomOptions?) -> CprResponse,
+    delete: (CprSession, string?, {}?, string?, CprCustomOptions?) -> CprResponse,
+    options: (CprSession, string?, {}?, string?, CprCustomOptions?) -> CprResponse,
+    head: (CprSession, string?, {}?, string?, CprCustomOptions?) -> CprResponse,
+    close: (CprSession) -> (),
+}
+
+type CprBatchOptions = {
+    concurrency: number?,
+    async: boolean?,
 }
 
 declare cpr: {
@@ -289,16 +324,81 @@ declare cpr: {
     delete: (string, {}?, string?, CprCustomOptions?) -> CprResponse,
     options: (string, {}?, string?, CprCustomOptions?) -> CprResponse,
     head: (string, {}?, string?, CprCustomOptions?) -> CprResponse,
+    poll: (number?) -> number,
+    pending: () -> number,
+    session: (string, CprSessionOptions?) -> CprSession,
+    batch: ({{any}}, CprBatchOptions?) -> {CprResponse},
+}
+
+type JsonEncodeOptions = {
+    pretty: boolean?,
+    indent: string?,
+    sortKeys: boolean?,
+}
+
+type JsonDecoderOptions = {
+    depth: number?,
+    start_object: (() -> ())?,
+    end_object: (() -> ())?,
+    start_array: (() -> ())?,
+    end_array: (() -> ())?,
+    key: ((string) -> ())?,
+    value: ((any) -> ())?,
+}
+
+type JsonDecoder = {
+    update: ((JsonDecoder, string) -> {any}?) & ((string) -> {any}?),
+    finish: ((JsonDecoder, string?) -> {any}?) & ((string?) -> {any}?),
 }
 
 declare json: {
-    encode: (any) -> string,
+    encode: (any, JsonEncodeOptions?) -> string,
     decode: (string) -> any,
+    decoder: (JsonDecoderOptions?) -> JsonDecoder,
+    parse_lazy: (string) -> any,
+    _version: string,
+}
+
+type Base64Options = {
+    urlSafe: boolean?,
+    padding: boolean?,
+}
+
+type Base64Stream = {
+    update: (Base64Stream, string) -> string,
+    finish: (Base64Stream, string?) -> string,
 }
 
 declare base64: {
-    encode: ((string) -> string) & ((number) -> string),
-    decode: (string) -> string,
+    encode: ((string, Base64Options?) -> string) & ((number, Base64Options?) -> string),
+    decode: (string, Base64Options?) -> string,
+    encoder: (Base64Options?) -> Base64Stream,
+    decoder: (Base64Options?) -> Base64Stream,
+}
+
+declare task: {
+    spawn: (<A...>((A...) -> ...any, A...) -> thread) & ((thread, ...any) -> thread),
+    defer: (<A...>((A...) -> ...any, A...) -> thread) & ((thread, ...any) -> thread),
+    delay: (<A...>(number, (A...) -> ...any, A...) -> thread) & ((number, thread, ...any) -> thread),
+    wait: (number?) -> number,
+    step: (number?) -> number,
+}
+
+declare serialize: {
+    encode: (...any) -> string,
+    decode: (string) -> ...any,
+}
+
+type WorkerHandle = {
+    send: (WorkerHandle, ...any) -> (),
+    join: (WorkerHandle) -> (boolean, ...any),
+}
+
+declare worker: {
+    spawn: (string, ...any) -> WorkerHandle,
+    send: (...any) -> (),
+    receive: (number?) -> (WorkerHandle?, ...any),
+    cores: () -> number,
 }
 
 declare utf8: {
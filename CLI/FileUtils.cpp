@@ -18,6 +18,7 @@
 #include <sys/stat.h>
 #endif
 
+#include <stdio.h>
 #include <string.h>
 
 #ifdef _WIN32
@@ -94,6 +95,38 @@ std::optional<std::string> readStdin()
     return result;
 }
 
+bool writeFile(const std::string& name, const std::string& data)
+{
+    // readers never see a partially written file: the data goes to a temporary file next to it first
+#ifdef _WIN32
+    std::string temp = name + ".tmp" + std::to_string(GetCurrentProcessId());
+    FILE* file = _wfopen(fromUtf8(temp).c_str(), L"wb");
+#else
+    std::string temp = name + ".tmp" + std::to_string(getpid());
+    FILE* file = fopen(temp.c_str(), "wb");
+#endif
+
+    if (!file)
+        return false;
+
+    bool written = fwrite(data.data(), 1, data.size(), file) == data.size();
+    written &= fclose(file) == 0;
+
+#ifdef _WIN32
+    if (written && MoveFileExW(fromUtf8(temp).c_str(), fromUtf8(name).c_str(), MOVEFILE_REPLACE_EXISTING))
+        return true;
+
+    _wremove(fromUtf8(temp).c_str());
+#else
+    if (written && rename(temp.c_str(), name.c_str()) == 0)
+        return true;
+
+    remove(temp.c_str());
+#endif
+
+    return false;
+}
+
 template<typename Ch>
 static void joinPaths(std::basic_string<Ch>& str, const Ch* lhs, const Ch* rhs)
 {
@@ -221,6 +254,18 @@ bool isDirectory(const std::string& path)
 #endif
 }
 
+bool createDirectory(const std::string& path)
+{
+    if (isDirectory(path))
+        return true;
+
+#ifdef _WIN32
+    return CreateDirectoryW(fromUtf8(path).c_str(), nullptr) != 0;
+#else
+    return mkdir(path.c_str(), 0777) == 0;
+#endif
+}
+
 std::string joinPaths(const std::string& lhs, const std::string& rhs)
 {
     std::string result = lhs;
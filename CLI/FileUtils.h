@@ -8,8 +8,10 @@
 
 std::optional<std::string> readFile(const std::string& name);
 std::optional<std::string> readStdin();
+bool writeFile(const std::string& name, const std::string& data); // replaces the file atomically
 
 bool isDirectory(const std::string& path);
+bool createDirectory(const std::string& path);
 bool traverseDirectory(const std::string& path, const std::function<void(const std::string& name)>& callback);
 
 std::string joinPaths(const std::string& lhs, const std::string& rhs);
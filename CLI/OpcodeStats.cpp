@@ -0,0 +1,107 @@
+// This file is part of the Luau programming language and is licensed under MIT License; see LICENSE.txt for details
+#include "OpcodeStats.h"
+
+#include "lua.h"
+
+#include "Luau/BytecodeBuilder.h"
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+// Counts how often each opcode runs right after another one in the same function, which is what fused instructions can save dispatch on.
+// The interpreter runs in single step mode, which still steps through both halves of a fused instruction; the first one is reported by its fused name.
+struct OpcodeStats
+{
+    lua_Callbacks* callbacks = nullptr;
+
+    // the last opcode that ran at every call depth of a thread; a deeper frame starts a new sequence
+    std::unordered_map<lua_State*, std::vector<int>> lastOpcode;
+
+    uint64_t counts[256] = {};
+    uint64_t pairs[256][256] = {};
+} gOpcodeStats;
+
+static void opcodeStatsStep(lua_State* L, lua_Debug* ar)
+{
+    int op = lua_getopcode(L, 0);
+    if (op < 0)
+        return;
+
+    std::vector<int>& last = gOpcodeStats.lastOpcode[L];
+    size_t depth = size_t(lua_stackdepth(L));
+
+    if (last.size() < depth + 1)
+        last.resize(depth + 1, -1);
+
+    // returns leave the sequence of the caller as it was before the call, which continues with the instruction after CALL
+    for (size_t i = depth + 1; i < last.size(); ++i)
+        last[i] = -1;
+
+    if (last[depth] >= 0)
+        gOpcodeStats.pairs[last[depth]][op]++;
+
+    gOpcodeStats.counts[op]++;
+    last[depth] = op;
+}
+
+static void opcodeStatsUserThread(lua_State* LP, lua_State* L)
+{
+    if (!LP)
+        gOpcodeStats.lastOpcode.erase(L);
+}
+
+void opcodeStatsStart(lua_State* L)
+{
+    gOpcodeStats.callbacks = lua_callbacks(L);
+    gOpcodeStats.callbacks->debugstep = opcodeStatsStep;
+    gOpcodeStats.callbacks->userthread = opcodeStatsUserThread;
+
+    lua_singlestep(L, true);
+}
+
+void opcodeStatsDump(const char* path)
+{
+    FILE* f = fopen(path, "w");
+    if (!f)
+    {
+        fprintf(stderr, "Error opening opcode stats %s\n", path);
+        return;
+    }
+
+    uint64_t total = 0;
+    for (uint64_t count : gOpcodeStats.counts)
+        total += count;
+
+    std::vector<std::pair<uint64_t, int>> ops;
+    std::vector<std::pair<uint64_t, int>> pairs;
+
+    for (int i = 0; i < 256; ++i)
+    {
+        if (gOpcodeStats.counts[i])
+            ops.push_back({gOpcodeStats.counts[i], i});
+
+        for (int j = 0; j < 256; ++j)
+            if (gOpcodeStats.pairs[i][j])
+                pairs.push_back({gOpcodeStats.pairs[i][j], i * 256 + j});
+    }
+
+    std::sort(ops.rbegin(), ops.rend());
+    std::sort(pairs.rbegin(), pairs.rend());
+
+    auto name = [](int op) {
+        return op < LOP__COUNT ? Luau::BytecodeBuilder::getOpcodeName(LuauOpcode(op)) : "?";
+    };
+
+    fprintf(f, "# opcodes\n");
+    for (auto& [count, op] : ops)
+        fprintf(f, "%lld %.2f%% %s\n", static_cast<long long>(count), double(count) / double(total) * 100, name(op));
+
+    fprintf(f, "# pairs\n");
+    for (auto& [count, pair] : pairs)
+        fprintf(f, "%lld %.2f%% %s %s\n", static_cast<long long>(count), double(count) / double(total) * 100, name(pair / 256), name(pair % 256));
+
+    fclose(f);
+
+    printf("Opcode stats written to %s (%lld instructions)\n", path, static_cast<long long>(total));
+}
@@ -5,23 +5,35 @@
 #include "lualib.h"
 
 #include "Luau/Compiler.h"
+#include "Luau/Bytecode.h"
 #include "Luau/BytecodeBuilder.h"
+#include "Luau/CodeGen.h"
 #include "Luau/Parser.h"
+#include "Luau/StringUtils.h"
 
 #include "FileUtils.h"
 #include "Profiler.h"
 #include "Coverage.h"
+#include "OpcodeStats.h"
 
 #include "isocline.h"
 
+#include <algorithm>
+#include <chrono>
 #include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
 
 #ifdef _WIN32
 #include <io.h>
 #include <fcntl.h>
+#else
+#include <poll.h>
 #endif
 
 #include <locale.h>
+#include <math.h>
 
 LUAU_FASTFLAG(DebugLuauTimeTracing)
 
@@ -46,6 +58,9 @@ struct GlobalOptions
 {
     int optimizationLevel = 1;
     int debugLevel = 1;
+    std::string bytecodeCache;
+    bool codegen = false;
+    unsigned int codegenThreshold = 0;
 } globalOptions;
 
 static Luau::CompileOptions copts()
@@ -58,6 +73,78 @@ static Luau::CompileOptions copts()
     return result;
 }
 
+// bump when the compiler output changes without a bytecode version change, so that old cache entries stop matching
+constexpr int BytecodeCacheVersion = 2;
+
+static uint64_t hashBytes(const char* data, size_t size, uint64_t seed)
+{
+    auto mix = [](uint64_t h) {
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdull;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ull;
+        h ^= h >> 33;
+        return h;
+    };
+
+    uint64_t h = seed ^ (size * 0x9e3779b97f4a7c15ull);
+
+    for (; size >= 8; data += 8, size -= 8)
+    {
+        uint64_t word;
+        memcpy(&word, data, 8);
+        h = (h ^ mix(word)) * 0x9e3779b97f4a7c15ull;
+    }
+
+    uint64_t tail = 0;
+    memcpy(&tail, data, size);
+
+    return mix(h ^ mix(tail));
+}
+
+// cache entries are named after a 128-bit hash of the source and of everything else that changes the bytecode compiled from it
+static std::string getCacheKey(const std::string& source, const Luau::CompileOptions& options)
+{
+    std::string input = Luau::format("%d %d %d %d %d %s %s", LBC_VERSION_TARGET, BytecodeCacheVersion, options.optimizationLevel,
+        options.debugLevel, options.coverageLevel, options.vectorLib ? options.vectorLib : "", options.vectorCtor ? options.vectorCtor : "");
+
+    for (const char** global = options.mutableGlobals; global && *global; ++global)
+        input += Luau::format(" %s", *global);
+
+    input += '\n';
+    input += source;
+
+    return Luau::format("%016llx%016llx", (unsigned long long)hashBytes(input.data(), input.size(), 1),
+        (unsigned long long)hashBytes(input.data(), input.size(), 2));
+}
+
+std::string compileWithCache(const std::string& source, const std::string& cacheDirectory)
+{
+    Luau::CompileOptions options = copts();
+
+    if (cacheDirectory.empty())
+        return Luau::compile(source, options);
+
+    // entries start with their key, which catches files that were renamed or copied to the wrong place
+    std::string key = getCacheKey(source, options);
+    std::string path = joinPaths(cacheDirectory, key + ".luauc");
+    std::string header = key + "\n";
+
+    if (std::optional<std::string> cached = readFile(path))
+    {
+        if (cached->size() > header.size() && cached->compare(0, header.size(), header) == 0)
+            return cached->substr(header.size());
+    }
+
+    std::string bytecode = Luau::compile(source, options);
+
+    // bytecode that starts with version 0 carries a compile error; those are cheap to reproduce and shouldn't outlive a fix to the compiler
+    if (!bytecode.empty() && bytecode[0] != 0)
+        writeFile(path, header + bytecode);
+
+    return bytecode;
+}
+
 static int lua_loadstring(lua_State* L)
 {
     size_t l = 0;
@@ -68,13 +155,49 @@ static int lua_loadstring(lua_State* L)
 
     std::string bytecode = Luau::compile(std::string(s, l), copts());
     if (luau_load(L, chunkname, bytecode.data(), bytecode.size(), 0) == 0)
+    {
+        if (globalOptions.codegen)
+            Luau::CodeGen::compile(L, -1);
+
         return 1;
+    }
 
     lua_pushnil(L);
     lua_insert(L, -2); /* put before error message */
     return 2;          /* return nil plus error message */
 }
 
+// modules are compiled once per process; the main VM and all workers that require a module share its instructions and line info
+static luau_Module* getModule(const std::string& name, const std::string& source)
+{
+    struct CachedModule
+    {
+        std::string source;
+        luau_Module* module;
+    };
+
+    static std::mutex mutex;
+    static std::unordered_map<std::string, CachedModule> modules;
+
+    std::unique_lock<std::mutex> lock(mutex);
+
+    CachedModule& cached = modules[name];
+
+    if (!cached.module || cached.source != source)
+    {
+        if (cached.module)
+            luau_releasemodule(cached.module);
+
+        std::string bytecode = compileWithCache(source, globalOptions.bytecodeCache);
+
+        cached.source = source;
+        cached.module = luau_newmodule(bytecode.data(), bytecode.size());
+    }
+
+    luau_retainmodule(cached.module);
+    return cached.module;
+}
+
 static int finishrequire(lua_State* L)
 {
     if (lua_isstring(L, -1))
@@ -113,9 +236,15 @@ static int lua_require(lua_State* L)
     luaL_sandboxthread(ML);
 
     // now we can compile & run module on the new thread
-    std::string bytecode = Luau::compile(*source, copts());
-    if (luau_load(ML, chunkname.c_str(), bytecode.data(), bytecode.size(), 0) == 0)
+    luau_Module* module = getModule(name, *source);
+    int loaded = luau_loadmodule(ML, chunkname.c_str(), module, 0);
+    luau_releasemodule(module);
+
+    if (loaded == 0)
     {
+        if (globalOptions.codegen)
+            Luau::CodeGen::compile(ML, -1);
+
         if (coverageActive())
             coverageTrack(ML, -1);
 
@@ -181,9 +310,79 @@ void setupState(lua_State* L)
     luaL_register(L, NULL, funcs);
     lua_pop(L, 1);
 
+    // workers get the same environment as the main VM
+    luaL_setworkerinit(L, setupState);
+
+    if (globalOptions.codegenThreshold)
+        Luau::CodeGen::setTieringThreshold(L, globalOptions.codegenThreshold);
+
     luaL_sandbox(L);
 }
 
+// waits until a task source has work or 'timeout' seconds pass; a negative timeout waits for the sources only
+static void waitForTasks(lua_State* L, double timeout)
+{
+    int fds[16];
+    int count = std::min(luaL_pollfds(L, fds, 16), 16);
+
+#ifndef _WIN32
+    if (count > 0)
+    {
+        pollfd pfds[16];
+        for (int i = 0; i < count; ++i)
+        {
+            pfds[i].fd = fds[i];
+            pfds[i].events = POLLIN;
+            pfds[i].revents = 0;
+        }
+
+        poll(pfds, count, timeout < 0 ? -1 : int(ceil(timeout * 1000)));
+        return;
+    }
+#endif
+
+    // without descriptors to wait on, check back on the sources every millisecond
+    if (count > 0 || timeout < 0)
+        timeout = timeout < 0 ? 0.001 : std::min(timeout, 0.001);
+
+    std::this_thread::sleep_for(std::chrono::duration<double>(timeout));
+}
+
+// Runs scheduled tasks and async request completions until there is nothing left to wait for, or until 'until' is no longer suspended
+// when it is set; returns a lua_pcall status with the error on top of the stack
+static int runEventLoop(lua_State* L, lua_State* until = nullptr)
+{
+    while ((!until || lua_status(until) == LUA_YIELD) && luaL_pendingtasks(L) > 0)
+    {
+        double next = luaL_nextdeadline(L);
+
+        if (next != 0)
+            waitForTasks(L, next < 0 ? -1 : std::max(next - lua_clock(), 0.0));
+
+        int status = luaL_runtasks(L, lua_clock(), 0);
+        if (status != 0)
+            return status;
+    }
+
+    return 0;
+}
+
+// keeps the event loop going while 'T' waits for tasks or requests; errors are moved to T's stack
+static int finishThread(lua_State* L, lua_State* T, int status, bool all)
+{
+    if (status != 0 && status != LUA_YIELD)
+        return status;
+
+    int loop = runEventLoop(L, all ? nullptr : T);
+    if (loop != 0)
+    {
+        lua_xmove(L, T, 1);
+        return loop;
+    }
+
+    return lua_status(T);
+}
+
 std::string runCode(lua_State* L, const std::string& source)
 {
     std::string bytecode = Luau::compile(source, copts());
@@ -205,7 +404,7 @@ std::string runCode(lua_State* L, const std::string& source)
     lua_remove(L, -3);
     lua_xmove(L, T, 1);
 
-    int status = lua_resume(T, NULL, 0);
+    int status = finishThread(L, T, lua_resume(T, NULL, 0), /* all= */ false);
 
     if (status == 0)
     {
@@ -513,15 +712,18 @@ static bool runFile(const char* name, lua_State* GL, bool repl)
 
     std::string chunkname = "=" + std::string(name);
 
-    std::string bytecode = Luau::compile(*source, copts());
+    std::string bytecode = compileWithCache(*source, globalOptions.bytecodeCache);
     int status = 0;
 
     if (luau_load(L, chunkname.c_str(), bytecode.data(), bytecode.size(), 0) == 0)
     {
+        if (globalOptions.codegen)
+            Luau::CodeGen::compile(L, -1);
+
         if (coverageActive())
             coverageTrack(L, -1);
 
-        status = lua_resume(L, NULL, 0);
+        status = finishThread(GL, L, lua_resume(L, NULL, 0), /* all= */ true);
     }
     else
     {
@@ -630,10 +832,15 @@ static void displayHelp(const char* argv0)
     printf("  --compile[=format]: compile input files and output resulting formatted bytecode (binary or text)\n");
     printf("\n");
     printf("Available options:\n");
+    printf("  --bytecode-cache=<dir>: store compiled scripts and modules in dir and reuse them until their source or compile options change\n");
+    printf("  --codegen: translate the loaded code to native machine code\n");
+    printf("  --codegen-threshold=N: translate functions to native machine code once they run N calls and loop iterations\n");
+    printf("  --codegen-perfmap: list native code in /tmp/perf-<pid>.map for the perf profiler\n");
     printf("  --coverage: collect code coverage while running the code and output results to coverage.out\n");
     printf("  -h, --help: Display this usage message.\n");
     printf("  -i, --interactive: Run an interactive REPL after executing the last script specified.\n");
     printf("  -O<n>: compile with optimization level n (default 1, n should be between 0 and 2).\n");
+    printf("  --opcode-stats: count executed opcodes and pairs of consecutive opcodes and output results to opcodes.out\n");
     printf("  -g<n>: compile with debug level n (default 1, n should be between 0 and 2).\n");
     printf("  --profile[=N]: profile the code using N Hz sampling (default 10000) and output results to profile.out\n");
     printf("  --timetrace: record compiler time tracing information into trace.json\n");
@@ -704,6 +911,7 @@ int replMain(int argc, char** argv)
     CompileFormat compileFormat{};
     int profile = 0;
     bool coverage = false;
+    bool opcodeStats = false;
     bool interactive = false;
 
     // Set the mode if the user has explicitly specified one.
@@ -778,6 +986,51 @@ int replMain(int argc, char** argv)
         {
             coverage = true;
         }
+        else if (strcmp(argv[i], "--opcode-stats") == 0)
+        {
+            opcodeStats = true;
+        }
+        else if (strncmp(argv[i], "--bytecode-cache=", 17) == 0)
+        {
+            globalOptions.bytecodeCache = argv[i] + 17;
+
+            if (!createDirectory(globalOptions.bytecodeCache))
+            {
+                fprintf(stderr, "Error: Can't create bytecode cache directory '%s'.\n", globalOptions.bytecodeCache.c_str());
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--codegen") == 0)
+        {
+            if (!Luau::CodeGen::isSupported())
+            {
+                fprintf(stderr, "Error: Native code generation is not supported on this platform.\n");
+                return 1;
+            }
+
+            globalOptions.codegen = true;
+        }
+        else if (strncmp(argv[i], "--codegen-threshold=", 20) == 0)
+        {
+            int threshold = atoi(argv[i] + 20);
+            if (threshold <= 0)
+            {
+                fprintf(stderr, "Error: Native code generation threshold must be positive.\n");
+                return 1;
+            }
+
+            if (!Luau::CodeGen::isSupported())
+            {
+                fprintf(stderr, "Error: Native code generation is not supported on this platform.\n");
+                return 1;
+            }
+
+            globalOptions.codegenThreshold = unsigned(threshold);
+        }
+        else if (strcmp(argv[i], "--codegen-perfmap") == 0)
+        {
+            Luau::CodeGen::enablePerfMap();
+        }
         else if (strcmp(argv[i], "--timetrace") == 0)
         {
             FFlag::DebugLuauTimeTracing.value = true;
@@ -851,6 +1104,9 @@ int replMain(int argc, char** argv)
         if (coverage)
             coverageInit(L);
 
+        if (opcodeStats)
+            opcodeStatsStart(L);
+
         int failed = 0;
 
         for (size_t i = 0; i < files.size(); ++i)
@@ -868,6 +1124,9 @@ int replMain(int argc, char** argv)
         if (coverage)
             coverageDump("coverage.out");
 
+        if (opcodeStats)
+            opcodeStatsDump("opcodes.out");
+
         return failed ? 1 : 0;
     }
     case CliMode::Unknown:
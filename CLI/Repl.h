@@ -12,6 +12,7 @@ using AddCompletionCallback = std::function<void(const std::string& completion,
 // so they can be included by unit tests.
 void setupState(lua_State* L);
 std::string runCode(lua_State* L, const std::string& source);
+std::string compileWithCache(const std::string& source, const std::string& cacheDirectory);
 void getCompletions(lua_State* L, const std::string& editBuffer, const AddCompletionCallback& addCompletionCallback);
 
 int replMain(int argc, char** argv);
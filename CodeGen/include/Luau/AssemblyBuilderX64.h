@@ -58,12 +58,28 @@ public:
     void jmp(Label& label);
     void jmp(OperandX64 op);
 
+    void call(OperandX64 op);
+
+    // Calls a function outside of the generated code with a rel32 displacement, which is filled in by 'relocate'
+    void call(const void* target);
+
     // AVX
     void vaddpd(OperandX64 dst, OperandX64 src1, OperandX64 src2);
     void vaddps(OperandX64 dst, OperandX64 src1, OperandX64 src2);
     void vaddsd(OperandX64 dst, OperandX64 src1, OperandX64 src2);
     void vaddss(OperandX64 dst, OperandX64 src1, OperandX64 src2);
 
+    void vsubsd(OperandX64 dst, OperandX64 src1, OperandX64 src2);
+    void vmulsd(OperandX64 dst, OperandX64 src1, OperandX64 src2);
+    void vdivsd(OperandX64 dst, OperandX64 src1, OperandX64 src2);
+
+    // Conversions between scalar doubles and integers; the integer size selects the 32 or 64 bit form
+    void vcvttsd2si(OperandX64 dst, OperandX64 src);
+    void vcvtsi2sd(OperandX64 dst, OperandX64 src1, OperandX64 src2);
+
+    // Compares scalar doubles and sets ZF, PF and CF like an unsigned comparison; PF is set when the operands are unordered
+    void vucomisd(OperandX64 src1, OperandX64 src2);
+
     void vsqrtpd(OperandX64 dst, OperandX64 src);
     void vsqrtps(OperandX64 dst, OperandX64 src);
     void vsqrtsd(OperandX64 dst, OperandX64 src1, OperandX64 src2);
@@ -87,6 +103,10 @@ public:
     // Assigns label position to the current location
     void setLabel(Label& label);
 
+    // Resolves the displacements of calls to functions outside of the generated code, for code placed at 'codeAddress'; returns false when
+    // one of them is out of range
+    bool relocate(const uint8_t* codeAddress);
+
     // Constant allocation (uses rip-relative addressing)
     OperandX64 i64(int64_t value);
     OperandX64 f32(float value);
@@ -152,8 +172,15 @@ private:
     const char* getSizeName(SizeX64 size);
     const char* getRegisterName(RegisterX64 reg);
 
+    struct ExternalCall
+    {
+        uint32_t location;
+        const void* target;
+    };
+
     uint32_t nextLabel = 1;
     std::vector<Label> pendingLabels;
+    std::vector<ExternalCall> externalCalls;
     std::vector<uint32_t> labelLocations;
 
     bool logText = false;
@@ -0,0 +1,86 @@
+// This file is part of the Luau programming language and is licensed under MIT License; see LICENSE.txt for details
+#pragma once
+
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace Luau
+{
+namespace CodeGen
+{
+
+// Allocates memory for generated code out of a single reserved address range. Pages are never writable and executable at the same time:
+// code is written in batches between beginWrite and endWrite, and only pages that don't hold any live code are made writable, so code that
+// is running is never remapped. Small allocations share pages of the same size class; larger ones get a run of whole pages.
+class CodeAllocator
+{
+public:
+    // The range is reserved close to 'nearAddress' when possible, so that code placed in it can reach functions there with rel32 calls
+    CodeAllocator(size_t reserveSize, const void* nearAddress);
+    ~CodeAllocator();
+
+    CodeAllocator(const CodeAllocator&) = delete;
+    CodeAllocator& operator=(const CodeAllocator&) = delete;
+
+    void beginWrite();
+
+    // Returns writable memory for 'size' bytes aligned to kMinAlignment, or null when the reserved range is exhausted; the memory becomes
+    // executable on endWrite
+    uint8_t* allocate(size_t size);
+
+    // Returns false if some of the pages couldn't be made executable, in which case code written in the batch must not be used
+    bool endWrite();
+
+    void deallocate(uint8_t* memory, size_t size);
+
+    // Checks if every address in the reserved range can reach 'target' with a rel32 displacement
+    bool isReachable(const void* target) const;
+
+    // Total size of live allocations, rounded up to their size class
+    size_t getAllocatedSize() const
+    {
+        return allocatedSize;
+    }
+
+    static constexpr size_t kPageSize = 4096;
+    static constexpr size_t kMinAlignment = 64;
+
+private:
+    struct Page
+    {
+        // size class of the slots in the page, 0 for pages of multi-page allocations
+        uint32_t slotSize = 0;
+
+        // number of pages in the allocation that starts at this page
+        uint32_t runLength = 0;
+
+        // slots in use, one bit per slot
+        uint64_t slotMask = 0;
+
+        bool used = false;
+
+        // the page was made writable by the current batch
+        bool writable = false;
+    };
+
+    size_t getSizeClass(size_t size) const;
+
+    uint8_t* allocateSlot(size_t slotSize);
+    uint8_t* allocateRun(size_t pages);
+
+    bool makeWritable(size_t first, size_t count);
+
+    uint8_t* base = nullptr;
+    size_t pageCount = 0;
+
+    std::vector<Page> pages;
+
+    bool writing = false;
+
+    size_t allocatedSize = 0;
+};
+
+} // namespace CodeGen
+} // namespace Luau
@@ -0,0 +1,28 @@
+// This file is part of the Luau programming language and is licensed under MIT License; see LICENSE.txt for details
+#pragma once
+
+struct lua_State;
+
+namespace Luau
+{
+namespace CodeGen
+{
+
+// Native code generation requires an x64 CPU with AVX support
+bool isSupported();
+
+// Translates the Luau function at stack index idx and every function defined inside of it to native code; calls to these functions run
+// the native code from then on, falling back to the interpreter for the instructions it doesn't implement. Does nothing when native code
+// generation isn't supported.
+void compile(lua_State* L, int idx);
+
+// Makes functions loaded from then on start in the interpreter and move to native code on their own, once their calls and loop iterations
+// add up to 'threshold'; functions that never get there are not compiled at all. A threshold of 0 turns this off for new functions.
+void setTieringThreshold(lua_State* L, unsigned int threshold);
+
+// Lists the native code of functions compiled from then on in /tmp/perf-<pid>.map, so that perf can attribute samples in it to Luau
+// functions. Only available on Linux.
+void enablePerfMap();
+
+} // namespace CodeGen
+} // namespace Luau
@@ -37,7 +37,9 @@ enum class Condition
     Zero,
     NotZero,
 
-    // TODO: ordered and unordered floating-point conditions
+    // Set by floating-point comparisons when either of the operands is NaN
+    Parity,
+    NotParity,
 
     Count
 };
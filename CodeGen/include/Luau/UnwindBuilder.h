@@ -0,0 +1,60 @@
+// This file is part of the Luau programming language and is licensed under MIT License; see LICENSE.txt for details
+#pragma once
+
+#include "Luau/RegisterX64.h"
+
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace Luau
+{
+namespace CodeGen
+{
+
+// Builds call frame information in the DWARF .eh_frame format for a block of generated code, so that debuggers, profilers and C++
+// exceptions can unwind through it. The stack changes are described in code order by the offset of the instruction that follows them;
+// the frame is assumed to stay the same between the prologue and the epilogue.
+class UnwindBuilder
+{
+public:
+    void start();
+
+    void push(uint32_t codeOffset, RegisterX64 reg);
+    void pop(uint32_t codeOffset);
+    void allocStack(uint32_t codeOffset, int size);
+    void freeStack(uint32_t codeOffset, int size);
+
+    void finish();
+
+    // Fills in the location of the code once it has been placed
+    void setCodeRange(const uint8_t* code, size_t size);
+
+    // A CIE, one FDE and a zero terminator
+    std::vector<uint8_t> data;
+
+private:
+    void advance(uint32_t codeOffset);
+    void setCfaOffset(int offset);
+
+    void placeU8(uint8_t value);
+    void placeU32(uint32_t value);
+    void placeU64(uint64_t value);
+    void placeUleb128(uint32_t value);
+    void alignTo8(size_t start);
+
+    size_t fdeStart = 0;
+    size_t pcBeginOffset = 0;
+
+    uint32_t lastOffset = 0;
+    int cfaOffset = 0;
+};
+
+// Registers the frame information built by UnwindBuilder with the system unwinder; returns false on platforms where it isn't supported.
+// The data has to stay alive until it is unregistered.
+bool registerUnwindInfo(uint8_t* data);
+void unregisterUnwindInfo(uint8_t* data);
+
+} // namespace CodeGen
+} // namespace Luau
@@ -0,0 +1,21 @@
+// This file is part of the Luau programming language and is licensed under MIT License; see LICENSE.txt for details
+#pragma once
+
+/* Can be used to reconfigure visibility/exports for public APIs */
+#ifndef LUACODEGEN_API
+#define LUACODEGEN_API extern
+#endif
+
+struct lua_State;
+
+/* returns 1 if native code can be generated on this platform */
+LUACODEGEN_API int lua_codegen_supported();
+
+/* translates the function at idx and all functions nested in it to native code; a no-op when native code generation isn't supported */
+LUACODEGEN_API void lua_codegen_compile(struct lua_State* L, int idx);
+
+/* functions loaded after this call are translated to native code once they run 'threshold' calls and loop iterations; 0 turns it off */
+LUACODEGEN_API void lua_codegen_settiering(struct lua_State* L, unsigned int threshold);
+
+/* writes the location of native code compiled from now on to /tmp/perf-<pid>.map for perf; Linux only */
+LUACODEGEN_API void lua_codegen_enableperfmap();
@@ -12,7 +12,7 @@ namespace CodeGen
 // TODO: more assertions on operand sizes
 
 const uint8_t codeForCondition[] = {
-    0x0, 0x1, 0x2, 0x3, 0x2, 0x6, 0x7, 0x3, 0x4, 0xc, 0xe, 0xf, 0xd, 0x3, 0x7, 0x6, 0x2, 0x5, 0xd, 0xf, 0xe, 0xc, 0x4, 0x5};
+    0x0, 0x1, 0x2, 0x3, 0x2, 0x6, 0x7, 0x3, 0x4, 0xc, 0xe, 0xf, 0xd, 0x3, 0x7, 0x6, 0x2, 0x5, 0xd, 0xf, 0xe, 0xc, 0x4, 0x5, 0xa, 0xb};
 static_assert(sizeof(codeForCondition) / sizeof(codeForCondition[0]) == size_t(Condition::Count), "all conditions have to be covered");
 
 #define OP_PLUS_REG(op, reg) ((op) + (reg & 0x7))
@@ -23,7 +23,7 @@ static_assert(sizeof(codeForCondition) / sizeof(codeForCondition[0]) == size_t(C
 #define REX_X(reg) (((reg).index & 0x8) >> 2)
 #define REX_B(reg) (((reg).index & 0x8) >> 3)
 
-#define AVX_W(value) (!(value) ? 0x80 : 0x0)
+#define AVX_W(value) ((value) ? 0x80 : 0x0)
 #define AVX_R(reg) ((~(reg).index & 0x8) << 4)
 #define AVX_X(reg) ((~(reg).index & 0x8) << 3)
 #define AVX_B(reg) ((~(reg).index & 0x8) << 2)
@@ -291,6 +291,32 @@ void AssemblyBuilderX64::jmp(OperandX64 op)
     commit();
 }
 
+void AssemblyBuilderX64::call(OperandX64 op)
+{
+    if (logText)
+        log("call", op);
+
+    uint8_t rex = REX_X(op.index) | REX_B(op.base);
+
+    if (rex != 0)
+        place(rex | 0x40);
+
+    place(0xff);
+    placeModRegMem(op, 2);
+    commit();
+}
+
+void AssemblyBuilderX64::call(const void* target)
+{
+    if (logText)
+        logAppend(" %-12s%p\n", "call", target);
+
+    place(0xe8);
+    externalCalls.push_back({getCodeSize(), target});
+    placeImm32(0);
+    commit();
+}
+
 void AssemblyBuilderX64::vaddpd(OperandX64 dst, OperandX64 src1, OperandX64 src2)
 {
     placeAvx("vaddpd", dst, src1, src2, 0x58, false, AVX_0F, AVX_66);
@@ -311,6 +337,38 @@ void AssemblyBuilderX64::vaddss(OperandX64 dst, OperandX64 src1, OperandX64 src2
     placeAvx("vaddss", dst, src1, src2, 0x58, false, AVX_0F, AVX_F3);
 }
 
+void AssemblyBuilderX64::vsubsd(OperandX64 dst, OperandX64 src1, OperandX64 src2)
+{
+    placeAvx("vsubsd", dst, src1, src2, 0x5c, false, AVX_0F, AVX_F2);
+}
+
+void AssemblyBuilderX64::vmulsd(OperandX64 dst, OperandX64 src1, OperandX64 src2)
+{
+    placeAvx("vmulsd", dst, src1, src2, 0x59, false, AVX_0F, AVX_F2);
+}
+
+void AssemblyBuilderX64::vdivsd(OperandX64 dst, OperandX64 src1, OperandX64 src2)
+{
+    placeAvx("vdivsd", dst, src1, src2, 0x5e, false, AVX_0F, AVX_F2);
+}
+
+void AssemblyBuilderX64::vcvttsd2si(OperandX64 dst, OperandX64 src)
+{
+    placeAvx("vcvttsd2si", dst, src, 0x2c, dst.base.size == SizeX64::qword, AVX_0F, AVX_F2);
+}
+
+void AssemblyBuilderX64::vcvtsi2sd(OperandX64 dst, OperandX64 src1, OperandX64 src2)
+{
+    SizeX64 size = src2.cat == CategoryX64::reg ? src2.base.size : src2.memSize;
+
+    placeAvx("vcvtsi2sd", dst, src1, src2, 0x2a, size == SizeX64::qword, AVX_0F, AVX_F2);
+}
+
+void AssemblyBuilderX64::vucomisd(OperandX64 src1, OperandX64 src2)
+{
+    placeAvx("vucomisd", src1, src2, 0x2e, false, AVX_0F, AVX_66);
+}
+
 void AssemblyBuilderX64::vsqrtpd(OperandX64 dst, OperandX64 src)
 {
     placeAvx("vsqrtpd", dst, src, 0x51, false, AVX_0F, AVX_66);
@@ -393,6 +451,24 @@ void AssemblyBuilderX64::finalize()
     finalized = true;
 }
 
+bool AssemblyBuilderX64::relocate(const uint8_t* codeAddress)
+{
+    LUAU_ASSERT(finalized);
+
+    for (ExternalCall call : externalCalls)
+    {
+        int64_t value = int64_t(uintptr_t(call.target)) - int64_t(uintptr_t(codeAddress + call.location + 4));
+
+        if (value < INT32_MIN || value > INT32_MAX)
+            return false;
+
+        int32_t displacement = int32_t(value);
+        memcpy(&code[call.location], &displacement, sizeof(displacement));
+    }
+
+    return true;
+}
+
 Label AssemblyBuilderX64::setLabel()
 {
     Label label{nextLabel++, getCodeSize()};
@@ -471,9 +547,9 @@ void AssemblyBuilderX64::placeBinaryRegMemAndImm(OperandX64 lhs, OperandX64 rhs,
     LUAU_ASSERT(lhs.cat == CategoryX64::reg || lhs.cat == CategoryX64::mem);
     LUAU_ASSERT(rhs.cat == CategoryX64::imm);
 
-    SizeX64 size = lhs.base.size;
+    SizeX64 size = lhs.cat == CategoryX64::reg ? lhs.base.size : lhs.memSize;
 
-    placeRex(lhs.base);
+    placeRex(lhs);
 
     if (size == SizeX64::byte)
     {
@@ -0,0 +1,320 @@
+// This file is part of the Luau programming language and is licensed under MIT License; see LICENSE.txt for details
+#include "Luau/CodeAllocator.h"
+
+#include "Luau/Common.h"
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace Luau
+{
+namespace CodeGen
+{
+
+#if defined(_WIN32)
+static uint8_t* reserveMemory(void* hint, size_t size)
+{
+    return static_cast<uint8_t*>(VirtualAlloc(hint, size, MEM_RESERVE, PAGE_NOACCESS));
+}
+
+static void releaseMemory(uint8_t* memory, size_t size)
+{
+    VirtualFree(memory, 0, MEM_RELEASE);
+}
+
+static bool commitMemory(uint8_t* memory, size_t size)
+{
+    return VirtualAlloc(memory, size, MEM_COMMIT, PAGE_READWRITE) != nullptr;
+}
+
+static void decommitMemory(uint8_t* memory, size_t size)
+{
+    VirtualFree(memory, size, MEM_DECOMMIT);
+}
+
+static bool protectExecutable(uint8_t* memory, size_t size)
+{
+    DWORD oldProtect;
+    if (!VirtualProtect(memory, size, PAGE_EXECUTE_READ, &oldProtect))
+        return false;
+
+    FlushInstructionCache(GetCurrentProcess(), memory, size);
+    return true;
+}
+#else
+static uint8_t* reserveMemory(void* hint, size_t size)
+{
+    void* memory = mmap(hint, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    return memory == MAP_FAILED ? nullptr : static_cast<uint8_t*>(memory);
+}
+
+static void releaseMemory(uint8_t* memory, size_t size)
+{
+    munmap(memory, size);
+}
+
+static bool commitMemory(uint8_t* memory, size_t size)
+{
+    return mprotect(memory, size, PROT_READ | PROT_WRITE) == 0;
+}
+
+static void decommitMemory(uint8_t* memory, size_t size)
+{
+    mprotect(memory, size, PROT_NONE);
+    madvise(memory, size, MADV_DONTNEED);
+}
+
+static bool protectExecutable(uint8_t* memory, size_t size)
+{
+    return mprotect(memory, size, PROT_READ | PROT_EXEC) == 0;
+}
+#endif
+
+static bool isRangeReachable(const uint8_t* start, size_t size, const void* target)
+{
+    // a rel32 displacement is relative to the end of the instruction, which can be anywhere in the range
+    int64_t lo = int64_t(uintptr_t(target)) - int64_t(uintptr_t(start));
+    int64_t hi = int64_t(uintptr_t(target)) - int64_t(uintptr_t(start + size));
+
+    return lo >= INT32_MIN && lo <= INT32_MAX && hi >= INT32_MIN && hi <= INT32_MAX;
+}
+
+static uint64_t getFullSlotMask(size_t slotSize)
+{
+    size_t slots = CodeAllocator::kPageSize / slotSize;
+
+    return slots == 64 ? ~0ull : (1ull << slots) - 1;
+}
+
+CodeAllocator::CodeAllocator(size_t reserveSize, const void* nearAddress)
+{
+    size_t count = (reserveSize + kPageSize - 1) / kPageSize;
+    size_t size = count * kPageSize;
+
+    // the OS treats the address as a hint, so the result is checked; the candidates step away from the target in both directions
+    const uintptr_t kStep = uintptr_t(256) << 20;
+    uintptr_t near = uintptr_t(nearAddress) & ~(kStep - 1);
+
+    for (uintptr_t i = 1; i <= 4 && !base; ++i)
+    {
+        for (uintptr_t hint : {near + i * kStep, near - i * kStep - size})
+        {
+            uint8_t* memory = reserveMemory(reinterpret_cast<void*>(hint), size);
+
+            if (memory && isRangeReachable(memory, size, nearAddress))
+            {
+                base = memory;
+                break;
+            }
+
+            if (memory)
+                releaseMemory(memory, size);
+        }
+    }
+
+    // code placed anywhere else still works, it just has to call functions through a register
+    if (!base)
+        base = reserveMemory(nullptr, size);
+
+    if (base)
+    {
+        pageCount = count;
+        pages.resize(count);
+    }
+}
+
+CodeAllocator::~CodeAllocator()
+{
+    if (base)
+        releaseMemory(base, pageCount * kPageSize);
+}
+
+void CodeAllocator::beginWrite()
+{
+    LUAU_ASSERT(!writing);
+    writing = true;
+}
+
+uint8_t* CodeAllocator::allocate(size_t size)
+{
+    LUAU_ASSERT(writing);
+    LUAU_ASSERT(size > 0);
+
+    if (size_t slotSize = getSizeClass(size))
+        return allocateSlot(slotSize);
+
+    return allocateRun((size + kPageSize - 1) / kPageSize);
+}
+
+bool CodeAllocator::endWrite()
+{
+    LUAU_ASSERT(writing);
+    writing = false;
+
+    bool success = true;
+
+    for (size_t i = 0; i < pageCount;)
+    {
+        if (!pages[i].writable)
+        {
+            i++;
+            continue;
+        }
+
+        size_t first = i;
+
+        for (; i < pageCount && pages[i].writable; ++i)
+            pages[i].writable = false;
+
+        if (!protectExecutable(base + first * kPageSize, (i - first) * kPageSize))
+            success = false;
+    }
+
+    return success;
+}
+
+void CodeAllocator::deallocate(uint8_t* memory, size_t size)
+{
+    LUAU_ASSERT(memory >= base && memory < base + pageCount * kPageSize);
+
+    size_t index = (memory - base) / kPageSize;
+    Page& page = pages[index];
+
+    size_t count = 1;
+
+    if (size_t slotSize = getSizeClass(size))
+    {
+        LUAU_ASSERT(page.slotSize == slotSize);
+
+        uint64_t bit = 1ull << ((memory - base) % kPageSize / slotSize);
+        LUAU_ASSERT(page.slotMask & bit);
+
+        page.slotMask &= ~bit;
+        allocatedSize -= slotSize;
+
+        if (page.slotMask != 0)
+            return;
+    }
+    else
+    {
+        count = page.runLength;
+        LUAU_ASSERT(count == (size + kPageSize - 1) / kPageSize);
+
+        allocatedSize -= count * kPageSize;
+    }
+
+    // the pages don't hold any live code anymore, so they are returned to the OS and can receive new code of any size
+    for (size_t i = index; i < index + count; ++i)
+        pages[i] = Page();
+
+    decommitMemory(base + index * kPageSize, count * kPageSize);
+}
+
+bool CodeAllocator::isReachable(const void* target) const
+{
+    return base && isRangeReachable(base, pageCount * kPageSize, target);
+}
+
+size_t CodeAllocator::getSizeClass(size_t size) const
+{
+    if (size > kPageSize / 2)
+        return 0;
+
+    size_t slotSize = kMinAlignment;
+
+    while (slotSize < size)
+        slotSize *= 2;
+
+    return slotSize;
+}
+
+uint8_t* CodeAllocator::allocateSlot(size_t slotSize)
+{
+    uint64_t fullMask = getFullSlotMask(slotSize);
+
+    // only pages opened in this batch accept new code, since they can't be running yet
+    for (size_t i = 0; i < pageCount; ++i)
+    {
+        Page& page = pages[i];
+
+        if (page.writable && page.slotSize == slotSize && page.slotMask != fullMask)
+        {
+            unsigned int slot = 0;
+            while (page.slotMask & (1ull << slot))
+                slot++;
+
+            page.slotMask |= 1ull << slot;
+            allocatedSize += slotSize;
+
+            return base + i * kPageSize + slot * slotSize;
+        }
+    }
+
+    uint8_t* memory = allocateRun(1);
+
+    if (!memory)
+        return nullptr;
+
+    // the page was set up as a run, turn it into a slot page
+    Page& page = pages[(memory - base) / kPageSize];
+    page.runLength = 0;
+    page.slotSize = uint32_t(slotSize);
+    page.slotMask = 1;
+
+    allocatedSize += slotSize - kPageSize;
+
+    return memory;
+}
+
+uint8_t* CodeAllocator::allocateRun(size_t count)
+{
+    for (size_t i = 0; i + count <= pageCount;)
+    {
+        size_t length = 0;
+
+        while (length < count && !pages[i + length].used)
+            length++;
+
+        if (length < count)
+        {
+            i += length + 1;
+            continue;
+        }
+
+        if (!makeWritable(i, count))
+            return nullptr;
+
+        pages[i].runLength = uint32_t(count);
+        allocatedSize += count * kPageSize;
+
+        return base + i * kPageSize;
+    }
+
+    return nullptr;
+}
+
+bool CodeAllocator::makeWritable(size_t first, size_t count)
+{
+    if (!commitMemory(base + first * kPageSize, count * kPageSize))
+        return false;
+
+    for (size_t i = first; i < first + count; ++i)
+    {
+        pages[i].used = true;
+        pages[i].writable = true;
+    }
+
+    return true;
+}
+
+} // namespace CodeGen
+} // namespace Luau
@@ -0,0 +1,902 @@
+// This file is part of the Luau programming language and is licensed under MIT License; see LICENSE.txt for details
+#include "Luau/CodeGen.h"
+
+#include "Luau/AssemblyBuilderX64.h"
+#include "Luau/Bytecode.h"
+#include "Luau/CodeAllocator.h"
+#include "Luau/UnwindBuilder.h"
+
+#include "EmitCommonX64.h"
+#include "EmitInstructionX64.h"
+
+#include "lapi.h"
+#include "lbuiltins.h"
+#include "ldo.h"
+#include "lvm.h"
+
+#include <exception>
+#include <mutex>
+#include <vector>
+
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__linux__)
+#include <unistd.h>
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64)
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+// Native code is a straight translation of the bytecode: every instruction of a function gets a fast path for the common operand types,
+// and everything else - metamethods, errors, rarely used instructions - runs through the interpreter one instruction at a time. Native
+// code never calls into the VM directly; helpers like executeFallback catch any errors, so exceptions never unwind native frames. The
+// frames are still described to the system unwinder, for debuggers and profilers.
+// When an instruction changes the active frame, native code continues in the new frame if it has native code as well, and returns to
+// the glue in onEnter otherwise.
+
+namespace Luau
+{
+namespace CodeGen
+{
+
+typedef void (*NativeEntry)(lua_State* L, const uint8_t* target);
+
+// Address space reserved for native code of a state; functions that don't fit stay in the interpreter
+constexpr size_t kCodeReserveSize = 256 * 1024 * 1024;
+
+struct NativeProto
+{
+    // data and code of the function, allocated by the CodeAllocator of the state
+    uint8_t* memory = nullptr;
+    size_t size = 0;
+
+    NativeEntry entry = nullptr;
+
+    // native code location for every instruction start; aux words have no native code
+    std::vector<const uint8_t*> instTargets;
+
+    // call frame information for the code, registered with the system unwinder once the code is executable
+    std::vector<uint8_t> unwind;
+    bool unwindRegistered = false;
+};
+
+static const uint8_t* executeFallback(lua_State* L);
+
+// perf map of the process, shared by all states; see enablePerfMap
+static std::mutex perfMapMutex;
+static FILE* perfMap = nullptr;
+
+struct NativeState
+{
+    // placed close to the helpers, so that native code can call them directly
+    CodeAllocator codeAllocator{kCodeReserveSize, reinterpret_cast<const void*>(&executeFallback)};
+
+    // error raised by an instruction that was running in the interpreter; rethrown once native code returns
+    std::exception_ptr pending;
+
+    // set when the interpreter has to exit after the instruction, because the thread was suspended or the entry frame returned
+    bool leave = false;
+};
+
+static int getOpLength(LuauOpcode op)
+{
+    switch (op)
+    {
+    case LOP_GETGLOBAL:
+    case LOP_SETGLOBAL:
+    case LOP_GETIMPORT:
+    case LOP_GETTABLEKS:
+    case LOP_SETTABLEKS:
+    case LOP_NAMECALL:
+    case LOP_JUMPIFEQ:
+    case LOP_JUMPIFLE:
+    case LOP_JUMPIFLT:
+    case LOP_JUMPIFNOTEQ:
+    case LOP_JUMPIFNOTLE:
+    case LOP_JUMPIFNOTLT:
+    case LOP_NEWTABLE:
+    case LOP_SETLIST:
+    case LOP_FORGLOOP:
+    case LOP_LOADKX:
+    case LOP_JUMPIFEQK:
+    case LOP_JUMPIFNOTEQK:
+    case LOP_FASTCALL2:
+    case LOP_FASTCALL2K:
+    case LOP_GETIMPORT_MOVE:
+        return 2;
+
+    default:
+        return 1;
+    }
+}
+
+// Fused instructions start with the operands of the first instruction of the pair; the second one is compiled on its own
+static LuauOpcode getUnfusedOpcode(LuauOpcode op)
+{
+    switch (op)
+    {
+    case LOP_MOVE_MOVE:
+    case LOP_MOVE_CALL:
+        return LOP_MOVE;
+    case LOP_LOADN_LOADN:
+        return LOP_LOADN;
+    case LOP_GETUPVAL_CALL:
+    case LOP_GETUPVAL_GETTABLEKS:
+        return LOP_GETUPVAL;
+    case LOP_GETIMPORT_MOVE:
+        return LOP_GETIMPORT;
+    case LOP_GETTABLE_GETTABLE:
+    case LOP_GETTABLE_ADD:
+        return LOP_GETTABLE;
+    case LOP_ADD_GETTABLE:
+        return LOP_ADD;
+
+    default:
+        return op;
+    }
+}
+
+// Returns the native code for the instruction the active frame continues with, or null when the function doesn't have native code
+static const uint8_t* getNativeTarget(lua_State* L)
+{
+    Proto* p = clvalue(L->ci->func)->l.p;
+    NativeProto* np = static_cast<NativeProto*>(p->execdata);
+
+    if (!np)
+        return nullptr;
+
+    return np->instTargets[L->ci->savedpc - p->code];
+}
+
+// Runs the instruction at L->ci->savedpc in the interpreter; returns the native code to continue with, or null when native code has to
+// return to onEnter
+static const uint8_t* executeFallback(lua_State* L)
+{
+    NativeState* state = static_cast<NativeState*>(L->global->ecb.context);
+
+    CallInfo* ci = L->ci;
+
+    // the interpreter exits when the frame it was entered with returns
+    bool leaving = LUAU_INSN_OP(*ci->savedpc) == LOP_RETURN && (ci->flags & LUA_CALLINFO_RETURN);
+
+    try
+    {
+        luau_executefallback(L);
+    }
+    catch (...)
+    {
+        state->pending = std::current_exception();
+        return nullptr;
+    }
+
+    if (leaving || L->status != 0)
+    {
+        state->leave = true;
+        return nullptr;
+    }
+
+    // calls and returns change the active frame, which may not have native code
+    return getNativeTarget(L);
+}
+
+// CALL and RETURN follow the interpreter, but skip its dispatch; interrupts and __call metamethods are still left to it
+static const uint8_t* executeCall(lua_State* L, const Instruction* pc)
+{
+    NativeState* state = static_cast<NativeState*>(L->global->ecb.context);
+
+    Instruction insn = *pc;
+    StkId ra = L->base + LUAU_INSN_A(insn);
+
+    if (L->global->cb.interrupt || !ttisfunction(ra))
+    {
+        L->ci->savedpc = pc;
+        return executeFallback(L);
+    }
+
+    int nparams = LUAU_INSN_B(insn) - 1;
+    int nresults = LUAU_INSN_C(insn) - 1;
+
+    StkId argtop = (nparams == LUA_MULTRET) ? L->top : ra + 1 + nparams;
+
+    Closure* ccl = clvalue(ra);
+    L->ci->savedpc = pc + 1;
+
+    try
+    {
+        CallInfo* ci = incr_ci(L);
+        ci->func = ra;
+        ci->base = ra + 1;
+        ci->top = argtop + ccl->stacksize;
+        ci->savedpc = NULL;
+        ci->flags = 0;
+        ci->nresults = nresults;
+
+        L->base = ci->base;
+        L->top = argtop;
+
+        // reallocates the stack, so ra and argtop can't be used after this
+        luaD_checkstack(L, ccl->stacksize);
+
+        if (!ccl->isC)
+        {
+            Proto* p = ccl->l.p;
+
+            StkId argi = L->top;
+            StkId argend = L->base + p->numparams;
+            while (argi < argend)
+                setnilvalue(argi++);
+            L->top = p->is_vararg ? argi : ci->top;
+
+            // the interpreter picks up the frame from here if the function doesn't have native code
+            ci->savedpc = p->code;
+            return getNativeTarget(L);
+        }
+
+        int n = ccl->c.f(L);
+
+        if (n < 0)
+        {
+            state->leave = true;
+            return nullptr;
+        }
+
+        // the function may have reallocated the call stack
+        ci = L->ci;
+        CallInfo* cip = ci - 1;
+
+        StkId res = ci->func;
+        StkId vali = L->top - n;
+        StkId valend = L->top;
+
+        int i;
+        for (i = nresults; i != 0 && vali < valend; i--)
+            setobjs2s(L, res++, vali++);
+        while (i-- > 0)
+            setnilvalue(res++);
+
+        L->ci = cip;
+        L->base = cip->base;
+        L->top = (nresults == LUA_MULTRET) ? res : cip->top;
+
+        return getNativeTarget(L);
+    }
+    catch (...)
+    {
+        state->pending = std::current_exception();
+        return nullptr;
+    }
+}
+
+static const uint8_t* executeReturn(lua_State* L, const Instruction* pc)
+{
+    NativeState* state = static_cast<NativeState*>(L->global->ecb.context);
+
+    if (L->global->cb.interrupt)
+    {
+        L->ci->savedpc = pc;
+        return executeFallback(L);
+    }
+
+    Instruction insn = *pc;
+    StkId ra = L->base + LUAU_INSN_A(insn);
+    int b = LUAU_INSN_B(insn) - 1;
+
+    CallInfo* ci = L->ci;
+    CallInfo* cip = ci - 1;
+
+    StkId res = ci->func;
+    StkId vali = ra;
+    StkId valend = (b == LUA_MULTRET) ? L->top : ra + b;
+
+    int nresults = ci->nresults;
+
+    int i;
+    for (i = nresults; i != 0 && vali < valend; i--)
+        setobjs2s(L, res++, vali++);
+    while (i-- > 0)
+        setnilvalue(res++);
+
+    L->ci = cip;
+    L->base = cip->base;
+    L->top = (nresults == LUA_MULTRET) ? res : cip->top;
+
+    // the interpreter exits when the frame it was entered with returns
+    if (ci->flags & LUA_CALLINFO_RETURN)
+    {
+        L->top = res;
+        state->leave = true;
+        return nullptr;
+    }
+
+    return getNativeTarget(L);
+}
+
+// Runs the builtin of a FASTCALL1, FASTCALL2 or FASTCALL2K instruction like the interpreter does; returns 1 when it succeeded and the call
+// is skipped, 0 when the call has to run and -1 when the builtin raised an error
+static int executeFastcall(lua_State* L, const Instruction* pc)
+{
+    NativeState* state = static_cast<NativeState*>(L->global->ecb.context);
+
+    Instruction insn = *pc;
+    LuauOpcode op = LuauOpcode(LUAU_INSN_OP(insn));
+
+    Closure* cl = clvalue(L->ci->func);
+    StkId base = L->base;
+
+    luau_FastFunction f = luauF_table[LUAU_INSN_A(insn)];
+
+    if (!f || !cl->env->safeenv)
+        return 0;
+
+    Instruction call = pc[1 + LUAU_INSN_C(insn)];
+    LUAU_ASSERT(LUAU_INSN_OP(call) == LOP_CALL);
+
+    StkId ra = base + LUAU_INSN_A(call);
+    int nresults = LUAU_INSN_C(call) - 1;
+
+    TValue* arg1 = base + LUAU_INSN_B(insn);
+    TValue* arg2 = op == LOP_FASTCALL2 ? base + pc[1] : op == LOP_FASTCALL2K ? &cl->l.p->k[pc[1]] : nullptr;
+    int nparams = op == LOP_FASTCALL1 ? 1 : 2;
+
+    L->ci->savedpc = pc + getOpLength(op);
+
+    int n = -1;
+
+    try
+    {
+        n = f(L, ra, arg1, nresults, arg2, nparams);
+    }
+    catch (...)
+    {
+        state->pending = std::current_exception();
+        return -1;
+    }
+
+    if (n < 0)
+        return 0;
+
+    L->top = (nresults == LUA_MULTRET) ? ra + n : L->ci->top;
+    return 1;
+}
+
+static void emitCall(AssemblyBuilderX64& build, NativeState& state, const void* function)
+{
+    if (state.codeAllocator.isReachable(function))
+    {
+        build.call(function);
+    }
+    else
+    {
+        build.mov64(rax, int64_t(function));
+        build.call(rax);
+    }
+}
+
+static void emitInstFastCall(AssemblyBuilderX64& build, NativeState& state, const Instruction* pc, int pcpos, Label* labelarr, Label& exit)
+{
+    build.mov(rArg1, rState);
+    build.mov64(rArg2, int64_t(pc));
+    emitCall(build, state, reinterpret_cast<const void*>(&executeFastcall));
+
+    // on success, the instructions that set up the call and the call itself are skipped
+    build.test(eax, eax);
+    build.jcc(Condition::Less, exit);
+    build.jcc(Condition::Greater, labelarr[pcpos + 1 + LUAU_INSN_C(*pc) + 1]);
+}
+
+// Calls a helper that takes the state and the instruction and returns the native code to continue with
+static void emitHelperCall(AssemblyBuilderX64& build, NativeState& state, const Instruction* pc, const void* helper, Label& dispatch)
+{
+    build.mov(rArg1, rState);
+    build.mov64(rArg2, int64_t(pc));
+    emitCall(build, state, helper);
+    build.jmp(dispatch);
+}
+
+static bool emitInstruction(AssemblyBuilderX64& build, NativeState& state, Proto* proto, const Instruction* pc, int i, Label* labelarr,
+    Label& fallback, Label& dispatch, Label& exit)
+{
+    LuauOpcode op = LuauOpcode(LUAU_INSN_OP(*pc));
+    LuauOpcode unfusedOp = getUnfusedOpcode(op);
+
+    if (unfusedOp != op)
+    {
+        // the emitters only read the operands, so they get a copy with the original opcode; fallbacks still use the fused instruction
+        Instruction unfused[2] = {(pc[0] & ~0xffu) | unfusedOp, getOpLength(op) > 1 ? pc[1] : 0};
+
+        return emitInstruction(build, state, proto, unfused, i, labelarr, fallback, dispatch, exit);
+    }
+
+    switch (op)
+    {
+    case LOP_NOP:
+        return true;
+    case LOP_LOADNIL:
+        emitInstLoadNil(build, pc);
+        return true;
+    case LOP_LOADB:
+        emitInstLoadB(build, pc, i, labelarr);
+        return true;
+    case LOP_LOADN:
+        emitInstLoadN(build, pc);
+        return true;
+    case LOP_LOADK:
+        emitInstLoadK(build, pc);
+        return true;
+    case LOP_MOVE:
+        emitInstMove(build, pc);
+        return true;
+    case LOP_GETUPVAL:
+        emitInstGetUpval(build, pc);
+        return true;
+    case LOP_JUMP:
+        emitInstJump(build, pc, i, labelarr);
+        return true;
+    case LOP_JUMPBACK:
+        emitInstJumpBack(build, pc, i, labelarr, fallback);
+        return true;
+    case LOP_JUMPIF:
+        emitInstJumpIf(build, pc, i, labelarr, /* not_= */ false);
+        return true;
+    case LOP_JUMPIFNOT:
+        emitInstJumpIf(build, pc, i, labelarr, /* not_= */ true);
+        return true;
+    case LOP_JUMPIFEQ:
+        emitInstJumpIfEq(build, pc, i, labelarr, /* not_= */ false, fallback);
+        return true;
+    case LOP_JUMPIFNOTEQ:
+        emitInstJumpIfEq(build, pc, i, labelarr, /* not_= */ true, fallback);
+        return true;
+    case LOP_JUMPIFLT:
+    case LOP_JUMPIFLE:
+    case LOP_JUMPIFNOTLT:
+    case LOP_JUMPIFNOTLE:
+        emitInstJumpIfCond(build, pc, i, labelarr, fallback);
+        return true;
+    case LOP_JUMPIFEQK:
+        emitInstJumpIfEqK(build, pc, i, proto->k, labelarr, /* not_= */ false);
+        return true;
+    case LOP_JUMPIFNOTEQK:
+        emitInstJumpIfEqK(build, pc, i, proto->k, labelarr, /* not_= */ true);
+        return true;
+    case LOP_NOT:
+        emitInstNot(build, pc);
+        return true;
+    case LOP_MINUS:
+        emitInstMinus(build, pc, fallback);
+        return true;
+    case LOP_ADD:
+    case LOP_SUB:
+    case LOP_MUL:
+    case LOP_DIV:
+        emitInstBinaryNumeric(build, pc, fallback);
+        return true;
+    case LOP_ADDK:
+    case LOP_SUBK:
+    case LOP_MULK:
+    case LOP_DIVK:
+        if (!ttisnumber(&proto->k[LUAU_INSN_C(*pc)]))
+            return false;
+
+        emitInstBinaryNumericK(build, pc, fallback);
+        return true;
+    case LOP_AND:
+        emitInstAnd(build, pc);
+        return true;
+    case LOP_ANDK:
+        emitInstAndK(build, pc);
+        return true;
+    case LOP_OR:
+        emitInstOr(build, pc);
+        return true;
+    case LOP_ORK:
+        emitInstOrK(build, pc);
+        return true;
+    case LOP_GETGLOBAL:
+        emitInstGetGlobal(build, pc, fallback);
+        return true;
+    case LOP_SETGLOBAL:
+        emitInstSetGlobal(build, pc, fallback);
+        return true;
+    case LOP_GETIMPORT:
+        if (ttisnil(&proto->k[LUAU_INSN_D(*pc)]))
+            return false;
+
+        emitInstGetImport(build, pc, fallback);
+        return true;
+    case LOP_GETTABLEKS:
+        emitInstGetTableKS(build, pc, fallback);
+        return true;
+    case LOP_SETTABLEKS:
+        emitInstSetTableKS(build, pc, fallback);
+        return true;
+    case LOP_GETTABLEN:
+        emitInstGetTableN(build, pc, fallback);
+        return true;
+    case LOP_SETTABLEN:
+        emitInstSetTableN(build, pc, fallback);
+        return true;
+    case LOP_GETTABLE:
+        emitInstGetTable(build, pc, fallback);
+        return true;
+    case LOP_SETTABLE:
+        emitInstSetTable(build, pc, fallback);
+        return true;
+    case LOP_CALL:
+        emitHelperCall(build, state, pc, reinterpret_cast<const void*>(&executeCall), dispatch);
+        return true;
+    case LOP_RETURN:
+        emitHelperCall(build, state, pc, reinterpret_cast<const void*>(&executeReturn), dispatch);
+        return true;
+    case LOP_FASTCALL1:
+    case LOP_FASTCALL2:
+    case LOP_FASTCALL2K:
+        emitInstFastCall(build, state, pc, i, labelarr, exit);
+        return true;
+    case LOP_FORNPREP:
+        emitInstForNPrep(build, pc, i, labelarr, fallback);
+        return true;
+    case LOP_FORNLOOP:
+        emitInstForNLoop(build, pc, i, labelarr, fallback);
+        return true;
+    default:
+        return false;
+    }
+}
+
+static NativeProto* assembleFunction(NativeState& state, Proto* proto)
+{
+    AssemblyBuilderX64 build(/* logText= */ false);
+
+    std::vector<Label> instLabels(proto->sizecode);
+    std::vector<Label> instFallbacks(proto->sizecode);
+
+    Label fallback;
+    Label dispatch;
+    Label exit;
+
+    // the frame set up by the entry gateway stays the same while native code jumps between functions, so each function describes it
+    UnwindBuilder unwind;
+    unwind.start();
+
+    // entry gateway: sets up the state registers and jumps to the requested instruction
+    for (RegisterX64 reg : {rState, rBase, rConstants})
+    {
+        build.push(reg);
+        unwind.push(build.setLabel().location, reg);
+    }
+
+    if (kShadowSpace != 0)
+    {
+        build.sub(rsp, kShadowSpace);
+        unwind.allocStack(build.setLabel().location, kShadowSpace);
+    }
+
+    build.mov(rState, rArg1);
+    build.mov(rBase, qword[rState + offsetof(lua_State, base)]);
+    build.mov64(rConstants, int64_t(proto->k));
+    build.jmp(rArg2);
+
+    for (int i = 0; i < proto->sizecode;)
+    {
+        const Instruction* pc = &proto->code[i];
+
+        build.setLabel(instLabels[i]);
+
+        if (!emitInstruction(build, state, proto, pc, i, instLabels.data(), instFallbacks[i], dispatch, exit))
+        {
+            build.mov64(rax, int64_t(pc));
+            build.jmp(fallback);
+        }
+
+        i += getOpLength(LuauOpcode(LUAU_INSN_OP(*pc)));
+    }
+
+    for (int i = 0; i < proto->sizecode; ++i)
+    {
+        if (instFallbacks[i].id != 0)
+        {
+            build.setLabel(instFallbacks[i]);
+            build.mov64(rax, int64_t(&proto->code[i]));
+            build.jmp(fallback);
+        }
+    }
+
+    // rax holds the instruction to run in the interpreter
+    build.setLabel(fallback);
+    build.mov(rcx, qword[rState + offsetof(lua_State, ci)]);
+    build.mov(qword[rcx + offsetof(CallInfo, savedpc)], rax);
+    build.mov(rArg1, rState);
+    emitCall(build, state, reinterpret_cast<const void*>(&executeFallback));
+
+    // rax holds the native code to continue with, which may belong to another function
+    build.setLabel(dispatch);
+    build.test(rax, rax);
+    build.jcc(Condition::Zero, exit);
+    build.mov(rBase, qword[rState + offsetof(lua_State, base)]);
+    loadClosure(build, rcx);
+    build.mov(rcx, qword[rcx + offsetof(Closure, l.p)]);
+    build.mov(rConstants, qword[rcx + offsetof(Proto, k)]);
+    build.jmp(rax);
+
+    build.setLabel(exit);
+
+    if (kShadowSpace != 0)
+    {
+        build.add(rsp, kShadowSpace);
+        unwind.freeStack(build.setLabel().location, kShadowSpace);
+    }
+
+    for (RegisterX64 reg : {rConstants, rBase, rState})
+    {
+        build.pop(reg);
+        unwind.pop(build.setLabel().location);
+    }
+
+    build.ret();
+
+    build.finalize();
+    unwind.finish();
+
+    // constants are addressed relative to the code, which starts right after them at a 16 byte boundary
+    size_t dataOffset = (16 - build.data.size() % 16) % 16;
+    size_t codeOffset = dataOffset + build.data.size();
+    size_t size = codeOffset + build.code.size();
+
+    uint8_t* memory = state.codeAllocator.allocate(size);
+    if (!memory)
+        return nullptr;
+
+    // direct calls are only emitted for helpers that every address of the allocator can reach
+    if (!build.relocate(memory + codeOffset))
+    {
+        LUAU_ASSERT(!"Helper call out of range");
+        state.codeAllocator.deallocate(memory, size);
+        return nullptr;
+    }
+
+    if (!build.data.empty())
+        memcpy(memory + dataOffset, build.data.data(), build.data.size());
+    memcpy(memory + codeOffset, build.code.data(), build.code.size());
+
+    NativeProto* result = new NativeProto();
+    result->memory = memory;
+    result->size = size;
+    result->entry = reinterpret_cast<NativeEntry>(memory + codeOffset);
+
+    unwind.setCodeRange(memory + codeOffset, build.code.size());
+    result->unwind = std::move(unwind.data);
+
+    result->instTargets.resize(proto->sizecode);
+
+    for (int i = 0; i < proto->sizecode; ++i)
+        if (instLabels[i].id != 0)
+            result->instTargets[i] = memory + codeOffset + instLabels[i].location;
+
+    return result;
+}
+
+static void compileRecursive(NativeState& state, Proto* proto, std::vector<Proto*>& compiled)
+{
+    if (!proto->execdata)
+    {
+        proto->execdata = assembleFunction(state, proto);
+
+        if (proto->execdata)
+            compiled.push_back(proto);
+    }
+
+    for (int i = 0; i < proto->sizep; ++i)
+        compileRecursive(state, proto->p[i], compiled);
+}
+
+// Makes code that just became executable known to unwinders and profilers
+static void publishNativeProto(Proto* proto)
+{
+    NativeProto* np = static_cast<NativeProto*>(proto->execdata);
+
+    np->unwindRegistered = registerUnwindInfo(np->unwind.data());
+
+    std::unique_lock<std::mutex> lock(perfMapMutex);
+
+    if (perfMap)
+    {
+        char source[LUA_IDSIZE];
+        luaO_chunkid(source, proto->source ? getstr(proto->source) : "=?", LUA_IDSIZE);
+
+        // the symbol covers the code, but not the constants in front of it
+        const uint8_t* code = reinterpret_cast<const uint8_t*>(np->entry);
+        size_t codeSize = np->size - (code - np->memory);
+
+        fprintf(perfMap, "%llx %llx luau:%s %s:%d\n", (unsigned long long)(uintptr_t)code, (unsigned long long)codeSize,
+            proto->debugname ? getstr(proto->debugname) : "<anonymous>", source, proto->linedefined);
+        fflush(perfMap);
+    }
+}
+
+static void destroyNativeProto(NativeState& state, Proto* proto)
+{
+    NativeProto* np = static_cast<NativeProto*>(proto->execdata);
+
+    if (np->unwindRegistered)
+        unregisterUnwindInfo(np->unwind.data());
+
+    state.codeAllocator.deallocate(np->memory, np->size);
+    delete np;
+
+    proto->execdata = nullptr;
+}
+
+static void onCloseState(lua_State* L)
+{
+    delete static_cast<NativeState*>(L->global->ecb.context);
+    L->global->ecb = lua_ExecutionCallbacks();
+}
+
+static void onDestroyFunction(lua_State* L, Proto* proto)
+{
+    destroyNativeProto(*static_cast<NativeState*>(L->global->ecb.context), proto);
+}
+
+static int onEnter(lua_State* L, Proto* proto)
+{
+    NativeState* state = static_cast<NativeState*>(L->global->ecb.context);
+
+    for (;;)
+    {
+        Proto* p = clvalue(L->ci->func)->l.p;
+        NativeProto* np = static_cast<NativeProto*>(p->execdata);
+
+        // the interpreter continues with the frame
+        if (!np)
+            return 0;
+
+        np->entry(L, np->instTargets[L->ci->savedpc - p->code]);
+
+        if (state->pending)
+        {
+            std::exception_ptr pending = state->pending;
+            state->pending = nullptr;
+            std::rethrow_exception(pending);
+        }
+
+        if (state->leave)
+        {
+            state->leave = false;
+            return 1;
+        }
+    }
+}
+
+bool isSupported()
+{
+#if defined(__x86_64__) || defined(_M_X64)
+    unsigned int cpuinfo[4] = {};
+
+#ifdef _MSC_VER
+    __cpuid(reinterpret_cast<int*>(cpuinfo), 1);
+#else
+    __cpuid(1, cpuinfo[0], cpuinfo[1], cpuinfo[2], cpuinfo[3]);
+#endif
+
+    // AVX also needs the OS to preserve the vector registers, which it reports through OSXSAVE and XCR0
+    const unsigned int kOsxsave = 1 << 27;
+    const unsigned int kAvx = 1 << 28;
+
+    if ((cpuinfo[2] & (kOsxsave | kAvx)) != (kOsxsave | kAvx))
+        return false;
+
+#ifdef _MSC_VER
+    unsigned long long xcr0 = _xgetbv(0);
+#else
+    unsigned int xcr0lo, xcr0hi;
+    __asm__ volatile("xgetbv" : "=a"(xcr0lo), "=d"(xcr0hi) : "c"(0));
+    unsigned long long xcr0 = xcr0lo | (static_cast<unsigned long long>(xcr0hi) << 32);
+#endif
+
+    return (xcr0 & 6) == 6;
+#else
+    return false;
+#endif
+}
+
+static void onHotFunction(lua_State* L, Proto* proto)
+{
+    NativeState& state = *static_cast<NativeState*>(L->global->ecb.context);
+
+    // nested functions get their own counters, so only the function itself is compiled
+    state.codeAllocator.beginWrite();
+    proto->execdata = assembleFunction(state, proto);
+
+    bool success = state.codeAllocator.endWrite();
+
+    if (!proto->execdata)
+        return;
+
+    if (success)
+        publishNativeProto(proto);
+    else
+        destroyNativeProto(state, proto);
+}
+
+static NativeState& getNativeState(lua_State* L)
+{
+    global_State* g = L->global;
+
+    if (!g->ecb.context)
+    {
+        g->ecb.context = new NativeState();
+        g->ecb.close = onCloseState;
+        g->ecb.destroy = onDestroyFunction;
+        g->ecb.enter = onEnter;
+    }
+
+    LUAU_ASSERT(g->ecb.enter == onEnter);
+
+    return *static_cast<NativeState*>(g->ecb.context);
+}
+
+void compile(lua_State* L, int idx)
+{
+    LUAU_ASSERT(lua_isLfunction(L, idx));
+
+    if (!isSupported())
+        return;
+
+    NativeState& state = getNativeState(L);
+
+    const TValue* func = luaA_toobject(L, idx);
+    std::vector<Proto*> compiled;
+
+    // all functions are written in one batch, which lets them share pages
+    state.codeAllocator.beginWrite();
+    compileRecursive(state, clvalue(func)->l.p, compiled);
+
+    if (state.codeAllocator.endWrite())
+    {
+        for (Proto* proto : compiled)
+            publishNativeProto(proto);
+    }
+    else
+    {
+        for (Proto* proto : compiled)
+            destroyNativeProto(state, proto);
+    }
+}
+
+void setTieringThreshold(lua_State* L, unsigned int threshold)
+{
+    if (!isSupported())
+        return;
+
+    global_State* g = L->global;
+
+    getNativeState(L);
+
+    g->ecb.hot = threshold ? onHotFunction : nullptr;
+    g->ecb.hotthreshold = threshold;
+}
+
+void enablePerfMap()
+{
+#if defined(__linux__)
+    std::unique_lock<std::mutex> lock(perfMapMutex);
+
+    if (perfMap)
+        return;
+
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/perf-%d.map", int(getpid()));
+
+    perfMap = fopen(path, "w");
+#endif
+}
+
+} // namespace CodeGen
+} // namespace Luau
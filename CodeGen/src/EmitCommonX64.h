@@ -0,0 +1,136 @@
+// This file is part of the Luau programming language and is licensed under MIT License; see LICENSE.txt for details
+#pragma once
+
+#include "Luau/AssemblyBuilderX64.h"
+
+#include "lgc.h"
+#include "lobject.h"
+#include "lstate.h"
+
+#include <stddef.h>
+
+namespace Luau
+{
+namespace CodeGen
+{
+
+// Native code keeps the interpreter state in callee-saved registers; everything else it uses is a scratch register
+constexpr RegisterX64 rState = rbx;     // lua_State* L
+constexpr RegisterX64 rBase = r12;      // StkId base
+constexpr RegisterX64 rConstants = r13; // TValue* k
+
+#if defined(_WIN32)
+constexpr RegisterX64 rArg1 = rcx;
+constexpr RegisterX64 rArg2 = rdx;
+#else
+constexpr RegisterX64 rArg1 = rdi;
+constexpr RegisterX64 rArg2 = rsi;
+#endif
+
+// Win64 ABI requires the caller to reserve space for the callee to spill its register arguments
+#if defined(_WIN32)
+constexpr int kShadowSpace = 32;
+#else
+constexpr int kShadowSpace = 0;
+#endif
+
+static_assert(sizeof(TValue) % 8 == 0, "TValue copies are performed in qwords");
+
+// Table nodes are indexed with a shift; the key tag shares a dword with the 'next' bitfield, occupying its low 4 bits
+constexpr int kLuaNodeSizeLog2 = 5;
+constexpr int kOffsetOfLuaNodeKeyTag = int(offsetof(LuaNode, key) + offsetof(TKey, extra) + sizeof(TKey::extra));
+
+static_assert(sizeof(LuaNode) == (1 << kLuaNodeSizeLog2), "LuaNode size mismatch");
+
+inline OperandX64 luauReg(int ri)
+{
+    return xmmword[rBase + int32_t(ri * sizeof(TValue))];
+}
+
+inline OperandX64 luauRegValue(int ri)
+{
+    return qword[rBase + int32_t(ri * sizeof(TValue) + offsetof(TValue, value))];
+}
+
+inline OperandX64 luauRegBoolean(int ri)
+{
+    return dword[rBase + int32_t(ri * sizeof(TValue) + offsetof(TValue, value))];
+}
+
+inline OperandX64 luauRegTag(int ri)
+{
+    return dword[rBase + int32_t(ri * sizeof(TValue) + offsetof(TValue, tt))];
+}
+
+inline OperandX64 luauConstantValue(int ki)
+{
+    return qword[rConstants + int32_t(ki * sizeof(TValue) + offsetof(TValue, value))];
+}
+
+// Loads the closure of the running function
+inline void loadClosure(AssemblyBuilderX64& build, RegisterX64 reg)
+{
+    build.mov(reg, qword[rState + offsetof(lua_State, ci)]);
+    build.mov(reg, qword[reg + offsetof(CallInfo, func)]);
+    build.mov(reg, qword[reg + offsetof(TValue, value)]);
+}
+
+// Copies a TValue between two memory locations with rax as a temporary
+inline void copyTValue(AssemblyBuilderX64& build, RegisterX64 dst, int32_t dstoffset, RegisterX64 src, int32_t srcoffset)
+{
+    for (int32_t i = 0; i < int32_t(sizeof(TValue)); i += 8)
+    {
+        build.mov(rax, qword[src + srcoffset + i]);
+        build.mov(qword[dst + dstoffset + i], rax);
+    }
+}
+
+inline void jumpIfTagIsNot(AssemblyBuilderX64& build, int ri, lua_Type tag, Label& label)
+{
+    build.cmp(luauRegTag(ri), tag);
+    build.jcc(Condition::NotEqual, label);
+}
+
+// Branches to 'falsy' when the register holds nil or false, as l_isfalse does
+inline void jumpIfFalsy(AssemblyBuilderX64& build, int ri, Label& falsy, Label& truthy)
+{
+    build.mov(eax, luauRegTag(ri));
+    build.cmp(eax, LUA_TNIL);
+    build.jcc(Condition::Equal, falsy);
+    build.cmp(eax, LUA_TBOOLEAN);
+    build.jcc(Condition::NotEqual, truthy);
+    build.cmp(luauRegBoolean(ri), 0);
+    build.jcc(Condition::Equal, falsy);
+    build.jmp(truthy);
+}
+
+// Tables are only written to natively when they aren't readonly and don't need a write barrier for the stored value, which is the case
+// for non-collectable values and tables that aren't black
+inline void jumpIfTableStoreUnsafe(AssemblyBuilderX64& build, RegisterX64 table, int ri, Label& label)
+{
+    Label skip;
+
+    build.mov(edx, dword[table + offsetof(Table, readonly)]);
+    build.test(edx, 0xff);
+    build.jcc(Condition::NotZero, label);
+
+    build.cmp(luauRegTag(ri), LUA_TSTRING);
+    build.jcc(Condition::Less, skip);
+    build.mov(edx, dword[table + offsetof(Table, marked)]);
+    build.test(edx, bitmask(BLACKBIT));
+    build.jcc(Condition::NotZero, label);
+
+    build.setLabel(skip);
+}
+
+// Native code can't call the interrupt handler itself, so the instruction is left to the interpreter when one is installed
+inline void jumpIfInterruptSet(AssemblyBuilderX64& build, Label& label)
+{
+    build.mov(rax, qword[rState + offsetof(lua_State, global)]);
+    build.mov(rax, qword[rax + offsetof(global_State, cb) + offsetof(lua_Callbacks, interrupt)]);
+    build.test(rax, rax);
+    build.jcc(Condition::NotZero, label);
+}
+
+} // namespace CodeGen
+} // namespace Luau
@@ -0,0 +1,610 @@
+// This file is part of the Luau programming language and is licensed under MIT License; see LICENSE.txt for details
+#include "EmitInstructionX64.h"
+
+#include "Luau/AssemblyBuilderX64.h"
+#include "Luau/Bytecode.h"
+
+#include "EmitCommonX64.h"
+
+#include <string.h>
+
+namespace Luau
+{
+namespace CodeGen
+{
+
+void emitInstLoadNil(AssemblyBuilderX64& build, const Instruction* pc)
+{
+    int ra = LUAU_INSN_A(*pc);
+
+    build.mov(luauRegTag(ra), LUA_TNIL);
+}
+
+void emitInstLoadB(AssemblyBuilderX64& build, const Instruction* pc, int pcpos, Label* labelarr)
+{
+    int ra = LUAU_INSN_A(*pc);
+
+    build.mov(luauRegBoolean(ra), LUAU_INSN_B(*pc));
+    build.mov(luauRegTag(ra), LUA_TBOOLEAN);
+
+    if (int target = LUAU_INSN_C(*pc))
+        build.jmp(labelarr[pcpos + 1 + target]);
+}
+
+void emitInstLoadN(AssemblyBuilderX64& build, const Instruction* pc)
+{
+    int ra = LUAU_INSN_A(*pc);
+
+    double value = double(LUAU_INSN_D(*pc));
+    int64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    build.mov64(rax, bits);
+    build.mov(luauRegValue(ra), rax);
+    build.mov(luauRegTag(ra), LUA_TNUMBER);
+}
+
+void emitInstLoadK(AssemblyBuilderX64& build, const Instruction* pc)
+{
+    int ra = LUAU_INSN_A(*pc);
+
+    copyTValue(build, rBase, int32_t(ra * sizeof(TValue)), rConstants, int32_t(LUAU_INSN_D(*pc) * sizeof(TValue)));
+}
+
+void emitInstMove(AssemblyBuilderX64& build, const Instruction* pc)
+{
+    int ra = LUAU_INSN_A(*pc);
+    int rb = LUAU_INSN_B(*pc);
+
+    copyTValue(build, rBase, int32_t(ra * sizeof(TValue)), rBase, int32_t(rb * sizeof(TValue)));
+}
+
+void emitInstGetUpval(AssemblyBuilderX64& build, const Instruction* pc)
+{
+    int ra = LUAU_INSN_A(*pc);
+    int up = LUAU_INSN_B(*pc);
+
+    int32_t upoffset = int32_t(offsetof(Closure, l.uprefs) + up * sizeof(TValue));
+
+    build.mov(rax, qword[rState + offsetof(lua_State, ci)]);
+    build.mov(rax, qword[rax + offsetof(CallInfo, func)]);
+    build.mov(rax, qword[rax + offsetof(TValue, value)]);
+
+    // captured locals are referenced through an UpVal object, other upvalues are stored in the closure itself
+    Label copy;
+    build.lea(rcx, qword[rax + upoffset]);
+    build.cmp(dword[rax + upoffset + offsetof(TValue, tt)], LUA_TUPVAL);
+    build.jcc(Condition::NotEqual, copy);
+    build.mov(rcx, qword[rcx + offsetof(TValue, value)]);
+    build.mov(rcx, qword[rcx + offsetof(UpVal, v)]);
+
+    build.setLabel(copy);
+    copyTValue(build, rBase, int32_t(ra * sizeof(TValue)), rcx, 0);
+}
+
+void emitInstJump(AssemblyBuilderX64& build, const Instruction* pc, int pcpos, Label* labelarr)
+{
+    build.jmp(labelarr[pcpos + 1 + LUAU_INSN_D(*pc)]);
+}
+
+void emitInstJumpBack(AssemblyBuilderX64& build, const Instruction* pc, int pcpos, Label* labelarr, Label& fallback)
+{
+    jumpIfInterruptSet(build, fallback);
+
+    build.jmp(labelarr[pcpos + 1 + LUAU_INSN_D(*pc)]);
+}
+
+void emitInstJumpIf(AssemblyBuilderX64& build, const Instruction* pc, int pcpos, Label* labelarr, bool not_)
+{
+    int ra = LUAU_INSN_A(*pc);
+
+    Label& target = labelarr[pcpos + 1 + LUAU_INSN_D(*pc)];
+    Label& next = labelarr[pcpos + 1];
+
+    if (not_)
+        jumpIfFalsy(build, ra, target, next);
+    else
+        jumpIfFalsy(build, ra, next, target);
+}
+
+void emitInstJumpIfEq(AssemblyBuilderX64& build, const Instruction* pc, int pcpos, Label* labelarr, bool not_, Label& fallback)
+{
+    int ra = LUAU_INSN_A(*pc);
+    int rb = pc[1];
+
+    Label& target = labelarr[pcpos + 1 + LUAU_INSN_D(*pc)];
+    Label& next = labelarr[pcpos + 2];
+
+    Label& equal = not_ ? next : target;
+    Label& notequal = not_ ? target : next;
+
+    // values of different types are never equal; tables, userdata and vectors are left to the interpreter
+    Label number, boolean, pointer;
+
+    build.mov(eax, luauRegTag(ra));
+    build.cmp(eax, luauRegTag(rb));
+    build.jcc(Condition::NotEqual, notequal);
+
+    build.cmp(eax, LUA_TNUMBER);
+    build.jcc(Condition::Equal, number);
+    build.cmp(eax, LUA_TNIL);
+    build.jcc(Condition::Equal, equal);
+    build.cmp(eax, LUA_TBOOLEAN);
+    build.jcc(Condition::Equal, boolean);
+    build.cmp(eax, LUA_TLIGHTUSERDATA);
+    build.jcc(Condition::Equal, pointer);
+    build.cmp(eax, LUA_TSTRING);
+    build.jcc(Condition::Equal, pointer);
+    build.cmp(eax, LUA_TFUNCTION);
+    build.jcc(Condition::Equal, pointer);
+    build.cmp(eax, LUA_TTHREAD);
+    build.jcc(Condition::NotEqual, fallback);
+
+    build.setLabel(pointer);
+    build.mov(rax, luauRegValue(ra));
+    build.cmp(rax, luauRegValue(rb));
+    build.jcc(Condition::Equal, equal);
+    build.jmp(notequal);
+
+    build.setLabel(boolean);
+    build.mov(eax, luauRegBoolean(ra));
+    build.cmp(eax, luauRegBoolean(rb));
+    build.jcc(Condition::Equal, equal);
+    build.jmp(notequal);
+
+    build.setLabel(number);
+    build.vmovsd(xmm0, luauRegValue(ra));
+    build.vucomisd(xmm0, luauRegValue(rb));
+    build.jcc(Condition::Parity, notequal);
+    build.jcc(Condition::Equal, equal);
+    build.jmp(notequal);
+}
+
+void emitInstJumpIfCond(AssemblyBuilderX64& build, const Instruction* pc, int pcpos, Label* labelarr, Label& fallback)
+{
+    int ra = LUAU_INSN_A(*pc);
+    int rb = pc[1];
+
+    // operands are swapped so that every condition is false when the comparison is unordered, which matches the C comparison operators
+    Condition cond = Condition::Count;
+
+    switch (LUAU_INSN_OP(*pc))
+    {
+    case LOP_JUMPIFLT:
+        cond = Condition::Above;
+        break;
+    case LOP_JUMPIFLE:
+        cond = Condition::AboveEqual;
+        break;
+    case LOP_JUMPIFNOTLT:
+        cond = Condition::BelowEqual;
+        break;
+    case LOP_JUMPIFNOTLE:
+        cond = Condition::Below;
+        break;
+    default:
+        LUAU_ASSERT(!"Unsupported comparison");
+    }
+
+    jumpIfTagIsNot(build, ra, LUA_TNUMBER, fallback);
+    jumpIfTagIsNot(build, rb, LUA_TNUMBER, fallback);
+
+    build.vmovsd(xmm0, luauRegValue(rb));
+    build.vucomisd(xmm0, luauRegValue(ra));
+    build.jcc(cond, labelarr[pcpos + 1 + LUAU_INSN_D(*pc)]);
+}
+
+void emitInstJumpIfEqK(AssemblyBuilderX64& build, const Instruction* pc, int pcpos, const TValue* k, Label* labelarr, bool not_)
+{
+    int ra = LUAU_INSN_A(*pc);
+    int kb = pc[1];
+
+    Label& target = labelarr[pcpos + 1 + LUAU_INSN_D(*pc)];
+    Label& next = labelarr[pcpos + 2];
+
+    Label& equal = not_ ? next : target;
+    Label& notequal = not_ ? target : next;
+
+    const TValue* kv = &k[kb];
+
+    switch (kv->tt)
+    {
+    case LUA_TNIL:
+        build.cmp(luauRegTag(ra), LUA_TNIL);
+        build.jcc(Condition::Equal, equal);
+        build.jmp(notequal);
+        break;
+
+    case LUA_TBOOLEAN:
+        jumpIfTagIsNot(build, ra, LUA_TBOOLEAN, notequal);
+        build.cmp(luauRegBoolean(ra), kv->value.b);
+        build.jcc(Condition::Equal, equal);
+        build.jmp(notequal);
+        break;
+
+    case LUA_TNUMBER:
+        jumpIfTagIsNot(build, ra, LUA_TNUMBER, notequal);
+        build.vmovsd(xmm0, luauRegValue(ra));
+        build.vucomisd(xmm0, luauConstantValue(kb));
+        build.jcc(Condition::Parity, notequal);
+        build.jcc(Condition::Equal, equal);
+        build.jmp(notequal);
+        break;
+
+    case LUA_TSTRING:
+        jumpIfTagIsNot(build, ra, LUA_TSTRING, notequal);
+        build.mov(rax, luauRegValue(ra));
+        build.cmp(rax, luauConstantValue(kb));
+        build.jcc(Condition::Equal, equal);
+        build.jmp(notequal);
+        break;
+
+    default:
+        LUAU_ASSERT(!"Constant is expected to be of primitive type");
+    }
+}
+
+void emitInstNot(AssemblyBuilderX64& build, const Instruction* pc)
+{
+    int ra = LUAU_INSN_A(*pc);
+    int rb = LUAU_INSN_B(*pc);
+
+    Label falsy, truthy, store;
+
+    jumpIfFalsy(build, rb, falsy, truthy);
+
+    build.setLabel(truthy);
+    build.mov(ecx, 0);
+    build.jmp(store);
+
+    build.setLabel(falsy);
+    build.mov(ecx, 1);
+
+    build.setLabel(store);
+    build.mov(luauRegBoolean(ra), ecx);
+    build.mov(luauRegTag(ra), LUA_TBOOLEAN);
+}
+
+void emitInstMinus(AssemblyBuilderX64& build, const Instruction* pc, Label& fallback)
+{
+    int ra = LUAU_INSN_A(*pc);
+    int rb = LUAU_INSN_B(*pc);
+
+    jumpIfTagIsNot(build, rb, LUA_TNUMBER, fallback);
+
+    build.mov(rax, luauRegValue(rb));
+    build.mov64(rcx, int64_t(0x8000000000000000ull));
+    build.xor_(rax, rcx);
+    build.mov(luauRegValue(ra), rax);
+
+    if (ra != rb)
+        build.mov(luauRegTag(ra), LUA_TNUMBER);
+}
+
+static void emitArithmetic(AssemblyBuilderX64& build, LuauOpcode op, OperandX64 rhs)
+{
+    switch (op)
+    {
+    case LOP_ADD:
+    case LOP_ADDK:
+        build.vaddsd(xmm0, xmm0, rhs);
+        break;
+    case LOP_SUB:
+    case LOP_SUBK:
+        build.vsubsd(xmm0, xmm0, rhs);
+        break;
+    case LOP_MUL:
+    case LOP_MULK:
+        build.vmulsd(xmm0, xmm0, rhs);
+        break;
+    case LOP_DIV:
+    case LOP_DIVK:
+        build.vdivsd(xmm0, xmm0, rhs);
+        break;
+    default:
+        LUAU_ASSERT(!"Unsupported arithmetic instruction");
+    }
+}
+
+void emitInstBinaryNumeric(AssemblyBuilderX64& build, const Instruction* pc, Label& fallback)
+{
+    int ra = LUAU_INSN_A(*pc);
+    int rb = LUAU_INSN_B(*pc);
+    int rc = LUAU_INSN_C(*pc);
+
+    jumpIfTagIsNot(build, rb, LUA_TNUMBER, fallback);
+    jumpIfTagIsNot(build, rc, LUA_TNUMBER, fallback);
+
+    build.vmovsd(xmm0, luauRegValue(rb));
+    emitArithmetic(build, LuauOpcode(LUAU_INSN_OP(*pc)), luauRegValue(rc));
+    build.vmovsd(luauRegValue(ra), xmm0);
+
+    if (ra != rb && ra != rc)
+        build.mov(luauRegTag(ra), LUA_TNUMBER);
+}
+
+void emitInstBinaryNumericK(AssemblyBuilderX64& build, const Instruction* pc, Label& fallback)
+{
+    int ra = LUAU_INSN_A(*pc);
+    int rb = LUAU_INSN_B(*pc);
+
+    jumpIfTagIsNot(build, rb, LUA_TNUMBER, fallback);
+
+    build.vmovsd(xmm0, luauRegValue(rb));
+    emitArithmetic(build, LuauOpcode(LUAU_INSN_OP(*pc)), luauConstantValue(LUAU_INSN_C(*pc)));
+    build.vmovsd(luauRegValue(ra), xmm0);
+
+    if (ra != rb)
+        build.mov(luauRegTag(ra), LUA_TNUMBER);
+}
+
+static void emitAndOr(AssemblyBuilderX64& build, const Instruction* pc, bool or_, bool constant)
+{
+    int ra = LUAU_INSN_A(*pc);
+    int rb = LUAU_INSN_B(*pc);
+    int c = LUAU_INSN_C(*pc);
+
+    // and selects the first operand when it is falsy, or selects it when it is truthy
+    Label falsy, truthy, done;
+
+    jumpIfFalsy(build, rb, falsy, truthy);
+
+    Label& first = or_ ? truthy : falsy;
+    Label& second = or_ ? falsy : truthy;
+
+    build.setLabel(first);
+    if (ra != rb)
+        copyTValue(build, rBase, int32_t(ra * sizeof(TValue)), rBase, int32_t(rb * sizeof(TValue)));
+    build.jmp(done);
+
+    build.setLabel(second);
+    if (constant)
+        copyTValue(build, rBase, int32_t(ra * sizeof(TValue)), rConstants, int32_t(c * sizeof(TValue)));
+    else if (ra != c)
+        copyTValue(build, rBase, int32_t(ra * sizeof(TValue)), rBase, int32_t(c * sizeof(TValue)));
+
+    build.setLabel(done);
+}
+
+void emitInstAnd(AssemblyBuilderX64& build, const Instruction* pc)
+{
+    emitAndOr(build, pc, /* or_= */ false, /* constant= */ false);
+}
+
+void emitInstAndK(AssemblyBuilderX64& build, const Instruction* pc)
+{
+    emitAndOr(build, pc, /* or_= */ false, /* constant= */ true);
+}
+
+void emitInstOr(AssemblyBuilderX64& build, const Instruction* pc)
+{
+    emitAndOr(build, pc, /* or_= */ true, /* constant= */ false);
+}
+
+void emitInstOrK(AssemblyBuilderX64& build, const Instruction* pc)
+{
+    emitAndOr(build, pc, /* or_= */ true, /* constant= */ true);
+}
+
+// Loads the node pointed to by the slot hint of the instruction at pc into rcx, jumping to fallback unless it holds a non-nil value for
+// the string constant in the aux word. The hint is read from the instruction at runtime, since the interpreter updates it on a miss.
+static void emitSlotLookup(AssemblyBuilderX64& build, RegisterX64 table, const Instruction* pc, Label& fallback)
+{
+    int kidx = pc[1];
+
+    build.mov64(rcx, int64_t(pc));
+    build.mov(ecx, dword[rcx]);
+    build.shr(ecx, 24);
+    build.and_(ecx, dword[table + offsetof(Table, nodemask8)]);
+    build.shl(rcx, kLuaNodeSizeLog2);
+    build.add(rcx, qword[table + offsetof(Table, node)]);
+
+    build.mov(edx, dword[rcx + kOffsetOfLuaNodeKeyTag]);
+    build.and_(edx, 0xf);
+    build.cmp(edx, LUA_TSTRING);
+    build.jcc(Condition::NotEqual, fallback);
+
+    build.mov(rdx, luauConstantValue(kidx));
+    build.cmp(rdx, qword[rcx + offsetof(LuaNode, key) + offsetof(TKey, value)]);
+    build.jcc(Condition::NotEqual, fallback);
+
+    build.cmp(dword[rcx + offsetof(LuaNode, val) + offsetof(TValue, tt)], LUA_TNIL);
+    build.jcc(Condition::Equal, fallback);
+}
+
+void emitInstGetGlobal(AssemblyBuilderX64& build, const Instruction* pc, Label& fallback)
+{
+    int ra = LUAU_INSN_A(*pc);
+
+    loadClosure(build, r8);
+    build.mov(r8, qword[r8 + offsetof(Closure, env)]);
+
+    emitSlotLookup(build, r8, pc, fallback);
+    copyTValue(build, rBase, int32_t(ra * sizeof(TValue)), rcx, offsetof(LuaNode, val));
+}
+
+void emitInstSetGlobal(AssemblyBuilderX64& build, const Instruction* pc, Label& fallback)
+{
+    int ra = LUAU_INSN_A(*pc);
+
+    loadClosure(build, r8);
+    build.mov(r8, qword[r8 + offsetof(Closure, env)]);
+
+    emitSlotLookup(build, r8, pc, fallback);
+    jumpIfTableStoreUnsafe(build, r8, ra, fallback);
+    copyTValue(build, rcx, offsetof(LuaNode, val), rBase, int32_t(ra * sizeof(TValue)));
+}
+
+void emitInstGetImport(AssemblyBuilderX64& build, const Instruction* pc, Label& fallback)
+{
+    int ra = LUAU_INSN_A(*pc);
+    int kd = LUAU_INSN_D(*pc);
+
+    // imports are resolved when the function is loaded, so the caller only emits this when the constant isn't nil
+    loadClosure(build, rax);
+    build.mov(rax, qword[rax + offsetof(Closure, env)]);
+    build.mov(eax, dword[rax + offsetof(Table, safeenv)]);
+    build.test(eax, 0xff);
+    build.jcc(Condition::Zero, fallback);
+
+    copyTValue(build, rBase, int32_t(ra * sizeof(TValue)), rConstants, int32_t(kd * sizeof(TValue)));
+}
+
+void emitInstGetTableKS(AssemblyBuilderX64& build, const Instruction* pc, Label& fallback)
+{
+    int ra = LUAU_INSN_A(*pc);
+    int rb = LUAU_INSN_B(*pc);
+
+    jumpIfTagIsNot(build, rb, LUA_TTABLE, fallback);
+    build.mov(r8, luauRegValue(rb));
+
+    emitSlotLookup(build, r8, pc, fallback);
+    copyTValue(build, rBase, int32_t(ra * sizeof(TValue)), rcx, offsetof(LuaNode, val));
+}
+
+void emitInstSetTableKS(AssemblyBuilderX64& build, const Instruction* pc, Label& fallback)
+{
+    int ra = LUAU_INSN_A(*pc);
+    int rb = LUAU_INSN_B(*pc);
+
+    jumpIfTagIsNot(build, rb, LUA_TTABLE, fallback);
+    build.mov(r8, luauRegValue(rb));
+
+    emitSlotLookup(build, r8, pc, fallback);
+    jumpIfTableStoreUnsafe(build, r8, ra, fallback);
+    copyTValue(build, rcx, offsetof(LuaNode, val), rBase, int32_t(ra * sizeof(TValue)));
+}
+
+// Loads the array element of the table in r8 with the zero-based index in ecx into rcx; the table must not have a metatable
+static void emitArraySlot(AssemblyBuilderX64& build, Label& fallback)
+{
+    build.cmp(ecx, dword[r8 + offsetof(Table, sizearray)]);
+    build.jcc(Condition::AboveEqual, fallback);
+    build.cmp(qword[r8 + offsetof(Table, metatable)], 0);
+    build.jcc(Condition::NotEqual, fallback);
+
+    build.shl(rcx, 4);
+    build.add(rcx, qword[r8 + offsetof(Table, array)]);
+}
+
+// Converts the number in register ri to a zero-based array index in ecx, unless it isn't an exact integer
+static void emitArrayIndex(AssemblyBuilderX64& build, int ri, Label& fallback)
+{
+    jumpIfTagIsNot(build, ri, LUA_TNUMBER, fallback);
+
+    build.vmovsd(xmm0, luauRegValue(ri));
+    build.vcvttsd2si(ecx, xmm0);
+    build.vcvtsi2sd(xmm1, xmm1, ecx);
+    build.vucomisd(xmm0, xmm1);
+    build.jcc(Condition::NotEqual, fallback);
+    build.jcc(Condition::Parity, fallback);
+
+    build.sub(ecx, 1);
+}
+
+static_assert(sizeof(TValue) == 16, "array index is scaled with a shift");
+
+void emitInstGetTableN(AssemblyBuilderX64& build, const Instruction* pc, Label& fallback)
+{
+    int ra = LUAU_INSN_A(*pc);
+    int rb = LUAU_INSN_B(*pc);
+
+    jumpIfTagIsNot(build, rb, LUA_TTABLE, fallback);
+    build.mov(r8, luauRegValue(rb));
+
+    build.mov(ecx, LUAU_INSN_C(*pc));
+    emitArraySlot(build, fallback);
+    copyTValue(build, rBase, int32_t(ra * sizeof(TValue)), rcx, 0);
+}
+
+void emitInstSetTableN(AssemblyBuilderX64& build, const Instruction* pc, Label& fallback)
+{
+    int ra = LUAU_INSN_A(*pc);
+    int rb = LUAU_INSN_B(*pc);
+
+    jumpIfTagIsNot(build, rb, LUA_TTABLE, fallback);
+    build.mov(r8, luauRegValue(rb));
+
+    build.mov(ecx, LUAU_INSN_C(*pc));
+    emitArraySlot(build, fallback);
+    jumpIfTableStoreUnsafe(build, r8, ra, fallback);
+    copyTValue(build, rcx, 0, rBase, int32_t(ra * sizeof(TValue)));
+}
+
+void emitInstGetTable(AssemblyBuilderX64& build, const Instruction* pc, Label& fallback)
+{
+    int ra = LUAU_INSN_A(*pc);
+    int rb = LUAU_INSN_B(*pc);
+    int rc = LUAU_INSN_C(*pc);
+
+    jumpIfTagIsNot(build, rb, LUA_TTABLE, fallback);
+    build.mov(r8, luauRegValue(rb));
+
+    emitArrayIndex(build, rc, fallback);
+    emitArraySlot(build, fallback);
+    copyTValue(build, rBase, int32_t(ra * sizeof(TValue)), rcx, 0);
+}
+
+void emitInstSetTable(AssemblyBuilderX64& build, const Instruction* pc, Label& fallback)
+{
+    int ra = LUAU_INSN_A(*pc);
+    int rb = LUAU_INSN_B(*pc);
+    int rc = LUAU_INSN_C(*pc);
+
+    jumpIfTagIsNot(build, rb, LUA_TTABLE, fallback);
+    build.mov(r8, luauRegValue(rb));
+
+    emitArrayIndex(build, rc, fallback);
+    emitArraySlot(build, fallback);
+    jumpIfTableStoreUnsafe(build, r8, ra, fallback);
+    copyTValue(build, rcx, 0, rBase, int32_t(ra * sizeof(TValue)));
+}
+
+// Evaluates 'step > 0 ? idx <= limit : limit <= idx' for the loop at ra with idx in xmm0, exactly like the interpreter does for NaN
+static void jumpOnNumericLoopCondition(AssemblyBuilderX64& build, int ra, Label& loop, Label& exit)
+{
+    Label reverse;
+
+    build.vmovsd(xmm1, luauRegValue(ra + 1));
+    build.vucomisd(xmm1, build.f64(0.0));
+    build.jcc(Condition::BelowEqual, reverse);
+
+    build.vmovsd(xmm1, luauRegValue(ra));
+    build.vucomisd(xmm1, xmm0);
+    build.jcc(Condition::AboveEqual, loop);
+    build.jmp(exit);
+
+    build.setLabel(reverse);
+    build.vucomisd(xmm0, luauRegValue(ra));
+    build.jcc(Condition::AboveEqual, loop);
+    build.jmp(exit);
+}
+
+void emitInstForNPrep(AssemblyBuilderX64& build, const Instruction* pc, int pcpos, Label* labelarr, Label& fallback)
+{
+    int ra = LUAU_INSN_A(*pc);
+
+    // the interpreter converts string arguments and reports errors
+    jumpIfTagIsNot(build, ra + 0, LUA_TNUMBER, fallback);
+    jumpIfTagIsNot(build, ra + 1, LUA_TNUMBER, fallback);
+    jumpIfTagIsNot(build, ra + 2, LUA_TNUMBER, fallback);
+
+    build.vmovsd(xmm0, luauRegValue(ra + 2));
+    jumpOnNumericLoopCondition(build, ra, labelarr[pcpos + 1], labelarr[pcpos + 1 + LUAU_INSN_D(*pc)]);
+}
+
+void emitInstForNLoop(AssemblyBuilderX64& build, const Instruction* pc, int pcpos, Label* labelarr, Label& fallback)
+{
+    int ra = LUAU_INSN_A(*pc);
+
+    jumpIfInterruptSet(build, fallback);
+
+    build.vmovsd(xmm0, luauRegValue(ra + 2));
+    build.vaddsd(xmm0, xmm0, luauRegValue(ra + 1));
+    build.vmovsd(luauRegValue(ra + 2), xmm0);
+
+    jumpOnNumericLoopCondition(build, ra, labelarr[pcpos + 1 + LUAU_INSN_D(*pc)], labelarr[pcpos + 1]);
+}
+
+} // namespace CodeGen
+} // namespace Luau
@@ -0,0 +1,53 @@
+// This file is part of the Luau programming language and is licensed under MIT License; see LICENSE.txt for details
+#pragma once
+
+#include <stdint.h>
+
+typedef uint32_t Instruction;
+typedef struct lua_TValue TValue;
+
+namespace Luau
+{
+namespace CodeGen
+{
+
+class AssemblyBuilderX64;
+struct Label;
+
+// Each function emits the native version of one instruction at pc, whose index in the function is pcpos; 'labelarr' holds the labels of
+// all instructions of the function. When an operand doesn't fit the fast path, native code jumps to 'fallback', which leaves the whole
+// instruction to the interpreter, so emitted code never modifies the state before that jump.
+void emitInstLoadNil(AssemblyBuilderX64& build, const Instruction* pc);
+void emitInstLoadB(AssemblyBuilderX64& build, const Instruction* pc, int pcpos, Label* labelarr);
+void emitInstLoadN(AssemblyBuilderX64& build, const Instruction* pc);
+void emitInstLoadK(AssemblyBuilderX64& build, const Instruction* pc);
+void emitInstMove(AssemblyBuilderX64& build, const Instruction* pc);
+void emitInstGetUpval(AssemblyBuilderX64& build, const Instruction* pc);
+void emitInstJump(AssemblyBuilderX64& build, const Instruction* pc, int pcpos, Label* labelarr);
+void emitInstJumpBack(AssemblyBuilderX64& build, const Instruction* pc, int pcpos, Label* labelarr, Label& fallback);
+void emitInstJumpIf(AssemblyBuilderX64& build, const Instruction* pc, int pcpos, Label* labelarr, bool not_);
+void emitInstJumpIfEq(AssemblyBuilderX64& build, const Instruction* pc, int pcpos, Label* labelarr, bool not_, Label& fallback);
+void emitInstJumpIfCond(AssemblyBuilderX64& build, const Instruction* pc, int pcpos, Label* labelarr, Label& fallback);
+void emitInstJumpIfEqK(AssemblyBuilderX64& build, const Instruction* pc, int pcpos, const TValue* k, Label* labelarr, bool not_);
+void emitInstNot(AssemblyBuilderX64& build, const Instruction* pc);
+void emitInstMinus(AssemblyBuilderX64& build, const Instruction* pc, Label& fallback);
+void emitInstBinaryNumeric(AssemblyBuilderX64& build, const Instruction* pc, Label& fallback);
+void emitInstBinaryNumericK(AssemblyBuilderX64& build, const Instruction* pc, Label& fallback);
+void emitInstAnd(AssemblyBuilderX64& build, const Instruction* pc);
+void emitInstAndK(AssemblyBuilderX64& build, const Instruction* pc);
+void emitInstOr(AssemblyBuilderX64& build, const Instruction* pc);
+void emitInstOrK(AssemblyBuilderX64& build, const Instruction* pc);
+void emitInstGetGlobal(AssemblyBuilderX64& build, const Instruction* pc, Label& fallback);
+void emitInstSetGlobal(AssemblyBuilderX64& build, const Instruction* pc, Label& fallback);
+void emitInstGetImport(AssemblyBuilderX64& build, const Instruction* pc, Label& fallback);
+void emitInstGetTableKS(AssemblyBuilderX64& build, const Instruction* pc, Label& fallback);
+void emitInstSetTableKS(AssemblyBuilderX64& build, const Instruction* pc, Label& fallback);
+void emitInstGetTableN(AssemblyBuilderX64& build, const Instruction* pc, Label& fallback);
+void emitInstSetTableN(AssemblyBuilderX64& build, const Instruction* pc, Label& fallback);
+void emitInstGetTable(AssemblyBuilderX64& build, const Instruction* pc, Label& fallback);
+void emitInstSetTable(AssemblyBuilderX64& build, const Instruction* pc, Label& fallback);
+void emitInstForNPrep(AssemblyBuilderX64& build, const Instruction* pc, int pcpos, Label* labelarr, Label& fallback);
+void emitInstForNLoop(AssemblyBuilderX64& build, const Instruction* pc, int pcpos, Label* labelarr, Label& fallback);
+
+} // namespace CodeGen
+} // namespace Luau
@@ -0,0 +1,234 @@
+// This file is part of the Luau programming language and is licensed under MIT License; see LICENSE.txt for details
+#include "Luau/UnwindBuilder.h"
+
+#include <string.h>
+
+#if defined(__x86_64__) && (defined(__linux__) || defined(__APPLE__))
+#define LUAU_UNWIND_REGISTER_FRAME 1
+
+// provided by libgcc and libunwind; libgcc takes a whole .eh_frame section, libunwind a single FDE
+extern "C" void __register_frame(const void* begin);
+extern "C" void __deregister_frame(const void* begin);
+#endif
+
+namespace Luau
+{
+namespace CodeGen
+{
+
+// DWARF call frame instructions and register numbers, see the System V x86-64 ABI
+const uint8_t kDwCfaAdvanceLoc = 0x40;
+const uint8_t kDwCfaOffset = 0x80;
+const uint8_t kDwCfaAdvanceLoc1 = 0x02;
+const uint8_t kDwCfaAdvanceLoc2 = 0x03;
+const uint8_t kDwCfaAdvanceLoc4 = 0x04;
+const uint8_t kDwCfaDefCfa = 0x0c;
+const uint8_t kDwCfaDefCfaOffset = 0x0e;
+const uint8_t kDwCfaNop = 0x00;
+
+const uint8_t kDwEhPeAbsptr = 0x00;
+
+const uint8_t kDwarfRegRsp = 7;
+const uint8_t kDwarfRegRa = 16;
+
+static uint8_t getDwarfRegister(RegisterX64 reg)
+{
+    // rax, rcx, rdx, rbx, rsp, rbp, rsi, rdi in the DWARF order; r8-r15 keep their numbers
+    static const uint8_t kRegisters[8] = {0, 2, 1, 3, 7, 6, 4, 5};
+
+    return reg.index < 8 ? kRegisters[reg.index] : reg.index;
+}
+
+void UnwindBuilder::start()
+{
+    data.clear();
+
+    // CIE: code is addressed in bytes, stack slots are 8 bytes and addresses in the FDE are absolute
+    placeU32(0);
+    placeU32(0);
+    placeU8(1);
+    placeU8('z');
+    placeU8('R');
+    placeU8(0);
+    placeUleb128(1);
+    placeU8(0x78); // -8 as sleb128
+    placeU8(kDwarfRegRa);
+    placeUleb128(1);
+    placeU8(kDwEhPeAbsptr);
+
+    // on entry, the return address is the only thing on the stack
+    placeU8(kDwCfaDefCfa);
+    placeUleb128(kDwarfRegRsp);
+    placeUleb128(8);
+    placeU8(kDwCfaOffset | kDwarfRegRa);
+    placeUleb128(1);
+
+    alignTo8(0);
+
+    // FDE: the code range is filled in by setCodeRange
+    fdeStart = data.size();
+
+    placeU32(0);
+    placeU32(uint32_t(fdeStart + 4));
+
+    pcBeginOffset = data.size();
+    placeU64(0);
+    placeU64(0);
+    placeUleb128(0);
+
+    lastOffset = 0;
+    cfaOffset = 8;
+}
+
+void UnwindBuilder::push(uint32_t codeOffset, RegisterX64 reg)
+{
+    advance(codeOffset);
+    setCfaOffset(cfaOffset + 8);
+
+    placeU8(kDwCfaOffset | getDwarfRegister(reg));
+    placeUleb128(cfaOffset / 8);
+}
+
+void UnwindBuilder::pop(uint32_t codeOffset)
+{
+    advance(codeOffset);
+    setCfaOffset(cfaOffset - 8);
+}
+
+void UnwindBuilder::allocStack(uint32_t codeOffset, int size)
+{
+    advance(codeOffset);
+    setCfaOffset(cfaOffset + size);
+}
+
+void UnwindBuilder::freeStack(uint32_t codeOffset, int size)
+{
+    advance(codeOffset);
+    setCfaOffset(cfaOffset - size);
+}
+
+void UnwindBuilder::finish()
+{
+    alignTo8(fdeStart);
+
+    // a zero length entry terminates the section for unwinders that take all of it
+    placeU32(0);
+}
+
+void UnwindBuilder::setCodeRange(const uint8_t* code, size_t size)
+{
+    uint64_t begin = uint64_t(uintptr_t(code));
+    uint64_t range = uint64_t(size);
+
+    memcpy(&data[pcBeginOffset], &begin, sizeof(begin));
+    memcpy(&data[pcBeginOffset + 8], &range, sizeof(range));
+}
+
+void UnwindBuilder::advance(uint32_t codeOffset)
+{
+    uint32_t delta = codeOffset - lastOffset;
+    lastOffset = codeOffset;
+
+    if (delta == 0)
+        return;
+
+    if (delta < 64)
+    {
+        placeU8(uint8_t(kDwCfaAdvanceLoc | delta));
+    }
+    else if (delta < 256)
+    {
+        placeU8(kDwCfaAdvanceLoc1);
+        placeU8(uint8_t(delta));
+    }
+    else if (delta < 65536)
+    {
+        uint16_t value = uint16_t(delta);
+
+        placeU8(kDwCfaAdvanceLoc2);
+        data.insert(data.end(), reinterpret_cast<uint8_t*>(&value), reinterpret_cast<uint8_t*>(&value) + sizeof(value));
+    }
+    else
+    {
+        placeU8(kDwCfaAdvanceLoc4);
+        placeU32(delta);
+    }
+}
+
+void UnwindBuilder::setCfaOffset(int offset)
+{
+    cfaOffset = offset;
+
+    placeU8(kDwCfaDefCfaOffset);
+    placeUleb128(uint32_t(offset));
+}
+
+void UnwindBuilder::placeU8(uint8_t value)
+{
+    data.push_back(value);
+}
+
+void UnwindBuilder::placeU32(uint32_t value)
+{
+    data.insert(data.end(), reinterpret_cast<uint8_t*>(&value), reinterpret_cast<uint8_t*>(&value) + sizeof(value));
+}
+
+void UnwindBuilder::placeU64(uint64_t value)
+{
+    data.insert(data.end(), reinterpret_cast<uint8_t*>(&value), reinterpret_cast<uint8_t*>(&value) + sizeof(value));
+}
+
+void UnwindBuilder::placeUleb128(uint32_t value)
+{
+    do
+    {
+        uint8_t byte = value & 0x7f;
+        value >>= 7;
+
+        placeU8(value ? byte | 0x80 : byte);
+    } while (value);
+}
+
+void UnwindBuilder::alignTo8(size_t start)
+{
+    // entries are padded to the address size, and their length doesn't include the length field itself
+    while ((data.size() - start) % 8 != 0)
+        placeU8(kDwCfaNop);
+
+    uint32_t length = uint32_t(data.size() - start - 4);
+    memcpy(&data[start], &length, sizeof(length));
+}
+
+bool registerUnwindInfo(uint8_t* data)
+{
+#if defined(LUAU_UNWIND_REGISTER_FRAME)
+#if defined(__APPLE__)
+    uint32_t cieLength;
+    memcpy(&cieLength, data, sizeof(cieLength));
+
+    __register_frame(data + 4 + cieLength);
+#else
+    __register_frame(data);
+#endif
+    return true;
+#else
+    return false;
+#endif
+}
+
+void unregisterUnwindInfo(uint8_t* data)
+{
+#if defined(LUAU_UNWIND_REGISTER_FRAME)
+#if defined(__APPLE__)
+    uint32_t cieLength;
+    memcpy(&cieLength, data, sizeof(cieLength));
+
+    __deregister_frame(data + 4 + cieLength);
+#else
+    __deregister_frame(data);
+#endif
+#endif
+}
+
+} // namespace CodeGen
+} // namespace Luau
@@ -0,0 +1,24 @@
+// This file is part of the Luau programming language and is licensed under MIT License; see LICENSE.txt for details
+#include "luacodegen.h"
+
+#include "Luau/CodeGen.h"
+
+int lua_codegen_supported()
+{
+    return Luau::CodeGen::isSupported();
+}
+
+void lua_codegen_compile(lua_State* L, int idx)
+{
+    Luau::CodeGen::compile(L, idx);
+}
+
+void lua_codegen_settiering(lua_State* L, unsigned int threshold)
+{
+    Luau::CodeGen::setTieringThreshold(L, threshold);
+}
+
+void lua_codegen_enableperfmap()
+{
+    Luau::CodeGen::enablePerfMap();
+}
@@ -367,6 +367,20 @@ enum LuauOpcode
     // D: jump offset (-32768..32767)
     LOP_FORGPREP,
 
+    // Fused instructions: each one replaces the opcode of the first instruction of a common pair, keeping its operands and AUX, and the second
+    // instruction follows unchanged. The VM runs the second instruction right after the first one without a dispatch in between; jumps
+    // to the second instruction run it on its own. The pairs were picked by how often they run in the benchmarks, see --opcode-stats.
+    // Only present in bytecode version 4 and above; BytecodeBuilder fuses instructions as it serializes them, so its dumps show the pairs.
+    LOP_MOVE_MOVE,
+    LOP_MOVE_CALL,
+    LOP_LOADN_LOADN,
+    LOP_GETUPVAL_CALL,
+    LOP_GETUPVAL_GETTABLEKS,
+    LOP_GETIMPORT_MOVE,
+    LOP_GETTABLE_GETTABLE,
+    LOP_GETTABLE_ADD,
+    LOP_ADD_GETTABLE,
+
     // Enum entry for number of opcodes, not a valid opcode by itself!
     LOP__COUNT
 };
@@ -390,9 +404,12 @@ enum LuauOpcode
 enum LuauBytecodeTag
 {
     // Bytecode version; runtime supports [MIN, MAX], compiler emits TARGET by default but may emit a higher version when flags are enabled
+    // Version 3 pads every instruction array so that it starts at a multiple of 4 bytes from the start of the blob
+    // Version 4 may contain fused instructions
     LBC_VERSION_MIN = 2,
-    LBC_VERSION_MAX = 2,
-    LBC_VERSION_TARGET = 2,
+    LBC_VERSION_MAX = 4,
+    LBC_VERSION_TARGET = 3,
+    LBC_VERSION_FUSED = 4,
     // Types of constant table entries
     LBC_CONSTANT_NIL = 0,
     LBC_CONSTANT_BOOLEAN,
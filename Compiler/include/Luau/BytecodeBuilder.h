@@ -102,6 +102,12 @@ public:
 
     void setDumpSource(const std::string& source);
 
+    // Replaces common instruction pairs with fused instructions in the serialized bytecode, which then requires LBC_VERSION_FUSED
+    void setInstructionFusion(bool enabled)
+    {
+        fusion = enabled;
+    }
+
     const std::string& getBytecode() const
     {
         LUAU_ASSERT(!bytecode.empty()); // did you forget to call finalize?
@@ -121,6 +127,11 @@ public:
 
     static uint8_t getVersion();
 
+    static const char* getOpcodeName(LuauOpcode op);
+
+    // Returns the fused instruction that runs 'op' followed by 'next', or LOP__COUNT when there is none
+    static LuauOpcode getFusedOpcode(LuauOpcode op, LuauOpcode next);
+
 private:
     struct Constant
     {
@@ -162,6 +173,7 @@ private:
     struct Function
     {
         std::string data;
+        size_t codeoffset = 0; // position of the instructions in data
 
         uint8_t maxstacksize = 0;
         uint8_t numparams = 0;
@@ -224,6 +236,8 @@ private:
 
     bool hasLongJumps = false;
 
+    bool fusion = false;
+
     DenseHashMap<ConstantKey, int32_t, ConstantKeyHash> constantMap;
     DenseHashMap<TableShape, int32_t, TableShapeHash> tableShapeMap;
     DenseHashMap<uint32_t, int16_t> protoMap;
@@ -251,7 +265,7 @@ private:
     std::string dumpCurrentFunction() const;
     void dumpInstruction(const uint32_t* opcode, std::string& output, int targetLabel) const;
 
-    void writeFunction(std::string& ss, uint32_t id) const;
+    size_t writeFunction(std::string& ss, uint32_t id) const;
     void writeLineInfo(std::string& ss) const;
     void writeStringTable(std::string& ss) const;
 
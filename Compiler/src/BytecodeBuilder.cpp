@@ -77,6 +77,7 @@ static int getOpLength(LuauOpcode op)
     case LOP_JUMPIFNOTEQK:
     case LOP_FASTCALL2:
     case LOP_FASTCALL2K:
+    case LOP_GETIMPORT_MOVE:
         return 2;
 
     default:
@@ -248,7 +249,7 @@ void BytecodeBuilder::endFunction(uint8_t maxstacksize, uint8_t numupvalues)
     // very approximate: 4 bytes per instruction for code, 1 byte for debug line, and 1-2 bytes for aux data like constants plus overhead
     func.data.reserve(32 + insns.size() * 7);
 
-    writeFunction(func.data, currentFunction);
+    func.codeoffset = writeFunction(func.data, currentFunction);
 
     currentFunction = ~0u;
 
@@ -570,12 +571,12 @@ void BytecodeBuilder::finalize()
         capacity += p.first.length + 2;
 
     for (const Function& func : functions)
-        capacity += func.data.size();
+        capacity += func.data.size() + 3;
 
     bytecode.reserve(capacity);
 
     // assemble final bytecode blob
-    uint8_t version = getVersion();
+    uint8_t version = fusion ? uint8_t(LBC_VERSION_FUSED) : getVersion();
     LUAU_ASSERT(version >= LBC_VERSION_MIN && version <= LBC_VERSION_MAX);
 
     bytecode = char(version);
@@ -585,13 +586,20 @@ void BytecodeBuilder::finalize()
     writeVarInt(bytecode, uint32_t(functions.size()));
 
     for (const Function& func : functions)
-        bytecode += func.data;
+    {
+        // aligned instructions can be executed in place from a mapped image, see luau_mapmodule
+        size_t padding = (0 - (bytecode.size() + func.codeoffset)) & 3;
+
+        bytecode.append(func.data, 0, func.codeoffset);
+        bytecode.append(padding, '\0');
+        bytecode.append(func.data, func.codeoffset, std::string::npos);
+    }
 
     LUAU_ASSERT(mainFunction < functions.size());
     writeVarInt(bytecode, mainFunction);
 }
 
-void BytecodeBuilder::writeFunction(std::string& ss, uint32_t id) const
+size_t BytecodeBuilder::writeFunction(std::string& ss, uint32_t id) const
 {
     LUAU_ASSERT(id < functions.size());
     const Function& func = functions[id];
@@ -605,12 +613,29 @@ void BytecodeBuilder::writeFunction(std::string& ss, uint32_t id) const
     // instructions
     writeVarInt(ss, uint32_t(insns.size()));
 
+    size_t codeoffset = ss.size();
+
+    bool fusedPrev = false;
+
     for (size_t i = 0; i < insns.size();)
     {
         uint8_t op = LUAU_INSN_OP(insns[i]);
         LUAU_ASSERT(op < LOP__COUNT);
 
         int oplen = getOpLength(LuauOpcode(op));
+
+        // the next instruction stays as is, so code that jumps to it doesn't need to know about the fusion; pairs don't overlap so that
+        // the VM can always run the second instruction of a pair directly
+        if (fusion && !fusedPrev && i + oplen < insns.size())
+        {
+            LuauOpcode fused = getFusedOpcode(LuauOpcode(op), LuauOpcode(LUAU_INSN_OP(insns[i + oplen])));
+
+            if (fused != LOP__COUNT)
+                op = uint8_t(fused);
+        }
+
+        fusedPrev = op != LUAU_INSN_OP(insns[i]);
+
         uint8_t openc = encoder ? encoder->encodeOp(op) : op;
 
         writeInt(ss, openc | (insns[i] & ~0xff));
@@ -729,6 +754,8 @@ void BytecodeBuilder::writeFunction(std::string& ss, uint32_t id) const
     {
         writeByte(ss, 0);
     }
+
+    return codeoffset;
 }
 
 void BytecodeBuilder::writeLineInfo(std::string& ss) const
@@ -1060,6 +1087,209 @@ uint8_t BytecodeBuilder::getVersion()
     return LBC_VERSION_TARGET;
 }
 
+const char* BytecodeBuilder::getOpcodeName(LuauOpcode op)
+{
+    switch (op)
+    {
+    case LOP_NOP:
+        return "NOP";
+    case LOP_BREAK:
+        return "BREAK";
+    case LOP_LOADNIL:
+        return "LOADNIL";
+    case LOP_LOADB:
+        return "LOADB";
+    case LOP_LOADN:
+        return "LOADN";
+    case LOP_LOADK:
+        return "LOADK";
+    case LOP_MOVE:
+        return "MOVE";
+    case LOP_GETGLOBAL:
+        return "GETGLOBAL";
+    case LOP_SETGLOBAL:
+        return "SETGLOBAL";
+    case LOP_GETUPVAL:
+        return "GETUPVAL";
+    case LOP_SETUPVAL:
+        return "SETUPVAL";
+    case LOP_CLOSEUPVALS:
+        return "CLOSEUPVALS";
+    case LOP_GETIMPORT:
+        return "GETIMPORT";
+    case LOP_GETTABLE:
+        return "GETTABLE";
+    case LOP_SETTABLE:
+        return "SETTABLE";
+    case LOP_GETTABLEKS:
+        return "GETTABLEKS";
+    case LOP_SETTABLEKS:
+        return "SETTABLEKS";
+    case LOP_GETTABLEN:
+        return "GETTABLEN";
+    case LOP_SETTABLEN:
+        return "SETTABLEN";
+    case LOP_NEWCLOSURE:
+        return "NEWCLOSURE";
+    case LOP_NAMECALL:
+        return "NAMECALL";
+    case LOP_CALL:
+        return "CALL";
+    case LOP_RETURN:
+        return "RETURN";
+    case LOP_JUMP:
+        return "JUMP";
+    case LOP_JUMPBACK:
+        return "JUMPBACK";
+    case LOP_JUMPIF:
+        return "JUMPIF";
+    case LOP_JUMPIFNOT:
+        return "JUMPIFNOT";
+    case LOP_JUMPIFEQ:
+        return "JUMPIFEQ";
+    case LOP_JUMPIFLE:
+        return "JUMPIFLE";
+    case LOP_JUMPIFLT:
+        return "JUMPIFLT";
+    case LOP_JUMPIFNOTEQ:
+        return "JUMPIFNOTEQ";
+    case LOP_JUMPIFNOTLE:
+        return "JUMPIFNOTLE";
+    case LOP_JUMPIFNOTLT:
+        return "JUMPIFNOTLT";
+    case LOP_ADD:
+        return "ADD";
+    case LOP_SUB:
+        return "SUB";
+    case LOP_MUL:
+        return "MUL";
+    case LOP_DIV:
+        return "DIV";
+    case LOP_MOD:
+        return "MOD";
+    case LOP_POW:
+        return "POW";
+    case LOP_ADDK:
+        return "ADDK";
+    case LOP_SUBK:
+        return "SUBK";
+    case LOP_MULK:
+        return "MULK";
+    case LOP_DIVK:
+        return "DIVK";
+    case LOP_MODK:
+        return "MODK";
+    case LOP_POWK:
+        return "POWK";
+    case LOP_AND:
+        return "AND";
+    case LOP_OR:
+        return "OR";
+    case LOP_ANDK:
+        return "ANDK";
+    case LOP_ORK:
+        return "ORK";
+    case LOP_CONCAT:
+        return "CONCAT";
+    case LOP_NOT:
+        return "NOT";
+    case LOP_MINUS:
+        return "MINUS";
+    case LOP_LENGTH:
+        return "LENGTH";
+    case LOP_NEWTABLE:
+        return "NEWTABLE";
+    case LOP_DUPTABLE:
+        return "DUPTABLE";
+    case LOP_SETLIST:
+        return "SETLIST";
+    case LOP_FORNPREP:
+        return "FORNPREP";
+    case LOP_FORNLOOP:
+        return "FORNLOOP";
+    case LOP_FORGLOOP:
+        return "FORGLOOP";
+    case LOP_FORGPREP_INEXT:
+        return "FORGPREP_INEXT";
+    case LOP_FORGLOOP_INEXT:
+        return "FORGLOOP_INEXT";
+    case LOP_FORGPREP_NEXT:
+        return "FORGPREP_NEXT";
+    case LOP_FORGLOOP_NEXT:
+        return "FORGLOOP_NEXT";
+    case LOP_GETVARARGS:
+        return "GETVARARGS";
+    case LOP_DUPCLOSURE:
+        return "DUPCLOSURE";
+    case LOP_PREPVARARGS:
+        return "PREPVARARGS";
+    case LOP_LOADKX:
+        return "LOADKX";
+    case LOP_JUMPX:
+        return "JUMPX";
+    case LOP_FASTCALL:
+        return "FASTCALL";
+    case LOP_COVERAGE:
+        return "COVERAGE";
+    case LOP_CAPTURE:
+        return "CAPTURE";
+    case LOP_JUMPIFEQK:
+        return "JUMPIFEQK";
+    case LOP_JUMPIFNOTEQK:
+        return "JUMPIFNOTEQK";
+    case LOP_FASTCALL1:
+        return "FASTCALL1";
+    case LOP_FASTCALL2:
+        return "FASTCALL2";
+    case LOP_FASTCALL2K:
+        return "FASTCALL2K";
+    case LOP_FORGPREP:
+        return "FORGPREP";
+    case LOP_MOVE_MOVE:
+        return "MOVE_MOVE";
+    case LOP_MOVE_CALL:
+        return "MOVE_CALL";
+    case LOP_LOADN_LOADN:
+        return "LOADN_LOADN";
+    case LOP_GETUPVAL_CALL:
+        return "GETUPVAL_CALL";
+    case LOP_GETUPVAL_GETTABLEKS:
+        return "GETUPVAL_GETTABLEKS";
+    case LOP_GETIMPORT_MOVE:
+        return "GETIMPORT_MOVE";
+    case LOP_GETTABLE_GETTABLE:
+        return "GETTABLE_GETTABLE";
+    case LOP_GETTABLE_ADD:
+        return "GETTABLE_ADD";
+    case LOP_ADD_GETTABLE:
+        return "ADD_GETTABLE";
+    default:
+        LUAU_ASSERT(!"Unsupported opcode");
+        return "UNKNOWN";
+    }
+}
+
+LuauOpcode BytecodeBuilder::getFusedOpcode(LuauOpcode op, LuauOpcode next)
+{
+    switch (op)
+    {
+    case LOP_MOVE:
+        return next == LOP_MOVE ? LOP_MOVE_MOVE : next == LOP_CALL ? LOP_MOVE_CALL : LOP__COUNT;
+    case LOP_LOADN:
+        return next == LOP_LOADN ? LOP_LOADN_LOADN : LOP__COUNT;
+    case LOP_GETUPVAL:
+        return next == LOP_CALL ? LOP_GETUPVAL_CALL : next == LOP_GETTABLEKS ? LOP_GETUPVAL_GETTABLEKS : LOP__COUNT;
+    case LOP_GETIMPORT:
+        return next == LOP_MOVE ? LOP_GETIMPORT_MOVE : LOP__COUNT;
+    case LOP_GETTABLE:
+        return next == LOP_GETTABLE ? LOP_GETTABLE_GETTABLE : next == LOP_ADD ? LOP_GETTABLE_ADD : LOP__COUNT;
+    case LOP_ADD:
+        return next == LOP_GETTABLE ? LOP_ADD_GETTABLE : LOP__COUNT;
+    default:
+        return LOP__COUNT;
+    }
+}
+
 #ifdef LUAU_ASSERTENABLED
 void BytecodeBuilder::validate() const
 {
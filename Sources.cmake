@@ -53,12 +53,24 @@ target_sources(Luau.Compiler PRIVATE
 # Luau.CodeGen Sources
 target_sources(Luau.CodeGen PRIVATE
     CodeGen/include/Luau/AssemblyBuilderX64.h
+    CodeGen/include/Luau/CodeAllocator.h
+    CodeGen/include/Luau/CodeGen.h
     CodeGen/include/Luau/Condition.h
     CodeGen/include/Luau/Label.h
     CodeGen/include/Luau/OperandX64.h
     CodeGen/include/Luau/RegisterX64.h
+    CodeGen/include/Luau/UnwindBuilder.h
+    CodeGen/include/luacodegen.h
 
     CodeGen/src/AssemblyBuilderX64.cpp
+    CodeGen/src/CodeAllocator.cpp
+    CodeGen/src/CodeGen.cpp
+    CodeGen/src/EmitInstructionX64.cpp
+    CodeGen/src/UnwindBuilder.cpp
+    CodeGen/src/lcodegen.cpp
+
+    CodeGen/src/EmitCommonX64.h
+    CodeGen/src/EmitInstructionX64.h
 )
 
 # Luau.Analysis Sources
@@ -163,7 +175,6 @@ target_sources(Luau.VM PRIVATE
     VM/src/lbase64lib.cpp
     VM/src/lbitlib.cpp
     VM/src/lbuiltins.cpp
-    VM/src/lc.cpp
     VM/src/lcorolib.cpp
     VM/src/lcprlib.cpp
     VM/src/ldblib.cpp
@@ -180,11 +191,15 @@ target_sources(Luau.VM PRIVATE
     VM/src/lobject.cpp
     VM/src/loslib.cpp
     VM/src/lperf.cpp
+    VM/src/lserializelib.cpp
+    VM/src/lsnapshot.cpp
     VM/src/lstate.cpp
     VM/src/lstring.cpp
     VM/src/lstrlib.cpp
     VM/src/ltable.cpp
     VM/src/ltablib.cpp
+    VM/src/ltasklib.cpp
+    VM/src/lworkerlib.cpp
     VM/src/ltm.cpp
     VM/src/ludata.cpp
     VM/src/lutf8lib.cpp
@@ -194,7 +209,6 @@ target_sources(Luau.VM PRIVATE
     VM/src/lapi.h
     VM/src/lbuiltins.h
     VM/src/lbytecode.h
-    VM/src/lc.h
     VM/src/lcommon.h
     VM/src/ldebug.h
     VM/src/ldo.h
@@ -203,6 +217,7 @@ target_sources(Luau.VM PRIVATE
     VM/src/lmem.h
     VM/src/lnumutils.h
     VM/src/lobject.h
+    VM/src/lserialize.h
     VM/src/lstate.h
     VM/src/lstring.h
     VM/src/ltable.h
@@ -223,6 +238,8 @@ if(TARGET Luau.Repl.CLI)
         CLI/Coverage.cpp
         CLI/FileUtils.h
         CLI/FileUtils.cpp
+        CLI/OpcodeStats.h
+        CLI/OpcodeStats.cpp
         CLI/Profiler.h
         CLI/Profiler.cpp
         CLI/Repl.cpp
@@ -305,12 +322,15 @@ if(TARGET Luau.UnitTest)
         tests/Variant.test.cpp
         tests/VisitTypeVar.test.cpp
         tests/AssemblyBuilderX64.test.cpp
+        tests/CodeAllocator.test.cpp
         tests/main.cpp)
 endif()
 
 if(TARGET Luau.Conformance)
     # Luau.Conformance Sources
     target_sources(Luau.Conformance PRIVATE
+        tests/LoopbackServer.h
+        tests/LoopbackServer.cpp
         tests/Conformance.test.cpp
         tests/main.cpp)
 endif()
@@ -322,6 +342,8 @@ if(TARGET Luau.CLI.Test)
         CLI/Coverage.cpp
         CLI/FileUtils.h
         CLI/FileUtils.cpp
+        CLI/OpcodeStats.h
+        CLI/OpcodeStats.cpp
         CLI/Profiler.h
         CLI/Profiler.cpp
         CLI/Repl.cpp
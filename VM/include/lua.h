@@ -215,6 +215,21 @@ LUA_API int lua_setfenv(lua_State* L, int idx);
 ** `load' and `call' functions (load and run Luau bytecode)
 */
 LUA_API int luau_load(lua_State* L, const char* chunkname, const char* data, size_t size, int env);
+
+/*
+** shared modules: bytecode decoded once, with instructions and line info shared by every state that loads it
+** modules are reference counted and can be loaded into states running on different threads at the same time
+** functions loaded from modules can't have breakpoints; use luau_load for code that needs them
+** mapped modules use a caller-owned image (e.g. a memory-mapped file) in place instead of copying it; instructions are executed straight
+** from the image when it is 4-byte aligned, so it may be read-only; unmap (if set) is called once the last reference is released
+*/
+typedef struct luau_Module luau_Module;
+
+LUA_API luau_Module* luau_newmodule(const char* data, size_t size); /* copies the bytecode; the caller holds the only reference */
+LUA_API luau_Module* luau_mapmodule(const char* data, size_t size, void (*unmap)(void* context), void* context);
+LUA_API int luau_loadmodule(lua_State* L, const char* chunkname, luau_Module* module, int env);
+LUA_API void luau_retainmodule(luau_Module* module);
+LUA_API void luau_releasemodule(luau_Module* module);
 LUA_API void lua_call(lua_State* L, int nargs, int nresults);
 LUA_API int lua_pcall(lua_State* L, int nargs, int nresults, int errfunc);
 
@@ -230,6 +245,14 @@ LUA_API int lua_isyieldable(lua_State* L);
 LUA_API void* lua_getthreaddata(lua_State* L);
 LUA_API void lua_setthreaddata(lua_State* L, void* data);
 
+/*
+** heap snapshots: everything reachable from the registry, the globals and the type metatables of an initialized state, restored into fresh states
+** snapshots only load into the executable that saved them, and C functions they refer to must be linked into the same binary as the VM
+** coroutines, light userdata and userdata with destructors can't be saved; libraries recreate their native state and hosts set their hooks again
+*/
+LUA_API char* lua_savesnapshot(lua_State* L, size_t* outsize); /* malloc'd; NULL with an error message on the stack on failure */
+LUA_API int lua_loadsnapshot(lua_State* L, const char* data, size_t size); /* 0 on success, otherwise pushes an error message */
+
 /*
 ** garbage-collection function and options
 */
@@ -379,6 +402,7 @@ LUA_API const char* lua_getupvalue(lua_State* L, int funcindex, int n);
 LUA_API const char* lua_setupvalue(lua_State* L, int funcindex, int n);
 
 LUA_API void lua_singlestep(lua_State* L, int enabled);
+LUA_API int lua_getopcode(lua_State* L, int level); /* opcode of the current instruction of a Lua function, -1 otherwise; see LuauOpcode */
 LUA_API void lua_breakpoint(lua_State* L, int funcindex, int line, int enabled);
 
 typedef void (*lua_Coverage)(void* context, const char* function, int linedefined, int depth, const int* hits, size_t size);
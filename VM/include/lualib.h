@@ -138,9 +138,48 @@ LUALIB_API int luaopen_cpr(lua_State* L);
 #define LUA_JSONLIBNAME "json"
 LUALIB_API int luaopen_json(lua_State* L);
 
+/* userdata tag of lazy json documents; hosts shouldn't use it for their own userdata */
+#define LUA_JSONVIEWTAG (LUA_UTAG_LIMIT - 1)
+
+/* userdata tag of cpr responses; hosts shouldn't use it for their own userdata */
+#define LUA_CPRRESPONSETAG (LUA_UTAG_LIMIT - 2)
+
 #define LUA_BASE64LIBNAME "base64"
 LUALIB_API int luaopen_base64(lua_State* L);
 
+#define LUA_TASKLIBNAME "task"
+LUALIB_API int luaopen_task(lua_State* L);
+
+/* suspends the running thread for at least 'seconds'; use as 'return luaL_taskwait(L, seconds);' from a C function */
+LUALIB_API int luaL_taskwait(lua_State* L, double seconds);
+
+/* lets a library resume threads from the event loop (see luaL_runtasks); 'fd' becomes readable when 'poll' has work, or is -1 */
+typedef struct luaL_TaskSource
+{
+    int fd;
+    int (*poll)(lua_State* L, int budget); /* resumes up to 'budget' threads and returns how many it resumed */
+    int (*pending)(lua_State* L);          /* number of threads waiting on the library */
+} luaL_TaskSource;
+
+LUALIB_API void luaL_addtasksource(lua_State* L, const luaL_TaskSource* source);
+
+/* event loop integration for threads scheduled by the task library, which has to be open in L; times are in lua_clock() seconds */
+LUALIB_API double luaL_nextdeadline(lua_State* L); /* 0 if threads are ready to run, -1 if no timer is scheduled */
+LUALIB_API int luaL_pendingtasks(lua_State* L);    /* number of threads waiting on timers or task sources */
+LUALIB_API int luaL_pollfds(lua_State* L, int* fds, int size); /* descriptors to wait on for readability; returns the total count */
+LUALIB_API int luaL_runtasks(lua_State* L, double now, int budget); /* resumes up to 'budget' threads (0 for no limit); returns a lua_pcall status */
+
+#define LUA_SERIALIZELIBNAME "serialize"
+LUALIB_API int luaopen_serialize(lua_State* L);
+
+#define LUA_WORKERLIBNAME "worker"
+LUALIB_API int luaopen_worker(lua_State* L);
+
+/* sets up the state of every worker spawned from L (and from its workers); defaults to luaL_openlibs. Workers compile their source with the
+ * global 'loadstring', so hosts that want workers need to provide one; worker.spawn raises an error when the state doesn't have it.
+ * The hook is not part of heap snapshots, so hosts set it again after lua_loadsnapshot */
+LUALIB_API void luaL_setworkerinit(lua_State* L, void (*init)(lua_State* L));
+
 /* open all builtin libraries */
 LUALIB_API void luaL_openlibs(lua_State* L);
 
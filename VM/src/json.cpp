@@ -1,2561 +1,2113 @@
-#include "lua.h"
-#include "lapi.h"
+// This file is part of the Luau programming language and is licensed under MIT License; see LICENSE.txt for details
 #include "lualib.h"
-#include "lc.h"
 
+#include "lstate.h"
+#include "lstring.h"
+#include "ltable.h"
+#include "lgc.h"
+#include "lnumutils.h"
+#include "lmem.h"
+
+#include <string>
+#include <new>
+
+#include <math.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-/* name: escape_char
- * function(c) */
-static int lcf1_escape_char (lua_State * L) {
-  enum { lc_nformalargs = 1 };
-  lua_settop(L,1);
-  
-  /* return "\\" .. (escape_char_map[c] or string.format("u%04x", c:byte())) */
-  lua_pushliteral(L,"\\");
-  lc_getupvalue(L,lua_upvalueindex(1),2,2);
-  lua_pushvalue(L,1);
-  lua_gettable(L,-2);
-  lua_remove(L,-2);
-  if (!(lua_toboolean(L,-1))) {
-    lua_pop(L,1);
-    lua_getfield(L,LUA_ENVIRONINDEX,"string");
-    lua_pushliteral(L,"format");
-    lua_gettable(L,-2);
-    lua_remove(L,-2);
-    const int lc6 = lua_gettop(L);
-    lua_pushliteral(L,"u%04x");
-    lua_pushvalue(L,1);
-    lua_pushliteral(L,"byte");
-    lua_gettable(L,-2);
-    lua_insert(L,-2);
-    lua_call(L,1,LUA_MULTRET);
-    lua_call(L,(lua_gettop(L) - lc6),1);
-  }
-  lua_concat(L,2);
-  return 1;
-}
-
-
-/* name: encode_nil
- * function(val) */
-static int lcf1_encode_nil (lua_State * L) {
-  enum { lc_nformalargs = 1 };
-  lua_settop(L,1);
-  
-  /* return "null" */
-  lua_pushliteral(L,"null");
-  return 1;
-}
-
-
-/* name: encode_table
- * function(val, stack) */
-static int lcf1_encode_table (lua_State * L) {
-  enum { lc_nformalargs = 2 };
-  lua_settop(L,2);
-  
-  /* local res = {} */
-  lua_newtable(L);
-  
-  /* stack = stack or {} */
-  lua_pushvalue(L,2);
-  if (!(lua_toboolean(L,-1))) {
-    lua_pop(L,1);
-    lua_newtable(L);
-  }
-  lua_replace(L,2);
-  
-  /* -- Circular reference?
-   * if stack[val] then */
-  enum { lc7 = 3 };
-  lua_pushvalue(L,1);
-  lua_gettable(L,2);
-  const int lc8 = lua_toboolean(L,-1);
-  lua_pop(L,1);
-  if (lc8) {
-    
-    /* error("circular reference") */
-    lua_getfield(L,LUA_ENVIRONINDEX,"error");
-    lua_pushliteral(L,"circular reference");
-    lua_call(L,1,0);
-  }
-  lua_settop(L,lc7);
-  
-  /* stack[val] = true */
-  lua_pushboolean(L,1);
-  lua_pushvalue(L,1);
-  lua_insert(L,-2);
-  lua_settable(L,2);
-  
-  /* if rawget(val, 1) ~= nil or next(val) == nil then */
-  enum { lc9 = 3 };
-  lua_getfield(L,LUA_ENVIRONINDEX,"rawget");
-  lua_pushvalue(L,1);
-  lua_pushnumber(L,1);
-  lua_call(L,2,1);
-  lua_pushnil(L);
-  const int lc10 = lua_equal(L,-2,-1);
-  lua_pop(L,2);
-  lua_pushboolean(L,lc10);
-  lua_pushboolean(L,!(lua_toboolean(L,-1)));
-  lua_remove(L,-2);
-  if (!(lua_toboolean(L,-1))) {
-    lua_pop(L,1);
-    lua_getfield(L,LUA_ENVIRONINDEX,"next");
-    lua_pushvalue(L,1);
-    lua_call(L,1,1);
-    lua_pushnil(L);
-    const int lc11 = lua_equal(L,-2,-1);
-    lua_pop(L,2);
-    lua_pushboolean(L,lc11);
-  }
-  const int lc12 = lua_toboolean(L,-1);
-  lua_pop(L,1);
-  if (lc12) {
-    
-    /* -- Treat as array -- check keys are valid and it is not sparse
-     * local n = 0 */
-    lua_pushnumber(L,0);
-    
-    /* for k in pairs(val) do
-     * internal: local f, s, var = explist */
-    enum { lc13 = 4 };
-    lua_getfield(L,LUA_ENVIRONINDEX,"pairs");
-    lua_pushvalue(L,1);
-    lua_call(L,1,3);
-    while (1) {
-      
-      /* internal: local var_1, ..., var_n = f(s, var)
-       *           if var_1 == nil then break end
-       *           var = var_1 */
-      lua_pushvalue(L,-3);
-      lua_pushvalue(L,-3);
-      lua_pushvalue(L,-3);
-      lua_call(L,2,1);
-      if (lua_isnil(L,-1)) {
-        break;
-      }
-      lua_pushvalue(L,-1);
-      lua_replace(L,-3);
-      
-      /* internal: local k with idx 8 */
-      
-      
-      /* if type(k) ~= "number" then */
-      enum { lc14 = 8 };
-      lua_getfield(L,LUA_ENVIRONINDEX,"type");
-      lua_pushvalue(L,8);
-      lua_call(L,1,1);
-      lua_pushliteral(L,"number");
-      const int lc15 = lua_equal(L,-2,-1);
-      lua_pop(L,2);
-      lua_pushboolean(L,lc15);
-      lua_pushboolean(L,!(lua_toboolean(L,-1)));
-      lua_remove(L,-2);
-      const int lc16 = lua_toboolean(L,-1);
-      lua_pop(L,1);
-      if (lc16) {
-        
-        /* error("invalid table: mixed or invalid key types") */
-        lua_getfield(L,LUA_ENVIRONINDEX,"error");
-        lua_pushliteral(L,"invalid table: mixed or invalid key types");
-        lua_call(L,1,0);
-      }
-      lua_settop(L,lc14);
-      
-      /* n = n + 1 */
-      lua_pushnumber(L,1);
-      lc_add(L,4,-1);
-      lua_remove(L,-2);
-      lua_replace(L,4);
-      
-      /* internal: stack cleanup on scope exit */
-      lua_pop(L,1);
+#if defined(__SSE2__) || (defined(_MSC_VER) && defined(_M_X64))
+#define JSON_USE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(JSON_USE_SSE2) && defined(__GNUC__)
+#define JSON_USE_AVX2 1
+#include <immintrin.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// The encoder and decoder implement the semantics of rxi/json.lua 0.1.2 that this library was originally translated from:
+// - tables with a non-nil [1], and empty tables, are encoded as arrays and must be proper sequences
+// - all other tables are encoded as objects and must only have string keys
+// - numbers are encoded using the shortest representation that roundtrips; NaN and infinities can't be encoded
+// - decoding accepts trailing commas in arrays and objects; null array elements leave holes and null object fields are skipped
+
+// maximum nesting depth of arrays and objects for both encoding and decoding
+#define JSON_MAXDEPTH LUAI_MAXCCALLS
+
+// decoded values are accumulated on the stack until their container is complete so that the table can be created with an exact size;
+// once this many stack slots are in use, containers are filled incrementally instead
+#define JSON_MAXPENDING (LUAI_MAXCSTACK / 2)
+
+#define JSON_VERSION "0.1.2"
+
+/*
+** {======================================================
+** Scanning
+** =======================================================
+*/
+
+// Both the decoder and the encoder spend most of their time looking for the next byte in a string that needs special handling, which is
+// a quote, a backslash or a control character. On x64 this is done 16 (SSE2) or 32 (AVX2, when supported by the CPU) bytes at a time.
+
+inline bool json_isspecial(unsigned char ch)
+{
+    return ch < 32 || ch == '"' || ch == '\\';
+}
+
+inline int json_ctz(unsigned int n)
+{
+#ifdef _MSC_VER
+    unsigned long rl;
+    _BitScanForward(&rl, n);
+    return int(rl);
+#else
+    return __builtin_ctz(n);
+#endif
+}
+
+static const char* json_scanspecialscalar(const char* p, const char* end)
+{
+    while (p < end && !json_isspecial(*p))
+        p++;
+
+    return p;
+}
+
+#ifdef JSON_USE_SSE2
+static const char* json_scanspecialsse2(const char* p, const char* end)
+{
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control = _mm_set1_epi8(31);
+
+    for (; end - p >= 16; p += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)p);
+
+        // unsigned v <= 31 is equivalent to min(v, 31) == v
+        __m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)), _mm_cmpeq_epi8(_mm_min_epu8(v, control), v));
+        unsigned int mask = unsigned(_mm_movemask_epi8(m));
+
+        if (mask)
+            return p + json_ctz(mask);
     }
-    lua_settop(L,lc13);
-    
-    /* if n ~= #val then */
-    enum { lc17 = 4 };
-    const double lc18 = lua_objlen(L,1);
-    lua_pushnumber(L,lc18);
-    const int lc19 = lua_equal(L,4,-1);
-    lua_pop(L,1);
-    lua_pushboolean(L,lc19);
-    lua_pushboolean(L,!(lua_toboolean(L,-1)));
-    lua_remove(L,-2);
-    const int lc20 = lua_toboolean(L,-1);
-    lua_pop(L,1);
-    if (lc20) {
-      
-      /* error("invalid table: sparse array") */
-      lua_getfield(L,LUA_ENVIRONINDEX,"error");
-      lua_pushliteral(L,"invalid table: sparse array");
-      lua_call(L,1,0);
+
+    return json_scanspecialscalar(p, end);
+}
+#endif
+
+#ifdef JSON_USE_AVX2
+__attribute__((target("avx2"))) static const char* json_scanspecialavx2(const char* p, const char* end)
+{
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i control = _mm256_set1_epi8(31);
+
+    for (; end - p >= 32; p += 32)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*)p);
+
+        __m256i m = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, quote), _mm256_cmpeq_epi8(v, backslash)), _mm256_cmpeq_epi8(_mm256_min_epu8(v, control), v));
+        unsigned int mask = unsigned(_mm256_movemask_epi8(m));
+
+        if (mask)
+            return p + json_ctz(mask);
     }
-    lua_settop(L,lc17);
-    
-    /* -- Encode
-     * for i, v in ipairs(val) do
-     * internal: local f, s, var = explist */
-    enum { lc21 = 4 };
-    lua_getfield(L,LUA_ENVIRONINDEX,"ipairs");
-    lua_pushvalue(L,1);
-    lua_call(L,1,3);
-    while (1) {
-      
-      /* internal: local var_1, ..., var_n = f(s, var)
-       *           if var_1 == nil then break end
-       *           var = var_1 */
-      lua_pushvalue(L,-3);
-      lua_pushvalue(L,-3);
-      lua_pushvalue(L,-3);
-      lua_call(L,2,2);
-      if (lua_isnil(L,-2)) {
-        break;
-      }
-      lua_pushvalue(L,-2);
-      lua_replace(L,-4);
-      
-      /* internal: local i with idx 8
-       * internal: local v with idx 9 */
-      
-      
-      /* table.insert(res, encode(v, stack)) */
-      lua_getfield(L,LUA_ENVIRONINDEX,"table");
-      lua_pushliteral(L,"insert");
-      lua_gettable(L,-2);
-      lua_remove(L,-2);
-      const int lc22 = lua_gettop(L);
-      lua_pushvalue(L,3);
-      lc_getupvalue(L,lua_upvalueindex(1),3,1);
-      lua_pushvalue(L,9);
-      lua_pushvalue(L,2);
-      lua_call(L,2,LUA_MULTRET);
-      lua_call(L,(lua_gettop(L) - lc22),0);
-      
-      /* internal: stack cleanup on scope exit */
-      lua_pop(L,2);
+
+    return json_scanspecialsse2(p, end);
+}
+#endif
+
+typedef const char* (*JsonScanFunction)(const char* p, const char* end);
+
+static JsonScanFunction json_selectscanspecial()
+{
+#if defined(JSON_USE_AVX2)
+    if (__builtin_cpu_supports("avx2"))
+        return json_scanspecialavx2;
+#endif
+
+#if defined(JSON_USE_SSE2)
+    return json_scanspecialsse2;
+#else
+    return json_scanspecialscalar;
+#endif
+}
+
+// returns the first byte in [p, end) that is a quote, a backslash or a control character, or end if there is none
+static const JsonScanFunction json_scanspecial = json_selectscanspecial();
+
+/* }====================================================== */
+
+/*
+** {======================================================
+** Decoding
+** =======================================================
+*/
+
+struct JsonReader
+{
+    lua_State* L;
+
+    const char* begin;
+    const char* end;
+
+    int depth;
+
+    // scratch buffer for strings with escape sequences; lives in stack slot scratchidx
+    char* scratch;
+    size_t scratchsize;
+
+    // position of begin in the document, which may not be the start for incremental decoding
+    int line;
+    int col;
+
+    int scratchidx;
+};
+
+static const char* json_parsevalue(JsonReader* R, const char* p);
+
+// note: offset may point past the end of input, in which case the extra positions are counted as columns
+static void json_advanceposition(const char* begin, const char* end, size_t offset, int* line, int* col)
+{
+    for (size_t i = 0; i < offset; ++i)
+    {
+        if (begin + i < end && begin[i] == '\n')
+        {
+            (*line)++;
+            *col = 1;
+        }
+        else
+        {
+            (*col)++;
+        }
     }
-    lua_settop(L,lc21);
-    
-    /* stack[val] = nil */
-    lua_pushnil(L);
-    lua_pushvalue(L,1);
-    lua_insert(L,-2);
-    lua_settable(L,2);
-    
-    /* return "[" .. table.concat(res, ",") .. "]" */
-    lua_pushliteral(L,"[");
-    lua_getfield(L,LUA_ENVIRONINDEX,"table");
-    lua_pushliteral(L,"concat");
-    lua_gettable(L,-2);
-    lua_remove(L,-2);
-    lua_pushvalue(L,3);
-    lua_pushliteral(L,",");
-    lua_call(L,2,1);
-    lua_pushliteral(L,"]");
-    lua_concat(L,2);
-    lua_concat(L,2);
-    return 1;
-  }
-  else {
-    
-    /* else
-     * -- Treat as an object
-     * for k, v in pairs(val) do
-     * internal: local f, s, var = explist */
-    enum { lc23 = 3 };
-    lua_getfield(L,LUA_ENVIRONINDEX,"pairs");
-    lua_pushvalue(L,1);
-    lua_call(L,1,3);
-    while (1) {
-      
-      /* internal: local var_1, ..., var_n = f(s, var)
-       *           if var_1 == nil then break end
-       *           var = var_1 */
-      lua_pushvalue(L,-3);
-      lua_pushvalue(L,-3);
-      lua_pushvalue(L,-3);
-      lua_call(L,2,2);
-      if (lua_isnil(L,-2)) {
-        break;
-      }
-      lua_pushvalue(L,-2);
-      lua_replace(L,-4);
-      
-      /* internal: local k with idx 7
-       * internal: local v with idx 8 */
-      
-      
-      /* if type(k) ~= "string" then */
-      enum { lc24 = 8 };
-      lua_getfield(L,LUA_ENVIRONINDEX,"type");
-      lua_pushvalue(L,7);
-      lua_call(L,1,1);
-      lua_pushliteral(L,"string");
-      const int lc25 = lua_equal(L,-2,-1);
-      lua_pop(L,2);
-      lua_pushboolean(L,lc25);
-      lua_pushboolean(L,!(lua_toboolean(L,-1)));
-      lua_remove(L,-2);
-      const int lc26 = lua_toboolean(L,-1);
-      lua_pop(L,1);
-      if (lc26) {
-        
-        /* error("invalid table: mixed or invalid key types") */
-        lua_getfield(L,LUA_ENVIRONINDEX,"error");
-        lua_pushliteral(L,"invalid table: mixed or invalid key types");
-        lua_call(L,1,0);
-      }
-      lua_settop(L,lc24);
-      
-      /* table.insert(res, encode(k, stack) .. ":" .. encode(v, stack)) */
-      lua_getfield(L,LUA_ENVIRONINDEX,"table");
-      lua_pushliteral(L,"insert");
-      lua_gettable(L,-2);
-      lua_remove(L,-2);
-      lua_pushvalue(L,3);
-      lc_getupvalue(L,lua_upvalueindex(1),3,1);
-      lua_pushvalue(L,7);
-      lua_pushvalue(L,2);
-      lua_call(L,2,1);
-      lua_pushliteral(L,":");
-      lc_getupvalue(L,lua_upvalueindex(1),3,1);
-      lua_pushvalue(L,8);
-      lua_pushvalue(L,2);
-      lua_call(L,2,1);
-      lua_concat(L,2);
-      lua_concat(L,2);
-      lua_call(L,2,0);
-      
-      /* internal: stack cleanup on scope exit */
-      lua_pop(L,2);
+}
+
+LUA_PRINTF_ATTR(3, 4) static l_noret json_decodeerror(JsonReader* R, size_t offset, const char* fmt, ...)
+{
+    char msg[LUA_BUFFERSIZE];
+
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(msg, sizeof(msg), fmt, args);
+    va_end(args);
+
+    int line = R->line;
+    int col = R->col;
+    json_advanceposition(R->begin, R->end, offset, &line, &col);
+
+    luaL_error(R->L, "%s at line %d col %d", msg, line, col);
+}
+
+inline bool json_isspace(char ch)
+{
+    return ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n';
+}
+
+inline bool json_isdelim(char ch)
+{
+    return json_isspace(ch) || ch == ']' || ch == '}' || ch == ',';
+}
+
+inline int json_hexdigit(char ch)
+{
+    if (unsigned(ch - '0') < 10)
+        return ch - '0';
+    else if (unsigned((ch | ' ') - 'a') < 6)
+        return (ch | ' ') - 'a' + 10;
+    else
+        return -1;
+}
+
+static const char* json_skipspace(const char* p, const char* end)
+{
+    // most separators are at most a few bytes long; longer runs come from indentation in pretty-printed documents
+    for (int i = 0; i < 4; ++i)
+    {
+        if (p == end || !json_isspace(*p))
+            return p;
+
+        p++;
     }
-    lua_settop(L,lc23);
-    
-    /* stack[val] = nil */
-    lua_pushnil(L);
-    lua_pushvalue(L,1);
-    lua_insert(L,-2);
-    lua_settable(L,2);
-    
-    /* return "{" .. table.concat(res, ",") .. "}" */
-    lua_pushliteral(L,"{");
-    lua_getfield(L,LUA_ENVIRONINDEX,"table");
-    lua_pushliteral(L,"concat");
-    lua_gettable(L,-2);
-    lua_remove(L,-2);
-    lua_pushvalue(L,3);
-    lua_pushliteral(L,",");
-    lua_call(L,2,1);
-    lua_pushliteral(L,"}");
-    lua_concat(L,2);
-    lua_concat(L,2);
-    return 1;
-  }
-  lua_settop(L,lc9);
-  return 0;
-}
-
-
-/* name: encode_string
- * function(val) */
-static int lcf1_encode_string (lua_State * L) {
-  enum { lc_nformalargs = 1 };
-  lua_settop(L,1);
-  
-  /* return '"' .. val:gsub('[%z\1-\31\\"]', escape_char) .. '"' */
-  lua_pushliteral(L,"\"");
-  lua_pushvalue(L,1);
-  lua_pushliteral(L,"gsub");
-  lua_gettable(L,-2);
-  lua_insert(L,-2);
-  lua_pushliteral(L,"[%z-\\\"]");
-  lc_getupvalue(L,lua_upvalueindex(1),0,4);
-  lua_call(L,3,1);
-  lua_pushliteral(L,"\"");
-  lua_concat(L,2);
-  lua_concat(L,2);
-  return 1;
-}
-
-
-/* name: encode_number
- * function(val) */
-static int lcf1_encode_number (lua_State * L) {
-  lua_settop(L,1);
-  
-  /* -- Check for NaN, -inf and inf
-   * if val ~= val or val <= -math.huge or val >= math.huge then */
-  enum { lc27 = 1 };
-  const int lc28 = lua_equal(L,1,1);
-  lua_pushboolean(L,lc28);
-  lua_pushboolean(L,!(lua_toboolean(L,-1)));
-  lua_remove(L,-2);
-  if (!(lua_toboolean(L,-1))) {
-    lua_pop(L,1);
-    lua_getfield(L,LUA_ENVIRONINDEX,"math");
-    lua_pushliteral(L,"huge");
-    lua_gettable(L,-2);
-    lua_remove(L,-2);
-    lc_unm(L,-1);
-    lua_remove(L,-2);
-    const int lc29 = lc_le(L,1,-1);
-    lua_pop(L,1);
-    lua_pushboolean(L,lc29);
-  }
-  if (!(lua_toboolean(L,-1))) {
-    lua_pop(L,1);
-    lua_getfield(L,LUA_ENVIRONINDEX,"math");
-    lua_pushliteral(L,"huge");
-    lua_gettable(L,-2);
-    lua_remove(L,-2);
-    const int lc30 = lc_le(L,-1,1);
-    lua_pop(L,1);
-    lua_pushboolean(L,lc30);
-  }
-  const int lc31 = lua_toboolean(L,-1);
-  lua_pop(L,1);
-  if (lc31) {
-    
-    /* error("unexpected number value '" .. tostring(val) .. "'") */
-    lua_getfield(L,LUA_ENVIRONINDEX,"error");
-    lua_pushliteral(L,"unexpected number value '");
-    lua_getfield(L,LUA_ENVIRONINDEX,"tostring");
-    lua_pushvalue(L,1);
-    lua_call(L,1,1);
-    lua_pushliteral(L,"'");
-    lua_concat(L,2);
-    lua_concat(L,2);
-    lua_call(L,1,0);
-  }
-  lua_settop(L,lc27);
-  
-  /* return string.format("%.14g", val) */
-  const int lc32 = lua_gettop(L);
-  lua_getfield(L,LUA_ENVIRONINDEX,"string");
-  lua_pushliteral(L,"format");
-  lua_gettable(L,-2);
-  lua_remove(L,-2);
-  lua_pushliteral(L,"%.14g");
-  lua_pushvalue(L,1);
-  lua_call(L,2,LUA_MULTRET);
-  return (lua_gettop(L) - lc32);
-}
-
-
-/* name: encode
- * function(val, stack) */
-static int lcf1_encode (lua_State * L) {
-  lua_settop(L,2);
-  
-  /* local t = type(val) */
-  lua_getfield(L,LUA_ENVIRONINDEX,"type");
-  lua_pushvalue(L,1);
-  lua_call(L,1,1);
-  
-  /* local f = type_func_map[t] */
-  lc_getupvalue(L,lua_upvalueindex(1),0,5);
-  lua_pushvalue(L,3);
-  lua_gettable(L,-2);
-  lua_remove(L,-2);
-  
-  /* if f then */
-  enum { lc34 = 4 };
-  if (lua_toboolean(L,4)) {
-    
-    /* return f(val, stack) */
-    const int lc35 = lua_gettop(L);
-    lua_pushvalue(L,4);
-    lua_pushvalue(L,1);
-    lua_pushvalue(L,2);
-    lua_call(L,2,LUA_MULTRET);
-    return (lua_gettop(L) - lc35);
-  }
-  lua_settop(L,lc34);
-  
-  /* error("unexpected type '" .. t .. "'") */
-  lua_getfield(L,LUA_ENVIRONINDEX,"error");
-  lua_pushliteral(L,"unexpected type '");
-  lua_pushvalue(L,3);
-  lua_pushliteral(L,"'");
-  lua_concat(L,2);
-  lua_concat(L,2);
-  lua_call(L,1,0);
-  return 0;
-}
-
-
-static void lc_setupvalue(lua_State * L, int tidx, int level, int varid) {
-  if (level == 0) {
-    lua_rawseti(L,tidx,varid);
-  }
-  else {
-    lua_pushvalue(L,tidx);
-    while(--level >= 0) {
-      lua_rawgeti(L,tidx,0); /* 0 links to parent table */
-      lua_remove(L,-2);
-      tidx = -1;
+
+#ifdef JSON_USE_SSE2
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i lf = _mm_set1_epi8('\n');
+
+    for (; end - p >= 16; p += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)p);
+
+        __m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, tab)), _mm_or_si128(_mm_cmpeq_epi8(v, cr), _mm_cmpeq_epi8(v, lf)));
+        unsigned int mask = ~unsigned(_mm_movemask_epi8(m)) & 0xffff;
+
+        if (mask)
+            return p + json_ctz(mask);
+    }
+#endif
+
+    while (p < end && json_isspace(*p))
+        p++;
+
+    return p;
+}
+
+static const char* json_skiptoken(const char* p, const char* end)
+{
+    while (p < end && !json_isdelim(*p))
+        p++;
+
+    return p;
+}
+
+// parses exactly 4 hex digits, returns -1 if any of them is invalid
+static int json_parsehex4(const char* p)
+{
+    int a = json_hexdigit(p[0]), b = json_hexdigit(p[1]), c = json_hexdigit(p[2]), d = json_hexdigit(p[3]);
+
+    if ((a | b | c | d) < 0)
+        return -1;
+
+    return (a << 12) | (b << 8) | (c << 4) | d;
+}
+
+static char* json_writeutf8(lua_State* L, char* out, int cp)
+{
+    if (cp <= 0x7f)
+    {
+        *out++ = char(cp);
     }
-    lua_insert(L,-2);
-    lua_rawseti(L,-2,varid);
-    lua_pop(L,1);
-  }
-}
-
-
-/* name: json.encode
- * function(val) */
-static int lcf1_json_encode (lua_State * L) {
-  lua_settop(L,1);
-  
-  /* return ( encode(val) ) */
-  lc_getupvalue(L,lua_upvalueindex(1),4,1);
-  lua_pushvalue(L,1);
-  lua_call(L,1,1);
-  return 1;
-}
-
-
-/* name: create_set
- * function(...) */
-static int lcf1_create_set (lua_State * L) {
-  enum { lc_nformalargs = 0 };
-  const int lc_nactualargs = lua_gettop(L);
-  const int lc_nextra = (lc_nactualargs - lc_nformalargs);
-  
-  /* local res = {} */
-  lua_newtable(L);
-  
-  /* for i = 1, select("#", ...) do */
-  lua_pushnumber(L,1);
-  lua_getfield(L,LUA_ENVIRONINDEX,"select");
-  const int lc40 = lua_gettop(L);
-  lua_pushliteral(L,"#");
-  {int i; for (i=lc_nformalargs+1; i<=lc_nactualargs; i++) { lua_pushvalue(L, i); }}
-  lua_call(L,(lua_gettop(L) - lc40),1);
-  if (!((lua_isnumber(L,-2) && lua_isnumber(L,-1)))) {
-    luaL_error(L,"'for' limit must be a number");
-  }
-  double lc37_var = lua_tonumber(L,-2);
-  const double lc38_limit = lua_tonumber(L,-1);
-  const double lc39_step = 1;
-  lua_pop(L,2);
-  enum { lc41 = 1 };
-  while ((((lc39_step > 0) && (lc37_var <= lc38_limit)) || ((lc39_step <= 0) && (lc37_var >= lc38_limit)))) {
-    
-    /* internal: local i at index 2 */
-    lua_pushnumber(L,lc37_var);
-    
-    /* res[ select(i, ...) ] = true */
-    lua_pushboolean(L,1);
-    lua_getfield(L,LUA_ENVIRONINDEX,"select");
-    const int lc42 = lua_gettop(L);
-    lua_pushvalue(L,(2 + lc_nextra));
-    {int i; for (i=lc_nformalargs+1; i<=lc_nactualargs; i++) { lua_pushvalue(L, i); }}
-    lua_call(L,(lua_gettop(L) - lc42),1);
-    lua_insert(L,-2);
-    lua_settable(L,(1 + lc_nextra));
-    
-    /* internal: stack cleanup on scope exit */
-    lua_pop(L,1);
-    lc37_var += lc39_step;
-  }
-  lua_settop(L,(lc41 + lc_nextra));
-  
-  /* return res */
-  lua_pushvalue(L,(1 + lc_nextra));
-  return 1;
-}
-
-
-/* name: next_char
- * function(str, idx, set, negate) */
-static int lcf1_next_char (lua_State * L) {
-  enum { lc_nformalargs = 4 };
-  lua_settop(L,4);
-  
-  /* for i = idx, #str do */
-  const double lc52 = lua_objlen(L,1);
-  lua_pushnumber(L,lc52);
-  if (!((lua_isnumber(L,2) && lua_isnumber(L,-1)))) {
-    luaL_error(L,"'for' limit must be a number");
-  }
-  double lc49_var = lua_tonumber(L,2);
-  const double lc50_limit = lua_tonumber(L,-1);
-  const double lc51_step = 1;
-  lua_pop(L,1);
-  enum { lc53 = 4 };
-  while ((((lc51_step > 0) && (lc49_var <= lc50_limit)) || ((lc51_step <= 0) && (lc49_var >= lc50_limit)))) {
-    
-    /* internal: local i at index 5 */
-    lua_pushnumber(L,lc49_var);
-    
-    /* if set[str:sub(i, i)] ~= negate then */
-    enum { lc54 = 5 };
-    lua_pushvalue(L,1);
-    lua_pushliteral(L,"sub");
-    lua_gettable(L,-2);
-    lua_insert(L,-2);
-    lua_pushvalue(L,5);
-    lua_pushvalue(L,5);
-    lua_call(L,3,1);
-    lua_gettable(L,3);
-    const int lc55 = lua_equal(L,-1,4);
-    lua_pop(L,1);
-    lua_pushboolean(L,lc55);
-    lua_pushboolean(L,!(lua_toboolean(L,-1)));
-    lua_remove(L,-2);
-    const int lc56 = lua_toboolean(L,-1);
-    lua_pop(L,1);
-    if (lc56) {
-      
-      /* return i */
-      lua_pushvalue(L,5);
-      return 1;
+    else if (cp <= 0x7ff)
+    {
+        *out++ = char(0xc0 | (cp >> 6));
+        *out++ = char(0x80 | (cp & 0x3f));
     }
-    lua_settop(L,lc54);
-    
-    /* internal: stack cleanup on scope exit */
-    lua_pop(L,1);
-    lc49_var += lc51_step;
-  }
-  lua_settop(L,lc53);
-  
-  /* return #str + 1 */
-  const double lc57 = lua_objlen(L,1);
-  lua_pushnumber(L,lc57);
-  lua_pushnumber(L,1);
-  lc_add(L,-2,-1);
-  lua_remove(L,-2);
-  lua_remove(L,-2);
-  return 1;
-}
-
-
-/* name: decode_error
- * function(str, idx, msg) */
-static int lcf1_decode_error (lua_State * L) {
-  enum { lc_nformalargs = 3 };
-  lua_settop(L,3);
-  
-  /* local line_count = 1 */
-  lua_pushnumber(L,1);
-  
-  /* local col_count = 1 */
-  lua_pushnumber(L,1);
-  
-  /* for i = 1, idx - 1 do */
-  lua_pushnumber(L,1);
-  lua_pushnumber(L,1);
-  lc_sub(L,2,-1);
-  lua_remove(L,-2);
-  if (!((lua_isnumber(L,-2) && lua_isnumber(L,-1)))) {
-    luaL_error(L,"'for' limit must be a number");
-  }
-  double lc59_var = lua_tonumber(L,-2);
-  const double lc60_limit = lua_tonumber(L,-1);
-  const double lc61_step = 1;
-  lua_pop(L,2);
-  enum { lc62 = 5 };
-  while ((((lc61_step > 0) && (lc59_var <= lc60_limit)) || ((lc61_step <= 0) && (lc59_var >= lc60_limit)))) {
-    
-    /* internal: local i at index 6 */
-    lua_pushnumber(L,lc59_var);
-    
-    /* col_count = col_count + 1 */
-    lua_pushnumber(L,1);
-    lc_add(L,5,-1);
-    lua_remove(L,-2);
-    lua_replace(L,5);
-    
-    /* if str:sub(i, i) == "\n" then */
-    enum { lc63 = 6 };
-    lua_pushvalue(L,1);
-    lua_pushliteral(L,"sub");
-    lua_gettable(L,-2);
-    lua_insert(L,-2);
-    lua_pushvalue(L,6);
-    lua_pushvalue(L,6);
-    lua_call(L,3,1);
-    lua_pushliteral(L,"\n");
-    const int lc64 = lua_equal(L,-2,-1);
-    lua_pop(L,2);
-    lua_pushboolean(L,lc64);
-    const int lc65 = lua_toboolean(L,-1);
-    lua_pop(L,1);
-    if (lc65) {
-      
-      /* line_count = line_count + 1 */
-      lua_pushnumber(L,1);
-      lc_add(L,4,-1);
-      lua_remove(L,-2);
-      lua_replace(L,4);
-      
-      /* col_count = 1 */
-      lua_pushnumber(L,1);
-      lua_replace(L,5);
+    else if (cp <= 0xffff)
+    {
+        *out++ = char(0xe0 | (cp >> 12));
+        *out++ = char(0x80 | ((cp >> 6) & 0x3f));
+        *out++ = char(0x80 | (cp & 0x3f));
     }
-    lua_settop(L,lc63);
-    
-    /* internal: stack cleanup on scope exit */
-    lua_pop(L,1);
-    lc59_var += lc61_step;
-  }
-  lua_settop(L,lc62);
-  
-  /* error( string.format("%s at line %d col %d", msg, line_count, col_count) ) */
-  lua_getfield(L,LUA_ENVIRONINDEX,"error");
-  const int lc66 = lua_gettop(L);
-  lua_getfield(L,LUA_ENVIRONINDEX,"string");
-  lua_pushliteral(L,"format");
-  lua_gettable(L,-2);
-  lua_remove(L,-2);
-  lua_pushliteral(L,"%s at line %d col %d");
-  lua_pushvalue(L,3);
-  lua_pushvalue(L,4);
-  lua_pushvalue(L,5);
-  lua_call(L,4,LUA_MULTRET);
-  lua_call(L,(lua_gettop(L) - lc66),0);
-  return 0;
-}
-
-
-/* name: codepoint_to_utf8
- * function(n) */
-static int lcf1_codepoint_to_utf8 (lua_State * L) {
-  enum { lc_nformalargs = 1 };
-  lua_settop(L,1);
-  
-  /* -- http://scripts.sil.org/cms/scripts/page.php?site_id=nrsi&id=iws-appendixa
-   * local f = math.floor */
-  lua_getfield(L,LUA_ENVIRONINDEX,"math");
-  lua_pushliteral(L,"floor");
-  lua_gettable(L,-2);
-  lua_remove(L,-2);
-  
-  /* if n <= 0x7f then */
-  enum { lc68 = 2 };
-  lua_pushnumber(L,127);
-  const int lc69 = lc_le(L,1,-1);
-  lua_pop(L,1);
-  lua_pushboolean(L,lc69);
-  const int lc70 = lua_toboolean(L,-1);
-  lua_pop(L,1);
-  if (lc70) {
-    
-    /* return string.char(n) */
-    const int lc71 = lua_gettop(L);
-    lua_getfield(L,LUA_ENVIRONINDEX,"string");
-    lua_pushliteral(L,"char");
-    lua_gettable(L,-2);
-    lua_remove(L,-2);
-    lua_pushvalue(L,1);
-    lua_call(L,1,LUA_MULTRET);
-    return (lua_gettop(L) - lc71);
-  }
-  else {
-    
-    /* elseif n <= 0x7ff then */
-    enum { lc72 = 2 };
-    lua_pushnumber(L,2047);
-    const int lc73 = lc_le(L,1,-1);
-    lua_pop(L,1);
-    lua_pushboolean(L,lc73);
-    const int lc74 = lua_toboolean(L,-1);
-    lua_pop(L,1);
-    if (lc74) {
-      
-      /* return string.char(f(n / 64) + 192, n % 64 + 128) */
-      const int lc75 = lua_gettop(L);
-      lua_getfield(L,LUA_ENVIRONINDEX,"string");
-      lua_pushliteral(L,"char");
-      lua_gettable(L,-2);
-      lua_remove(L,-2);
-      lua_pushvalue(L,2);
-      lua_pushnumber(L,64);
-      lc_div(L,1,-1);
-      lua_remove(L,-2);
-      lua_call(L,1,1);
-      lua_pushnumber(L,192);
-      lc_add(L,-2,-1);
-      lua_remove(L,-2);
-      lua_remove(L,-2);
-      lua_pushnumber(L,64);
-      lc_mod(L,1,-1);
-      lua_remove(L,-2);
-      lua_pushnumber(L,128);
-      lc_add(L,-2,-1);
-      lua_remove(L,-2);
-      lua_remove(L,-2);
-      lua_call(L,2,LUA_MULTRET);
-      return (lua_gettop(L) - lc75);
+    else if (cp <= 0x10ffff)
+    {
+        *out++ = char(0xf0 | (cp >> 18));
+        *out++ = char(0x80 | ((cp >> 12) & 0x3f));
+        *out++ = char(0x80 | ((cp >> 6) & 0x3f));
+        *out++ = char(0x80 | (cp & 0x3f));
     }
-    else {
-      
-      /* elseif n <= 0xffff then */
-      enum { lc76 = 2 };
-      lua_pushnumber(L,65535);
-      const int lc77 = lc_le(L,1,-1);
-      lua_pop(L,1);
-      lua_pushboolean(L,lc77);
-      const int lc78 = lua_toboolean(L,-1);
-      lua_pop(L,1);
-      if (lc78) {
-        
-        /* return string.char(f(n / 4096) + 224, f(n % 4096 / 64) + 128, n % 64 + 128) */
-        const int lc79 = lua_gettop(L);
-        lua_getfield(L,LUA_ENVIRONINDEX,"string");
-        lua_pushliteral(L,"char");
-        lua_gettable(L,-2);
-        lua_remove(L,-2);
-        lua_pushvalue(L,2);
-        lua_pushnumber(L,4096);
-        lc_div(L,1,-1);
-        lua_remove(L,-2);
-        lua_call(L,1,1);
-        lua_pushnumber(L,224);
-        lc_add(L,-2,-1);
-        lua_remove(L,-2);
-        lua_remove(L,-2);
-        lua_pushvalue(L,2);
-        lua_pushnumber(L,4096);
-        lc_mod(L,1,-1);
-        lua_remove(L,-2);
-        lua_pushnumber(L,64);
-        lc_div(L,-2,-1);
-        lua_remove(L,-2);
-        lua_remove(L,-2);
-        lua_call(L,1,1);
-        lua_pushnumber(L,128);
-        lc_add(L,-2,-1);
-        lua_remove(L,-2);
-        lua_remove(L,-2);
-        lua_pushnumber(L,64);
-        lc_mod(L,1,-1);
-        lua_remove(L,-2);
-        lua_pushnumber(L,128);
-        lc_add(L,-2,-1);
-        lua_remove(L,-2);
-        lua_remove(L,-2);
-        lua_call(L,3,LUA_MULTRET);
-        return (lua_gettop(L) - lc79);
-      }
-      else {
-        
-        /* elseif n <= 0x10ffff then */
-        enum { lc80 = 2 };
-        lua_pushnumber(L,1114111);
-        const int lc81 = lc_le(L,1,-1);
-        lua_pop(L,1);
-        lua_pushboolean(L,lc81);
-        const int lc82 = lua_toboolean(L,-1);
-        lua_pop(L,1);
-        if (lc82) {
-          
-          /* return string.char(f(n / 262144) + 240, f(n % 262144 / 4096) + 128,
-           *                        f(n % 4096 / 64) + 128, n % 64 + 128) */
-          const int lc83 = lua_gettop(L);
-          lua_getfield(L,LUA_ENVIRONINDEX,"string");
-          lua_pushliteral(L,"char");
-          lua_gettable(L,-2);
-          lua_remove(L,-2);
-          lua_pushvalue(L,2);
-          lua_pushnumber(L,262144);
-          lc_div(L,1,-1);
-          lua_remove(L,-2);
-          lua_call(L,1,1);
-          lua_pushnumber(L,240);
-          lc_add(L,-2,-1);
-          lua_remove(L,-2);
-          lua_remove(L,-2);
-          lua_pushvalue(L,2);
-          lua_pushnumber(L,262144);
-          lc_mod(L,1,-1);
-          lua_remove(L,-2);
-          lua_pushnumber(L,4096);
-          lc_div(L,-2,-1);
-          lua_remove(L,-2);
-          lua_remove(L,-2);
-          lua_call(L,1,1);
-          lua_pushnumber(L,128);
-          lc_add(L,-2,-1);
-          lua_remove(L,-2);
-          lua_remove(L,-2);
-          lua_pushvalue(L,2);
-          lua_pushnumber(L,4096);
-          lc_mod(L,1,-1);
-          lua_remove(L,-2);
-          lua_pushnumber(L,64);
-          lc_div(L,-2,-1);
-          lua_remove(L,-2);
-          lua_remove(L,-2);
-          lua_call(L,1,1);
-          lua_pushnumber(L,128);
-          lc_add(L,-2,-1);
-          lua_remove(L,-2);
-          lua_remove(L,-2);
-          lua_pushnumber(L,64);
-          lc_mod(L,1,-1);
-          lua_remove(L,-2);
-          lua_pushnumber(L,128);
-          lc_add(L,-2,-1);
-          lua_remove(L,-2);
-          lua_remove(L,-2);
-          lua_call(L,4,LUA_MULTRET);
-          return (lua_gettop(L) - lc83);
-        }
-        lua_settop(L,lc80);
-      }
-      lua_settop(L,lc76);
+    else
+    {
+        luaL_error(L, "invalid unicode codepoint '%x'", cp);
     }
-    lua_settop(L,lc72);
-  }
-  lua_settop(L,lc68);
-  
-  /* error( string.format("invalid unicode codepoint '%x'", n) ) */
-  lua_getfield(L,LUA_ENVIRONINDEX,"error");
-  const int lc84 = lua_gettop(L);
-  lua_getfield(L,LUA_ENVIRONINDEX,"string");
-  lua_pushliteral(L,"format");
-  lua_gettable(L,-2);
-  lua_remove(L,-2);
-  lua_pushliteral(L,"invalid unicode codepoint '%x'");
-  lua_pushvalue(L,1);
-  lua_call(L,2,LUA_MULTRET);
-  lua_call(L,(lua_gettop(L) - lc84),0);
-  return 0;
-}
-
-
-/* name: parse_unicode_escape
- * function(s) */
-static int lcf1_parse_unicode_escape (lua_State * L) {
-  enum { lc_nformalargs = 1 };
-  lua_settop(L,1);
-  
-  /* local n1 = tonumber( s:sub(1, 4),  16 ) */
-  lua_getfield(L,LUA_ENVIRONINDEX,"tonumber");
-  lua_pushvalue(L,1);
-  lua_pushliteral(L,"sub");
-  lua_gettable(L,-2);
-  lua_insert(L,-2);
-  lua_pushnumber(L,1);
-  lua_pushnumber(L,4);
-  lua_call(L,3,1);
-  lua_pushnumber(L,16);
-  lua_call(L,2,1);
-  
-  /* local n2 = tonumber( s:sub(7, 10), 16 ) */
-  lua_getfield(L,LUA_ENVIRONINDEX,"tonumber");
-  lua_pushvalue(L,1);
-  lua_pushliteral(L,"sub");
-  lua_gettable(L,-2);
-  lua_insert(L,-2);
-  lua_pushnumber(L,7);
-  lua_pushnumber(L,10);
-  lua_call(L,3,1);
-  lua_pushnumber(L,16);
-  lua_call(L,2,1);
-  
-  /* -- Surrogate pair?
-   * if n2 then */
-  enum { lc86 = 3 };
-  if (lua_toboolean(L,3)) {
-    
-    /* return codepoint_to_utf8((n1 - 0xd800) * 0x400 + (n2 - 0xdc00) + 0x10000) */
-    const int lc87 = lua_gettop(L);
-    lc_getupvalue(L,lua_upvalueindex(1),1,14);
-    lua_pushnumber(L,55296);
-    lc_sub(L,2,-1);
-    lua_remove(L,-2);
-    lua_pushnumber(L,1024);
-    lc_mul(L,-2,-1);
-    lua_remove(L,-2);
-    lua_remove(L,-2);
-    lua_pushnumber(L,56320);
-    lc_sub(L,3,-1);
-    lua_remove(L,-2);
-    lc_add(L,-2,-1);
-    lua_remove(L,-2);
-    lua_remove(L,-2);
-    lua_pushnumber(L,65536);
-    lc_add(L,-2,-1);
-    lua_remove(L,-2);
-    lua_remove(L,-2);
-    lua_call(L,1,LUA_MULTRET);
-    return (lua_gettop(L) - lc87);
-  }
-  else {
-    
-    /* else
-     * return codepoint_to_utf8(n1) */
-    const int lc88 = lua_gettop(L);
-    lc_getupvalue(L,lua_upvalueindex(1),1,14);
-    lua_pushvalue(L,2);
-    lua_call(L,1,LUA_MULTRET);
-    return (lua_gettop(L) - lc88);
-  }
-  lua_settop(L,lc86);
-  return 0;
-}
-
-
-/* name: parse_string
- * function(str, i) */
-static int lcf1_parse_string (lua_State * L) {
-  enum { lc_nformalargs = 2 };
-  lua_settop(L,2);
-  
-  /* local res = "" */
-  lua_pushliteral(L,"");
-  
-  /* local j = i + 1 */
-  lua_pushnumber(L,1);
-  lc_add(L,2,-1);
-  lua_remove(L,-2);
-  
-  /* local k = j */
-  lua_pushvalue(L,4);
-  
-  /* while j <= #str do */
-  enum { lc89 = 5 };
-  while (1) {
-    const double lc90 = lua_objlen(L,1);
-    lua_pushnumber(L,lc90);
-    const int lc91 = lc_le(L,4,-1);
-    lua_pop(L,1);
-    lua_pushboolean(L,lc91);
-    if (!(lua_toboolean(L,-1))) {
-      break;
+
+    return out;
+}
+
+static char* json_reservescratch(JsonReader* R, size_t size)
+{
+    if (R->scratchsize < size)
+    {
+        lua_State* L = R->L;
+
+        size_t newsize = R->scratchsize * 2 < size ? size : R->scratchsize * 2;
+        TString* ts = luaS_bufstart(L, newsize);
+        setsvalue2s(L, L->base + (R->scratchidx - 1), ts);
+
+        R->scratch = ts->data;
+        R->scratchsize = newsize;
     }
-    lua_pop(L,1);
-    
-    /* local x = str:byte(j) */
-    lua_pushvalue(L,1);
-    lua_pushliteral(L,"byte");
-    lua_gettable(L,-2);
-    lua_insert(L,-2);
-    lua_pushvalue(L,4);
-    lua_call(L,2,1);
-    
-    /* if x < 32 then */
-    enum { lc92 = 6 };
-    lua_pushnumber(L,32);
-    const int lc93 = lua_lessthan(L,6,-1);
-    lua_pop(L,1);
-    lua_pushboolean(L,lc93);
-    const int lc94 = lua_toboolean(L,-1);
-    lua_pop(L,1);
-    if (lc94) {
-      
-      /* decode_error(str, j, "control character in string") */
-      lc_getupvalue(L,lua_upvalueindex(1),2,13);
-      lua_pushvalue(L,1);
-      lua_pushvalue(L,4);
-      lua_pushliteral(L,"control character in string");
-      lua_call(L,3,0);
+
+    return R->scratch;
+}
+
+// reads the string that starts at p; the contents either point into the source or into the scratch buffer when unescaping is required
+static const char* json_readstring(JsonReader* R, const char* p, const char** str, size_t* len)
+{
+    lua_State* L = R->L;
+    const char* end = R->end;
+    const char* start = p + 1;
+
+    // fast path: strings without escape sequences are used directly from the source
+    const char* q = json_scanspecial(start, end);
+
+    if (q < end && (unsigned char)*q < 32)
+        json_decodeerror(R, q - R->begin, "control character in string");
+
+    if (q < end && *q == '"')
+    {
+        *str = start;
+        *len = q - start;
+        return q + 1;
     }
-    else {
-      
-      /* elseif x == 92 then */
-      enum { lc95 = 6 };
-      lua_pushnumber(L,92);
-      const int lc96 = lua_equal(L,6,-1);
-      lua_pop(L,1);
-      lua_pushboolean(L,lc96);
-      const int lc97 = lua_toboolean(L,-1);
-      lua_pop(L,1);
-      if (lc97) {
-        
-        /* -- `\`: Escape
-         * res = res .. str:sub(k, j - 1) */
-        lua_pushvalue(L,3);
-        lua_pushvalue(L,1);
-        lua_pushliteral(L,"sub");
-        lua_gettable(L,-2);
-        lua_insert(L,-2);
-        lua_pushvalue(L,5);
-        lua_pushnumber(L,1);
-        lc_sub(L,4,-1);
-        lua_remove(L,-2);
-        lua_call(L,3,1);
-        lua_concat(L,2);
-        lua_replace(L,3);
-        
-        /* j = j + 1 */
-        lua_pushnumber(L,1);
-        lc_add(L,4,-1);
-        lua_remove(L,-2);
-        lua_replace(L,4);
-        
-        /* local c = str:sub(j, j) */
-        lua_pushvalue(L,1);
-        lua_pushliteral(L,"sub");
-        lua_gettable(L,-2);
-        lua_insert(L,-2);
-        lua_pushvalue(L,4);
-        lua_pushvalue(L,4);
-        lua_call(L,3,1);
-        
-        /* if c == "u" then */
-        enum { lc98 = 7 };
-        lua_pushliteral(L,"u");
-        const int lc99 = lua_equal(L,7,-1);
-        lua_pop(L,1);
-        lua_pushboolean(L,lc99);
-        const int lc100 = lua_toboolean(L,-1);
-        lua_pop(L,1);
-        if (lc100) {
-          
-          /* local hex = str:match("^[dD][89aAbB]%x%x\\u%x%x%x%x", j + 1)
-           *                  or str:match("^%x%x%x%x", j + 1)
-           *                  or decode_error(str, j - 1, "invalid unicode escape in string") */
-          lua_pushvalue(L,1);
-          lua_pushliteral(L,"match");
-          lua_gettable(L,-2);
-          lua_insert(L,-2);
-          lua_pushliteral(L,"^[dD][89aAbB]%x%x\\u%x%x%x%x");
-          lua_pushnumber(L,1);
-          lc_add(L,4,-1);
-          lua_remove(L,-2);
-          lua_call(L,3,1);
-          if (!(lua_toboolean(L,-1))) {
-            lua_pop(L,1);
-            lua_pushvalue(L,1);
-            lua_pushliteral(L,"match");
-            lua_gettable(L,-2);
-            lua_insert(L,-2);
-            lua_pushliteral(L,"^%x%x%x%x");
-            lua_pushnumber(L,1);
-            lc_add(L,4,-1);
-            lua_remove(L,-2);
-            lua_call(L,3,1);
-          }
-          if (!(lua_toboolean(L,-1))) {
-            lua_pop(L,1);
-            lc_getupvalue(L,lua_upvalueindex(1),2,13);
-            lua_pushvalue(L,1);
-            lua_pushnumber(L,1);
-            lc_sub(L,4,-1);
-            lua_remove(L,-2);
-            lua_pushliteral(L,"invalid unicode escape in string");
-            lua_call(L,3,1);
-          }
-          
-          /* res = res .. parse_unicode_escape(hex) */
-          lua_pushvalue(L,3);
-          lc_getupvalue(L,lua_upvalueindex(1),0,15);
-          lua_pushvalue(L,8);
-          lua_call(L,1,1);
-          lua_concat(L,2);
-          lua_replace(L,3);
-          
-          /* j = j + #hex */
-          const double lc101 = lua_objlen(L,8);
-          lua_pushnumber(L,lc101);
-          lc_add(L,4,-1);
-          lua_remove(L,-2);
-          lua_replace(L,4);
+
+    // find the extent of the string to size the output; escape sequences never expand so this is an upper bound
+    const char* last = q;
+
+    while ((last = json_scanspecial(last, end)) < end && *last != '"')
+        last += (*last == '\\') ? 2 : 1;
+
+    char* out = json_reservescratch(R, (last < end ? last : end) - start);
+    char* o = out;
+
+    memcpy(o, start, q - start);
+    o += q - start;
+
+    while (q < end)
+    {
+        unsigned char ch = *q;
+
+        if (ch < 32)
+        {
+            json_decodeerror(R, q - R->begin, "control character in string");
+        }
+        else if (ch == '\\')
+        {
+            q++;
+
+            char esc = q < end ? *q : 0;
+
+            if (esc == 'u')
+            {
+                int cp = -1;
+
+                // surrogate pairs are only recognized when the first escape is in D800-DBFF range
+                if (end - q > 10 && (q[1] == 'd' || q[1] == 'D') && strchr("89aAbB", q[2]) && q[2] && q[5] == '\\' && q[6] == 'u')
+                {
+                    int n1 = json_parsehex4(q + 1);
+                    int n2 = json_parsehex4(q + 7);
+
+                    if (n1 >= 0 && n2 >= 0)
+                    {
+                        cp = (n1 - 0xd800) * 0x400 + (n2 - 0xdc00) + 0x10000;
+                        q += 10;
+                    }
+                }
+
+                if (cp < 0 && end - q > 4)
+                {
+                    cp = json_parsehex4(q + 1);
+
+                    if (cp >= 0)
+                        q += 4;
+                }
+
+                if (cp < 0)
+                    json_decodeerror(R, q - 1 - R->begin, "invalid unicode escape in string");
+
+                o = json_writeutf8(L, o, cp);
+            }
+            else
+            {
+                switch (esc)
+                {
+                case '"':
+                case '\\':
+                case '/':
+                    *o++ = esc;
+                    break;
+                case 'b':
+                    *o++ = '\b';
+                    break;
+                case 'f':
+                    *o++ = '\f';
+                    break;
+                case 'n':
+                    *o++ = '\n';
+                    break;
+                case 'r':
+                    *o++ = '\r';
+                    break;
+                case 't':
+                    *o++ = '\t';
+                    break;
+                default:
+                    json_decodeerror(R, q - 1 - R->begin, "invalid escape char '%.*s' in string", q < end ? 1 : 0, q);
+                }
+            }
         }
-        else {
-          
-          /* else
-           * if not escape_chars[c] then */
-          enum { lc102 = 7 };
-          lc_getupvalue(L,lua_upvalueindex(1),6,9);
-          lua_pushvalue(L,7);
-          lua_gettable(L,-2);
-          lua_remove(L,-2);
-          lua_pushboolean(L,!(lua_toboolean(L,-1)));
-          lua_remove(L,-2);
-          const int lc103 = lua_toboolean(L,-1);
-          lua_pop(L,1);
-          if (lc103) {
-            
-            /* decode_error(str, j - 1, "invalid escape char '" .. c .. "' in string") */
-            lc_getupvalue(L,lua_upvalueindex(1),2,13);
-            lua_pushvalue(L,1);
-            lua_pushnumber(L,1);
-            lc_sub(L,4,-1);
-            lua_remove(L,-2);
-            lua_pushliteral(L,"invalid escape char '");
-            lua_pushvalue(L,7);
-            lua_pushliteral(L,"' in string");
-            lua_concat(L,2);
-            lua_concat(L,2);
-            lua_call(L,3,0);
-          }
-          lua_settop(L,lc102);
-          
-          /* res = res .. escape_char_map_inv[c] */
-          lua_pushvalue(L,3);
-          lc_getupvalue(L,lua_upvalueindex(1),12,3);
-          lua_pushvalue(L,7);
-          lua_gettable(L,-2);
-          lua_remove(L,-2);
-          lua_concat(L,2);
-          lua_replace(L,3);
+        else if (ch == '"')
+        {
+            *str = out;
+            *len = o - out;
+            return q + 1;
         }
-        lua_settop(L,lc98);
-        
-        /* k = j + 1 */
-        lua_pushnumber(L,1);
-        lc_add(L,4,-1);
-        lua_remove(L,-2);
-        lua_replace(L,5);
-      }
-      else {
-        
-        /* elseif x == 34 then */
-        enum { lc104 = 6 };
-        lua_pushnumber(L,34);
-        const int lc105 = lua_equal(L,6,-1);
-        lua_pop(L,1);
-        lua_pushboolean(L,lc105);
-        const int lc106 = lua_toboolean(L,-1);
-        lua_pop(L,1);
-        if (lc106) {
-          
-          /* -- `"`: End of string
-           * res = res .. str:sub(k, j - 1) */
-          lua_pushvalue(L,3);
-          lua_pushvalue(L,1);
-          lua_pushliteral(L,"sub");
-          lua_gettable(L,-2);
-          lua_insert(L,-2);
-          lua_pushvalue(L,5);
-          lua_pushnumber(L,1);
-          lc_sub(L,4,-1);
-          lua_remove(L,-2);
-          lua_call(L,3,1);
-          lua_concat(L,2);
-          lua_replace(L,3);
-          
-          /* return res, j + 1 */
-          lua_pushvalue(L,3);
-          lua_pushnumber(L,1);
-          lc_add(L,4,-1);
-          lua_remove(L,-2);
-          return 2;
+        else
+        {
+            // copy the run of ordinary characters up to the next quote, backslash or control character
+            const char* next = json_scanspecial(q + 1, end);
+
+            memcpy(o, q, next - q);
+            o += next - q;
+            q = next;
+            continue;
         }
-        lua_settop(L,lc104);
-      }
-      lua_settop(L,lc95);
+
+        q++;
     }
-    lua_settop(L,lc92);
-    
-    /* j = j + 1 */
-    lua_pushnumber(L,1);
-    lc_add(L,4,-1);
-    lua_remove(L,-2);
-    lua_replace(L,4);
-    
-    /* internal: stack cleanup on scope exit */
-    lua_pop(L,1);
-  }
-  lua_settop(L,lc89);
-  
-  /* decode_error(str, i, "expected closing quote for string") */
-  lc_getupvalue(L,lua_upvalueindex(1),2,13);
-  lua_pushvalue(L,1);
-  lua_pushvalue(L,2);
-  lua_pushliteral(L,"expected closing quote for string");
-  lua_call(L,3,0);
-  return 0;
-}
-
-
-/* name: parse_number
- * function(str, i) */
-static int lcf1_parse_number (lua_State * L) {
-  enum { lc_nformalargs = 2 };
-  lua_settop(L,2);
-  
-  /* local x = next_char(str, i, delim_chars) */
-  lc_getupvalue(L,lua_upvalueindex(1),3,12);
-  lua_pushvalue(L,1);
-  lua_pushvalue(L,2);
-  lc_getupvalue(L,lua_upvalueindex(1),7,8);
-  lua_call(L,3,1);
-  
-  /* local s = str:sub(i, x - 1) */
-  lua_pushvalue(L,1);
-  lua_pushliteral(L,"sub");
-  lua_gettable(L,-2);
-  lua_insert(L,-2);
-  lua_pushvalue(L,2);
-  lua_pushnumber(L,1);
-  lc_sub(L,3,-1);
-  lua_remove(L,-2);
-  lua_call(L,3,1);
-  
-  /* local n = tonumber(s) */
-  lua_getfield(L,LUA_ENVIRONINDEX,"tonumber");
-  lua_pushvalue(L,4);
-  lua_call(L,1,1);
-  
-  /* if not n then */
-  enum { lc107 = 5 };
-  lua_pushboolean(L,!(lua_toboolean(L,5)));
-  const int lc108 = lua_toboolean(L,-1);
-  lua_pop(L,1);
-  if (lc108) {
-    
-    /* decode_error(str, i, "invalid number '" .. s .. "'") */
-    lc_getupvalue(L,lua_upvalueindex(1),2,13);
-    lua_pushvalue(L,1);
-    lua_pushvalue(L,2);
-    lua_pushliteral(L,"invalid number '");
-    lua_pushvalue(L,4);
-    lua_pushliteral(L,"'");
-    lua_concat(L,2);
-    lua_concat(L,2);
-    lua_call(L,3,0);
-  }
-  lua_settop(L,lc107);
-  
-  /* return n, x */
-  lua_pushvalue(L,5);
-  lua_pushvalue(L,3);
-  return 2;
-}
-
-
-/* name: parse_literal
- * function(str, i) */
-static int lcf1_parse_literal (lua_State * L) {
-  enum { lc_nformalargs = 2 };
-  lua_settop(L,2);
-  
-  /* local x = next_char(str, i, delim_chars) */
-  lc_getupvalue(L,lua_upvalueindex(1),3,12);
-  lua_pushvalue(L,1);
-  lua_pushvalue(L,2);
-  lc_getupvalue(L,lua_upvalueindex(1),7,8);
-  lua_call(L,3,1);
-  
-  /* local word = str:sub(i, x - 1) */
-  lua_pushvalue(L,1);
-  lua_pushliteral(L,"sub");
-  lua_gettable(L,-2);
-  lua_insert(L,-2);
-  lua_pushvalue(L,2);
-  lua_pushnumber(L,1);
-  lc_sub(L,3,-1);
-  lua_remove(L,-2);
-  lua_call(L,3,1);
-  
-  /* if not literals[word] then */
-  enum { lc109 = 4 };
-  lc_getupvalue(L,lua_upvalueindex(1),5,10);
-  lua_pushvalue(L,4);
-  lua_gettable(L,-2);
-  lua_remove(L,-2);
-  lua_pushboolean(L,!(lua_toboolean(L,-1)));
-  lua_remove(L,-2);
-  const int lc110 = lua_toboolean(L,-1);
-  lua_pop(L,1);
-  if (lc110) {
-    
-    /* decode_error(str, i, "invalid literal '" .. word .. "'") */
-    lc_getupvalue(L,lua_upvalueindex(1),2,13);
-    lua_pushvalue(L,1);
-    lua_pushvalue(L,2);
-    lua_pushliteral(L,"invalid literal '");
-    lua_pushvalue(L,4);
-    lua_pushliteral(L,"'");
-    lua_concat(L,2);
-    lua_concat(L,2);
-    lua_call(L,3,0);
-  }
-  lua_settop(L,lc109);
-  
-  /* return literal_map[word], x */
-  lc_getupvalue(L,lua_upvalueindex(1),4,11);
-  lua_pushvalue(L,4);
-  lua_gettable(L,-2);
-  lua_remove(L,-2);
-  lua_pushvalue(L,3);
-  return 2;
-}
-
-
-/* name: parse_array
- * function(str, i) */
-static int lcf1_parse_array (lua_State * L) {
-  enum { lc_nformalargs = 2 };
-  lua_settop(L,2);
-  
-  /* local res = {} */
-  lua_newtable(L);
-  
-  /* local n = 1 */
-  lua_pushnumber(L,1);
-  
-  /* i = i + 1 */
-  lua_pushnumber(L,1);
-  lc_add(L,2,-1);
-  lua_remove(L,-2);
-  lua_replace(L,2);
-  
-  /* while 1 do */
-  enum { lc111 = 4 };
-  while (1) {
-    lua_pushnumber(L,1);
-    if (!(lua_toboolean(L,-1))) {
-      break;
+
+    json_decodeerror(R, p - R->begin, "expected closing quote for string");
+}
+
+static const char* json_parsestring(JsonReader* R, const char* p)
+{
+    const char* str;
+    size_t len;
+    p = json_readstring(R, p, &str, &len);
+
+    lua_pushlstring(R->L, str, len);
+    return p;
+}
+
+static const char* json_parsenumber(JsonReader* R, const char* p)
+{
+    lua_State* L = R->L;
+    const char* e = json_skiptoken(p, R->end);
+    size_t len = e - p;
+
+    // fast path: integers with up to 15 digits are exactly representable and don't need strtod
+    const char* d = p + (*p == '-');
+
+    if (d < e && size_t(e - d) <= 15)
+    {
+        long long v = 0;
+        const char* q = d;
+
+        while (q < e && unsigned(*q - '0') < 10)
+            v = v * 10 + (*q++ - '0');
+
+        if (q == e)
+        {
+            double n = double(v);
+            lua_pushnumber(L, *p == '-' ? -n : n);
+            return e;
+        }
     }
-    lua_pop(L,1);
-    
-    /* local x */
-    lua_settop(L,(lua_gettop(L) + 1));
-    
-    /* i = next_char(str, i, space_chars, true) */
-    lc_getupvalue(L,lua_upvalueindex(1),3,12);
-    lua_pushvalue(L,1);
-    lua_pushvalue(L,2);
-    lc_getupvalue(L,lua_upvalueindex(1),8,7);
-    lua_pushboolean(L,1);
-    lua_call(L,4,1);
-    lua_replace(L,2);
-    
-    /* -- Empty / end of array?
-     * if str:sub(i, i) == "]" then */
-    enum { lc112 = 5 };
-    lua_pushvalue(L,1);
-    lua_pushliteral(L,"sub");
-    lua_gettable(L,-2);
-    lua_insert(L,-2);
-    lua_pushvalue(L,2);
-    lua_pushvalue(L,2);
-    lua_call(L,3,1);
-    lua_pushliteral(L,"]");
-    const int lc113 = lua_equal(L,-2,-1);
-    lua_pop(L,2);
-    lua_pushboolean(L,lc113);
-    const int lc114 = lua_toboolean(L,-1);
-    lua_pop(L,1);
-    if (lc114) {
-      
-      /* i = i + 1 */
-      lua_pushnumber(L,1);
-      lc_add(L,2,-1);
-      lua_remove(L,-2);
-      lua_replace(L,2);
-      
-      /* break */
-      break;
+
+    // slow path matches tonumber(), including its support for hexadecimal numbers
+    double n = 0;
+    int ok = 0;
+
+    char buf[64];
+
+    if (len < sizeof(buf))
+    {
+        memcpy(buf, p, len);
+        buf[len] = 0;
+        ok = luaO_str2d(buf, &n);
     }
-    lua_settop(L,lc112);
-    
-    /* -- Read token
-     * x, i = parse(str, i) */
-    lc_getupvalue(L,lua_upvalueindex(1),9,6);
-    lua_pushvalue(L,1);
-    lua_pushvalue(L,2);
-    lua_call(L,2,2);
-    lua_replace(L,2);
-    lua_replace(L,5);
-    
-    /* res[n] = x */
-    lua_pushvalue(L,5);
-    lua_pushvalue(L,4);
-    lua_insert(L,-2);
-    lua_settable(L,3);
-    
-    /* n = n + 1 */
-    lua_pushnumber(L,1);
-    lc_add(L,4,-1);
-    lua_remove(L,-2);
-    lua_replace(L,4);
-    
-    /* -- Next token
-     * i = next_char(str, i, space_chars, true) */
-    lc_getupvalue(L,lua_upvalueindex(1),3,12);
-    lua_pushvalue(L,1);
-    lua_pushvalue(L,2);
-    lc_getupvalue(L,lua_upvalueindex(1),8,7);
-    lua_pushboolean(L,1);
-    lua_call(L,4,1);
-    lua_replace(L,2);
-    
-    /* local chr = str:sub(i, i) */
-    lua_pushvalue(L,1);
-    lua_pushliteral(L,"sub");
-    lua_gettable(L,-2);
-    lua_insert(L,-2);
-    lua_pushvalue(L,2);
-    lua_pushvalue(L,2);
-    lua_call(L,3,1);
-    
-    /* i = i + 1 */
-    lua_pushnumber(L,1);
-    lc_add(L,2,-1);
-    lua_remove(L,-2);
-    lua_replace(L,2);
-    
-    /* if chr == "]" then */
-    enum { lc115 = 6 };
-    lua_pushliteral(L,"]");
-    const int lc116 = lua_equal(L,6,-1);
-    lua_pop(L,1);
-    lua_pushboolean(L,lc116);
-    const int lc117 = lua_toboolean(L,-1);
-    lua_pop(L,1);
-    if (lc117) {
-      
-      /* break */
-      break;
+    else
+    {
+        lua_pushlstring(L, p, len);
+        n = lua_tonumberx(L, -1, &ok);
+        lua_pop(L, 1);
     }
-    lua_settop(L,lc115);
-    
-    /* if chr ~= "," then */
-    enum { lc118 = 6 };
-    lua_pushliteral(L,",");
-    const int lc119 = lua_equal(L,6,-1);
-    lua_pop(L,1);
-    lua_pushboolean(L,lc119);
-    lua_pushboolean(L,!(lua_toboolean(L,-1)));
-    lua_remove(L,-2);
-    const int lc120 = lua_toboolean(L,-1);
-    lua_pop(L,1);
-    if (lc120) {
-      
-      /* decode_error(str, i, "expected ']' or ','") */
-      lc_getupvalue(L,lua_upvalueindex(1),2,13);
-      lua_pushvalue(L,1);
-      lua_pushvalue(L,2);
-      lua_pushliteral(L,"expected ']' or ','");
-      lua_call(L,3,0);
+
+    if (!ok)
+        json_decodeerror(R, p - R->begin, "invalid number '%.*s'", int(len), p);
+
+    lua_pushnumber(L, n);
+    return e;
+}
+
+static const char* json_parseliteral(JsonReader* R, const char* p)
+{
+    lua_State* L = R->L;
+    const char* e = json_skiptoken(p, R->end);
+    size_t len = e - p;
+
+    if (len == 4 && memcmp(p, "true", 4) == 0)
+        lua_pushboolean(L, true);
+    else if (len == 5 && memcmp(p, "false", 5) == 0)
+        lua_pushboolean(L, false);
+    else if (len == 4 && memcmp(p, "null", 4) == 0)
+        lua_pushnil(L);
+    else
+        json_decodeerror(R, p - R->begin, "invalid literal '%.*s'", int(len), p);
+
+    return e;
+}
+
+// moves pending elements above stack slot t into the array at slot t, creating it if necessary; returns new element count
+static int json_flusharray(lua_State* L, int t, int n, bool done)
+{
+    int count = lua_gettop(L) - t;
+
+    if (lua_isnil(L, t))
+    {
+        // if the array is incomplete, we assume it will grow further
+        lua_createtable(L, done ? count : count * 2, 0);
+        lua_replace(L, t);
     }
-    lua_settop(L,lc118);
-    
-    /* internal: stack cleanup on scope exit */
-    lua_pop(L,2);
-  }
-  lua_settop(L,lc111);
-  
-  /* return res, i */
-  lua_pushvalue(L,3);
-  lua_pushvalue(L,2);
-  return 2;
-}
-
-
-/* name: parse_object
- * function(str, i) */
-static int lcf1_parse_object (lua_State * L) {
-  enum { lc_nformalargs = 2 };
-  lua_settop(L,2);
-  
-  /* local res = {} */
-  lua_newtable(L);
-  
-  /* i = i + 1 */
-  lua_pushnumber(L,1);
-  lc_add(L,2,-1);
-  lua_remove(L,-2);
-  lua_replace(L,2);
-  
-  /* while 1 do */
-  enum { lc121 = 3 };
-  while (1) {
-    lua_pushnumber(L,1);
-    if (!(lua_toboolean(L,-1))) {
-      break;
+
+    Table* h = hvalue(L->base + t - 1);
+
+    for (int i = 0; i < count; ++i)
+    {
+        StkId v = L->base + t + i;
+
+        // null elements leave holes in the array
+        if (!ttisnil(v))
+        {
+            setobj2t(L, luaH_setnum(L, h, n + i + 1), v);
+            luaC_barriert(L, h, v);
+        }
     }
-    lua_pop(L,1);
-    
-    /* local key, val */
-    lua_settop(L,(lua_gettop(L) + 2));
-    
-    /* i = next_char(str, i, space_chars, true) */
-    lc_getupvalue(L,lua_upvalueindex(1),3,12);
-    lua_pushvalue(L,1);
-    lua_pushvalue(L,2);
-    lc_getupvalue(L,lua_upvalueindex(1),8,7);
-    lua_pushboolean(L,1);
-    lua_call(L,4,1);
-    lua_replace(L,2);
-    
-    /* -- Empty / end of object?
-     * if str:sub(i, i) == "}" then */
-    enum { lc122 = 5 };
-    lua_pushvalue(L,1);
-    lua_pushliteral(L,"sub");
-    lua_gettable(L,-2);
-    lua_insert(L,-2);
-    lua_pushvalue(L,2);
-    lua_pushvalue(L,2);
-    lua_call(L,3,1);
-    lua_pushliteral(L,"}");
-    const int lc123 = lua_equal(L,-2,-1);
-    lua_pop(L,2);
-    lua_pushboolean(L,lc123);
-    const int lc124 = lua_toboolean(L,-1);
-    lua_pop(L,1);
-    if (lc124) {
-      
-      /* i = i + 1 */
-      lua_pushnumber(L,1);
-      lc_add(L,2,-1);
-      lua_remove(L,-2);
-      lua_replace(L,2);
-      
-      /* break */
-      break;
+
+    lua_settop(L, t);
+    return n + count;
+}
+
+// moves pending key/value pairs above stack slot t into the object at slot t, creating it if necessary
+static void json_flushobject(lua_State* L, int t, bool done)
+{
+    int count = (lua_gettop(L) - t) / 2;
+
+    if (lua_isnil(L, t))
+    {
+        lua_createtable(L, 0, done ? count : count * 2);
+        lua_replace(L, t);
     }
-    lua_settop(L,lc122);
-    
-    /* -- Read key
-     * if str:sub(i, i) ~= '"' then */
-    enum { lc125 = 5 };
-    lua_pushvalue(L,1);
-    lua_pushliteral(L,"sub");
-    lua_gettable(L,-2);
-    lua_insert(L,-2);
-    lua_pushvalue(L,2);
-    lua_pushvalue(L,2);
-    lua_call(L,3,1);
-    lua_pushliteral(L,"\"");
-    const int lc126 = lua_equal(L,-2,-1);
-    lua_pop(L,2);
-    lua_pushboolean(L,lc126);
-    lua_pushboolean(L,!(lua_toboolean(L,-1)));
-    lua_remove(L,-2);
-    const int lc127 = lua_toboolean(L,-1);
-    lua_pop(L,1);
-    if (lc127) {
-      
-      /* decode_error(str, i, "expected string for key") */
-      lc_getupvalue(L,lua_upvalueindex(1),2,13);
-      lua_pushvalue(L,1);
-      lua_pushvalue(L,2);
-      lua_pushliteral(L,"expected string for key");
-      lua_call(L,3,0);
+
+    Table* h = hvalue(L->base + t - 1);
+
+    for (int i = 0; i < count; ++i)
+    {
+        StkId k = L->base + t + i * 2;
+        StkId v = k + 1;
+
+        // null fields are skipped, but they still remove earlier fields with the same key
+        if (ttisnil(v))
+        {
+            if (!ttisnil(luaH_get(h, k)))
+                setnilvalue(luaH_set(L, h, k));
+        }
+        else
+        {
+            setobj2t(L, luaH_set(L, h, k), v);
+            luaC_barriert(L, h, v);
+        }
     }
-    lua_settop(L,lc125);
-    
-    /* key, i = parse(str, i) */
-    lc_getupvalue(L,lua_upvalueindex(1),9,6);
-    lua_pushvalue(L,1);
-    lua_pushvalue(L,2);
-    lua_call(L,2,2);
-    lua_replace(L,2);
-    lua_replace(L,4);
-    
-    /* -- Read ':' delimiter
-     * i = next_char(str, i, space_chars, true) */
-    lc_getupvalue(L,lua_upvalueindex(1),3,12);
-    lua_pushvalue(L,1);
-    lua_pushvalue(L,2);
-    lc_getupvalue(L,lua_upvalueindex(1),8,7);
-    lua_pushboolean(L,1);
-    lua_call(L,4,1);
-    lua_replace(L,2);
-    
-    /* if str:sub(i, i) ~= ":" then */
-    enum { lc128 = 5 };
-    lua_pushvalue(L,1);
-    lua_pushliteral(L,"sub");
-    lua_gettable(L,-2);
-    lua_insert(L,-2);
-    lua_pushvalue(L,2);
-    lua_pushvalue(L,2);
-    lua_call(L,3,1);
-    lua_pushliteral(L,":");
-    const int lc129 = lua_equal(L,-2,-1);
-    lua_pop(L,2);
-    lua_pushboolean(L,lc129);
-    lua_pushboolean(L,!(lua_toboolean(L,-1)));
-    lua_remove(L,-2);
-    const int lc130 = lua_toboolean(L,-1);
-    lua_pop(L,1);
-    if (lc130) {
-      
-      /* decode_error(str, i, "expected ':' after key") */
-      lc_getupvalue(L,lua_upvalueindex(1),2,13);
-      lua_pushvalue(L,1);
-      lua_pushvalue(L,2);
-      lua_pushliteral(L,"expected ':' after key");
-      lua_call(L,3,0);
+
+    lua_settop(L, t);
+}
+
+static void json_enter(JsonReader* R, const char* p)
+{
+    if (++R->depth > JSON_MAXDEPTH)
+        json_decodeerror(R, p - R->begin, "maximum nesting depth exceeded");
+}
+
+static const char* json_parsearray(JsonReader* R, const char* p)
+{
+    lua_State* L = R->L;
+    const char* end = R->end;
+
+    json_enter(R, p);
+
+    // placeholder for the table which is created once the element count is known
+    lua_pushnil(L);
+    int t = lua_gettop(L);
+    int n = 0;
+
+    p++;
+
+    for (;;)
+    {
+        p = json_skipspace(p, end);
+
+        if (p < end && *p == ']')
+        {
+            p++;
+            break;
+        }
+
+        if (lua_gettop(L) >= JSON_MAXPENDING)
+            n = json_flusharray(L, t, n, false);
+
+        luaL_checkstack(L, 3, "too many nested values");
+
+        p = json_parsevalue(R, p);
+        p = json_skipspace(p, end);
+
+        if (p < end && *p == ']')
+        {
+            p++;
+            break;
+        }
+
+        if (p >= end || *p != ',')
+            json_decodeerror(R, p + 1 - R->begin, "expected ']' or ','");
+
+        p++;
     }
-    lua_settop(L,lc128);
-    
-    /* i = next_char(str, i + 1, space_chars, true) */
-    lc_getupvalue(L,lua_upvalueindex(1),3,12);
-    lua_pushvalue(L,1);
-    lua_pushnumber(L,1);
-    lc_add(L,2,-1);
-    lua_remove(L,-2);
-    lc_getupvalue(L,lua_upvalueindex(1),8,7);
-    lua_pushboolean(L,1);
-    lua_call(L,4,1);
-    lua_replace(L,2);
-    
-    /* -- Read value
-     * val, i = parse(str, i) */
-    lc_getupvalue(L,lua_upvalueindex(1),9,6);
-    lua_pushvalue(L,1);
-    lua_pushvalue(L,2);
-    lua_call(L,2,2);
-    lua_replace(L,2);
-    lua_replace(L,5);
-    
-    /* -- Set
-     * res[key] = val */
-    lua_pushvalue(L,5);
-    lua_pushvalue(L,4);
-    lua_insert(L,-2);
-    lua_settable(L,3);
-    
-    /* -- Next token
-     * i = next_char(str, i, space_chars, true) */
-    lc_getupvalue(L,lua_upvalueindex(1),3,12);
-    lua_pushvalue(L,1);
-    lua_pushvalue(L,2);
-    lc_getupvalue(L,lua_upvalueindex(1),8,7);
-    lua_pushboolean(L,1);
-    lua_call(L,4,1);
-    lua_replace(L,2);
-    
-    /* local chr = str:sub(i, i) */
-    lua_pushvalue(L,1);
-    lua_pushliteral(L,"sub");
-    lua_gettable(L,-2);
-    lua_insert(L,-2);
-    lua_pushvalue(L,2);
-    lua_pushvalue(L,2);
-    lua_call(L,3,1);
-    
-    /* i = i + 1 */
-    lua_pushnumber(L,1);
-    lc_add(L,2,-1);
-    lua_remove(L,-2);
-    lua_replace(L,2);
-    
-    /* if chr == "}" then */
-    enum { lc131 = 6 };
-    lua_pushliteral(L,"}");
-    const int lc132 = lua_equal(L,6,-1);
-    lua_pop(L,1);
-    lua_pushboolean(L,lc132);
-    const int lc133 = lua_toboolean(L,-1);
-    lua_pop(L,1);
-    if (lc133) {
-      
-      /* break */
-      break;
+
+    json_flusharray(L, t, n, true);
+
+    R->depth--;
+    return p;
+}
+
+static const char* json_parseobject(JsonReader* R, const char* p)
+{
+    lua_State* L = R->L;
+    const char* end = R->end;
+
+    json_enter(R, p);
+
+    // placeholder for the table which is created once the field count is known
+    lua_pushnil(L);
+    int t = lua_gettop(L);
+
+    p++;
+
+    for (;;)
+    {
+        p = json_skipspace(p, end);
+
+        if (p < end && *p == '}')
+        {
+            p++;
+            break;
+        }
+
+        if (p >= end || *p != '"')
+            json_decodeerror(R, p - R->begin, "expected string for key");
+
+        if (lua_gettop(L) >= JSON_MAXPENDING)
+            json_flushobject(L, t, false);
+
+        luaL_checkstack(L, 4, "too many nested values");
+
+        p = json_parsestring(R, p);
+        p = json_skipspace(p, end);
+
+        if (p >= end || *p != ':')
+            json_decodeerror(R, p - R->begin, "expected ':' after key");
+
+        p = json_skipspace(p + 1, end);
+        p = json_parsevalue(R, p);
+        p = json_skipspace(p, end);
+
+        if (p < end && *p == '}')
+        {
+            p++;
+            break;
+        }
+
+        if (p >= end || *p != ',')
+            json_decodeerror(R, p + 1 - R->begin, "expected '}' or ','");
+
+        p++;
     }
-    lua_settop(L,lc131);
-    
-    /* if chr ~= "," then */
-    enum { lc134 = 6 };
-    lua_pushliteral(L,",");
-    const int lc135 = lua_equal(L,6,-1);
-    lua_pop(L,1);
-    lua_pushboolean(L,lc135);
-    lua_pushboolean(L,!(lua_toboolean(L,-1)));
-    lua_remove(L,-2);
-    const int lc136 = lua_toboolean(L,-1);
-    lua_pop(L,1);
-    if (lc136) {
-      
-      /* decode_error(str, i, "expected '}' or ','") */
-      lc_getupvalue(L,lua_upvalueindex(1),2,13);
-      lua_pushvalue(L,1);
-      lua_pushvalue(L,2);
-      lua_pushliteral(L,"expected '}' or ','");
-      lua_call(L,3,0);
+
+    json_flushobject(L, t, true);
+
+    R->depth--;
+    return p;
+}
+
+static const char* json_parsevalue(JsonReader* R, const char* p)
+{
+    char ch = p < R->end ? *p : 0;
+
+    switch (ch)
+    {
+    case '"':
+        return json_parsestring(R, p);
+    case '-':
+    case '0':
+    case '1':
+    case '2':
+    case '3':
+    case '4':
+    case '5':
+    case '6':
+    case '7':
+    case '8':
+    case '9':
+        return json_parsenumber(R, p);
+    case 't':
+    case 'f':
+    case 'n':
+        return json_parseliteral(R, p);
+    case '[':
+        return json_parsearray(R, p);
+    case '{':
+        return json_parseobject(R, p);
+    default:
+        json_decodeerror(R, p - R->begin, "unexpected character '%.*s'", p < R->end ? 1 : 0, p);
     }
-    lua_settop(L,lc134);
-    
-    /* internal: stack cleanup on scope exit */
-    lua_pop(L,3);
-  }
-  lua_settop(L,lc121);
-  
-  /* return res, i */
-  lua_pushvalue(L,3);
-  lua_pushvalue(L,2);
-  return 2;
-}
-
-
-/* name: parse
- * function(str, idx) */
-static int lcf1_parse (lua_State * L) {
-  enum { lc_nformalargs = 2 };
-  lua_settop(L,2);
-  
-  /* local chr = str:sub(idx, idx) */
-  lua_pushvalue(L,1);
-  lua_pushliteral(L,"sub");
-  lua_gettable(L,-2);
-  lua_insert(L,-2);
-  lua_pushvalue(L,2);
-  lua_pushvalue(L,2);
-  lua_call(L,3,1);
-  
-  /* local f = char_func_map[chr] */
-  lc_getupvalue(L,lua_upvalueindex(1),0,16);
-  lua_pushvalue(L,3);
-  lua_gettable(L,-2);
-  lua_remove(L,-2);
-  
-  /* if f then */
-  enum { lc138 = 4 };
-  if (lua_toboolean(L,4)) {
-    
-    /* return f(str, idx) */
-    const int lc139 = lua_gettop(L);
-    lua_pushvalue(L,4);
-    lua_pushvalue(L,1);
-    lua_pushvalue(L,2);
-    lua_call(L,2,LUA_MULTRET);
-    return (lua_gettop(L) - lc139);
-  }
-  lua_settop(L,lc138);
-  
-  /* decode_error(str, idx, "unexpected character '" .. chr .. "'") */
-  lc_getupvalue(L,lua_upvalueindex(1),3,13);
-  lua_pushvalue(L,1);
-  lua_pushvalue(L,2);
-  lua_pushliteral(L,"unexpected character '");
-  lua_pushvalue(L,3);
-  lua_pushliteral(L,"'");
-  lua_concat(L,2);
-  lua_concat(L,2);
-  lua_call(L,3,0);
-  return 0;
-}
-
-
-/* name: json.decode
- * function(str) */
-static int lcf1_json_decode (lua_State * L) {
-  enum { lc_nformalargs = 1 };
-  lua_settop(L,1);
-  
-  /* if type(str) ~= "string" then */
-  enum { lc140 = 1 };
-  lua_getfield(L,LUA_ENVIRONINDEX,"type");
-  lua_pushvalue(L,1);
-  lua_call(L,1,1);
-  lua_pushliteral(L,"string");
-  const int lc141 = lua_equal(L,-2,-1);
-  lua_pop(L,2);
-  lua_pushboolean(L,lc141);
-  lua_pushboolean(L,!(lua_toboolean(L,-1)));
-  lua_remove(L,-2);
-  const int lc142 = lua_toboolean(L,-1);
-  lua_pop(L,1);
-  if (lc142) {
-    
-    /* error("expected argument of type string, got " .. type(str)) */
-    lua_getfield(L,LUA_ENVIRONINDEX,"error");
-    lua_pushliteral(L,"expected argument of type string, got ");
-    lua_getfield(L,LUA_ENVIRONINDEX,"type");
-    lua_pushvalue(L,1);
-    lua_call(L,1,1);
-    lua_concat(L,2);
-    lua_call(L,1,0);
-  }
-  lua_settop(L,lc140);
-  
-  /* local res, idx = parse(str, next_char(str, 1, space_chars, true)) */
-  lc_getupvalue(L,lua_upvalueindex(1),10,6);
-  const int lc143 = lua_gettop(L);
-  lua_pushvalue(L,1);
-  lc_getupvalue(L,lua_upvalueindex(1),4,12);
-  lua_pushvalue(L,1);
-  lua_pushnumber(L,1);
-  lc_getupvalue(L,lua_upvalueindex(1),9,7);
-  lua_pushboolean(L,1);
-  lua_call(L,4,LUA_MULTRET);
-  lua_call(L,(lua_gettop(L) - lc143),2);
-  
-  /* idx = next_char(str, idx, space_chars, true) */
-  lc_getupvalue(L,lua_upvalueindex(1),4,12);
-  lua_pushvalue(L,1);
-  lua_pushvalue(L,3);
-  lc_getupvalue(L,lua_upvalueindex(1),9,7);
-  lua_pushboolean(L,1);
-  lua_call(L,4,1);
-  lua_replace(L,3);
-  
-  /* if idx <= #str then */
-  enum { lc144 = 3 };
-  const double lc145 = lua_objlen(L,1);
-  lua_pushnumber(L,lc145);
-  const int lc146 = lc_le(L,3,-1);
-  lua_pop(L,1);
-  lua_pushboolean(L,lc146);
-  const int lc147 = lua_toboolean(L,-1);
-  lua_pop(L,1);
-  if (lc147) {
-    
-    /* decode_error(str, idx, "trailing garbage") */
-    lc_getupvalue(L,lua_upvalueindex(1),3,13);
-    lua_pushvalue(L,1);
-    lua_pushvalue(L,3);
-    lua_pushliteral(L,"trailing garbage");
-    lua_call(L,3,0);
-  }
-  lua_settop(L,lc144);
-  
-  /* return res */
-  lua_pushvalue(L,2);
-  return 1;
-}
-
-/* name: (main)
- * function(...) */
-static int lcf_main (lua_State * L) {
-  lua_checkstack(L,37);
-  enum { lc_nformalargs = 0 };
-  const int lc_nactualargs = lua_gettop(L);
-  const int lc_nextra = (lc_nactualargs - lc_nformalargs);
-  
-  /* --
-   * -- json.lua
-   * --
-   * -- Copyright (c) 2020 rxi
-   * --
-   * -- Permission is hereby granted, free of charge, to any person obtaining a copy of
-   * -- this software and associated documentation files (the "Software"), to deal in
-   * -- the Software without restriction, including without limitation the rights to
-   * -- use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
-   * -- of the Software, and to permit persons to whom the Software is furnished to do
-   * -- so, subject to the following conditions:
-   * --
-   * -- The above copyright notice and this permission notice shall be included in all
-   * -- copies or substantial portions of the Software.
-   * --
-   * -- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
-   * -- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
-   * -- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
-   * -- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
-   * -- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
-   * -- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
-   * -- SOFTWARE.
-   * --
-   * local json = { _version = "0.1.2" } */
-  lc_register(L, LUA_JSONLIBNAME, 2);
-  
-  /* -------------------------------------------------------------------------------
-   * -- Encode
-   * -------------------------------------------------------------------------------
-   * local encode */
-  lc_newclosuretable(L,lua_upvalueindex(1));
-  enum { lc1 = 2 };
-  lua_settop(L,(lua_gettop(L) + 1));
-  lua_rawseti(L,(lc1 + lc_nextra),1);
-  
-  /* local escape_char_map = {
-   *   [ "\\" ] = "\\",
-   *   [ "\"" ] = "\"",
-   *   [ "\b" ] = "b",
-   *   [ "\f" ] = "f",
-   *   [ "\n" ] = "n",
-   *   [ "\r" ] = "r",
-   *   [ "\t" ] = "t",
-   * } */
-  lc_newclosuretable(L,(lc1 + lc_nextra));
-  enum { lc2 = 3 };
-  lua_createtable(L,0,7);
-  lua_pushliteral(L,"\\");
-  lua_pushliteral(L,"\\");
-  lua_rawset(L,-3);
-  lua_pushliteral(L,"\"");
-  lua_pushliteral(L,"\"");
-  lua_rawset(L,-3);
-  lua_pushliteral(L,"");
-  lua_pushliteral(L,"b");
-  lua_rawset(L,-3);
-  lua_pushliteral(L,"");
-  lua_pushliteral(L,"f");
-  lua_rawset(L,-3);
-  lua_pushliteral(L,"\n");
-  lua_pushliteral(L,"n");
-  lua_rawset(L,-3);
-  lua_pushliteral(L,"\r");
-  lua_pushliteral(L,"r");
-  lua_rawset(L,-3);
-  lua_pushliteral(L,"	");
-  lua_pushliteral(L,"t");
-  lua_rawset(L,-3);
-  lua_rawseti(L,(lc2 + lc_nextra),2);
-  
-  /* local escape_char_map_inv = { [ "/" ] = "/" } */
-  lc_newclosuretable(L,(lc2 + lc_nextra));
-  enum { lc3 = 4 };
-  lua_createtable(L,0,1);
-  lua_pushliteral(L,"/");
-  lua_pushliteral(L,"/");
-  lua_rawset(L,-3);
-  lua_rawseti(L,(lc3 + lc_nextra),3);
-  
-  /* for k, v in pairs(escape_char_map) do
-   * internal: local f, s, var = explist */
-  enum { lc4 = 4 };
-  lua_getfield(L,LUA_ENVIRONINDEX,"pairs");
-  lc_getupvalue(L,(lc3 + lc_nextra),1,2);
-  lua_call(L,1,3);
-  while (1) {
-    
-    /* internal: local var_1, ..., var_n = f(s, var)
-     *           if var_1 == nil then break end
-     *           var = var_1 */
-    lua_pushvalue(L,-3);
-    lua_pushvalue(L,-3);
-    lua_pushvalue(L,-3);
-    lua_call(L,2,2);
-    if (lua_isnil(L,-2)) {
-      break;
+}
+
+static int json_decode(lua_State* L)
+{
+    lua_settop(L, 1);
+
+    if (lua_type(L, 1) != LUA_TSTRING)
+        luaL_error(L, "expected argument of type string, got %s", lua_typename(L, lua_type(L, 1)));
+
+    size_t len = 0;
+    const char* str = lua_tolstring(L, 1, &len);
+
+    // slot 2 holds the scratch buffer for unescaping strings
+    lua_pushnil(L);
+
+    JsonReader R = {L, str, str + len, 0, NULL, 0, 1, 1, 2};
+
+    const char* p = json_skipspace(str, R.end);
+    p = json_parsevalue(&R, p);
+    p = json_skipspace(p, R.end);
+
+    if (p < R.end)
+        json_decodeerror(&R, p - str, "trailing garbage");
+
+    return 1;
+}
+
+/* }====================================================== */
+
+/*
+** {======================================================
+** Incremental decoding
+** =======================================================
+*/
+
+// A decoder receives the document in chunks. Arrays and objects that are less than `depth` levels deep are reported with start/end events as
+// soon as their brackets are seen; all other values are decoded with the regular decoder once their text is complete and reported to the
+// `value` callback. Only unconsumed input is buffered, so memory use is bounded by nesting depth and the size of the largest such value.
+
+enum JsonDecoderState
+{
+    JSON_DECODER_VALUE,       // expecting the top level value
+    JSON_DECODER_DONE,        // after the top level value
+    JSON_DECODER_ARRAYVALUE,  // after '[' or ','
+    JSON_DECODER_ARRAYNEXT,   // after an array element
+    JSON_DECODER_OBJECTKEY,   // after '{' or ','
+    JSON_DECODER_OBJECTCOLON, // after a key
+    JSON_DECODER_OBJECTVALUE, // after ':'
+    JSON_DECODER_OBJECTNEXT,  // after a field value
+};
+
+struct JsonDecoder
+{
+    // unconsumed input; line and col are the position of its first byte in the document
+    std::string buffer;
+    int line;
+    int col;
+
+    // values nested at least this deep are decoded as a whole
+    int depth;
+
+    // states[0] is the top level state, states[i] is the state of the i-th open array or object
+    int top;
+    unsigned char states[JSON_MAXDEPTH + 1];
+
+    // progress of the search for the end of the value at the current position, so that it isn't rescanned for every chunk
+    size_t scanned;
+    int scannest;
+    bool scanstring;
+    bool scanescape;
+
+    // values returned from update/finish when there is no value callback
+    int collected;
+
+    bool busy;
+    bool finished;
+};
+
+// stack slots used by update/finish; slot 1 is the decoder table (or nil when called as a plain function) and slot 2 is the input
+#define JSON_DECODER_SCRATCH 3
+#define JSON_DECODER_RESULTS 4
+
+static void json_decoderdtor(void* ud)
+{
+    static_cast<JsonDecoder*>(ud)->~JsonDecoder();
+}
+
+static void json_decoderemit(lua_State* L, const char* event, int nargs)
+{
+    lua_getfield(L, lua_upvalueindex(2), event);
+
+    if (lua_isnil(L, -1))
+    {
+        lua_pop(L, 1 + nargs);
+        return;
     }
-    lua_pushvalue(L,-2);
-    lua_replace(L,-4);
-    
-    /* internal: local k with idx 8
-     * internal: local v with idx 9 */
-    
-    
-    /* escape_char_map_inv[v] = k */
-    lua_pushvalue(L,(8 + lc_nextra));
-    lc_getupvalue(L,(lc3 + lc_nextra),0,3);
-    lua_insert(L,-2);
-    lua_pushvalue(L,(9 + lc_nextra));
-    lua_insert(L,-2);
-    lua_settable(L,-3);
-    lua_pop(L,1);
-    
-    /* internal: stack cleanup on scope exit */
-    lua_pop(L,2);
-  }
-  lua_settop(L,(lc4 + lc_nextra));
-  
-  /* local function escape_char(c)
-   *   return "\\" .. (escape_char_map[c] or string.format("u%04x", c:byte()))
-   * end */
-  lc_newclosuretable(L,(lc3 + lc_nextra));
-  enum { lc5 = 5 };
-  lua_pushvalue(L,(lc5 + lc_nextra));
-  lua_pushcclosure(L,lcf1_escape_char, "escape_char", 1);
-  lua_rawseti(L,(lc5 + lc_nextra),4);
-  
-  /* local function encode_nil(val)
-   *   return "null"
-   * end */
-  lua_pushcfunction(L, lcf1_encode_nil, "encode_nil");
-  
-  /* local function encode_table(val, stack)
-   *   local res = {}
-   *   stack = stack or {}
-   * 
-   *   -- Circular reference?
-   *   if stack[val] then error("circular reference") end
-   * 
-   *   stack[val] = true
-   * 
-   *   if rawget(val, 1) ~= nil or next(val) == nil then
-   *     -- Treat as array -- check keys are valid and it is not sparse
-   *     local n = 0
-   *     for k in pairs(val) do
-   *       if type(k) ~= "number" then
-   *         error("invalid table: mixed or invalid key types")
-   *       end
-   *       n = n + 1
-   *     end
-   *     if n ~= #val then
-   *       error("invalid table: sparse array")
-   *     end
-   *     -- Encode
-   *     for i, v in ipairs(val) do
-   *       table.insert(res, encode(v, stack))
-   *     end
-   *     stack[val] = nil
-   *     return "[" .. table.concat(res, ",") .. "]"
-   * 
-   *   else
-   *     -- Treat as an object
-   *     for k, v in pairs(val) do
-   *       if type(k) ~= "string" then
-   *         error("invalid table: mixed or invalid key types")
-   *       end
-   *       table.insert(res, encode(k, stack) .. ":" .. encode(v, stack))
-   *     end
-   *     stack[val] = nil
-   *     return "{" .. table.concat(res, ",") .. "}"
-   *   end
-   * end */
-  lua_pushvalue(L,(lc5 + lc_nextra));
-  lua_pushcclosure(L, lcf1_encode_table, "encode_table", 1);
-  
-  /* local function encode_string(val)
-   *   return '"' .. val:gsub('[%z\1-\31\\"]', escape_char) .. '"'
-   * end */
-  lua_pushvalue(L,(lc5 + lc_nextra));
-  lua_pushcclosure(L, lcf1_encode_string, "encode_string", 1);
-  
-  /* local function encode_number(val)
-   *   -- Check for NaN, -inf and inf
-   *   if val ~= val or val <= -math.huge or val >= math.huge then
-   *     error("unexpected number value '" .. tostring(val) .. "'")
-   *   end
-   *   return string.format("%.14g", val)
-   * end */
-  lua_pushcfunction(L, lcf1_encode_number, "encode_number");
-  
-  /* local type_func_map = {
-   *   [ "nil"     ] = encode_nil,
-   *   [ "table"   ] = encode_table,
-   *   [ "string"  ] = encode_string,
-   *   [ "number"  ] = encode_number,
-   *   [ "boolean" ] = tostring,
-   * } */
-  lc_newclosuretable(L,(lc5 + lc_nextra));
-  enum { lc33 = 10 };
-  lua_createtable(L,0,5);
-  lua_pushliteral(L,"nil");
-  lua_pushvalue(L,(6 + lc_nextra));
-  lua_rawset(L,-3);
-  lua_pushliteral(L,"table");
-  lua_pushvalue(L,(7 + lc_nextra));
-  lua_rawset(L,-3);
-  lua_pushliteral(L,"string");
-  lua_pushvalue(L,(8 + lc_nextra));
-  lua_rawset(L,-3);
-  lua_pushliteral(L,"number");
-  lua_pushvalue(L,(9 + lc_nextra));
-  lua_rawset(L,-3);
-  lua_pushliteral(L,"boolean");
-  lua_getfield(L,LUA_ENVIRONINDEX,"tostring");
-  lua_rawset(L,-3);
-  lua_rawseti(L,(lc33 + lc_nextra),5);
-  
-  /* encode = function(val, stack)
-   *   local t = type(val)
-   *   local f = type_func_map[t]
-   *   if f then
-   *     return f(val, stack)
-   *   end
-   *   error("unexpected type '" .. t .. "'")
-   * end */
-  lua_pushvalue(L,(lc33 + lc_nextra));
-  lua_pushcclosure(L, lcf1_encode, "encode", 1);
-  lc_setupvalue(L,(lc33 + lc_nextra),4,1);
-  
-  /* function json.encode(val)
-   *   return ( encode(val) )
-   * end */
-  lua_pushvalue(L,(lc33 + lc_nextra));
-  lua_pushcclosure(L, lcf1_json_encode, "encode", 1);
-  lua_pushliteral(L,"encode");
-  lua_insert(L,-2);
-  lua_settable(L,(1 + lc_nextra));
-  
-  /* -------------------------------------------------------------------------------
-   * -- Decode
-   * -------------------------------------------------------------------------------
-   * local parse */
-  lc_newclosuretable(L,(lc33 + lc_nextra));
-  enum { lc36 = 11 };
-  lua_settop(L,(lua_gettop(L) + 1));
-  lua_rawseti(L,(lc36 + lc_nextra),6);
-  
-  /* local function create_set(...)
-   *   local res = {}
-   *   for i = 1, select("#", ...) do
-   *     res[ select(i, ...) ] = true
-   *   end
-   *   return res
-   * end */
-  lua_pushcfunction(L, lcf1_create_set, "create_set");
-  
-  /* local space_chars   = create_set(" ", "\t", "\r", "\n") */
-  lc_newclosuretable(L,(lc36 + lc_nextra));
-  enum { lc43 = 13 };
-  lua_pushvalue(L,(12 + lc_nextra));
-  lua_pushliteral(L," ");
-  lua_pushliteral(L,"	");
-  lua_pushliteral(L,"\r");
-  lua_pushliteral(L,"\n");
-  lua_call(L,4,1);
-  lua_rawseti(L,(lc43 + lc_nextra),7);
-  
-  /* local delim_chars   = create_set(" ", "\t", "\r", "\n", "]", "}", ",") */
-  lc_newclosuretable(L,(lc43 + lc_nextra));
-  enum { lc44 = 14 };
-  lua_pushvalue(L,(12 + lc_nextra));
-  lua_pushliteral(L," ");
-  lua_pushliteral(L,"	");
-  lua_pushliteral(L,"\r");
-  lua_pushliteral(L,"\n");
-  lua_pushliteral(L,"]");
-  lua_pushliteral(L,"}");
-  lua_pushliteral(L,",");
-  lua_call(L,7,1);
-  lua_rawseti(L,(lc44 + lc_nextra),8);
-  
-  /* local escape_chars  = create_set("\\", "/", '"', "b", "f", "n", "r", "t", "u") */
-  lc_newclosuretable(L,(lc44 + lc_nextra));
-  enum { lc45 = 15 };
-  lua_pushvalue(L,(12 + lc_nextra));
-  lua_pushliteral(L,"\\");
-  lua_pushliteral(L,"/");
-  lua_pushliteral(L,"\"");
-  lua_pushliteral(L,"b");
-  lua_pushliteral(L,"f");
-  lua_pushliteral(L,"n");
-  lua_pushliteral(L,"r");
-  lua_pushliteral(L,"t");
-  lua_pushliteral(L,"u");
-  lua_call(L,9,1);
-  lua_rawseti(L,(lc45 + lc_nextra),9);
-  
-  /* local literals      = create_set("true", "false", "null") */
-  lc_newclosuretable(L,(lc45 + lc_nextra));
-  enum { lc46 = 16 };
-  lua_pushvalue(L,(12 + lc_nextra));
-  lua_pushliteral(L,"true");
-  lua_pushliteral(L,"false");
-  lua_pushliteral(L,"null");
-  lua_call(L,3,1);
-  lua_rawseti(L,(lc46 + lc_nextra),10);
-  
-  /* local literal_map = {
-   *   [ "true"  ] = true,
-   *   [ "false" ] = false,
-   *   [ "null"  ] = nil,
-   * } */
-  lc_newclosuretable(L,(lc46 + lc_nextra));
-  enum { lc47 = 17 };
-  lua_createtable(L,0,3);
-  lua_pushliteral(L,"true");
-  lua_pushboolean(L,1);
-  lua_rawset(L,-3);
-  lua_pushliteral(L,"false");
-  lua_pushboolean(L,0);
-  lua_rawset(L,-3);
-  lua_pushliteral(L,"null");
-  lua_pushnil(L);
-  lua_rawset(L,-3);
-  lua_rawseti(L,(lc47 + lc_nextra),11);
-  
-  /* local function next_char(str, idx, set, negate)
-   *   for i = idx, #str do
-   *     if set[str:sub(i, i)] ~= negate then
-   *       return i
-   *     end
-   *   end
-   *   return #str + 1
-   * end */
-  lc_newclosuretable(L,(lc47 + lc_nextra));
-  enum { lc48 = 18 };
-  lua_pushcfunction(L, lcf1_next_char, "next_char");
-  lua_rawseti(L,(lc48 + lc_nextra),12);
-  
-  /* local function decode_error(str, idx, msg)
-   *   local line_count = 1
-   *   local col_count = 1
-   *   for i = 1, idx - 1 do
-   *     col_count = col_count + 1
-   *     if str:sub(i, i) == "\n" then
-   *       line_count = line_count + 1
-   *       col_count = 1
-   *     end
-   *   end
-   *   error( string.format("%s at line %d col %d", msg, line_count, col_count) )
-   * end */
-  lc_newclosuretable(L,(lc48 + lc_nextra));
-  enum { lc58 = 19 };
-  lua_pushcfunction(L, lcf1_decode_error, "decode_error");
-  lua_rawseti(L,(lc58 + lc_nextra),13);
-  
-  /* local function codepoint_to_utf8(n)
-   *   -- http://scripts.sil.org/cms/scripts/page.php?site_id=nrsi&id=iws-appendixa
-   *   local f = math.floor
-   *   if n <= 0x7f then
-   *     return string.char(n)
-   *   elseif n <= 0x7ff then
-   *     return string.char(f(n / 64) + 192, n % 64 + 128)
-   *   elseif n <= 0xffff then
-   *     return string.char(f(n / 4096) + 224, f(n % 4096 / 64) + 128, n % 64 + 128)
-   *   elseif n <= 0x10ffff then
-   *     return string.char(f(n / 262144) + 240, f(n % 262144 / 4096) + 128,
-   *                        f(n % 4096 / 64) + 128, n % 64 + 128)
-   *   end
-   *   error( string.format("invalid unicode codepoint '%x'", n) )
-   * end */
-  lc_newclosuretable(L,(lc58 + lc_nextra));
-  enum { lc67 = 20 };
-  lua_pushcfunction(L,lcf1_codepoint_to_utf8, "codepoint_to_utf8");
-  lua_rawseti(L,(lc67 + lc_nextra),14);
-  
-  /* local function parse_unicode_escape(s)
-   *   local n1 = tonumber( s:sub(1, 4),  16 )
-   *   local n2 = tonumber( s:sub(7, 10), 16 )
-   *    -- Surrogate pair?
-   *   if n2 then
-   *     return codepoint_to_utf8((n1 - 0xd800) * 0x400 + (n2 - 0xdc00) + 0x10000)
-   *   else
-   *     return codepoint_to_utf8(n1)
-   *   end
-   * end */
-  lc_newclosuretable(L,(lc67 + lc_nextra));
-  enum { lc85 = 21 };
-  lua_pushvalue(L,(lc85 + lc_nextra));
-  lua_pushcclosure(L,lcf1_parse_unicode_escape,"parse_unicode_escape",1);
-  lua_rawseti(L,(lc85 + lc_nextra),15);
-  
-  /* local function parse_string(str, i)
-   *   local res = ""
-   *   local j = i + 1
-   *   local k = j
-   * 
-   *   while j <= #str do
-   *     local x = str:byte(j)
-   * 
-   *     if x < 32 then
-   *       decode_error(str, j, "control character in string")
-   * 
-   *     elseif x == 92 then -- `\`: Escape
-   *       res = res .. str:sub(k, j - 1)
-   *       j = j + 1
-   *       local c = str:sub(j, j)
-   *       if c == "u" then
-   *         local hex = str:match("^[dD][89aAbB]%x%x\\u%x%x%x%x", j + 1)
-   *                  or str:match("^%x%x%x%x", j + 1)
-   *                  or decode_error(str, j - 1, "invalid unicode escape in string")
-   *         res = res .. parse_unicode_escape(hex)
-   *         j = j + #hex
-   *       else
-   *         if not escape_chars[c] then
-   *           decode_error(str, j - 1, "invalid escape char '" .. c .. "' in string")
-   *         end
-   *         res = res .. escape_char_map_inv[c]
-   *       end
-   *       k = j + 1
-   * 
-   *     elseif x == 34 then -- `"`: End of string
-   *       res = res .. str:sub(k, j - 1)
-   *       return res, j + 1
-   *     end
-   * 
-   *     j = j + 1
-   *   end
-   * 
-   *   decode_error(str, i, "expected closing quote for string")
-   * end */
-  lua_pushvalue(L,(lc85 + lc_nextra));
-  lua_pushcclosure(L,lcf1_parse_string, "parse_string",1);
-  
-  /* local function parse_number(str, i)
-   *   local x = next_char(str, i, delim_chars)
-   *   local s = str:sub(i, x - 1)
-   *   local n = tonumber(s)
-   *   if not n then
-   *     decode_error(str, i, "invalid number '" .. s .. "'")
-   *   end
-   *   return n, x
-   * end */
-  lua_pushvalue(L,(lc85 + lc_nextra));
-  lua_pushcclosure(L,lcf1_parse_number,"parse_number",1);
-  
-  /* local function parse_literal(str, i)
-   *   local x = next_char(str, i, delim_chars)
-   *   local word = str:sub(i, x - 1)
-   *   if not literals[word] then
-   *     decode_error(str, i, "invalid literal '" .. word .. "'")
-   *   end
-   *   return literal_map[word], x
-   * end */
-  lua_pushvalue(L,(lc85 + lc_nextra));
-  lua_pushcclosure(L,lcf1_parse_literal,"parse_literal",1);
-  
-  /* local function parse_array(str, i)
-   *   local res = {}
-   *   local n = 1
-   *   i = i + 1
-   *   while 1 do
-   *     local x
-   *     i = next_char(str, i, space_chars, true)
-   *     -- Empty / end of array?
-   *     if str:sub(i, i) == "]" then
-   *       i = i + 1
-   *       break
-   *     end
-   *     -- Read token
-   *     x, i = parse(str, i)
-   *     res[n] = x
-   *     n = n + 1
-   *     -- Next token
-   *     i = next_char(str, i, space_chars, true)
-   *     local chr = str:sub(i, i)
-   *     i = i + 1
-   *     if chr == "]" then break end
-   *     if chr ~= "," then decode_error(str, i, "expected ']' or ','") end
-   *   end
-   *   return res, i
-   * end */
-  lua_pushvalue(L,(lc85 + lc_nextra));
-  lua_pushcclosure(L,lcf1_parse_array,"parse_array",1);
-  
-  /* local function parse_object(str, i)
-   *   local res = {}
-   *   i = i + 1
-   *   while 1 do
-   *     local key, val
-   *     i = next_char(str, i, space_chars, true)
-   *     -- Empty / end of object?
-   *     if str:sub(i, i) == "}" then
-   *       i = i + 1
-   *       break
-   *     end
-   *     -- Read key
-   *     if str:sub(i, i) ~= '"' then
-   *       decode_error(str, i, "expected string for key")
-   *     end
-   *     key, i = parse(str, i)
-   *     -- Read ':' delimiter
-   *     i = next_char(str, i, space_chars, true)
-   *     if str:sub(i, i) ~= ":" then
-   *       decode_error(str, i, "expected ':' after key")
-   *     end
-   *     i = next_char(str, i + 1, space_chars, true)
-   *     -- Read value
-   *     val, i = parse(str, i)
-   *     -- Set
-   *     res[key] = val
-   *     -- Next token
-   *     i = next_char(str, i, space_chars, true)
-   *     local chr = str:sub(i, i)
-   *     i = i + 1
-   *     if chr == "}" then break end
-   *     if chr ~= "," then decode_error(str, i, "expected '}' or ','") end
-   *   end
-   *   return res, i
-   * end */
-  lua_pushvalue(L,(lc85 + lc_nextra));
-  lua_pushcclosure(L,lcf1_parse_object,"parse_object",1);
-  
-  /* local char_func_map = {
-   *   [ '"' ] = parse_string,
-   *   [ "0" ] = parse_number,
-   *   [ "1" ] = parse_number,
-   *   [ "2" ] = parse_number,
-   *   [ "3" ] = parse_number,
-   *   [ "4" ] = parse_number,
-   *   [ "5" ] = parse_number,
-   *   [ "6" ] = parse_number,
-   *   [ "7" ] = parse_number,
-   *   [ "8" ] = parse_number,
-   *   [ "9" ] = parse_number,
-   *   [ "-" ] = parse_number,
-   *   [ "t" ] = parse_literal,
-   *   [ "f" ] = parse_literal,
-   *   [ "n" ] = parse_literal,
-   *   [ "[" ] = parse_array,
-   *   [ "{" ] = parse_object,
-   * } */
-  lc_newclosuretable(L,(lc85 + lc_nextra));
-  enum { lc137 = 27 };
-  lua_createtable(L,0,17);
-  lua_pushliteral(L,"\"");
-  lua_pushvalue(L,(22 + lc_nextra));
-  lua_rawset(L,-3);
-  lua_pushliteral(L,"0");
-  lua_pushvalue(L,(23 + lc_nextra));
-  lua_rawset(L,-3);
-  lua_pushliteral(L,"1");
-  lua_pushvalue(L,(23 + lc_nextra));
-  lua_rawset(L,-3);
-  lua_pushliteral(L,"2");
-  lua_pushvalue(L,(23 + lc_nextra));
-  lua_rawset(L,-3);
-  lua_pushliteral(L,"3");
-  lua_pushvalue(L,(23 + lc_nextra));
-  lua_rawset(L,-3);
-  lua_pushliteral(L,"4");
-  lua_pushvalue(L,(23 + lc_nextra));
-  lua_rawset(L,-3);
-  lua_pushliteral(L,"5");
-  lua_pushvalue(L,(23 + lc_nextra));
-  lua_rawset(L,-3);
-  lua_pushliteral(L,"6");
-  lua_pushvalue(L,(23 + lc_nextra));
-  lua_rawset(L,-3);
-  lua_pushliteral(L,"7");
-  lua_pushvalue(L,(23 + lc_nextra));
-  lua_rawset(L,-3);
-  lua_pushliteral(L,"8");
-  lua_pushvalue(L,(23 + lc_nextra));
-  lua_rawset(L,-3);
-  lua_pushliteral(L,"9");
-  lua_pushvalue(L,(23 + lc_nextra));
-  lua_rawset(L,-3);
-  lua_pushliteral(L,"-");
-  lua_pushvalue(L,(23 + lc_nextra));
-  lua_rawset(L,-3);
-  lua_pushliteral(L,"t");
-  lua_pushvalue(L,(24 + lc_nextra));
-  lua_rawset(L,-3);
-  lua_pushliteral(L,"f");
-  lua_pushvalue(L,(24 + lc_nextra));
-  lua_rawset(L,-3);
-  lua_pushliteral(L,"n");
-  lua_pushvalue(L,(24 + lc_nextra));
-  lua_rawset(L,-3);
-  lua_pushliteral(L,"[");
-  lua_pushvalue(L,(25 + lc_nextra));
-  lua_rawset(L,-3);
-  lua_pushliteral(L,"{");
-  lua_pushvalue(L,(26 + lc_nextra));
-  lua_rawset(L,-3);
-  lua_rawseti(L,(lc137 + lc_nextra),16);
-  
-  /* parse = function(str, idx)
-   *   local chr = str:sub(idx, idx)
-   *   local f = char_func_map[chr]
-   *   if f then
-   *     return f(str, idx)
-   *   end
-   *   decode_error(str, idx, "unexpected character '" .. chr .. "'")
-   * end */
-  lua_pushvalue(L,(lc137 + lc_nextra));
-  lua_pushcclosure(L,lcf1_parse,"parse",1);
-  lc_setupvalue(L,(lc137 + lc_nextra),10,6);
-  
-  /* function json.decode(str)
-   *   if type(str) ~= "string" then
-   *     error("expected argument of type string, got " .. type(str))
-   *   end
-   *   local res, idx = parse(str, next_char(str, 1, space_chars, true))
-   *   idx = next_char(str, idx, space_chars, true)
-   *   if idx <= #str then
-   *     decode_error(str, idx, "trailing garbage")
-   *   end
-   *   return res
-   * end */
-  lua_pushvalue(L,(lc137 + lc_nextra));
-  lua_pushcclosure(L,lcf1_json_decode,"decode",1);
-  lua_pushliteral(L,"decode");
-  lua_insert(L,-2);
-  lua_settable(L,(1 + lc_nextra));
-  
-  /* return json */
-  lua_pushvalue(L,(1 + lc_nextra));
-  return 1;
+
+    lua_insert(L, -1 - nargs);
+    lua_call(L, nargs, 0);
 }
 
-LUALIB_API int luaopen_json(lua_State* L)
+static void json_decoderdeliver(lua_State* L, JsonDecoder* D)
 {
-  lcf_main(L);
+    if (lua_istable(L, JSON_DECODER_RESULTS))
+        lua_rawseti(L, JSON_DECODER_RESULTS, ++D->collected);
+    else
+        json_decoderemit(L, "value", 1);
+}
 
-  return 1;
-}
\ No newline at end of file
+// returns the end of the value that starts at p, or NULL if more input is needed to find it
+static const char* json_decoderspan(JsonDecoder* D, const char* p, const char* end, bool finish)
+{
+    const char* q = p + D->scanned;
+
+    if (*p == '"' || *p == '[' || *p == '{')
+    {
+        while (q < end)
+        {
+            if (D->scanescape)
+            {
+                D->scanescape = false;
+                q++;
+            }
+            else if (D->scanstring)
+            {
+                q = json_scanspecial(q, end);
+
+                if (q == end)
+                    break;
+
+                // control characters are skipped here and reported by the parser
+                if (*q == '"')
+                    D->scanstring = false;
+                else if (*q == '\\')
+                    D->scanescape = true;
+
+                q++;
+
+                if (!D->scanstring && D->scannest == 0)
+                    return q;
+            }
+            else
+            {
+                char ch = *q++;
+
+                if (ch == '"')
+                    D->scanstring = true;
+                else if (ch == '[' || ch == '{')
+                    D->scannest++;
+                else if ((ch == ']' || ch == '}') && --D->scannest == 0)
+                    return q;
+            }
+        }
+    }
+    else
+    {
+        // numbers, literals and invalid tokens all end at the next delimiter
+        q = json_skiptoken(q, end);
+
+        if (q < end)
+            return q;
+    }
+
+    D->scanned = q - p;
+
+    // at the end of input the parser reports what's wrong with the incomplete value
+    return finish ? end : NULL;
+}
+
+static void json_decoderresetspan(JsonDecoder* D)
+{
+    D->scanned = 0;
+    D->scannest = 0;
+    D->scanstring = false;
+    D->scanescape = false;
+}
+
+static const char* json_decodervalue(JsonDecoder* D, JsonReader* R, const char* p, bool finish)
+{
+    lua_State* L = R->L;
+    int state = D->states[D->top];
+    int after = D->top == 0 ? JSON_DECODER_DONE : state == JSON_DECODER_ARRAYVALUE ? JSON_DECODER_ARRAYNEXT : JSON_DECODER_OBJECTNEXT;
+
+    char ch = p < R->end ? *p : 0;
+
+    if ((ch == '[' || ch == '{') && D->top < D->depth)
+    {
+        if (D->top >= JSON_MAXDEPTH)
+            json_decodeerror(R, p - R->begin, "maximum nesting depth exceeded");
+
+        D->states[D->top] = (unsigned char)after;
+        D->states[++D->top] = ch == '[' ? JSON_DECODER_ARRAYVALUE : JSON_DECODER_OBJECTKEY;
+
+        json_decoderemit(L, ch == '[' ? "start_array" : "start_object", 0);
+        return p + 1;
+    }
+
+    if (p < R->end && !json_decoderspan(D, p, R->end, finish))
+        return NULL;
+
+    json_decoderresetspan(D);
+
+    R->depth = D->top;
+    p = json_parsevalue(R, p);
+
+    D->states[D->top] = (unsigned char)after;
+
+    json_decoderdeliver(L, D);
+    return p;
+}
+
+static void json_decoderclose(lua_State* L, JsonDecoder* D, const char* event)
+{
+    D->top--;
+
+    json_decoderemit(L, event, 0);
+}
+
+// consumes as much of the input as possible and returns the number of bytes consumed
+static size_t json_decoderparse(lua_State* L, JsonDecoder* D, const char* data, size_t size, bool finish)
+{
+    JsonReader R = {L, data, data + size, 0, NULL, 0, D->line, D->col, JSON_DECODER_SCRATCH};
+
+    const char* end = R.end;
+    const char* p = data;
+
+    for (;;)
+    {
+        p = json_skipspace(p, end);
+
+        if (p == end && (!finish || D->states[D->top] == JSON_DECODER_DONE))
+            break;
+
+        int state = D->states[D->top];
+        char ch = p < end ? *p : 0;
+
+        switch (state)
+        {
+        case JSON_DECODER_DONE:
+            json_decodeerror(&R, p - data, "trailing garbage");
+
+        case JSON_DECODER_VALUE:
+        case JSON_DECODER_ARRAYVALUE:
+        case JSON_DECODER_OBJECTVALUE:
+            if (state == JSON_DECODER_ARRAYVALUE && ch == ']')
+            {
+                p++;
+                json_decoderclose(L, D, "end_array");
+            }
+            else
+            {
+                const char* e = json_decodervalue(D, &R, p, finish);
+
+                if (!e)
+                    return p - data;
+
+                p = e;
+            }
+            break;
+
+        case JSON_DECODER_ARRAYNEXT:
+            if (ch == ']')
+            {
+                p++;
+                json_decoderclose(L, D, "end_array");
+            }
+            else if (ch == ',')
+            {
+                p++;
+                D->states[D->top] = JSON_DECODER_ARRAYVALUE;
+            }
+            else
+            {
+                json_decodeerror(&R, p + 1 - data, "expected ']' or ','");
+            }
+            break;
+
+        case JSON_DECODER_OBJECTKEY:
+            if (ch == '}')
+            {
+                p++;
+                json_decoderclose(L, D, "end_object");
+            }
+            else if (ch == '"')
+            {
+                if (!json_decoderspan(D, p, end, finish))
+                    return p - data;
+
+                json_decoderresetspan(D);
+
+                p = json_parsestring(&R, p);
+                D->states[D->top] = JSON_DECODER_OBJECTCOLON;
+
+                json_decoderemit(L, "key", 1);
+            }
+            else
+            {
+                json_decodeerror(&R, p - data, "expected string for key");
+            }
+            break;
+
+        case JSON_DECODER_OBJECTCOLON:
+            if (ch != ':')
+                json_decodeerror(&R, p - data, "expected ':' after key");
+
+            p++;
+            D->states[D->top] = JSON_DECODER_OBJECTVALUE;
+            break;
+
+        case JSON_DECODER_OBJECTNEXT:
+            if (ch == '}')
+            {
+                p++;
+                json_decoderclose(L, D, "end_object");
+            }
+            else if (ch == ',')
+            {
+                p++;
+                D->states[D->top] = JSON_DECODER_OBJECTKEY;
+            }
+            else
+            {
+                json_decodeerror(&R, p + 1 - data, "expected '}' or ','");
+            }
+            break;
+        }
+    }
+
+    return p - data;
+}
+
+static int json_decoderrun(lua_State* L, bool finish)
+{
+    JsonDecoder* D = (JsonDecoder*)lua_touserdata(L, lua_upvalueindex(1));
+
+    if (D->busy)
+        luaL_error(L, "decoder can't be used after an error or from its own callbacks");
+    if (D->finished)
+        luaL_error(L, "decoder has already finished");
+
+    // update and finish also work as plain functions of the chunk, so that decoder.update can be passed as a cpr stream sink
+    if (!lua_istable(L, 1))
+    {
+        lua_pushnil(L);
+        lua_insert(L, 1);
+    }
+
+    size_t len = 0;
+    const char* chunk = finish ? luaL_optlstring(L, 2, "", &len) : luaL_checklstring(L, 2, &len);
+
+    lua_settop(L, 2);
+    lua_pushnil(L);
+
+    // decoded values are returned instead of being passed to a callback
+    lua_getfield(L, lua_upvalueindex(2), "value");
+
+    if (lua_isnil(L, JSON_DECODER_RESULTS))
+    {
+        lua_pop(L, 1);
+        lua_newtable(L);
+    }
+    else
+    {
+        lua_pop(L, 1);
+        lua_pushnil(L);
+    }
+
+    D->collected = 0;
+    D->busy = true;
+
+    // input is parsed in place from the chunk when there is nothing buffered from the previous one
+    bool buffered = !D->buffer.empty();
+
+    if (buffered)
+        D->buffer.append(chunk, len);
+
+    const char* data = buffered ? D->buffer.data() : chunk;
+    size_t size = buffered ? D->buffer.size() : len;
+
+    size_t consumed = json_decoderparse(L, D, data, size, finish);
+
+    json_advanceposition(data, data + size, consumed, &D->line, &D->col);
+
+    if (buffered)
+        D->buffer.erase(0, consumed);
+    else
+        D->buffer.assign(data + consumed, size - consumed);
+
+    D->busy = false;
+
+    if (finish)
+    {
+        D->finished = true;
+        std::string().swap(D->buffer);
+    }
+
+    return lua_istable(L, JSON_DECODER_RESULTS) ? 1 : 0;
+}
+
+static int json_decoderupdate(lua_State* L)
+{
+    return json_decoderrun(L, false);
+}
+
+static int json_decoderfinish(lua_State* L)
+{
+    return json_decoderrun(L, true);
+}
+
+static int json_decoder(lua_State* L)
+{
+    if (lua_isnoneornil(L, 1))
+    {
+        lua_settop(L, 0);
+        lua_newtable(L);
+    }
+
+    luaL_checktype(L, 1, LUA_TTABLE);
+    lua_settop(L, 1);
+
+    // by default only scalar values are decoded as a whole
+    int depth = JSON_MAXDEPTH + 1;
+
+    lua_getfield(L, 1, "depth");
+
+    if (!lua_isnil(L, 2))
+    {
+        if (!lua_isnumber(L, 2))
+            luaL_error(L, "invalid option 'depth' (number expected, got %s)", luaL_typename(L, 2));
+
+        depth = lua_tointeger(L, 2);
+        luaL_argcheck(L, depth >= 0, 1, "depth must be non-negative");
+    }
+
+    lua_pop(L, 1);
+
+    JsonDecoder* D = new (lua_newuserdatadtor(L, sizeof(JsonDecoder), json_decoderdtor)) JsonDecoder();
+    D->line = 1;
+    D->col = 1;
+    D->depth = depth;
+    D->top = 0;
+    D->states[0] = JSON_DECODER_VALUE;
+    json_decoderresetspan(D);
+    D->collected = 0;
+    D->busy = false;
+    D->finished = false;
+
+    lua_createtable(L, 0, 2);
+
+    lua_pushvalue(L, 2);
+    lua_pushvalue(L, 1);
+    lua_pushcclosure(L, json_decoderupdate, "update", 2);
+    lua_setfield(L, -2, "update");
+
+    lua_pushvalue(L, 2);
+    lua_pushvalue(L, 1);
+    lua_pushcclosure(L, json_decoderfinish, "finish", 2);
+    lua_setfield(L, -2, "finish");
+
+    return 1;
+}
+
+/* }====================================================== */
+
+/*
+** {======================================================
+** Lazy documents
+** =======================================================
+*/
+
+// json.parse_lazy validates the document in a single pass that records where each value starts, without creating any Lua values.
+// Arrays and objects are returned as views: userdata tagged with LUA_JSONVIEWTAG that share a copy of the text and the index. Indexing a
+// view decodes scalar values on demand and returns nested arrays and objects as new views, so untouched parts of the document are never
+// turned into tables and strings.
+
+struct JsonIndexEntry
+{
+    uint32_t offset; // position of the value in the text
+    uint32_t next;   // index of the entry that follows the value and all of its children
+};
+
+// object fields are stored as a key entry followed by the value entries
+struct JsonDocument
+{
+    int refs;
+    uint8_t memcat;
+
+    size_t size;
+    size_t count;
+
+    // followed by JsonIndexEntry[count] and char[size]
+};
+
+struct JsonView
+{
+    JsonDocument* doc;
+    uint32_t index;
+
+    // position of the last accessed array element, so that sequential traversal doesn't rescan the array
+    uint32_t lastkey;
+    uint32_t lastentry;
+};
+
+#define JSON_VIEWMETATABLE "json.view"
+
+#define json_docindex(doc) ((JsonIndexEntry*)((doc) + 1))
+#define json_doctext(doc) ((char*)(json_docindex(doc) + (doc)->count))
+#define json_docsize(doc) (sizeof(JsonDocument) + (doc)->count * sizeof(JsonIndexEntry) + (doc)->size)
+
+struct JsonIndex
+{
+    JsonIndexEntry* entries;
+    size_t count;
+    size_t capacity;
+};
+
+// stack slots used by parse_lazy; slot 1 is the input and slot 2 is the scratch buffer
+#define JSON_LAZY_INDEX 3
+
+static uint32_t json_indexadd(JsonReader* R, JsonIndex* I, const char* p)
+{
+    if (I->count == I->capacity)
+    {
+        lua_State* L = R->L;
+
+        size_t newcapacity = I->capacity ? I->capacity * 2 : 64;
+        TString* ts = luaS_bufstart(L, newcapacity * sizeof(JsonIndexEntry));
+        memcpy(ts->data, I->entries, I->count * sizeof(JsonIndexEntry));
+        setsvalue2s(L, L->base + (JSON_LAZY_INDEX - 1), ts);
+
+        I->entries = (JsonIndexEntry*)ts->data;
+        I->capacity = newcapacity;
+    }
+
+    JsonIndexEntry& e = I->entries[I->count];
+    e.offset = uint32_t(p - R->begin);
+    e.next = uint32_t(I->count + 1);
+
+    return uint32_t(I->count++);
+}
+
+// validates the value at p with the same rules and errors as json_parsevalue, recording index entries instead of creating values
+static const char* json_indexvalue(JsonReader* R, JsonIndex* I, const char* p)
+{
+    lua_State* L = R->L;
+    const char* end = R->end;
+    const char* str;
+    size_t len;
+
+    uint32_t index = json_indexadd(R, I, p);
+    char ch = p < end ? *p : 0;
+
+    if (ch == '[')
+    {
+        json_enter(R, p);
+
+        p++;
+
+        for (;;)
+        {
+            p = json_skipspace(p, end);
+
+            if (p < end && *p == ']')
+            {
+                p++;
+                break;
+            }
+
+            p = json_indexvalue(R, I, p);
+            p = json_skipspace(p, end);
+
+            if (p < end && *p == ']')
+            {
+                p++;
+                break;
+            }
+
+            if (p >= end || *p != ',')
+                json_decodeerror(R, p + 1 - R->begin, "expected ']' or ','");
+
+            p++;
+        }
+
+        R->depth--;
+    }
+    else if (ch == '{')
+    {
+        json_enter(R, p);
+
+        p++;
+
+        for (;;)
+        {
+            p = json_skipspace(p, end);
+
+            if (p < end && *p == '}')
+            {
+                p++;
+                break;
+            }
+
+            if (p >= end || *p != '"')
+                json_decodeerror(R, p - R->begin, "expected string for key");
+
+            json_indexadd(R, I, p);
+            p = json_readstring(R, p, &str, &len);
+            p = json_skipspace(p, end);
+
+            if (p >= end || *p != ':')
+                json_decodeerror(R, p - R->begin, "expected ':' after key");
+
+            p = json_skipspace(p + 1, end);
+            p = json_indexvalue(R, I, p);
+            p = json_skipspace(p, end);
+
+            if (p < end && *p == '}')
+            {
+                p++;
+                break;
+            }
+
+            if (p >= end || *p != ',')
+                json_decodeerror(R, p + 1 - R->begin, "expected '}' or ','");
+
+            p++;
+        }
+
+        R->depth--;
+    }
+    else if (ch == '"')
+    {
+        p = json_readstring(R, p, &str, &len);
+    }
+    else
+    {
+        // numbers and literals are validated by decoding them, which doesn't allocate
+        p = json_parsevalue(R, p);
+        lua_pop(L, 1);
+    }
+
+    I->entries[index].next = uint32_t(I->count);
+    return p;
+}
+
+static void json_viewdtor(lua_State* L, void* ud)
+{
+    JsonDocument* doc = static_cast<JsonView*>(ud)->doc;
+
+    if (doc && --doc->refs == 0)
+        luaM_free_(L, doc, json_docsize(doc), doc->memcat);
+}
+
+static JsonView* json_newview(lua_State* L, JsonDocument* doc, uint32_t index)
+{
+    JsonView* V = (JsonView*)lua_newuserdatatagged(L, sizeof(JsonView), LUA_JSONVIEWTAG);
+    V->doc = doc;
+    V->index = index;
+    V->lastkey = 0;
+    V->lastentry = 0;
+
+    if (doc)
+        doc->refs++;
+
+    luaL_getmetatable(L, JSON_VIEWMETATABLE);
+    lua_setmetatable(L, -2);
+
+    return V;
+}
+
+static JsonView* json_checkview(lua_State* L, int idx)
+{
+    JsonView* V = (JsonView*)lua_touserdatatagged(L, idx, LUA_JSONVIEWTAG);
+
+    if (!V)
+        luaL_typeerror(L, idx, "json view");
+
+    return V;
+}
+
+// pushes the value of an index entry; the document has been validated so decoding it can't fail
+static void json_pushentry(lua_State* L, JsonDocument* doc, uint32_t index, int scratchidx)
+{
+    const char* text = json_doctext(doc);
+    const char* p = text + json_docindex(doc)[index].offset;
+
+    if (*p == '[' || *p == '{')
+    {
+        json_newview(L, doc, index);
+    }
+    else
+    {
+        JsonReader R = {L, text, text + doc->size, 0, NULL, 0, 1, 1, scratchidx};
+        json_parsevalue(&R, p);
+    }
+}
+
+static int json_viewindex(lua_State* L)
+{
+    JsonView* V = json_checkview(L, 1);
+    JsonDocument* doc = V->doc;
+    const JsonIndexEntry* index = json_docindex(doc);
+    const char* text = json_doctext(doc);
+
+    lua_settop(L, 2);
+
+    // slot 3 holds the scratch buffer for unescaping keys and values
+    lua_pushnil(L);
+
+    uint32_t i = V->index + 1;
+    uint32_t end = index[V->index].next;
+
+    if (text[index[V->index].offset] == '[')
+    {
+        double d = lua_type(L, 2) == LUA_TNUMBER ? lua_tonumber(L, 2) : 0;
+
+        if (d < 1 || d > end - i || floor(d) != d)
+            return 0;
+
+        uint32_t key = uint32_t(d);
+        uint32_t k = 1;
+
+        if (V->lastkey != 0 && V->lastkey <= key)
+        {
+            k = V->lastkey;
+            i = V->lastentry;
+        }
+
+        for (; k < key && i < end; ++k)
+            i = index[i].next;
+
+        if (i >= end)
+            return 0;
+
+        V->lastkey = key;
+        V->lastentry = i;
+
+        json_pushentry(L, doc, i, 3);
+        return 1;
+    }
+    else
+    {
+        if (lua_type(L, 2) != LUA_TSTRING)
+            return 0;
+
+        size_t keylen = 0;
+        const char* key = lua_tolstring(L, 2, &keylen);
+
+        JsonReader R = {L, text, text + doc->size, 0, NULL, 0, 1, 1, 3};
+        uint32_t found = 0;
+
+        // later fields with the same key take precedence, like they do in json.decode
+        while (i < end)
+        {
+            const char* str;
+            size_t len;
+            json_readstring(&R, text + index[i].offset, &str, &len);
+
+            if (len == keylen && memcmp(str, key, len) == 0)
+                found = i + 1;
+
+            i = index[i + 1].next;
+        }
+
+        if (!found)
+            return 0;
+
+        json_pushentry(L, doc, found, 3);
+        return 1;
+    }
+}
+
+static int json_viewlen(lua_State* L)
+{
+    JsonView* V = json_checkview(L, 1);
+    const JsonIndexEntry* index = json_docindex(V->doc);
+
+    int n = 0;
+
+    // objects have no array part in json.decode either
+    if (json_doctext(V->doc)[index[V->index].offset] == '[')
+        for (uint32_t i = V->index + 1; i < index[V->index].next; i = index[i].next)
+            n++;
+
+    lua_pushinteger(L, n);
+    return 1;
+}
+
+static int json_viewnext(lua_State* L)
+{
+    JsonView* V = (JsonView*)lua_touserdata(L, lua_upvalueindex(1));
+    JsonDocument* doc = V->doc;
+    const JsonIndexEntry* index = json_docindex(doc);
+    const char* text = json_doctext(doc);
+
+    // slot 1 holds the scratch buffer for unescaping keys and values
+    lua_settop(L, 0);
+    lua_pushnil(L);
+
+    uint32_t i = uint32_t(lua_tonumber(L, lua_upvalueindex(2)));
+    int n = lua_tointeger(L, lua_upvalueindex(3));
+
+    uint32_t end = index[V->index].next;
+    bool isarray = text[index[V->index].offset] == '[';
+
+    // null values are skipped, matching the holes and missing fields that json.decode produces
+    for (; i < end; i = index[isarray ? i : i + 1].next)
+    {
+        uint32_t value = isarray ? i : i + 1;
+        n++;
+
+        if (text[index[value].offset] != 'n')
+            break;
+    }
+
+    if (i >= end)
+        return 0;
+
+    lua_pushnumber(L, index[isarray ? i : i + 1].next);
+    lua_replace(L, lua_upvalueindex(2));
+    lua_pushinteger(L, n);
+    lua_replace(L, lua_upvalueindex(3));
+
+    if (isarray)
+    {
+        lua_pushinteger(L, n);
+        json_pushentry(L, doc, i, 1);
+    }
+    else
+    {
+        json_pushentry(L, doc, i, 1);
+        json_pushentry(L, doc, i + 1, 1);
+    }
+
+    return 2;
+}
+
+static int json_viewiter(lua_State* L)
+{
+    JsonView* V = json_checkview(L, 1);
+
+    lua_pushvalue(L, 1);
+    lua_pushnumber(L, V->index + 1);
+    lua_pushinteger(L, 0);
+    lua_pushcclosure(L, json_viewnext, "next", 3);
+    return 1;
+}
+
+static int json_vieweq(lua_State* L)
+{
+    JsonView* a = json_checkview(L, 1);
+    JsonView* b = json_checkview(L, 2);
+
+    lua_pushboolean(L, a->doc == b->doc && a->index == b->index);
+    return 1;
+}
+
+static int json_parselazy(lua_State* L)
+{
+    lua_settop(L, 1);
+
+    if (lua_type(L, 1) != LUA_TSTRING)
+        luaL_error(L, "expected argument of type string, got %s", lua_typename(L, lua_type(L, 1)));
+
+    size_t len = 0;
+    const char* str = lua_tolstring(L, 1, &len);
+
+    if (len > UINT32_MAX)
+        luaL_error(L, "document is too large");
+
+    lua_pushnil(L);
+    lua_pushnil(L);
+
+    JsonReader R = {L, str, str + len, 0, NULL, 0, 1, 1, 2};
+    JsonIndex I = {NULL, 0, 0};
+
+    const char* p = json_skipspace(str, R.end);
+    p = json_indexvalue(&R, &I, p);
+    p = json_skipspace(p, R.end);
+
+    if (p < R.end)
+        json_decodeerror(&R, p - str, "trailing garbage");
+
+    const char* root = str + I.entries[0].offset;
+
+    if (*root != '[' && *root != '{')
+    {
+        json_parsevalue(&R, root);
+        return 1;
+    }
+
+    // the view is created first so that the document is owned by it as soon as it's allocated
+    JsonView* V = json_newview(L, NULL, 0);
+
+    size_t indexsize = I.count * sizeof(JsonIndexEntry);
+    JsonDocument* doc = (JsonDocument*)luaM_new_(L, sizeof(JsonDocument) + indexsize + len, L->activememcat);
+    doc->refs = 1;
+    doc->memcat = L->activememcat;
+    doc->size = len;
+    doc->count = I.count;
+
+    memcpy(json_docindex(doc), I.entries, indexsize);
+    memcpy(json_doctext(doc), str, len);
+
+    V->doc = doc;
+    return 1;
+}
+
+static const luaL_Reg jsonviewmeta[] = {
+    {"__index", json_viewindex},
+    {"__len", json_viewlen},
+    {"__iter", json_viewiter},
+    {"__eq", json_vieweq},
+    {NULL, NULL},
+};
+
+/* }====================================================== */
+
+/*
+** {======================================================
+** Encoding
+** =======================================================
+*/
+
+struct JsonWriter
+{
+    lua_State* L;
+    luaL_Buffer b;
+
+    // tables that are currently being encoded, used to detect circular references
+    int depth;
+    Table* stack[JSON_MAXDEPTH];
+
+    // indentation for pretty printing, or NULL for compact output
+    const char* indent;
+    size_t indentlen;
+
+    // keys of the objects that are being encoded with sorted keys; nested objects use the space after the keys of their parent
+    bool sortkeys;
+    TString** keys;
+    size_t keyscount;
+    size_t keyssize;
+};
+
+// stack slots used by encode; slots 1 and 2 are the arguments
+#define JSON_ENCODE_KEYS 3
+#define JSON_ENCODE_INDENT 4
+
+static void json_encodevalue(JsonWriter* W, const TValue* v);
+
+static void json_encodenumber(JsonWriter* W, double n)
+{
+    if (n != n || n <= -HUGE_VAL || n >= HUGE_VAL)
+    {
+        char buf[LUAI_MAXNUM2STR + 1];
+        *luai_num2str(buf, n) = 0;
+        luaL_error(W->L, "unexpected number value '%s'", buf);
+    }
+
+    char buf[LUAI_MAXNUM2STR];
+
+    // fast path: integers below 2^53 are printed exactly, which is also the shortest representation
+    if (fabs(n) < 1e15 && n == double((long long)n) && !(n == 0 && signbit(n)))
+    {
+        unsigned long long v = n < 0 ? (unsigned long long)-(long long)n : (unsigned long long)n;
+        char* e = buf + sizeof(buf);
+        char* s = e;
+
+        do
+        {
+            *--s = char('0' + v % 10);
+            v /= 10;
+        } while (v);
+
+        if (n < 0)
+            *--s = '-';
+
+        luaL_addlstring(&W->b, s, e - s);
+        return;
+    }
+
+    char* end = luai_num2str(buf, n);
+
+    // scientific format with a single digit significand is printed as "1.e+100", which isn't valid JSON
+    if (char* dot = (char*)memchr(buf, '.', end - buf))
+    {
+        if (dot[1] == 'e')
+        {
+            memmove(dot, dot + 1, end - dot - 1);
+            end--;
+        }
+    }
+
+    luaL_addlstring(&W->b, buf, end - buf);
+}
+
+static void json_newline(JsonWriter* W, int depth)
+{
+    if (!W->indent)
+        return;
+
+    luaL_addchar(&W->b, '\n');
+
+    for (int i = 0; i < depth; ++i)
+        luaL_addlstring(&W->b, W->indent, W->indentlen);
+}
+
+static void json_encodestring(JsonWriter* W, const char* str, size_t len)
+{
+    luaL_Buffer* b = &W->b;
+
+    luaL_reservebuffer(b, len + 2, -1);
+    luaL_addchar(b, '"');
+
+    const char* run = str;
+    const char* end = str + len;
+
+    for (const char* p = json_scanspecial(str, end); p < end; p = json_scanspecial(p + 1, end))
+    {
+        unsigned char ch = *p;
+
+        luaL_addlstring(b, run, p - run);
+        run = p + 1;
+
+        char esc[8];
+
+        switch (ch)
+        {
+        case '"':
+        case '\\':
+            esc[0] = '\\';
+            esc[1] = ch;
+            luaL_addlstring(b, esc, 2);
+            break;
+        case '\b':
+            luaL_addlstring(b, "\\b", 2);
+            break;
+        case '\f':
+            luaL_addlstring(b, "\\f", 2);
+            break;
+        case '\n':
+            luaL_addlstring(b, "\\n", 2);
+            break;
+        case '\r':
+            luaL_addlstring(b, "\\r", 2);
+            break;
+        case '\t':
+            luaL_addlstring(b, "\\t", 2);
+            break;
+        default:
+            snprintf(esc, sizeof(esc), "\\u%04x", ch);
+            luaL_addlstring(b, esc, 6);
+        }
+    }
+
+    luaL_addlstring(b, run, end - run);
+    luaL_addchar(b, '"');
+}
+
+static bool json_isempty(Table* h)
+{
+    for (int i = 0; i < h->sizearray; ++i)
+        if (!ttisnil(&h->array[i]))
+            return false;
+
+    for (int i = 0; i < sizenode(h); ++i)
+        if (!ttisnil(gval(gnode(h, i))))
+            return false;
+
+    return true;
+}
+
+static void json_encodearray(JsonWriter* W, Table* h)
+{
+    lua_State* L = W->L;
+
+    // all keys must be numbers and there must be no holes
+    int n = 0;
+
+    for (int i = 0; i < h->sizearray; ++i)
+        if (!ttisnil(&h->array[i]))
+            n++;
+
+    for (int i = 0; i < sizenode(h); ++i)
+    {
+        LuaNode* node = gnode(h, i);
+
+        if (!ttisnil(gval(node)))
+        {
+            if (gkey(node)->tt != LUA_TNUMBER)
+                luaL_error(L, "invalid table: mixed or invalid key types");
+
+            n++;
+        }
+    }
+
+    if (n != luaH_getn(h))
+        luaL_error(L, "invalid table: sparse array");
+
+    luaL_addchar(&W->b, '[');
+
+    for (int i = 1;; ++i)
+    {
+        const TValue* v = luaH_getnum(h, i);
+
+        if (ttisnil(v))
+            break;
+
+        if (i > 1)
+            luaL_addchar(&W->b, ',');
+
+        json_newline(W, W->depth);
+        json_encodevalue(W, v);
+    }
+
+    if (n > 0)
+        json_newline(W, W->depth - 1);
+
+    luaL_addchar(&W->b, ']');
+}
+
+static void json_encodefield(JsonWriter* W, TString* key, const TValue* value, bool first)
+{
+    if (!first)
+        luaL_addchar(&W->b, ',');
+
+    json_newline(W, W->depth);
+    json_encodestring(W, getstr(key), key->len);
+
+    if (W->indent)
+        luaL_addlstring(&W->b, ": ", 2);
+    else
+        luaL_addchar(&W->b, ':');
+
+    json_encodevalue(W, value);
+}
+
+static int json_comparekeys(const void* lhs, const void* rhs)
+{
+    const TString* a = *(const TString* const*)lhs;
+    const TString* b = *(const TString* const*)rhs;
+
+    int r = memcmp(a->data, b->data, a->len < b->len ? a->len : b->len);
+
+    return r != 0 ? r : (a->len > b->len) - (a->len < b->len);
+}
+
+static void json_encodesortedobject(JsonWriter* W, Table* h)
+{
+    lua_State* L = W->L;
+    size_t base = W->keyscount;
+
+    for (int i = 0; i < sizenode(h); ++i)
+    {
+        LuaNode* node = gnode(h, i);
+
+        if (ttisnil(gval(node)))
+            continue;
+
+        if (gkey(node)->tt != LUA_TSTRING)
+            luaL_error(L, "invalid table: mixed or invalid key types");
+
+        if (W->keyscount == W->keyssize)
+        {
+            size_t newsize = W->keyssize ? W->keyssize * 2 : 64;
+            TString* ts = luaS_bufstart(L, newsize * sizeof(TString*));
+            memcpy(ts->data, W->keys, W->keyscount * sizeof(TString*));
+            setsvalue2s(L, L->base + (JSON_ENCODE_KEYS - 1), ts);
+
+            W->keys = (TString**)ts->data;
+            W->keyssize = newsize;
+        }
+
+        W->keys[W->keyscount++] = tsvalue(gkey(node));
+    }
+
+    qsort(W->keys + base, W->keyscount - base, sizeof(TString*), json_comparekeys);
+
+    // nested objects may reallocate the key storage so it's indexed on every iteration
+    for (size_t i = base; i < W->keyscount; ++i)
+    {
+        TString* key = W->keys[i];
+        json_encodefield(W, key, luaH_getstr(h, key), i == base);
+    }
+
+    W->keyscount = base;
+}
+
+static void json_encodeobject(JsonWriter* W, Table* h)
+{
+    lua_State* L = W->L;
+
+    // keys in the array part are numbers; we only need to check if there are any to match the error reported by iteration
+    for (int i = 0; i < h->sizearray; ++i)
+        if (!ttisnil(&h->array[i]))
+            luaL_error(L, "invalid table: mixed or invalid key types");
+
+    luaL_addchar(&W->b, '{');
+
+    if (W->sortkeys)
+    {
+        json_encodesortedobject(W, h);
+    }
+    else
+    {
+        bool first = true;
+
+        for (int i = 0; i < sizenode(h); ++i)
+        {
+            LuaNode* node = gnode(h, i);
+
+            if (ttisnil(gval(node)))
+                continue;
+
+            if (gkey(node)->tt != LUA_TSTRING)
+                luaL_error(L, "invalid table: mixed or invalid key types");
+
+            json_encodefield(W, tsvalue(gkey(node)), gval(node), first);
+            first = false;
+        }
+    }
+
+    // objects are never empty since empty tables are encoded as arrays
+    json_newline(W, W->depth - 1);
+    luaL_addchar(&W->b, '}');
+}
+
+static void json_encodetable(JsonWriter* W, Table* h)
+{
+    lua_State* L = W->L;
+
+    for (int i = 0; i < W->depth; ++i)
+        if (W->stack[i] == h)
+            luaL_error(L, "circular reference");
+
+    if (W->depth >= JSON_MAXDEPTH)
+        luaL_error(L, "maximum nesting depth exceeded");
+
+    W->stack[W->depth++] = h;
+
+    if (!ttisnil(luaH_getnum(h, 1)) || json_isempty(h))
+        json_encodearray(W, h);
+    else
+        json_encodeobject(W, h);
+
+    W->depth--;
+}
+
+static void json_encodevalue(JsonWriter* W, const TValue* v)
+{
+    switch (ttype(v))
+    {
+    case LUA_TNIL:
+        luaL_addlstring(&W->b, "null", 4);
+        break;
+    case LUA_TBOOLEAN:
+        if (bvalue(v))
+            luaL_addlstring(&W->b, "true", 4);
+        else
+            luaL_addlstring(&W->b, "false", 5);
+        break;
+    case LUA_TNUMBER:
+        json_encodenumber(W, nvalue(v));
+        break;
+    case LUA_TSTRING:
+        json_encodestring(W, svalue(v), tsvalue(v)->len);
+        break;
+    case LUA_TTABLE:
+        json_encodetable(W, hvalue(v));
+        break;
+    default:
+        luaL_error(W->L, "unexpected type '%s'", lua_typename(W->L, ttype(v)));
+    }
+}
+
+static int json_encode(lua_State* L)
+{
+    lua_settop(L, 2);
+
+    JsonWriter W;
+    W.L = L;
+    W.depth = 0;
+    W.indent = NULL;
+    W.indentlen = 0;
+    W.sortkeys = false;
+    W.keys = NULL;
+    W.keyscount = 0;
+    W.keyssize = 0;
+
+    lua_pushnil(L);
+
+    if (!lua_isnil(L, 2))
+    {
+        luaL_checktype(L, 2, LUA_TTABLE);
+
+        lua_getfield(L, 2, "sortKeys");
+        W.sortkeys = lua_toboolean(L, -1);
+        lua_pop(L, 1);
+
+        // indent implies pretty printing; pretty without an indent uses two spaces
+        lua_getfield(L, 2, "indent");
+
+        if (lua_isnil(L, -1))
+        {
+            lua_pop(L, 1);
+            lua_getfield(L, 2, "pretty");
+
+            if (lua_toboolean(L, -1))
+                lua_pushliteral(L, "  ");
+            else
+                lua_pushnil(L);
+
+            lua_remove(L, -2);
+        }
+        else if (lua_type(L, -1) != LUA_TSTRING)
+        {
+            luaL_error(L, "invalid option 'indent' (string expected, got %s)", luaL_typename(L, -1));
+        }
+    }
+    else
+    {
+        lua_pushnil(L);
+    }
+
+    if (lua_isstring(L, JSON_ENCODE_INDENT))
+        W.indent = lua_tolstring(L, JSON_ENCODE_INDENT, &W.indentlen);
+
+    // the encoder reads values directly from the table structure, so nothing is pushed to the stack until the result;
+    // this keeps buffer storage at the top of the stack where luaL_Buffer expects it
+    luaL_buffinit(L, &W.b);
+
+    json_encodevalue(&W, L->base);
+
+    luaL_pushresult(&W.b);
+    return 1;
+}
+
+/* }====================================================== */
+
+static const luaL_Reg jsonlib[] = {
+    {"encode", json_encode},
+    {"decode", json_decode},
+    {"decoder", json_decoder},
+    {"parse_lazy", json_parselazy},
+    {NULL, NULL},
+};
+
+/*
+** Open json library
+*/
+LUALIB_API int luaopen_json(lua_State* L)
+{
+    luaL_register(L, LUA_JSONLIBNAME, jsonlib);
+
+    lua_pushliteral(L, JSON_VERSION);
+    lua_setfield(L, -2, "_version");
+
+    luaL_newmetatable(L, JSON_VIEWMETATABLE);
+    luaL_register(L, NULL, jsonviewmeta);
+    lua_pop(L, 1);
+
+    lua_setuserdatadtor(L, LUA_JSONVIEWTAG, json_viewdtor);
+
+    return 1;
+}
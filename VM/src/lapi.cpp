@@ -12,6 +12,7 @@
 #include "lvm.h"
 #include "lnumutils.h"
 
+#include <stdio.h>
 #include <string.h>
 
 /*
@@ -392,7 +393,7 @@ int lua_tointegerx(lua_State* L, int idx, int* isnum)
 long lua_tolongx(lua_State* L, int idx, int* isnum)
 {
     TValue n;
-    const TValue* o = index2adr(L, idx);
+    const TValue* o = index2addr(L, idx);
     if (tonumber(o, &n))
     {
         long res;
@@ -413,7 +414,7 @@ long lua_tolongx(lua_State* L, int idx, int* isnum)
 long long lua_tollongx(lua_State* L, int idx, int* isnum)
 {
     TValue n;
-    const TValue* o = index2adr(L, idx);
+    const TValue* o = index2addr(L, idx);
     if (tonumber(o, &n))
     {
         long long res;
@@ -1,289 +1,548 @@
+// This file is part of the Luau programming language and is licensed under MIT License; see LICENSE.txt for details
 #include "lualib.h"
-#include "lapi.h"
+
 #include "lstate.h"
-#include <string>
-#include <map>
-#include <tuple>
+#include "lstring.h"
+#include "lgc.h"
+#include "ldo.h"
+
+#include <string.h>
+
+// Encoding and decoding work directly on the input string and write into a single preallocated result string. Both the standard
+// alphabet and the URL and filename safe alphabet from RFC 4648 are supported, with or without padding.
+
+static const char kStandardAlphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+static const char kUrlSafeAlphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+// maps characters to their 6-bit values; invalid characters map to 255
+static const unsigned char kStandardDecodeTable[256] = {
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 62, 255, 255, 255, 63,
+    52, 53, 54, 55, 56, 57, 58, 59, 60, 61, 255, 255, 255, 255, 255, 255,
+    255, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14,
+    15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 255, 255, 255, 255, 255,
+    255, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+    41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+};
+
+static const unsigned char kUrlSafeDecodeTable[256] = {
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 62, 255, 255,
+    52, 53, 54, 55, 56, 57, 58, 59, 60, 61, 255, 255, 255, 255, 255, 255,
+    255, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14,
+    15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 255, 255, 255, 255, 63,
+    255, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+    41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+};
+
+// pairs of output characters for each 12-bit input value, so that a 3-byte group is encoded with two lookups
+struct Base64PairTable
+{
+    char pairs[4096][2];
+
+    explicit Base64PairTable(const char* alphabet)
+    {
+        for (int i = 0; i < 4096; ++i)
+        {
+            pairs[i][0] = alphabet[i >> 6];
+            pairs[i][1] = alphabet[i & 63];
+        }
+    }
+};
+
+static const Base64PairTable kStandardPairs(kStandardAlphabet);
+static const Base64PairTable kUrlSafePairs(kUrlSafeAlphabet);
+
+struct Base64Options
+{
+    bool urlsafe;
+    bool padding;
+};
 
-#define ALLONES ~0u
-#define NBITS int(8 * sizeof(unsigned))
+static Base64Options base64_getoptions(lua_State* L, int idx)
+{
+    Base64Options options = {false, true};
 
-/* macro to trim extra bits */
-#define trim(x) ((x)&ALLONES)
+    if (lua_isnoneornil(L, idx))
+        return options;
 
-/* builds a number with 'n' ones (1 <= n <= NBITS) */
-#define mask(n) (~((ALLONES << 1) << ((n)-1)))
+    luaL_checktype(L, idx, LUA_TTABLE);
 
-#define CODES "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/="
-#define EMPTY ""
-#define SEP EMPTY
+    lua_getfield(L, idx, "urlSafe");
+    options.urlsafe = lua_toboolean(L, -1);
+    lua_pop(L, 1);
 
-/* macro to `unsign' a character */
-#define uchar(c) ((unsigned char)(c))
+    lua_getfield(L, idx, "padding");
+    if (!lua_isnil(L, -1))
+        options.padding = lua_toboolean(L, -1);
+    lua_pop(L, 1);
 
-typedef unsigned b_uint;
+    return options;
+}
 
-static void addfield(lua_State* L, int idx, luaL_Buffer* b, int i)
+static size_t base64_encodedsize(size_t size, bool padding)
 {
-    lua_rawgeti(L, idx, i);
-    if (!lua_isstring(L, -1))
-        luaL_error(L, "invalid value (%s) at index %d in table for 'concat'", luaL_typename(L, -1), i);
-    luaL_addvalue(b);
+    return padding ? (size + 2) / 3 * 4 : size / 3 * 4 + (size % 3 ? size % 3 + 1 : 0);
 }
 
-static int table_concat(lua_State* L, int idx)
+// encodes complete 3-byte groups; size must be a multiple of 3
+static char* base64_encodegroups(char* out, const unsigned char* in, size_t size, const Base64PairTable& table)
 {
-    luaL_checktype(L, idx, LUA_TTABLE);
-    luaL_Buffer b;
-    int i = 1;
-    int last = lua_objlen(L, idx);
-    luaL_buffinit(L, &b);
-    for (; i < last; i++)
+    for (size_t i = 0; i < size; i += 3)
     {
-        addfield(L, idx, &b, i);
-        luaL_addstring(&b, SEP);
+        unsigned int v = (in[i] << 16) | (in[i + 1] << 8) | in[i + 2];
+
+        memcpy(out, table.pairs[v >> 12], 2);
+        memcpy(out + 2, table.pairs[v & 4095], 2);
+        out += 4;
     }
-    if (i == last) /* add last value (if interval was not empty) */
-        addfield(L, idx, &b, i);
-    luaL_pushresult(&b);
-    return 1;
+
+    return out;
 }
 
-static int posrelat(int pos, size_t len)
+// encodes the last 1 or 2 bytes of input
+static char* base64_encodetail(char* out, const unsigned char* in, size_t size, const char* alphabet, bool padding)
 {
-    /* relative string position: negative means back from end */
-    if (pos < 0)
-        pos += (int)len + 1;
-    return (pos >= 0) ? pos : 0;
+    if (size == 0)
+        return out;
+
+    unsigned int v = (in[0] << 16) | (size > 1 ? in[1] << 8 : 0);
+
+    *out++ = alphabet[v >> 18];
+    *out++ = alphabet[(v >> 12) & 63];
+
+    if (size > 1)
+        *out++ = alphabet[(v >> 6) & 63];
+    else if (padding)
+        *out++ = '=';
+
+    if (padding)
+        *out++ = '=';
+
+    return out;
 }
 
-static std::tuple<unsigned char, unsigned char, unsigned char> string_byte(lua_State* L, const char* s, size_t l, int i = NULL, int e = NULL)
+// decodes complete 4-character groups; returns the number of groups before the first one with an invalid character
+static size_t base64_decodegroups(char* out, const unsigned char* in, size_t groups, const unsigned char* table)
 {
-    int posi = posrelat(i, l);
-    int pose = posrelat(e, l);
+    for (size_t i = 0; i < groups; ++i)
+    {
+        unsigned int a = table[in[0]], b = table[in[1]], c = table[in[2]], d = table[in[3]];
 
-    int n;
-    if (posi < 0)
-        posi = 0;
+        if ((a | b | c | d) & 0x80)
+            return i;
 
-    if ((size_t)pose > l)
-        pose = (int)l;
+        unsigned int v = (a << 18) | (b << 12) | (c << 6) | d;
 
-    if (posi > pose)
-        return std::tuple<unsigned char, unsigned char, unsigned char>(NULL, NULL, NULL); /* empty interval; return no values */
+        out[0] = char(v >> 16);
+        out[1] = char(v >> 8);
+        out[2] = char(v);
 
-    n = (int)(pose - posi + 1);
-    if (posi + n <= pose) /* overflow? */{
-        luaL_error(L, "string slice too long");
-        return std::tuple<unsigned char, unsigned char, unsigned char>(NULL, NULL, NULL);
+        in += 4;
+        out += 3;
     }
-    
-    unsigned char a = uchar(s[posi]);
-    if (n == 1)
-        return std::tuple<unsigned char, unsigned char, unsigned char>(a, NULL, NULL);
-    
-    unsigned char b = uchar(s[posi + 1]);
-    if (n == 2)
-        return std::tuple<unsigned char, unsigned char, unsigned char>(a, b, NULL);
-
-    unsigned char c = uchar(s[posi + 2]);
-    return std::tuple<unsigned char, unsigned char, unsigned char>(a, b, c);
+
+    return groups;
 }
 
-static unsigned char string_byte_one(lua_State* L, const char* s, int i = 0)
+// decodes the last 2 or 3 characters of unpadded input; returns false if there is an invalid character
+static bool base64_decodetail(char* out, const unsigned char* in, size_t size, const unsigned char* table)
 {
-    size_t l = strlen(s);
-    int posi = posrelat(i, l);
-    int pose = posrelat(posi, l);
-    
-    if (posi < 0)
-        posi = 0;
+    if (size == 0)
+        return true;
+
+    unsigned int a = table[in[0]], b = table[in[1]], c = size > 2 ? table[in[2]] : 0;
 
-    if ((size_t)pose > l)
-        pose = (int)l;
+    if ((a | b | c) & 0x80)
+        return false;
 
-    if (posi > pose)
-        return NULL; /* empty interval; return no values */
+    unsigned int v = (a << 18) | (b << 12) | (c << 6);
 
-    return uchar(s[posi]);
+    out[0] = char(v >> 16);
+
+    if (size > 2)
+        out[1] = char(v >> 8);
+
+    return true;
 }
 
-static int string_char_one(lua_State* L, b_uint c)
+static l_noret base64_invalidcharacter(lua_State* L, const char* str, size_t size, size_t offset, const unsigned char* table)
 {
-    if (uchar(c) != c){
-        luaL_error(L, "invalid value");
-        return 0;
-    }
+    while (offset < size && table[(unsigned char)str[offset]] != 255)
+        offset++;
+
+    luaL_error(L, "invalid base64 character '%c' at position %d", str[offset], int(offset + 1));
+}
 
-    luaL_Buffer b;
-    char* ptr = luaL_buffinitsize(L, &b, 1);
+static void base64_pushbuffer(lua_State* L, TString* ts)
+{
+    setsvalue2s(L, L->top, luaS_buffinish(L, ts));
+    incr_top(L);
+}
+
+static int base64_encode(lua_State* L)
+{
+    size_t size;
+    const char* str = luaL_optlstring(L, 1, "", &size);
+    Base64Options options = base64_getoptions(L, 2);
 
-    *ptr++ = uchar(c);
+    const char* alphabet = options.urlsafe ? kUrlSafeAlphabet : kStandardAlphabet;
+    const unsigned char* in = (const unsigned char*)str;
+    size_t full = size / 3 * 3;
 
-    luaL_pushresultsize(&b, 1);
+    TString* ts = luaS_bufstart(L, base64_encodedsize(size, options.padding));
 
-    //const char* chr = lua_tostring(L, -1);
-    //lua_pop(L, 1);
+    char* out = base64_encodegroups(ts->data, in, full, options.urlsafe ? kUrlSafePairs : kStandardPairs);
+    base64_encodetail(out, in + full, size - full, alphabet, options.padding);
 
+    base64_pushbuffer(L, ts);
     return 1;
 }
 
-static int string_char_four(lua_State* L, int ca, int cb, int cc, int cd)
+static int base64_decode(lua_State* L)
 {
-    if (uchar(ca) != ca || uchar(cb) != cb || uchar(cc) != cc || uchar(cd) != cd){
-        luaL_error(L, "invalid value");
-        return 0;
+    size_t size;
+    const char* str = luaL_optlstring(L, 1, "", &size);
+    Base64Options options = base64_getoptions(L, 2);
+
+    const unsigned char* table = options.urlsafe ? kUrlSafeDecodeTable : kStandardDecodeTable;
+    const unsigned char* in = (const unsigned char*)str;
+
+    // padding is optional, but when it's present it has to complete the last group
+    size_t n = size;
+
+    if (n > 0 && str[n - 1] == '=')
+    {
+        n--;
+
+        if (n > 0 && str[n - 1] == '=')
+            n--;
+
+        if (size % 4 != 0)
+            luaL_error(L, "invalid base64 padding");
     }
 
-    luaL_Buffer b;
-    char* ptr = luaL_buffinitsize(L, &b, 4);
+    if (n % 4 == 1)
+        luaL_error(L, "invalid base64 length");
+
+    size_t groups = n / 4;
+    size_t tail = n % 4;
+
+    TString* ts = luaS_bufstart(L, groups * 3 + (tail ? tail - 1 : 0));
+
+    size_t decoded = base64_decodegroups(ts->data, in, groups, table);
 
-    *ptr++ = uchar(ca);
-    *ptr++ = uchar(cb);
-    *ptr++ = uchar(cc);
-    *ptr++ = uchar(cd);
+    if (decoded != groups)
+        base64_invalidcharacter(L, str, n, decoded * 4, table);
 
-    luaL_pushresultsize(&b, 4);
+    if (!base64_decodetail(ts->data + groups * 3, in + groups * 4, tail, table))
+        base64_invalidcharacter(L, str, n, groups * 4, table);
 
+    base64_pushbuffer(L, ts);
     return 1;
 }
 
-static b_uint band(b_uint a, b_uint b)
+/*
+** {======================================================
+** Streaming
+** =======================================================
+*/
+
+// Encoder and decoder objects process input in chunks, carrying the bytes of an incomplete group to the next call, so large payloads
+// don't need to be concatenated before encoding or decoding. update and finish are closures over the state userdata.
+
+struct Base64Encoder
 {
-    b_uint r = ~(b_uint)0;
-    r &= a;
-    r &= b;
-    return trim(r);
-}
+    Base64Options options;
 
-static b_uint bor(b_uint a, b_uint b)
+    unsigned char pending[2];
+    int npending;
+
+    bool finished;
+};
+
+struct Base64Decoder
 {
-    b_uint r = (b_uint)0;
-    r |= a;
-    r |= b;
-    return trim(r);
-}
+    Base64Options options;
+
+    unsigned char pending[4];
+    int npending;
 
-static b_uint shift(b_uint r, int i)
+    // number of characters consumed before pending[0], for error positions
+    size_t position;
+
+    // set after a padded group, which has to be the last one
+    bool padded;
+    bool finished;
+};
+
+static int base64_encoderrun(lua_State* L, bool finish)
 {
-    if (i < 0)
-    { /* shift right? */
-        i = -i;
-        r = trim(r);
-        if (i >= NBITS)
-            r = 0;
-        else
-            r >>= i;
+    Base64Encoder* E = (Base64Encoder*)lua_touserdata(L, lua_upvalueindex(1));
+
+    if (E->finished)
+        luaL_error(L, "encoder has already finished");
+
+    size_t size;
+    const char* str = finish ? luaL_optlstring(L, 2, "", &size) : luaL_checklstring(L, 2, &size);
+
+    const unsigned char* in = (const unsigned char*)str;
+    size_t total = E->npending + size;
+    size_t rest = finish ? total % 3 : 0;
+
+    TString* ts = luaS_bufstart(L, total / 3 * 4 + (rest ? base64_encodedsize(rest, E->options.padding) : 0));
+    char* out = ts->data;
+
+    const Base64PairTable& pairs = E->options.urlsafe ? kUrlSafePairs : kStandardPairs;
+
+    // complete the group started by the previous chunk
+    if (E->npending > 0 && total >= 3)
+    {
+        unsigned char group[3];
+        memcpy(group, E->pending, E->npending);
+        memcpy(group + E->npending, in, 3 - E->npending);
+
+        out = base64_encodegroups(out, group, 3, pairs);
+
+        in += 3 - E->npending;
+        size -= 3 - E->npending;
+        E->npending = 0;
     }
-    else
-    { /* shift left */
-        if (i >= NBITS)
-            r = 0;
-        else
-            r <<= i;
-        r = trim(r);
+
+    size_t full = size / 3 * 3;
+    out = base64_encodegroups(out, in, full, pairs);
+
+    memcpy(E->pending + E->npending, in + full, size - full);
+    E->npending += int(size - full);
+
+    if (finish)
+    {
+        base64_encodetail(out, E->pending, E->npending, E->options.urlsafe ? kUrlSafeAlphabet : kStandardAlphabet, E->options.padding);
+
+        E->npending = 0;
+        E->finished = true;
     }
-    return r;
+
+    base64_pushbuffer(L, ts);
+    return 1;
 }
 
-static b_uint lshift(b_uint r, int i)
+static int base64_encoderupdate(lua_State* L)
 {
-    return shift(r, i);
+    return base64_encoderrun(L, false);
 }
 
-static b_uint rshift(b_uint r, int i)
+static int base64_encoderfinish(lua_State* L)
 {
-    return shift(r, -i);
+    return base64_encoderrun(L, true);
 }
 
-static int base64_encode(lua_State* L)
+// decodes one group that might be the padded final group
+static char* base64_decodergroup(lua_State* L, Base64Decoder* D, char* out, const unsigned char* group, const unsigned char* table)
 {
-    size_t l;
-    const char* str = luaL_optlstring(L, 1, EMPTY, &l);
-    lua_settop(L, 0);
-    lua_createtable(L, 0, 0); // parts = {}
-    int j = 1;
-    int li = (int)l;
-    for (int i = 0; i < li; i++)
+    if (D->padded)
+        luaL_error(L, "invalid base64 padding");
+
+    if (base64_decodegroups(out, group, 1, table) == 1)
+        return out + 3;
+
+    if (group[3] == '=')
     {
-        std::tuple<unsigned char,unsigned char,unsigned char> abc = string_byte(L, str, l, i, i + 2); // local a, b, c = byte(str, i, i + 2)
-        unsigned char a = std::get<0>(abc);
-        unsigned char b = std::get<1>(abc);
-        unsigned char c = std::get<2>(abc);
-
-        // 61 is '='
-
-        // Higher 6 bits of a
-        unsigned char ca = string_byte_one(L, CODES, rshift(a, 2));
-        // Lower 2 bits of a + high 4 bits of b
-        unsigned char cb = string_byte_one(L, CODES, bor(lshift(band(a, 3), 4), ((b != NULL) ? rshift(b, 4) : 0)));
-        // Low 4 bits of b + High 2 bits of c
-        unsigned char cc = ((b != NULL) ? string_byte_one(L, CODES, bor(lshift(band(b, 15), 2),((c != NULL) ? rshift(c, 6) : 0))) : 61);
-        // Lower 6 bits of c
-        unsigned char cd = ((c != NULL) ? string_byte_one(L, CODES, band(c, 63)) : 61);
-
-        string_char_four(L, ca, cb, cc, cd);
-        lua_rawseti(L, 1, j);
-
-        j++;
-        i++;
-        i++;
+        size_t n = group[2] == '=' ? 2 : 3;
+
+        if (base64_decodetail(out, group, n, table))
+        {
+            D->padded = true;
+            return out + n - 1;
+        }
     }
-    table_concat(L, 1); // table.concat(parts)
-    return 1;
-}
 
-// Reverse map from character code to 6-bit integer
-static std::map<unsigned char, int> map = std::map<unsigned char, int>{}; // map = {}
+    int i = 0;
+    while (table[group[i]] != 255)
+        i++;
 
-static int base64_decode(lua_State* L)
+    luaL_error(L, "invalid base64 character '%c' at position %d", group[i], int(D->position + i + 1));
+}
+
+static int base64_decoderrun(lua_State* L, bool finish)
 {
-    size_t l;
-    const char* data = luaL_optlstring(L, 1, EMPTY, &l);
-    lua_settop(L, 0);
-    lua_createtable(L, 0, 0); // bytes = {}
-    int j = 1;
-    int li = (int)l;
-    for (int i = 0; i < li; i++)
+    Base64Decoder* D = (Base64Decoder*)lua_touserdata(L, lua_upvalueindex(1));
+
+    if (D->finished)
+        luaL_error(L, "decoder has already finished");
+
+    size_t size;
+    const char* str = finish ? luaL_optlstring(L, 2, "", &size) : luaL_checklstring(L, 2, &size);
+
+    const unsigned char* table = D->options.urlsafe ? kUrlSafeDecodeTable : kStandardDecodeTable;
+    const unsigned char* in = (const unsigned char*)str;
+    size_t total = D->npending + size;
+
+    // padding can make the output shorter than this, in which case the result is copied
+    size_t capacity = total / 4 * 3 + (finish ? 2 : 0);
+
+    // the buffer stays on the stack until the result is pushed, since copying it out of a partly filled buffer allocates
+    TString* ts = luaS_bufstart(L, capacity);
+    setsvalue2s(L, L->top, ts);
+    incr_top(L);
+
+    char* out = ts->data;
+
+    // complete the group started by the previous chunk
+    if (D->npending > 0 && total >= 4)
+    {
+        memcpy(D->pending + D->npending, in, 4 - D->npending);
+
+        out = base64_decodergroup(L, D, out, D->pending, table);
+
+        in += 4 - D->npending;
+        size -= 4 - D->npending;
+        D->position += 4;
+        D->npending = 0;
+    }
+
+    size_t groups = size / 4;
+
+    while (groups > 0)
     {
-        int a = map[string_byte_one(L, data, i)]; // a = map[string.byte(data, i)]
-        int b = map[string_byte_one(L, data, i + 1)]; // b = map[string.byte(data, i + 1)]
-        int c = map[string_byte_one(L, data, i + 2)]; // c = map[string.byte(data, i + 2)]
-        int d = map[string_byte_one(L, data, i + 3)]; // d = map[string.byte(data, i + 3)]
-
-        // higher 6 bits are the first char
-        // lower 2 bits are upper 2 bits of second char
-        string_char_one(L, bor(lshift(a, 2), rshift(b, 4)));
-        lua_rawseti(L, 1, j); /* bytes[j] = string.char(bit32.bor(bit32.lshift(a, 2), bit32.rshift(b, 4))) */
-
-        // if the third char is not padding, we have a second byte
-        if (c < 64){
-            // high 4 bits come from lower 4 bits in b
-            // low 4 bits come from high 4 bits in c
-            string_char_one(L, bor(lshift(band(b, 0xf), 4), rshift(c, 2)));
-            lua_rawseti(L, 1, j + 1); /* bytes[j + 1] = string.char(bit32.bor(bit32.lshift(bit32.band(b, 0xf), 4), bit32.rshift(c, 2))) */
-
-            // if the fourth char is not padding, we have a third byte
-            if (d < 64) {
-                // Upper 2 bits come from Lower 2 bits of c
-                // Lower 6 bits come from d
-                string_char_one(L, bor(lshift(band(c, 3), 6), d));
-                lua_rawseti(L, 1, j + 2); /* bytes[j + 2] = string.char(bit32.bor(bit32.lshift(bit32.band(c, 3), 6), d)) */
-            }
+        size_t decoded = D->padded ? 0 : base64_decodegroups(out, in, groups, table);
+
+        out += decoded * 3;
+        in += decoded * 4;
+        D->position += decoded * 4;
+        groups -= decoded;
+
+        // the group that stopped the fast path is either invalid or the padded final group
+        if (groups > 0)
+        {
+            out = base64_decodergroup(L, D, out, in, table);
+
+            in += 4;
+            D->position += 4;
+            groups--;
         }
+    }
 
-        j = j + 3;
-        i++;
-        i++;
-        i++;
+    size_t rest = size % 4;
+
+    if (rest > 0 && D->padded)
+        luaL_error(L, "invalid base64 padding");
+
+    memcpy(D->pending + D->npending, in, rest);
+    D->npending += int(rest);
+
+    if (finish)
+    {
+        if (D->npending == 1)
+            luaL_error(L, "invalid base64 length");
+
+        for (int i = 0; i < D->npending; ++i)
+            if (D->pending[i] == '=')
+                luaL_error(L, "invalid base64 padding");
+
+        if (!base64_decodetail(out, D->pending, D->npending, table))
+        {
+            int i = 0;
+            while (table[D->pending[i]] != 255)
+                i++;
+
+            luaL_error(L, "invalid base64 character '%c' at position %d", D->pending[i], int(D->position + i + 1));
+        }
+
+        out += D->npending ? D->npending - 1 : 0;
+
+        D->npending = 0;
+        D->finished = true;
+    }
+
+    if (size_t(out - ts->data) == capacity)
+    {
+        setsvalue2s(L, L->top - 1, luaS_buffinish(L, ts));
+    }
+    else
+    {
+        lua_pushlstring(L, ts->data, out - ts->data);
     }
-    table_concat(L, 1); // table.concat(bytes)
+
     return 1;
 }
 
+static int base64_decoderupdate(lua_State* L)
+{
+    return base64_decoderrun(L, false);
+}
+
+static int base64_decoderfinish(lua_State* L)
+{
+    return base64_decoderrun(L, true);
+}
+
+static void base64_pushstream(lua_State* L, lua_CFunction update, lua_CFunction finish)
+{
+    lua_createtable(L, 0, 2);
+
+    lua_pushvalue(L, -2);
+    lua_pushcclosure(L, update, "update", 1);
+    lua_setfield(L, -2, "update");
+
+    lua_pushvalue(L, -2);
+    lua_pushcclosure(L, finish, "finish", 1);
+    lua_setfield(L, -2, "finish");
+}
+
+static int base64_encoder(lua_State* L)
+{
+    Base64Options options = base64_getoptions(L, 1);
+
+    Base64Encoder* E = (Base64Encoder*)lua_newuserdata(L, sizeof(Base64Encoder));
+    E->options = options;
+    E->npending = 0;
+    E->finished = false;
+
+    base64_pushstream(L, base64_encoderupdate, base64_encoderfinish);
+    return 1;
+}
+
+static int base64_decoder(lua_State* L)
+{
+    Base64Options options = base64_getoptions(L, 1);
+
+    Base64Decoder* D = (Base64Decoder*)lua_newuserdata(L, sizeof(Base64Decoder));
+    D->options = options;
+    D->npending = 0;
+    D->position = 0;
+    D->padded = false;
+    D->finished = false;
+
+    base64_pushstream(L, base64_decoderupdate, base64_decoderfinish);
+    return 1;
+}
+
+/* }====================================================== */
+
 static const luaL_Reg base64lib[] = {
     {"encode", base64_encode},
     {"decode", base64_decode},
+    {"encoder", base64_encoder},
+    {"decoder", base64_decoder},
     {NULL, NULL},
 };
 
@@ -294,11 +553,5 @@ LUALIB_API int luaopen_base64(lua_State* L)
 {
     luaL_register(L, LUA_BASE64LIBNAME, base64lib);
 
-    int lcodes = (int)strlen(CODES);
-
-    for (int i = 1; i < lcodes; i++){
-        map[string_byte_one(L, CODES, i)] = i;
-    }
-
     return 1;
 }
@@ -7,6 +7,21 @@
 #include "lstate.h"
 #include <cpr/cpr.h>
 
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <thread>
+
+#include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 #undef strdup
 #define strdup _strdup
 
@@ -14,6 +29,7 @@
 #define strlwr _strlwr
 
 #define CPR_RESPONSE "cprResponse"
+#define CPR_SESSION "cprSession"
 
 typedef struct ResponseData
 {
@@ -85,7 +101,7 @@ enum RequestMethod
     Options
 };
 
-static std::map<std::string, RequestMethod, cpr::CaseInsensitiveCompare> requestMap = std::map<std::string, RequestMethod, cpr::CaseInsensitiveCompare>{
+static const std::map<std::string, RequestMethod, cpr::CaseInsensitiveCompare> requestMap = std::map<std::string, RequestMethod, cpr::CaseInsensitiveCompare>{
     {"GET", RequestMethod::Get},
     {"get", RequestMethod::Get},
     {"Get", RequestMethod::Get},
@@ -115,29 +131,204 @@ static std::map<std::string, RequestMethod, cpr::CaseInsensitiveCompare> request
     {"Options", RequestMethod::Options},
 };
 
-template <typename... Ts>
-cpr::Response Request(RequestMethod method, Ts&&... ts) {
-    switch( method )
+// lookups never insert, the map is shared by the VMs of all worker threads
+static RequestMethod findRequestMethod(const std::string& name)
+{
+    std::map<std::string, RequestMethod, cpr::CaseInsensitiveCompare>::const_iterator it = requestMap.find(name);
+    return it == requestMap.end() ? RequestMethod::None : it->second;
+}
+
+class CprPool;
+
+struct CprRequest
+{
+    RequestMethod method = RequestMethod::None;
+    cpr::Url url;
+
+    bool hasHeader = false;
+    cpr::Header header = {};
+
+    bool hasBody = false;
+    cpr::Body body;
+
+    // custom options; timeout and redirect are only applied when an options table was passed
+    bool hasOptions = false;
+    cpr::Timeout timeout = cpr::Timeout(0); // Default is no timeout
+    cpr::Redirect redirect = cpr::Redirect(true); // Default is true
+    Auth auth = Auth();
+    bool hasPayload = false;
+    cpr::Payload payload = {};
+    bool hasMultipart = false;
+    cpr::Multipart multipart = {};
+    bool hasParameters = false;
+    cpr::Parameters parameters = {};
+
+    // suspend the calling coroutine instead of blocking the thread
+    bool async = false;
+
+    // registry reference to the function that receives the body chunk by chunk
+    int stream = LUA_NOREF;
+    bool hasWrite = false;
+    cpr::WriteCallback write;
+
+    // requests made through a cpr.session borrow a handle from the session pool
+    std::shared_ptr<CprPool> pool;
+    // whether the handle can serve later requests; it remembers credentials and forms that later requests may not override
+    bool reusable = true;
+};
+
+// a finished transfer; the cert chain is read from the curl handle as soon as the transfer ends, before a pooled handle serves another request
+struct CprResult
+{
+    cpr::Response response;
+    std::vector<std::string> certInfo;
+};
+
+static void applyRequest(cpr::Session& session, const CprRequest& request)
+{
+    session.SetOption(request.url);
+
+    if (request.hasHeader)
+        session.SetOption(request.header);
+    if (request.hasBody)
+        session.SetOption(request.body);
+    if (request.hasWrite)
+        session.SetOption(request.write);
+
+    if (request.hasOptions)
+    {
+        session.SetOption(request.timeout);
+        session.SetOption(request.redirect);
+
+        // only forward post data that was asked for; an empty payload would otherwise clobber the body
+        if (request.hasPayload)
+            session.SetOption(request.payload);
+        if (request.hasMultipart)
+            session.SetOption(request.multipart);
+        if (request.hasParameters)
+            session.SetOption(request.parameters);
+
+        if (request.auth.hasBasic)
+            session.SetOption(request.auth.basic);
+        else if (request.auth.hasDigest)
+            session.SetOption(request.auth.digest);
+        else if (request.auth.hasNTLM)
+            session.SetOption(request.auth.ntlm);
+        else if (request.auth.hasBearer)
+            session.SetOption(request.auth.bearer);
+    }
+}
+
+static cpr::Response performRequest(cpr::Session& session, RequestMethod method)
+{
+    switch (method)
+    {
+    case RequestMethod::Get:
+        return session.Get();
+    case RequestMethod::Post:
+        return session.Post();
+    case RequestMethod::Patch:
+        return session.Patch();
+    case RequestMethod::Put:
+        return session.Put();
+    case RequestMethod::Delete:
+        return session.Delete();
+    case RequestMethod::Head:
+        return session.Head();
+    case RequestMethod::Options:
+        return session.Options();
+    case RequestMethod::None:
+    default:
+        return cpr::Response();
+    }
+}
+
+// scheme://host:port part of the url, which identifies the connections a handle can reuse
+static std::string urlorigin(const std::string& url)
+{
+    size_t scheme = url.find("://");
+    size_t start = scheme == std::string::npos ? 0 : scheme + 3;
+    size_t end = url.find_first_of("/?#", start);
+
+    return url.substr(0, end);
+}
+
+// idle handles of a cpr.session grouped by origin; libcurl keeps each handle's connection alive between requests
+class CprPool
+{
+public:
+    explicit CprPool(size_t limit)
+        : limit(limit)
+    {
+    }
+
+    CprResult perform(const CprRequest& request)
+    {
+        // cpr keeps post fields on the handle, so handles that carried a body only serve requests that replace it
+        bool posting = request.hasBody || request.hasPayload;
+        std::string key = urlorigin(request.url.str()) + (posting ? " post" : "");
+
+        std::unique_ptr<cpr::Session> session = checkout(key);
+        applyRequest(*session, request);
+        CprResult result;
+        result.response = performRequest(*session, request.method);
+        result.certInfo = result.response.GetCertInfo();
+
+        if (request.reusable)
+            checkin(key, std::move(session));
+
+        return result;
+    }
+
+    void clear()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        idle.clear();
+    }
+
+private:
+    std::unique_ptr<cpr::Session> checkout(const std::string& key)
     {
-        case RequestMethod::Get:
-            
-            return (cpr::Response) cpr::Get(std::forward<Ts>(ts)...);
-        case RequestMethod::Post:
-            return (cpr::Response) cpr::Post(std::forward<Ts>(ts)...);
-        case RequestMethod::Patch:
-            return (cpr::Response) cpr::Patch(std::forward<Ts>(ts)...);
-        case RequestMethod::Put:
-            return (cpr::Response) cpr::Put(std::forward<Ts>(ts)...);
-        case RequestMethod::Delete:
-            return (cpr::Response) cpr::Delete(std::forward<Ts>(ts)...);
-        case RequestMethod::Head:
-            return (cpr::Response) cpr::Head(std::forward<Ts>(ts)...);
-        case RequestMethod::Options:
-            return (cpr::Response) cpr::Options(std::forward<Ts>(ts)...);
-        case RequestMethod::None:
-        default:
-            return cpr::Response();
+        std::unique_lock<std::mutex> lock(mutex);
+
+        std::map<std::string, std::vector<std::unique_ptr<cpr::Session>>>::iterator it = idle.find(key);
+        if (it != idle.end() && !it->second.empty())
+        {
+            std::unique_ptr<cpr::Session> session = std::move(it->second.back());
+            it->second.pop_back();
+            return session;
+        }
+
+        lock.unlock();
+        return std::unique_ptr<cpr::Session>(new cpr::Session());
+    }
+
+    void checkin(const std::string& key, std::unique_ptr<cpr::Session> session)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+
+        std::vector<std::unique_ptr<cpr::Session>>& handles = idle[key];
+        if (handles.size() < limit)
+            handles.push_back(std::move(session));
     }
+
+    std::mutex mutex;
+    std::map<std::string, std::vector<std::unique_ptr<cpr::Session>>> idle;
+    size_t limit;
+};
+
+static CprResult performRequest(const CprRequest& request)
+{
+    if (request.pool)
+        return request.pool->perform(request);
+
+    cpr::Session session;
+    applyRequest(session, request);
+
+    CprResult result;
+    result.response = performRequest(session, request.method);
+    result.certInfo = result.response.GetCertInfo();
+    return result;
 }
 
 static l_noret table_arg_error(lua_State* L, const char* nname, const char* extramsg)
@@ -302,7 +493,7 @@ static const char* getfield(lua_State* L, const char* key, const char* d)
         res = (const char*)lua_tostring(L, -1);
     else
     {
-        if (d < 0)
+        if (!d)
             luaL_error(L, "field '%s' missing in table", key);
         res = d;
     }
@@ -561,15 +752,10 @@ static cpr::Body getBodyFromArgs(lua_State* L, int idx)
     return cpr::Body(body, bodyl);
 }
 
-static std::tuple<cpr::Timeout, cpr::Redirect, Auth, cpr::Payload, cpr::Multipart, cpr::Parameters> getOptionsFromArgs(lua_State* L, int idx)
+static void getOptionsFromArgs(lua_State* L, int idx, CprRequest& request)
 {
     luaL_checktype(L, idx, LUA_TTABLE);
-    cpr::Timeout timeout = cpr::Timeout(0); // Default is no timeout
-    cpr::Redirect redirect = cpr::Redirect(true); // Default is true
-    Auth auth = Auth();
-    cpr::Payload payload = {};
-    cpr::Parameters parameters = {};
-    cpr::Multipart multipart = {};
+    request.hasOptions = true;
     
     // push nil for lua_next to indicate it needs to pick the first key 
     lua_pushnil(L);
@@ -591,7 +777,7 @@ static std::tuple<cpr::Timeout, cpr::Redirect, Auth, cpr::Payload, cpr::Multipar
         if (key == "followRedirects" || key == "followredirects" || key == "Followredirects" || key == "FollowRedirects" || key == "FOLLOWREDIRECTS")
         {
             if (lua_isboolean(L, -1))
-                redirect.follow = lua_toboolean(L, -1) ? true : false;
+                request.redirect.follow = lua_toboolean(L, -1) ? true : false;
         }
         else if (key == "maxRedirects" || key == "maxredirects" || key == "Maxredirects" || key == "MaxRedirects" || key == "MAXREDIRECTS")
         {
@@ -600,7 +786,7 @@ static std::tuple<cpr::Timeout, cpr::Redirect, Auth, cpr::Payload, cpr::Multipar
             if (isnum){
                 if (n < 0)
                     table_arg_error(L, "maximum redirects", "out of range");
-                redirect.maximum = n;
+                request.redirect.maximum = n;
             }
         }
         else if (key == "timeout" || key == "Timeout" || key == "TimeOut" || key == "timeOut" || key == "TIMEOUT")
@@ -610,30 +796,49 @@ static std::tuple<cpr::Timeout, cpr::Redirect, Auth, cpr::Payload, cpr::Multipar
             if (isnum){
                 if (n < 0)
                     table_arg_error(L, "timeout", "out of range");
-                timeout = cpr::Timeout(n);
+                request.timeout = cpr::Timeout(n);
             }
         }
         else if (key == "auth" || key == "authentication" || key == "Auth" || key == "Authentication" || key == "AUTH" || key == "AUTHENTICATION" || key == "basic-auth" || key == "basicAuth" || key == "basicAuthentication" || key == "basicauth" || key == "basicauthentication" || key == "Basicauth" || key == "Basicauthentication" || key == "BasicAuth" || key == "BasicAuthentication" || key == "BASICAUTH" || key == "BASICAUTHENTICATION")
-            auth.AddBasic(getAuthenticationFromArgs(L, -1));
+            request.auth.AddBasic(getAuthenticationFromArgs(L, -1));
         else if (key == "digest" || key == "Digest")
-            auth.AddDigest(getDigestFromArgs(L, -1));
+            request.auth.AddDigest(getDigestFromArgs(L, -1));
         else if (key == "ntlm" || key == "NTLM" || key == "Ntlm")
-            auth.AddNTLM(getNTLMFromArgs(L, -1));
+            request.auth.AddNTLM(getNTLMFromArgs(L, -1));
         else if (key == "bearer" || key == "BEARER" || key == "Bearer")
-            auth.AddBearer(getBearerFromArgs(L, -1));
+            request.auth.AddBearer(getBearerFromArgs(L, -1));
         else if (key == "parameters" || key == "PARAMETERS" || key == "Parameters")
-            parameters = getParametersFromArgs(L, -1);
+        {
+            request.parameters = getParametersFromArgs(L, -1);
+            request.hasParameters = true;
+        }
         else if (key == "payload" || key == "PAYLOAD" || key == "Payload")
-            payload = getPayloadFromArgs(L, -1);
+        {
+            request.payload = getPayloadFromArgs(L, -1);
+            request.hasPayload = true;
+        }
         else if (key == "multipart" || key == "MULTIPART" || key == "Multipart" || key == "MultiPart" || key == "multiPart")
-            multipart = getMultipartFromArgs(L, -1);
+        {
+            request.multipart = getMultipartFromArgs(L, -1);
+            request.hasMultipart = true;
+        }
+        else if (key == "async" || key == "Async" || key == "ASYNC")
+            request.async = lua_toboolean(L, -1) != 0;
 
         // pop the value when you're done with it 
         lua_pop(L, 2);
         lua_pushstring(L, k);
     }
 
-    return std::tuple <cpr::Timeout, cpr::Redirect, Auth, cpr::Payload, cpr::Multipart, cpr::Parameters>(timeout, redirect, auth, payload, multipart, parameters);
+    // referenced last, so that errors raised while reading the other options can't leak it
+    lua_rawgetfield(L, idx, "stream");
+    if (!lua_isnil(L, -1))
+    {
+        if (!lua_isfunction(L, -1))
+            table_type_error(L, -1, "stream", LUA_TFUNCTION);
+        request.stream = lua_ref(L, -1);
+    }
+    lua_pop(L, 1);
 }
 
 static const char * getTextForEnum( cpr::ErrorCode code )
@@ -683,333 +888,1006 @@ static const char * getTextForEnum( cpr::ErrorCode code )
   }
 }
 
-static Table *pushResponse (lua_State *L, cpr::Response* response)
+/* {======================================================
+** Responses
+** =======================================================*/
+
+// Responses are userdata tagged with LUA_CPRRESPONSETAG that own the parts of the cpr::Response. Fields are converted to Lua values the first
+// time they are read and kept in a per-response table stored in a weak-keyed registry table, so a loop that only looks at the status code
+// and text doesn't build headers, cookies and certificate tables for every request.
+
+#define CPR_RESPONSE_CACHE "cprResponseCache"
+
+struct CprResponse
 {
-    lua_createtable(L, 0, 12); /* 12 = number of fields */
+    long status_code;
+    std::string text;
+    cpr::Header header;
+    cpr::Url url;
+    double elapsed;
+    cpr::Cookies cookies;
+    cpr::Error error;
+    std::string raw_header;
+    std::string status_line;
+    std::string reason;
+    decltype(cpr::Response::uploaded_bytes) uploaded_bytes;
+    decltype(cpr::Response::downloaded_bytes) downloaded_bytes;
+    long redirect_count;
+
+    std::vector<std::string> certInfo;
+};
 
-    setfield(L, "reason", response->reason.c_str());
-    setfield(L, "redirects", response->redirect_count);
-    
-    lua_createtable(L, 0, 2); /* 2 = number of fields */
-    Table* st = hvalue(L->top - 1);
-    setfield(L, "code", response->status_code);
-    setfield(L, "line", response->status_line.c_str());
-    st->readonly = true;
-    lua_setfield(L, -2, "status");
-
-    setfield(L, "text", response->text.c_str());
-    setfield(L, "url", response->url.data());
-    setfield(L, "rawHeader", response->raw_header.c_str());
-
-    cpr::Header header = response->header;
-    size_t hsizet = header.size();
-    if ( hsizet > INT_MAX )
-    {
-        luaL_error(L, "header size is larger than INT_MAX");
-        //throw std::overflow_error("data is larger than INT_MAX");
-    }
-    int hsize = static_cast<int>(hsizet);
+enum CprResponseField
+{
+    CprResponse_reason,
+    CprResponse_redirects,
+    CprResponse_status,
+    CprResponse_text,
+    CprResponse_url,
+    CprResponse_rawHeader,
+    CprResponse_header,
+    CprResponse_error,
+    CprResponse_downloaded,
+    CprResponse_uploaded,
+    CprResponse_elapsed,
+    CprResponse_cookies,
+    CprResponse_certInfo,
+    CprResponse__Count
+};
+
+static const char* const kCprResponseFields[CprResponse__Count] = {
+    "reason",
+    "redirects",
+    "status",
+    "text",
+    "url",
+    "rawHeader",
+    "header",
+    "error",
+    "downloaded",
+    "uploaded",
+    "elapsed",
+    "cookies",
+    "certInfo",
+};
 
-    lua_createtable(L, 0, hsize);
-    Table* ht = hvalue(L->top - 1);
+static int findresponsefield(lua_State* L, int idx)
+{
+    if (lua_type(L, idx) != LUA_TSTRING)
+        return -1;
 
-    // Create a map iterator and point to beginning of map
-    cpr::Header::iterator hit = header.begin();
-    // Iterate over the map using Iterator till end.
-    while (hit != header.end())
-    {
-        // Accessing KEY from element pointed by it.
-        std::string k = hit->first;
-        // Accessing VALUE from element pointed by it.
-        std::string v = hit->second;
-        // Add to cookie table
-        setfield(L, k.c_str(), v.c_str());
-        // Increment the Iterator to point to next entry
-        hit++;
-    }
-    ht->readonly = true;
-    lua_setfield(L, -2, "header");
-
-    lua_createtable(L, 0, 2); /* 2 = number of fields */
-    Table* et = hvalue(L->top - 1);
-    setfield(L, "code", getTextForEnum(response->error.code));
-    setfield(L, "message", response->error.message.c_str());
-    et->readonly = true;
-    lua_setfield(L, -2, "error");
-
-    setfield(L, "downloaded", response->downloaded_bytes);
-    setfield(L, "uploaded", response->uploaded_bytes);
-    setfield(L, "elapsed", response->elapsed);
-
-    cpr::Cookies cookies = response->cookies;
-    int csize = 0;
-
-    // Create a map iterator and point to beginning of map
-    cpr::Cookies::iterator sit = cookies.begin();
-    // Iterate over the map using Iterator till end.
-    while (sit != cookies.end())
+    const char* key = lua_tostring(L, idx);
+
+    for (int i = 0; i < CprResponse__Count; ++i)
+        if (strcmp(key, kCprResponseFields[i]) == 0)
+            return i;
+
+    return -1;
+}
+
+static void response_dtor(lua_State* L, void* ud)
+{
+    static_cast<CprResponse*>(ud)->~CprResponse();
+}
+
+// moves the contents of the response into a new response userdata
+static void pushResponse(lua_State* L, CprResult* result)
+{
+    cpr::Response* response = &result->response;
+
+    CprResponse* r = (CprResponse*)lua_newuserdatatagged(L, sizeof(CprResponse), LUA_CPRRESPONSETAG);
+    new (r) CprResponse();
+
+    r->status_code = response->status_code;
+    r->text = std::move(response->text);
+    r->header = std::move(response->header);
+    r->url = std::move(response->url);
+    r->elapsed = response->elapsed;
+    r->cookies = std::move(response->cookies);
+    r->error = std::move(response->error);
+    r->raw_header = std::move(response->raw_header);
+    r->status_line = std::move(response->status_line);
+    r->reason = std::move(response->reason);
+    r->uploaded_bytes = response->uploaded_bytes;
+    r->downloaded_bytes = response->downloaded_bytes;
+    r->redirect_count = response->redirect_count;
+    r->certInfo = std::move(result->certInfo);
+
+    luaL_getmetatable(L, CPR_RESPONSE);
+    lua_setmetatable(L, -2);
+}
+
+static CprResponse* checkresponse(lua_State* L, int idx)
+{
+    CprResponse* r = (CprResponse*)lua_touserdatatagged(L, idx, LUA_CPRRESPONSETAG);
+
+    if (!r)
+        luaL_typeerror(L, idx, CPR_RESPONSE);
+
+    return r;
+}
+
+static void convertfield(lua_State* L, CprResponse* r, int field)
+{
+    switch (field)
     {
-        // Increment the Iterator to point to next entry
-        csize++;
-        sit++;
+    case CprResponse_reason:
+        lua_pushlstring(L, r->reason.data(), r->reason.size());
+        break;
+    case CprResponse_status:
+        lua_createtable(L, 0, 2);
+        setfield(L, "code", r->status_code);
+        setfield(L, "line", r->status_line.c_str());
+        lua_setreadonly(L, -1, true);
+        break;
+    case CprResponse_text:
+        lua_pushlstring(L, r->text.data(), r->text.size());
+        break;
+    case CprResponse_url:
+        lua_pushstring(L, r->url.c_str());
+        break;
+    case CprResponse_rawHeader:
+        lua_pushlstring(L, r->raw_header.data(), r->raw_header.size());
+        break;
+    case CprResponse_header:
+        if (r->header.size() > INT_MAX)
+            luaL_error(L, "header size is larger than INT_MAX");
+
+        lua_createtable(L, 0, int(r->header.size()));
+        for (cpr::Header::iterator it = r->header.begin(); it != r->header.end(); ++it)
+            setfield(L, it->first.c_str(), it->second.c_str());
+        lua_setreadonly(L, -1, true);
+        break;
+    case CprResponse_error:
+        lua_createtable(L, 0, 2);
+        setfield(L, "code", getTextForEnum(r->error.code));
+        setfield(L, "message", r->error.message.c_str());
+        lua_setreadonly(L, -1, true);
+        break;
+    case CprResponse_cookies:
+        lua_newtable(L);
+        for (cpr::Cookies::iterator it = r->cookies.begin(); it != r->cookies.end(); ++it)
+            setfield(L, it->first.c_str(), it->second.c_str());
+        lua_setreadonly(L, -1, true);
+        break;
+    case CprResponse_certInfo:
+        if (r->certInfo.size() > INT_MAX)
+            luaL_error(L, "data is larger than INT_MAX");
+
+        lua_createtable(L, int(r->certInfo.size()), 0);
+        for (size_t i = 0; i < r->certInfo.size(); ++i)
+        {
+            lua_pushlstring(L, r->certInfo[i].data(), r->certInfo[i].size());
+            lua_rawseti(L, -2, int(i + 1));
+        }
+        lua_setreadonly(L, -1, true);
+        break;
+    default:
+        LUAU_ASSERT(!"unexpected response field");
     }
+}
 
-    lua_createtable(L, 0, csize);
-    Table* ct = hvalue(L->top - 1);
+// pushes the value of a field of the response at 'idx'
+static void pushfield(lua_State* L, int idx, int field)
+{
+    CprResponse* r = checkresponse(L, idx);
 
-    // Create a map iterator and point to beginning of map
-    cpr::Cookies::iterator it = cookies.begin();
-    // Iterate over the map using Iterator till end.
-    while (it != cookies.end())
+    // numbers are cheaper to push than to look up
+    switch (field)
     {
-        // Accessing KEY from element pointed by it.
-        std::string k = it->first;
-        // Accessing VALUE from element pointed by it.
-        std::string v = it->second;
-        // Add to cookie table
-        setfield(L, k.c_str(), v.c_str());
-        // Increment the Iterator to point to next entry
-        it++;
+    case CprResponse_redirects:
+        lua_pushnumber(L, double(r->redirect_count));
+        return;
+    case CprResponse_downloaded:
+        lua_pushnumber(L, double(r->downloaded_bytes));
+        return;
+    case CprResponse_uploaded:
+        lua_pushnumber(L, double(r->uploaded_bytes));
+        return;
+    case CprResponse_elapsed:
+        lua_pushnumber(L, r->elapsed);
+        return;
     }
-    ct->readonly = true;
-    lua_setfield(L, -2, "cookies");
 
-    std::vector<std::string> certInfo = response->GetCertInfo();
-    size_t data = certInfo.size();
-    if ( data > INT_MAX )
+    lua_getfield(L, LUA_REGISTRYINDEX, CPR_RESPONSE_CACHE);
+    lua_pushvalue(L, idx);
+    lua_rawget(L, -2);
+
+    if (lua_isnil(L, -1))
     {
-        luaL_error(L, "data is larger than INT_MAX");
-        //throw std::overflow_error("data is larger than INT_MAX");
+        lua_pop(L, 1);
+        lua_createtable(L, 0, 2);
+        lua_pushvalue(L, idx);
+        lua_pushvalue(L, -2);
+        lua_rawset(L, -4);
     }
-    int convertData = static_cast<int>(data);
-    lua_createtable(L, convertData, 0); /* 2 = number of fields */
-    Table* t = hvalue(L->top - 1);
-    int i = 0;
-    for (const std::string& s : certInfo)
+
+    lua_rawgeti(L, -1, field + 1);
+
+    if (lua_isnil(L, -1))
     {
-        TValue* e = &t->array[i++];
-        lua_pushstring(L, s.c_str());
-        StkId v = L->top - 1;
-        setobj2t(L, e, v);
         lua_pop(L, 1);
+        convertfield(L, r, field);
+        lua_pushvalue(L, -1);
+        lua_rawseti(L, -3, field + 1);
     }
-    t->readonly = true;
-    lua_setfield(L, -2, "certInfo");
-    luaL_setmetatable(L, CPR_RESPONSE);
 
-    Table* rt = hvalue(L->top - 1);
-    rt->readonly = true;
-    return rt;
+    // leave only the value
+    lua_replace(L, -3);
+    lua_pop(L, 1);
 }
 
-static int cprrequest(lua_State* L, RequestMethod method)
+static int response_index(lua_State* L)
 {
-    cpr::Url url = getURLFromArgs(L, 1);
+    checkresponse(L, 1);
 
-    if (!lua_isnoneornil(L, 2))
+    int field = findresponsefield(L, 2);
+    if (field < 0)
+        return 0;
+
+    pushfield(L, 1, field);
+    return 1;
+}
+
+static int response_next(lua_State* L)
+{
+    checkresponse(L, 1);
+
+    int field = lua_isnil(L, 2) ? 0 : findresponsefield(L, 2) + 1;
+    if (field <= 0 && !lua_isnil(L, 2))
+        luaL_error(L, "invalid key to 'next'");
+    if (field >= CprResponse__Count)
+        return 0;
+
+    lua_pushstring(L, kCprResponseFields[field]);
+    pushfield(L, 1, field);
+    return 2;
+}
+
+static int response_iter(lua_State* L)
+{
+    checkresponse(L, 1);
+
+    lua_pushcfunction(L, response_next, "next");
+    lua_pushvalue(L, 1);
+    lua_pushnil(L);
+    return 3;
+}
+
+static int response_tostring(lua_State* L)
+{
+    lua_pushstring(L, CPR_RESPONSE);
+    return 1;
+}
+
+static const luaL_Reg response_meta[] = {
+    {"__index", response_index},
+    {"__iter", response_iter},
+    {"__tostring", response_tostring},
+    {NULL, NULL},
+};
+
+static void createmeta(lua_State* L)
+{
+    luaL_newmetatable(L, CPR_RESPONSE);
+    luaL_register(L, NULL, response_meta);
+    lua_pushliteral(L, "The metatable is locked");
+    lua_setfield(L, -2, "__metatable");
+    lua_pop(L, 1);
+
+    // converted fields live as long as their response
+    lua_newtable(L);
+    lua_createtable(L, 0, 1);
+    lua_pushliteral(L, "k");
+    lua_setfield(L, -2, "__mode");
+    lua_setmetatable(L, -2);
+    lua_setfield(L, LUA_REGISTRYINDEX, CPR_RESPONSE_CACHE);
+
+    lua_setuserdatadtor(L, LUA_CPRRESPONSETAG, response_dtor);
+}
+
+/* }====================================================== */
+
+/* {======================================================
+** Asynchronous requests
+** =======================================================*/
+
+#define CPR_QUEUE "cprQueue"
+
+// transfers run on a process-wide pool so that a yielded coroutine never ties up the VM thread
+static const int kCprMaxWorkers = 64;
+
+class CprWorkerPool
+{
+public:
+    static CprWorkerPool& instance()
+    {
+        // intentionally leaked: workers are detached and may still be finishing transfers at exit
+        static CprWorkerPool* pool = new CprWorkerPool();
+        return *pool;
+    }
+
+    void submit(std::function<void()> job)
     {
-        cpr::Header header = getHeaderFromArgs(L, 2);
-        if (!lua_isnoneornil(L, 3))
+        std::unique_lock<std::mutex> lock(mutex);
+        jobs.push_back(std::move(job));
+
+        if (jobs.size() > size_t(idle) && workers < kCprMaxWorkers)
         {
-            cpr::Body body = getBodyFromArgs(L, 3);
-            if (!lua_isnoneornil(L, 4)) // URL, Headers, Body, and CustomOptions are available
-            {
-                luaL_checktype(L, 4, LUA_TTABLE);
-                std::tuple<cpr::Timeout, cpr::Redirect, Auth, cpr::Payload, cpr::Multipart, cpr::Parameters> options = getOptionsFromArgs(L, 4);
-                cpr::Timeout timeout = std::get<cpr::Timeout>(options); // Default is no timeout
-                cpr::Redirect redirect = std::get<cpr::Redirect>(options); // Default is true
-                Auth auth = std::get<Auth>(options);
-                cpr::Payload payload = std::get<cpr::Payload>(options);
-                cpr::Multipart multipart = std::get<cpr::Multipart>(options);
-                cpr::Parameters parameters = std::get<cpr::Parameters>(options);
-                if (auth.hasBasic)
-                {
-                    cpr::Response r = Request(method, url, header, body, timeout, redirect, payload, multipart, parameters, auth.basic);
-                    pushResponse(L, &r);
-                }
-                else if (auth.hasDigest)
-                {
-                    cpr::Response r = Request(method, url, header, body, timeout, redirect, payload, multipart, parameters, auth.digest);
-                    pushResponse(L, &r);
-                }
-                else if (auth.hasNTLM)
-                {
-                    cpr::Response r = Request(method, url, header, body, timeout, redirect, payload, multipart, parameters, auth.ntlm);
-                    pushResponse(L, &r);
-                }
-                else if (auth.hasBearer)
-                {
-                    cpr::Response r = Request(method, url, header, body, timeout, redirect, payload, multipart, parameters, auth.bearer);
-                    pushResponse(L, &r);
-                }
-                else
-                {
-                    cpr::Response r = Request(method, url, header, body, timeout, redirect, payload, multipart, parameters);
-                    pushResponse(L, &r);
-                }
-            }
-            else                        // Only URL, Headers, and Body are available
-            {
-                cpr::Response r = Request(method, url, header, body);
-                pushResponse(L, &r);
-            }
+            workers++;
+            std::thread(&CprWorkerPool::run, this).detach();
         }
-        else if (!lua_isnoneornil(L, 4)) // URL, Headers, and CustomOptions are available
+        else
         {
-            luaL_checktype(L, 4, LUA_TTABLE);
-            std::tuple<cpr::Timeout, cpr::Redirect, Auth, cpr::Payload, cpr::Multipart, cpr::Parameters> options = getOptionsFromArgs(L, 4);
-            cpr::Timeout timeout = std::get<cpr::Timeout>(options); // Default is no timeout
-            cpr::Redirect redirect = std::get<cpr::Redirect>(options); // Default is true
-            Auth auth = std::get<Auth>(options);
-            cpr::Payload payload = std::get<cpr::Payload>(options);
-            cpr::Multipart multipart = std::get<cpr::Multipart>(options);
-            cpr::Parameters parameters = std::get<cpr::Parameters>(options);
-            if (auth.hasBasic)
-            {
-                cpr::Response r = Request(method, url, header, timeout, redirect, payload, multipart, parameters, auth.basic);
-                pushResponse(L, &r);
-            }
-            else if (auth.hasDigest)
-            {
-                cpr::Response r = Request(method, url, header, timeout, redirect, payload, multipart, parameters, auth.digest);
-                pushResponse(L, &r);
-            }
-            else if (auth.hasNTLM)
-            {
-                cpr::Response r = Request(method, url, header, timeout, redirect, payload, multipart, parameters, auth.ntlm);
-                pushResponse(L, &r);
-            }
-            else if (auth.hasBearer)
-            {
-                cpr::Response r = Request(method, url, header, timeout, redirect, payload, multipart, parameters, auth.bearer);
-                pushResponse(L, &r);
-            }
-            else
-            {
-                cpr::Response r = Request(method, url, header, timeout, redirect, payload, multipart, parameters);
-                pushResponse(L, &r);
-            }
+            wake.notify_one();
         }
-        else                        // Only URL and Headers are available
+    }
+
+private:
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+
+        for (;;)
         {
-            cpr::Response r = Request(method, url, header);
-            pushResponse(L, &r);
+            idle++;
+            wake.wait(lock, [this] { return !jobs.empty(); });
+            idle--;
+
+            std::function<void()> job = std::move(jobs.front());
+            jobs.pop_front();
+
+            lock.unlock();
+            job();
+            lock.lock();
         }
     }
-    else if (!lua_isnoneornil(L, 3))
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<std::function<void()>> jobs;
+    int workers = 0;
+    int idle = 0;
+};
+
+// body chunks of an async streaming transfer, handed to the VM thread one at a time
+struct CprStream
+{
+    // only touched on the VM thread
+    int sink = LUA_NOREF;
+    int error = LUA_NOREF;
+
+    std::string chunk;
+    bool full = false;      // chunk is waiting for the sink
+    bool cancelled = false; // sink failed or asked to stop
+    std::condition_variable consumed;
+};
+
+struct CprCompletion
+{
+    int thread; // registry reference to the suspended coroutine
+    std::vector<CprResult> responses;
+    bool batch; // resume with an array of responses instead of the only one
+    std::shared_ptr<CprStream> stream;
+};
+
+// finished transfers of one VM, shared with the workers so that it outlives lua_close while transfers are in flight
+struct CprQueue
+{
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::deque<CprCompletion> completed;
+    std::deque<std::shared_ptr<CprStream>> chunks;
+    int pending = 0; // submitted but not yet delivered
+    bool closed = false;
+
+    // readable while completions or chunks are waiting, so hosts can wait for them next to their own I/O (see luaL_pollfds)
+    int wakeup[2] = {-1, -1};
+    bool signalled = false;
+
+    CprQueue()
     {
-        cpr::Body body = getBodyFromArgs(L, 3);
-        if (!lua_isnoneornil(L, 4)) // URL, Body, and CustomOptions are available
+#ifndef _WIN32
+        if (pipe(wakeup) == 0)
         {
-            luaL_checktype(L, 4, LUA_TTABLE);
-            std::tuple<cpr::Timeout, cpr::Redirect, Auth, cpr::Payload, cpr::Multipart, cpr::Parameters> options = getOptionsFromArgs(L, 4);
-            cpr::Timeout timeout = std::get<cpr::Timeout>(options); // Default is no timeout
-            cpr::Redirect redirect = std::get<cpr::Redirect>(options); // Default is true
-            Auth auth = std::get<Auth>(options);
-            cpr::Payload payload = std::get<cpr::Payload>(options);
-            cpr::Multipart multipart = std::get<cpr::Multipart>(options);
-            cpr::Parameters parameters = std::get<cpr::Parameters>(options);
-            if (auth.hasBasic)
-            {
-                cpr::Response r = Request(method, url, body, timeout, redirect, payload, multipart, parameters, auth.basic);
-                pushResponse(L, &r);
-            }
-            else if (auth.hasDigest)
-            {
-                cpr::Response r = Request(method, url, body, timeout, redirect, payload, multipart, parameters, auth.digest);
-                pushResponse(L, &r);
-            }
-            else if (auth.hasNTLM)
-            {
-                cpr::Response r = Request(method, url, body, timeout, redirect, payload, multipart, parameters, auth.ntlm);
-                pushResponse(L, &r);
-            }
-            else if (auth.hasBearer)
-            {
-                cpr::Response r = Request(method, url, body, timeout, redirect, payload, multipart, parameters, auth.bearer);
-                pushResponse(L, &r);
-            }
-            else
+            for (int fd : wakeup)
             {
-                cpr::Response r = Request(method, url, body, timeout, redirect, payload, multipart, parameters);
-                pushResponse(L, &r);
+                fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+                fcntl(fd, F_SETFD, FD_CLOEXEC);
             }
         }
-        else                        // Only URL and Body are available
+        else
         {
-            cpr::Response r = Request(method, url, body);
-            pushResponse(L, &r);
+            wakeup[0] = wakeup[1] = -1;
         }
+#endif
     }
-    else if (!lua_isnoneornil(L, 4)) // URL and CustomOptions are available
+
+    ~CprQueue()
     {
-        luaL_checktype(L, 4, LUA_TTABLE);
-        std::tuple<cpr::Timeout, cpr::Redirect, Auth, cpr::Payload, cpr::Multipart, cpr::Parameters> options = getOptionsFromArgs(L, 4);
-        cpr::Timeout timeout = std::get<cpr::Timeout>(options); // Default is no timeout
-        cpr::Redirect redirect = std::get<cpr::Redirect>(options); // Default is true
-        Auth auth = std::get<Auth>(options);
-        cpr::Payload payload = std::get<cpr::Payload>(options);
-        cpr::Multipart multipart = std::get<cpr::Multipart>(options);
-        cpr::Parameters parameters = std::get<cpr::Parameters>(options);
-        if (auth.hasBasic)
-        {
-            cpr::Response r = Request(method, url, timeout, redirect, payload, multipart, parameters, auth.basic);
-            pushResponse(L, &r);
-        }
-        else if (auth.hasDigest)
+#ifndef _WIN32
+        if (wakeup[0] >= 0)
         {
-            cpr::Response r = Request(method, url, timeout, redirect, payload, multipart, parameters, auth.digest);
-            pushResponse(L, &r);
+            ::close(wakeup[0]);
+            ::close(wakeup[1]);
         }
-        else if (auth.hasNTLM)
-        {
-            cpr::Response r = Request(method, url, timeout, redirect, payload, multipart, parameters, auth.ntlm);
-            pushResponse(L, &r);
-        }
-        else if (auth.hasBearer)
+#endif
+    }
+
+    // called with the mutex held when completions or chunks are added
+    void signal()
+    {
+        ready.notify_all();
+
+#ifndef _WIN32
+        if (!signalled && wakeup[1] >= 0)
         {
-            cpr::Response r = Request(method, url, timeout, redirect, payload, multipart, parameters, auth.bearer);
-            pushResponse(L, &r);
+            char byte = 0;
+            signalled = write(wakeup[1], &byte, 1) == 1;
         }
-        else
+#endif
+    }
+
+    // called with the mutex held before the VM thread takes completions and chunks
+    void unsignal()
+    {
+#ifndef _WIN32
+        if (signalled)
         {
-            cpr::Response r = Request(method, url, timeout, redirect, payload, multipart, parameters);
-            pushResponse(L, &r);
+            char buf[16];
+            while (read(wakeup[0], buf, sizeof(buf)) > 0)
+            {
+            }
+
+            signalled = false;
         }
+#endif
     }
-    else                             // Only url is available
+
+    // called on a worker: waits until the VM thread passed the chunk to the sink, so at most one chunk per transfer is buffered
+    bool feed(const std::shared_ptr<CprStream>& stream, std::string data)
     {
-        cpr::Response r = Request(method, url);
-        pushResponse(L, &r);
+        std::unique_lock<std::mutex> lock(mutex);
+        if (closed || stream->cancelled)
+            return false;
+
+        stream->chunk = std::move(data);
+        stream->full = true;
+        chunks.push_back(stream);
+        signal();
+
+        stream->consumed.wait(lock, [&stream] {
+            return !stream->full;
+        });
+
+        return !stream->cancelled;
     }
 
-    return 1;
-}
+    // called when the VM goes away: transfers blocked on their sink are cancelled
+    void close()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        closed = true;
 
-static int cprrequest(lua_State* L)
+        for (size_t i = 0; i < chunks.size(); ++i)
+        {
+            chunks[i]->cancelled = true;
+            chunks[i]->full = false;
+            chunks[i]->consumed.notify_all();
+        }
+
+        chunks.clear();
+    }
+};
+
+// passes one chunk to the sink; returns false to stop the transfer, keeping a reference to the error if the sink failed
+static bool feedsink(lua_State* L, int sink, const std::string& data, int& error)
 {
-    std::string m = luaL_checklstring(L, (1), NULL);
-    lua_remove(L, 1);
-    if (requestMap[m] == RequestMethod::None){
-        luaL_error(L, "invalid request method (got \"%s\")", m.c_str());
-        return 0;
+    lua_getref(L, sink);
+    lua_pushlstring(L, data.data(), data.size());
+
+    // errors must not unwind through libcurl
+    if (lua_pcall(L, 1, 1, 0) != 0)
+    {
+        error = lua_ref(L, -1);
+        lua_pop(L, 1);
+        return false;
     }
-    return cprrequest(L, requestMap[m]);
+
+    // the sink returns false to cancel the transfer
+    bool keep = !(lua_isboolean(L, -1) && !lua_toboolean(L, -1));
+    lua_pop(L, 1);
+    return keep;
 }
 
-static int cprget(lua_State* L)
+static void addtasksource(lua_State* L, const std::shared_ptr<CprQueue>& queue);
+
+static std::shared_ptr<CprQueue> createqueue(lua_State* L)
 {
-    return cprrequest(L, RequestMethod::Get);
+    void* ud = lua_newuserdatadtor(L, sizeof(std::shared_ptr<CprQueue>), [](void* ud) {
+        std::shared_ptr<CprQueue>* queue = (std::shared_ptr<CprQueue>*)ud;
+        (*queue)->close();
+        queue->~shared_ptr();
+    });
+    std::shared_ptr<CprQueue> queue = std::make_shared<CprQueue>();
+    new (ud) std::shared_ptr<CprQueue>(queue);
+    lua_setfield(L, LUA_REGISTRYINDEX, CPR_QUEUE);
+
+    addtasksource(L, queue);
+    return queue;
 }
 
-static int cprpost(lua_State* L)
+// heap snapshots leave the queue out, so states restored from one create it on first use
+static std::shared_ptr<CprQueue> getqueue(lua_State* L)
 {
-    return cprrequest(L, RequestMethod::Post);
+    lua_getfield(L, LUA_REGISTRYINDEX, CPR_QUEUE);
+    std::shared_ptr<CprQueue>* queue = (std::shared_ptr<CprQueue>*)lua_touserdata(L, -1);
+    lua_pop(L, 1);
+    return queue ? *queue : createqueue(L);
 }
 
-static int cprdelete(lua_State* L)
+// registers the running coroutine as waiting for one completion; it's only referenced from the registry until then
+static int suspendthread(lua_State* L, CprQueue& queue)
 {
-    return cprrequest(L, RequestMethod::Delete);
+    if (!lua_isyieldable(L))
+        luaL_error(L, "attempt to yield across metamethod/C-call boundary");
+
+    lua_pushthread(L);
+    int thread = lua_ref(L, -1);
+    lua_pop(L, 1);
+
+    std::unique_lock<std::mutex> lock(queue.mutex);
+    queue.pending++;
+
+    return thread;
+}
+
+static void completethread(CprQueue& queue, int thread, std::vector<CprResult> responses, bool batch,
+    std::shared_ptr<CprStream> stream = std::shared_ptr<CprStream>())
+{
+    CprCompletion completion = {thread, std::move(responses), batch, std::move(stream)};
+
+    std::unique_lock<std::mutex> lock(queue.mutex);
+    queue.completed.push_back(std::move(completion));
+    queue.signal();
+}
+
+static int startasync(lua_State* L, CprRequest& request)
+{
+    // suspendthread raises the error, release the sink first
+    if (!lua_isyieldable(L) && request.stream != LUA_NOREF)
+        lua_unref(L, request.stream);
+
+    std::shared_ptr<CprQueue> queue = getqueue(L);
+    int thread = suspendthread(L, *queue);
+
+    std::shared_ptr<CprStream> stream;
+
+    if (request.stream != LUA_NOREF)
+    {
+        stream = std::make_shared<CprStream>();
+        stream->sink = request.stream;
+
+        request.write = cpr::WriteCallback([queue, stream](std::string data, intptr_t) {
+            return queue->feed(stream, std::move(data));
+        });
+        request.hasWrite = true;
+    }
+
+    CprWorkerPool::instance().submit([queue, thread, request, stream]() {
+        std::vector<CprResult> responses;
+        responses.push_back(performRequest(request));
+
+        completethread(*queue, thread, std::move(responses), false, stream);
+    });
+
+    return lua_yield(L, 0);
+}
+
+static void pushResponses(lua_State* L, std::vector<CprResult>& responses)
+{
+    lua_createtable(L, int(responses.size()), 0);
+
+    for (size_t i = 0; i < responses.size(); ++i)
+    {
+        pushResponse(L, &responses[i]);
+        lua_rawseti(L, -2, int(i + 1));
+    }
+}
+
+// resumes the coroutines whose transfers finished, waiting up to 'timeout' seconds for the first one and stopping after 'budget' of them
+static int drainqueue(lua_State* L, std::shared_ptr<CprQueue> queue, double timeout, int budget)
+{
+    int resumed = 0;
+
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    queue->unsignal();
+
+    if (queue->completed.empty() && queue->chunks.empty() && queue->pending > 0 && timeout > 0)
+        queue->ready.wait_for(lock, std::chrono::duration<double>(timeout), [&queue] {
+            return !queue->completed.empty() || !queue->chunks.empty();
+        });
+
+    while ((!queue->completed.empty() || !queue->chunks.empty()) && resumed < budget)
+    {
+        if (!queue->chunks.empty())
+        {
+            std::shared_ptr<CprStream> stream = queue->chunks.front();
+            queue->chunks.pop_front();
+
+            std::string data = std::move(stream->chunk);
+
+            lock.unlock();
+            bool keep = feedsink(L, stream->sink, data, stream->error);
+            lock.lock();
+
+            stream->cancelled = !keep;
+            stream->full = false;
+            stream->consumed.notify_all();
+            continue;
+        }
+
+        CprCompletion completion = std::move(queue->completed.front());
+        queue->completed.pop_front();
+        queue->pending--;
+
+        lock.unlock();
+
+        lua_getref(L, completion.thread);
+        lua_unref(L, completion.thread);
+        lua_State* co = lua_tothread(L, -1);
+
+        int error = LUA_NOREF;
+        if (completion.stream)
+        {
+            lua_unref(L, completion.stream->sink);
+            error = completion.stream->error;
+        }
+
+        // a coroutine that was resumed by someone else in the meantime no longer expects the response
+        if (lua_status(co) == LUA_YIELD)
+        {
+            int status;
+
+            // the sink's error is raised in the coroutine, as it would be for a synchronous request
+            if (error != LUA_NOREF)
+            {
+                lua_getref(L, error);
+                lua_xmove(L, co, 1);
+                status = lua_resumeerror(co, L);
+            }
+            else
+            {
+                if (completion.batch)
+                    pushResponses(co, completion.responses);
+                else
+                    pushResponse(co, &completion.responses[0]);
+
+                status = lua_resume(co, L, 1);
+            }
+
+            if (status != LUA_OK && status != LUA_YIELD && status != LUA_BREAK)
+            {
+                lock.lock();
+                if (!queue->completed.empty() || !queue->chunks.empty())
+                    queue->signal();
+                lock.unlock();
+
+                lua_xmove(co, L, 1);
+                lua_error(L);
+            }
+
+            // nobody receives the results of the coroutine, or the values it yielded
+            lua_settop(co, 0);
+
+            resumed++;
+        }
+
+        if (error != LUA_NOREF)
+            lua_unref(L, error);
+
+        lua_pop(L, 1);
+
+        lock.lock();
+    }
+
+    // whatever is left over keeps the descriptor readable
+    if (!queue->completed.empty() || !queue->chunks.empty())
+        queue->signal();
+
+    return resumed;
+}
+
+static int pendingcount(lua_State* L)
+{
+    std::shared_ptr<CprQueue> queue = getqueue(L);
+
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    return queue->pending;
+}
+
+static int cprpoll(lua_State* L)
+{
+    double timeout = luaL_optnumber(L, 1, 0);
+    luaL_argcheck(L, timeout >= 0, 1, "timeout must be non-negative");
+
+    lua_pushinteger(L, drainqueue(L, getqueue(L), timeout, INT_MAX));
+    return 1;
+}
+
+static int cprpending(lua_State* L)
+{
+    lua_pushinteger(L, pendingcount(L));
+    return 1;
+}
+
+static int pollqueue(lua_State* L, int budget)
+{
+    return drainqueue(L, getqueue(L), 0, budget);
+}
+
+// async requests are resumed by the task scheduler's event loop too
+static void addtasksource(lua_State* L, const std::shared_ptr<CprQueue>& queue)
+{
+    luaL_TaskSource source = {queue->wakeup[0], pollqueue, pendingcount};
+    luaL_addtasksource(L, &source);
+}
+
+/* }====================================================== */
+
+/* {======================================================
+** Batches
+** =======================================================*/
+
+// requests of one cpr.batch call; each worker keeps taking the next unstarted request until none are left
+struct CprBatch
+{
+    std::vector<CprRequest> requests;
+    std::vector<CprResult> responses;
+
+    std::mutex mutex;
+    size_t next = 0;
+    size_t remaining = 0;
+
+    // async batches deliver the responses through the VM queue instead of waking the caller
+    std::shared_ptr<CprQueue> queue;
+    int thread = LUA_NOREF;
+};
+
+static void runbatch(const std::shared_ptr<CprBatch>& batch)
+{
+    for (;;)
+    {
+        size_t index;
+
+        {
+            std::unique_lock<std::mutex> lock(batch->mutex);
+            if (batch->next == batch->requests.size())
+                return;
+
+            index = batch->next++;
+        }
+
+        CprResult result = performRequest(batch->requests[index]);
+
+        std::unique_lock<std::mutex> lock(batch->mutex);
+        batch->responses[index] = std::move(result);
+
+        if (--batch->remaining == 0 && batch->queue)
+            completethread(*batch->queue, batch->thread, std::move(batch->responses), true);
+    }
+}
+
+static int cprbatch(lua_State* L)
+{
+    luaL_checktype(L, 1, LUA_TTABLE);
+
+    int concurrency = kCprMaxWorkers;
+    bool async = false;
+
+    if (!lua_isnoneornil(L, 2))
+    {
+        luaL_checktype(L, 2, LUA_TTABLE);
+
+        lua_rawgetfield(L, 2, "concurrency");
+        if (!lua_isnil(L, -1))
+        {
+            int isnum;
+            concurrency = lua_tointegerx(L, -1, &isnum);
+            if (!isnum || concurrency < 1)
+                table_arg_error(L, "concurrency", "out of range");
+        }
+        lua_pop(L, 1);
+
+        lua_rawgetfield(L, 2, "async");
+        async = lua_toboolean(L, -1) != 0;
+        lua_pop(L, 1);
+    }
+
+    std::shared_ptr<CprBatch> batch = std::make_shared<CprBatch>();
+
+    int n = lua_objlen(L, 1);
+    batch->requests.resize(n);
+    batch->responses.resize(n);
+    batch->remaining = n;
+
+    // each entry is {method, url, headers, body, options}
+    for (int i = 0; i < n; ++i)
+    {
+        lua_rawgeti(L, 1, i + 1);
+        checktablefortable(L, -1, "batch request");
+
+        int entry = lua_gettop(L);
+        for (int field = 1; field <= 5; ++field)
+            lua_rawgeti(L, entry, field);
+
+        CprRequest& request = batch->requests[i];
+
+        std::string m = checktableforstring(L, entry + 1, "request method");
+        request.method = findRequestMethod(m);
+        if (request.method == RequestMethod::None)
+            luaL_error(L, "invalid request method (got \"%s\")", m.c_str());
+
+        request.url = getURLFromArgs(L, entry + 2);
+
+        if (!lua_isnil(L, entry + 3))
+        {
+            request.header = getHeaderFromArgs(L, entry + 3);
+            request.hasHeader = true;
+        }
+
+        if (!lua_isnil(L, entry + 4))
+        {
+            request.body = getBodyFromArgs(L, entry + 4);
+            request.hasBody = true;
+        }
+
+        if (!lua_isnil(L, entry + 5))
+            getOptionsFromArgs(L, entry + 5, request);
+
+        // sinks run on the VM thread, which is busy waiting for the batch
+        if (request.stream != LUA_NOREF)
+        {
+            lua_unref(L, request.stream);
+            request.stream = LUA_NOREF;
+            luaL_error(L, "stream is not supported in batch requests");
+        }
+
+        // the batch as a whole decides whether the caller is suspended
+        request.async = false;
+
+        lua_settop(L, entry - 1);
+    }
+
+    if (n == 0)
+    {
+        lua_createtable(L, 0, 0);
+        return 1;
+    }
+
+    if (async)
+    {
+        batch->queue = getqueue(L);
+        batch->thread = suspendthread(L, *batch->queue);
+    }
+
+    if (async)
+    {
+        for (int i = 0; i < concurrency && i < n; ++i)
+            CprWorkerPool::instance().submit([batch]() {
+                runbatch(batch);
+            });
+
+        return lua_yield(L, 0);
+    }
+
+    // the caller blocks until the batch is done, so it doesn't use the shared pool: its workers may all be held by streaming transfers
+    // of this VM, which wait for this thread to take their chunks
+    std::vector<std::thread> threads;
+
+    try
+    {
+        for (int i = 0; i < concurrency && i < n; ++i)
+            threads.push_back(std::thread(runbatch, batch));
+    }
+    catch (std::system_error&)
+    {
+        // out of threads; the caller takes the requests that no thread picked up
+        runbatch(batch);
+    }
+
+    for (std::thread& thread : threads)
+        thread.join();
+
+    pushResponses(L, batch->responses);
+    return 1;
+}
+
+/* }====================================================== */
+
+static int sendrequest(lua_State* L, CprRequest& request)
+{
+    if (request.async)
+        return startasync(L, request);
+
+    int error = LUA_NOREF;
+
+    // the transfer runs on this thread, so chunks go straight to the sink
+    if (request.stream != LUA_NOREF)
+    {
+        int sink = request.stream;
+
+        request.write = cpr::WriteCallback([L, sink, &error](std::string data, intptr_t) {
+            return feedsink(L, sink, data, error);
+        });
+        request.hasWrite = true;
+    }
+
+    CprResult r = performRequest(request);
+
+    if (request.stream != LUA_NOREF)
+        lua_unref(L, request.stream);
+
+    if (error != LUA_NOREF)
+    {
+        lua_getref(L, error);
+        lua_unref(L, error);
+        lua_error(L);
+    }
+
+    pushResponse(L, &r);
+    return 1;
+}
+
+static int cprrequest(lua_State* L, RequestMethod method)
+{
+    CprRequest request;
+    request.method = method;
+    request.url = getURLFromArgs(L, 1);
+
+    if (!lua_isnoneornil(L, 2))
+    {
+        request.header = getHeaderFromArgs(L, 2);
+        request.hasHeader = true;
+    }
+
+    if (!lua_isnoneornil(L, 3))
+    {
+        request.body = getBodyFromArgs(L, 3);
+        request.hasBody = true;
+    }
+
+    if (!lua_isnoneornil(L, 4))
+        getOptionsFromArgs(L, 4, request);
+
+    return sendrequest(L, request);
+}
+
+static int cprrequest(lua_State* L)
+{
+    std::string m = luaL_checklstring(L, (1), NULL);
+    lua_remove(L, 1);
+    RequestMethod method = findRequestMethod(m);
+    if (method == RequestMethod::None){
+        luaL_error(L, "invalid request method (got \"%s\")", m.c_str());
+        return 0;
+    }
+    return cprrequest(L, method);
+}
+
+static int cprget(lua_State* L)
+{
+    return cprrequest(L, RequestMethod::Get);
+}
+
+static int cprpost(lua_State* L)
+{
+    return cprrequest(L, RequestMethod::Post);
+}
+
+static int cprdelete(lua_State* L)
+{
+    return cprrequest(L, RequestMethod::Delete);
 }
 
 static int cprpatch(lua_State* L)
@@ -1032,31 +1910,230 @@ static int cprhead(lua_State* L)
     return cprrequest(L, RequestMethod::Head);
 }
 
-static int response_tostring (lua_State *L)
+/* {======================================================
+** Sessions
+** =======================================================*/
+
+// idle handles kept per origin unless the session options say otherwise
+static const int kCprDefaultPoolSize = 4;
+
+struct CprSession
 {
-  lua_pushstring(L, CPR_RESPONSE);
-  return 1;
+    std::string base;
+    CprRequest defaults;
+};
+
+static CprSession* checksession(lua_State* L, int idx)
+{
+    return (CprSession*)luaL_checkudata(L, idx, CPR_SESSION);
 }
 
-static const luaL_Reg response_meta[] = {
-  {"__tostring", response_tostring},
-  {NULL, NULL},
+static std::string joinurl(const std::string& base, const std::string& path)
+{
+    if (path.empty() || path.find("://") != std::string::npos)
+        return path.empty() ? base : path;
+
+    bool baseslash = !base.empty() && base.back() == '/';
+    bool pathslash = path[0] == '/';
+
+    if (baseslash && pathslash)
+        return base + path.substr(1);
+    else if (baseslash || pathslash || path[0] == '?')
+        return base + path;
+    else
+        return base + "/" + path;
+}
+
+static bool hasauth(const Auth& auth)
+{
+    return auth.hasBasic || auth.hasDigest || auth.hasNTLM || auth.hasBearer;
+}
+
+static int cprsession(lua_State* L)
+{
+    size_t basel;
+    const char* base = luaL_checklstring(L, 1, &basel);
+
+    // every request on a pooled handle sets all of these, so nothing leaks from the previous request
+    CprRequest defaults;
+    defaults.hasHeader = true;
+    defaults.hasOptions = true;
+    defaults.hasParameters = true;
+
+    int limit = kCprDefaultPoolSize;
+
+    if (!lua_isnoneornil(L, 2))
+    {
+        getOptionsFromArgs(L, 2, defaults);
+
+        // post data and sinks are per request
+        defaults.hasPayload = false;
+        defaults.hasMultipart = false;
+
+        if (defaults.stream != LUA_NOREF)
+        {
+            lua_unref(L, defaults.stream);
+            defaults.stream = LUA_NOREF;
+        }
+
+        lua_rawgetfield(L, 2, "headers");
+        if (!lua_isnil(L, -1))
+            defaults.header = getHeaderFromArgs(L, -1);
+        lua_pop(L, 1);
+
+        lua_rawgetfield(L, 2, "poolSize");
+        if (!lua_isnil(L, -1))
+        {
+            int isnum;
+            limit = lua_tointegerx(L, -1, &isnum);
+            if (!isnum || limit < 0)
+                table_arg_error(L, "pool size", "out of range");
+        }
+        lua_pop(L, 1);
+    }
+
+    void* ud = lua_newuserdatadtor(L, sizeof(CprSession), [](void* ud) {
+        ((CprSession*)ud)->~CprSession();
+    });
+    CprSession* session = new (ud) CprSession();
+    session->base.assign(base, basel);
+    session->defaults = defaults;
+    session->defaults.pool = std::make_shared<CprPool>(size_t(limit));
+
+    luaL_setmetatable(L, CPR_SESSION);
+    return 1;
+}
+
+static int sessionsend(lua_State* L, RequestMethod method)
+{
+    CprSession* session = checksession(L, 1);
+
+    size_t pathl;
+    const char* path = luaL_optlstring(L, 2, "", &pathl);
+
+    CprRequest request = session->defaults;
+    request.method = method;
+    request.url = cpr::Url(joinurl(session->base, std::string(path, pathl)));
+
+    // credentials of the request replace the session's instead of being merged with them, see below
+    request.auth = Auth();
+
+    if (!lua_isnoneornil(L, 3))
+    {
+        cpr::Header header = getHeaderFromArgs(L, 3);
+        for (cpr::Header::iterator it = header.begin(); it != header.end(); ++it)
+            request.header[it->first] = it->second;
+    }
+
+    if (!lua_isnoneornil(L, 4))
+    {
+        request.body = getBodyFromArgs(L, 4);
+        request.hasBody = true;
+    }
+
+    if (!lua_isnoneornil(L, 5))
+    {
+        getOptionsFromArgs(L, 5, request);
+
+        // a handle remembers credentials, forms and sinks, so requests that set their own get a handle of their own
+        if (request.hasMultipart || request.stream != LUA_NOREF || hasauth(request.auth))
+            request.reusable = false;
+    }
+
+    if (!hasauth(request.auth))
+        request.auth = session->defaults.auth;
+
+    return sendrequest(L, request);
+}
+
+static int session_request(lua_State* L)
+{
+    std::string m = luaL_checklstring(L, 2, NULL);
+    lua_remove(L, 2);
+    RequestMethod method = findRequestMethod(m);
+    if (method == RequestMethod::None)
+        luaL_error(L, "invalid request method (got \"%s\")", m.c_str());
+    return sessionsend(L, method);
+}
+
+static int session_get(lua_State* L)
+{
+    return sessionsend(L, RequestMethod::Get);
+}
+
+static int session_post(lua_State* L)
+{
+    return sessionsend(L, RequestMethod::Post);
+}
+
+static int session_patch(lua_State* L)
+{
+    return sessionsend(L, RequestMethod::Patch);
+}
+
+static int session_put(lua_State* L)
+{
+    return sessionsend(L, RequestMethod::Put);
+}
+
+static int session_delete(lua_State* L)
+{
+    return sessionsend(L, RequestMethod::Delete);
+}
+
+static int session_options(lua_State* L)
+{
+    return sessionsend(L, RequestMethod::Options);
+}
+
+static int session_head(lua_State* L)
+{
+    return sessionsend(L, RequestMethod::Head);
+}
+
+// drops idle connections; the session stays usable and reconnects on demand
+static int session_close(lua_State* L)
+{
+    CprSession* session = checksession(L, 1);
+    session->defaults.pool->clear();
+    return 0;
+}
+
+static int session_tostring(lua_State* L)
+{
+    lua_pushstring(L, CPR_SESSION);
+    return 1;
+}
+
+static const luaL_Reg session_methods[] = {
+    {"request", session_request},
+    {"get", session_get},
+    {"post", session_post},
+    {"patch", session_patch},
+    {"put", session_put},
+    {"delete", session_delete},
+    {"options", session_options},
+    {"head", session_head},
+    {"close", session_close},
+    {NULL, NULL},
 };
 
+static void createsessionmeta(lua_State* L)
+{
+    luaL_newmetatable(L, CPR_SESSION);
 
-static void createmeta (lua_State *L) {
-  luaL_newmetatable(L, CPR_RESPONSE);  /* metatable for cpr responses */
-  luaL_register(L, NULL, response_meta);    /* fill metatable */
-  lua_pushliteral(L, "__index");
-  lua_pushvalue(L, -3);               /* dup methods table*/
-  lua_rawset(L, -3);                  /* metatable.__index = methods */
-  lua_pushliteral(L, "__metatable");
-  lua_pushvalue(L, -3);               /* dup methods table*/
-  lua_rawset(L, -3);                  /* hide metatable: metatable.__metatable = methods */
-  lua_pop(L, 1);                      /* drop metatable */
-  lua_pop(L, 1);  /* pop metatable */
+    lua_createtable(L, 0, sizeof(session_methods) / sizeof(session_methods[0]) - 1);
+    luaL_register(L, NULL, session_methods);
+    lua_setfield(L, -2, "__index");
+
+    lua_pushcfunction(L, session_tostring, "__tostring");
+    lua_setfield(L, -2, "__tostring");
+
+    lua_pop(L, 1);
 }
 
+/* }====================================================== */
+
 static const luaL_Reg funcs[] = {
   {"request", cprrequest},
   {"get", cprget},
@@ -1066,6 +2143,10 @@ static const luaL_Reg funcs[] = {
   {"delete", cprdelete},
   {"options", cproptions},
   {"head", cprhead},
+  {"poll", cprpoll},
+  {"pending", cprpending},
+  {"session", cprsession},
+  {"batch", cprbatch},
   {NULL, NULL},
 };
 
@@ -1080,6 +2161,8 @@ LUALIB_API int luaopen_cpr(lua_State* L)
 //   lua_pop(L, 1);                      /* drop response */
 
   createmeta(L);
+  createsessionmeta(L);
+  createqueue(L);
 
   return 1;
 }
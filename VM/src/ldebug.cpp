@@ -302,7 +302,8 @@ void luaG_pusherror(lua_State* L, const char* error)
 
 void luaG_breakpoint(lua_State* L, Proto* p, int line, bool enable)
 {
-    if (p->lineinfo)
+    // instructions of shared modules are read-only; breakpoints would leak into every state that loaded the module
+    if (p->lineinfo && !p->module)
     {
         for (int i = 0; i < p->sizecode; ++i)
         {
@@ -367,6 +368,24 @@ void lua_singlestep(lua_State* L, int enabled)
     L->singlestep = bool(enabled);
 }
 
+int lua_getopcode(lua_State* L, int level)
+{
+    if (unsigned(level) >= unsigned(L->ci - L->base_ci))
+        return -1;
+
+    CallInfo* ci = L->ci - level;
+    if (!isLua(ci))
+        return -1;
+
+    Proto* p = ci_func(ci)->l.p;
+    int pc = currentpc(L, ci);
+    if (pc < 0)
+        return -1;
+
+    // breakpoints replace the opcode in code[]; debuginsn has the original one
+    return p->debuginsn ? p->debuginsn[pc] : LUAU_INSN_OP(p->code[pc]);
+}
+
 void lua_breakpoint(lua_State* L, int funcindex, int line, int enabled)
 {
     const TValue* func = luaA_toobject(L, funcindex);
@@ -31,6 +31,10 @@ Proto* luaF_newproto(lua_State* L)
     f->source = NULL;
     f->debugname = NULL;
     f->debuginsn = NULL;
+    f->module = NULL;
+    f->execdata = NULL;
+    f->hotcount = L->global->ecb.hotthreshold;
+    f->codereadonly = 0;
     return f;
 }
 
@@ -155,15 +159,25 @@ void luaF_close(lua_State* L, StkId level)
 
 void luaF_freeproto(lua_State* L, Proto* f, lua_Page* page)
 {
-    luaM_freearray(L, f->code, f->sizecode, Instruction, f->memcat);
+    if (f->module)
+    {
+        luau_releasemodule(f->module);
+    }
+    else
+    {
+        luaM_freearray(L, f->code, f->sizecode, Instruction, f->memcat);
+        if (f->lineinfo)
+            luaM_freearray(L, f->lineinfo, f->sizelineinfo, uint8_t, f->memcat);
+    }
+
     luaM_freearray(L, f->p, f->sizep, Proto*, f->memcat);
     luaM_freearray(L, f->k, f->sizek, TValue, f->memcat);
-    if (f->lineinfo)
-        luaM_freearray(L, f->lineinfo, f->sizelineinfo, uint8_t, f->memcat);
     luaM_freearray(L, f->locvars, f->sizelocvars, struct LocVar, f->memcat);
     luaM_freearray(L, f->upvalues, f->sizeupvalues, TString*, f->memcat);
     if (f->debuginsn)
         luaM_freearray(L, f->debuginsn, f->sizecode, uint8_t, f->memcat);
+    if (f->execdata)
+        L->global->ecb.destroy(L, f);
     luaM_freegco(L, f, sizeof(Proto), f->memcat, page);
 }
 
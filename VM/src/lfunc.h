@@ -7,6 +7,11 @@
 #define sizeCclosure(n) (offsetof(Closure, c.upvals) + sizeof(TValue) * (n))
 #define sizeLclosure(n) (offsetof(Closure, l.uprefs) + sizeof(TValue) * (n))
 
+/* memory owned by the proto; code and line info of protos loaded from shared modules belong to the module */
+#define sizeproto(p) \
+    (sizeof(Proto) + ((p)->module ? 0 : sizeof(Instruction) * (p)->sizecode + (p)->sizelineinfo) + sizeof(Proto*) * (p)->sizep + \
+        sizeof(TValue) * (p)->sizek + sizeof(LocVar) * (p)->sizelocvars + sizeof(TString*) * (p)->sizeupvalues)
+
 LUAI_FUNC Proto* luaF_newproto(lua_State* L);
 LUAI_FUNC Closure* luaF_newLclosure(lua_State* L, int nelems, Table* e, Proto* p);
 LUAI_FUNC Closure* luaF_newCclosure(lua_State* L, int nelems, Table* e);
@@ -417,8 +417,7 @@ static void dumpthread(FILE* f, lua_State* th)
 
 static void dumpproto(FILE* f, Proto* p)
 {
-    size_t size = sizeof(Proto) + sizeof(Instruction) * p->sizecode + sizeof(Proto*) * p->sizep + sizeof(TValue) * p->sizek + p->sizelineinfo +
-                  sizeof(LocVar) * p->sizelocvars + sizeof(TString*) * p->sizeupvalues;
+    size_t size = sizeproto(p);
 
     fprintf(f, "{\"type\":\"proto\",\"cat\":%d,\"size\":%d", p->memcat, int(size));
 
@@ -17,6 +17,9 @@ static const luaL_Reg lualibs[] = {
     {LUA_CPRLIBNAME, luaopen_cpr},
     {LUA_JSONLIBNAME, luaopen_json},
     {LUA_BASE64LIBNAME, luaopen_base64},
+    {LUA_TASKLIBNAME, luaopen_task},
+    {LUA_SERIALIZELIBNAME, luaopen_serialize},
+    {LUA_WORKERLIBNAME, luaopen_worker},
     {NULL, NULL},
 };
 
@@ -281,6 +281,10 @@ typedef struct Proto
     TString* debugname;
     uint8_t* debuginsn; // a copy of code[] array with just opcodes
 
+    struct luau_Module* module; // shared image that owns code[] and lineinfo[], if any; see luau_loadmodule
+    void* execdata;             // native code for the function, owned by lua_ExecutionCallbacks
+    unsigned int hotcount;      // calls and loop iterations left until the function is reported to lua_ExecutionCallbacks::hot
+
     GCObject* gclist;
 
 
@@ -298,6 +302,7 @@ typedef struct Proto
     uint8_t numparams;
     uint8_t is_vararg;
     uint8_t maxstacksize;
+    uint8_t codereadonly; /* code[] is shared through a module image, so slot hints are not patched */
 } Proto;
 // clang-format on
 
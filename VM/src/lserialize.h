@@ -0,0 +1,12 @@
+// This file is part of the Luau programming language and is licensed under MIT License; see LICENSE.txt for details
+#pragma once
+
+#include "lobject.h"
+
+#include <string>
+
+/* appends the values in stack slots [first, last] to 'out' in the structured clone format (see lserializelib.cpp) */
+LUAI_FUNC void luaU_serialize(lua_State* L, int first, int last, std::string& out);
+
+/* pushes the values of a message; returns their count. malformed data raises an error */
+LUAI_FUNC int luaU_deserialize(lua_State* L, const char* data, size_t size);
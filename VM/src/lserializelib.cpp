@@ -0,0 +1,508 @@
+// This file is part of the Luau programming language and is licensed under MIT License; see LICENSE.txt for details
+#include "lualib.h"
+
+#include "lserialize.h"
+
+#include "lapi.h"
+#include "ldo.h"
+#include "lgc.h"
+#include "lstate.h"
+#include "lstring.h"
+#include "ltable.h"
+#include "lnumutils.h"
+
+#include <vector>
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+// Structured clone format: a varint count followed by that many values, each starting with a tag byte.
+//   nil, false, true      tag only
+//   integer               zigzag varint; used for numbers that are exact 32-bit integers (but not -0)
+//   number                8 byte double
+//   string                varint length and bytes; each string gets the next string id
+//   string reference      varint id of a string written before
+//   vector                LUA_VECTOR_SIZE floats
+//   table                 varint array size, varint hash size, the array values, then the hash keys and values; each table gets the next
+//                         table id before its contents are written, so contents can refer back to it
+//   table reference       varint id of a table written before
+// Tables are walked through their array and node parts directly. Metatables are not preserved.
+// Multi-byte values are stored in host byte order, so messages are meant for caches and processes on the same machine.
+
+enum SerializeTag
+{
+    Serialize_Nil,
+    Serialize_False,
+    Serialize_True,
+    Serialize_Integer,
+    Serialize_Number,
+    Serialize_String,
+    Serialize_StringRef,
+    Serialize_Vector,
+    Serialize_Table,
+    Serialize_TableRef,
+};
+
+// nesting depth of tables; cycles and shared tables are written as references and don't count
+static const int kSerializeMaxDepth = 1000;
+
+/* {======================================================
+** Writer
+** =======================================================*/
+
+// Open addressing map from objects to the ids they were written with; every string and table is looked up once, so this needs to be cheap
+class SerializeIds
+{
+public:
+    SerializeIds()
+        : count(0)
+    {
+    }
+
+    // returns the id of 'object', or assigns it the next id and returns ~0u if it wasn't seen before
+    unsigned insert(const void* object)
+    {
+        if (count >= slots.size() / 2)
+            grow();
+
+        size_t mask = slots.size() - 1;
+
+        for (size_t i = hash(object) & mask;; i = (i + 1) & mask)
+        {
+            if (slots[i].object == object)
+                return slots[i].id;
+
+            if (!slots[i].object)
+            {
+                slots[i].object = object;
+                slots[i].id = count++;
+                return ~0u;
+            }
+        }
+    }
+
+private:
+    struct Slot
+    {
+        const void* object;
+        unsigned id;
+    };
+
+    static size_t hash(const void* object)
+    {
+        return size_t((uintptr_t(object) >> 3) * 0x9E3779B97F4A7C15ull >> 16);
+    }
+
+    void grow()
+    {
+        std::vector<Slot> old(slots.empty() ? 64 : slots.size() * 2, Slot{nullptr, 0});
+        old.swap(slots);
+
+        size_t mask = slots.size() - 1;
+
+        for (const Slot& slot : old)
+        {
+            if (!slot.object)
+                continue;
+
+            size_t i = hash(slot.object) & mask;
+            while (slots[i].object)
+                i = (i + 1) & mask;
+
+            slots[i] = slot;
+        }
+    }
+
+    std::vector<Slot> slots;
+    unsigned count;
+};
+
+struct Serializer
+{
+    lua_State* L;
+    std::string& out;
+
+    SerializeIds strings;
+    SerializeIds tables;
+    int depth;
+};
+
+static void writevarint(std::string& out, size_t value)
+{
+    while (value >= 0x80)
+    {
+        out += char((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+
+    out += char(value);
+}
+
+static void writevalue(Serializer& S, const TValue* v);
+
+static void writetable(Serializer& S, Table* h)
+{
+    unsigned id = S.tables.insert(h);
+    if (id != ~0u)
+    {
+        S.out += char(Serialize_TableRef);
+        writevarint(S.out, id);
+        return;
+    }
+
+    if (S.depth >= kSerializeMaxDepth)
+        luaL_error(S.L, "cannot serialize a table nested more than %d levels deep", kSerializeMaxDepth);
+
+    // trailing nils of the array part are left out
+    int narray = h->sizearray;
+    while (narray > 0 && ttisnil(&h->array[narray - 1]))
+        narray--;
+
+    int nhash = 0;
+    for (int i = 0; i < sizenode(h); ++i)
+        nhash += !ttisnil(gval(gnode(h, i)));
+
+    S.out += char(Serialize_Table);
+    writevarint(S.out, narray);
+    writevarint(S.out, nhash);
+
+    S.depth++;
+
+    for (int i = 0; i < narray; ++i)
+        writevalue(S, &h->array[i]);
+
+    for (int i = 0; i < sizenode(h); ++i)
+    {
+        LuaNode* n = gnode(h, i);
+
+        if (!ttisnil(gval(n)))
+        {
+            TValue key;
+            getnodekey(S.L, &key, n);
+
+            writevalue(S, &key);
+            writevalue(S, gval(n));
+        }
+    }
+
+    S.depth--;
+}
+
+static void writevalue(Serializer& S, const TValue* v)
+{
+    switch (ttype(v))
+    {
+    case LUA_TNIL:
+        S.out += char(Serialize_Nil);
+        break;
+
+    case LUA_TBOOLEAN:
+        S.out += char(bvalue(v) ? Serialize_True : Serialize_False);
+        break;
+
+    case LUA_TNUMBER:
+    {
+        double d = nvalue(v);
+
+        if (d >= -2147483648.0 && d <= 2147483647.0 && double(int(d)) == d && !(d == 0 && signbit(d)))
+        {
+            int i = int(d);
+            S.out += char(Serialize_Integer);
+            writevarint(S.out, (uint32_t(i) << 1) ^ uint32_t(i >> 31));
+        }
+        else
+        {
+            S.out += char(Serialize_Number);
+            S.out.append((const char*)&d, sizeof(d));
+        }
+        break;
+    }
+
+    case LUA_TSTRING:
+    {
+        const TString* ts = tsvalue(v);
+
+        unsigned id = S.strings.insert(ts);
+        if (id != ~0u)
+        {
+            S.out += char(Serialize_StringRef);
+            writevarint(S.out, id);
+        }
+        else
+        {
+            S.out += char(Serialize_String);
+            writevarint(S.out, ts->len);
+            S.out.append(getstr(ts), ts->len);
+        }
+        break;
+    }
+
+    case LUA_TVECTOR:
+        S.out += char(Serialize_Vector);
+        S.out.append((const char*)vvalue(v), sizeof(float) * LUA_VECTOR_SIZE);
+        break;
+
+    case LUA_TTABLE:
+        writetable(S, hvalue(v));
+        break;
+
+    default:
+        luaL_error(S.L, "cannot serialize a value of type %s", luaT_typenames[ttype(v)]);
+    }
+}
+
+void luaU_serialize(lua_State* L, int first, int last, std::string& out)
+{
+    Serializer S = {L, out, SerializeIds(), SerializeIds(), 0};
+
+    writevarint(out, last >= first ? last - first + 1 : 0);
+
+    for (int i = first; i <= last; ++i)
+        writevalue(S, luaA_toobject(L, i));
+}
+
+/* }====================================================== */
+
+/* {======================================================
+** Reader
+** =======================================================*/
+
+struct Deserializer
+{
+    lua_State* L;
+    const char* data;
+    const char* end;
+
+    // everything decoded so far is reachable from the stack, so these don't need to be anchored separately
+    std::vector<TString*> strings;
+    std::vector<Table*> tables;
+    int depth;
+};
+
+LUAU_NOINLINE static void malformed(Deserializer& D)
+{
+    luaL_error(D.L, "malformed serialized data");
+}
+
+static size_t readvarint(Deserializer& D)
+{
+    size_t value = 0;
+
+    for (int shift = 0;; shift += 7)
+    {
+        if (D.data == D.end || shift >= 64)
+            malformed(D);
+
+        unsigned char byte = *D.data++;
+        value |= size_t(byte & 0x7f) << shift;
+
+        if ((byte & 0x80) == 0)
+            return value;
+    }
+}
+
+static void readbytes(Deserializer& D, void* target, size_t size)
+{
+    if (size_t(D.end - D.data) < size)
+        malformed(D);
+
+    memcpy(target, D.data, size);
+    D.data += size;
+}
+
+static void readvalue(Deserializer& D);
+
+static void readtable(Deserializer& D)
+{
+    lua_State* L = D.L;
+
+    size_t narray = readvarint(D);
+    size_t nhash = readvarint(D);
+
+    // every value takes at least a byte, which bounds the sizes of well-formed tables by the remaining input
+    size_t remaining = D.end - D.data;
+    if (narray > remaining || nhash > remaining / 2 || narray + nhash * 2 > remaining || D.depth >= kSerializeMaxDepth)
+        malformed(D);
+
+    luaD_checkstack(L, 3);
+
+    lua_createtable(L, int(narray), int(nhash));
+    Table* h = hvalue(L->top - 1);
+    D.tables.push_back(h);
+
+    D.depth++;
+
+    for (size_t i = 0; i < narray; ++i)
+    {
+        readvalue(D);
+
+        // lua_createtable sized the array part to exactly narray
+        setobj2t(L, &h->array[i], L->top - 1);
+        luaC_barriert(L, h, L->top - 1);
+        L->top--;
+    }
+
+    for (size_t i = 0; i < nhash; ++i)
+    {
+        readvalue(D);
+        readvalue(D);
+
+        // a dropped key could leave a decoded string unanchored
+        if (ttisnil(L->top - 2) || ttisnil(L->top - 1) || (ttisnumber(L->top - 2) && luai_numisnan(nvalue(L->top - 2))))
+            malformed(D);
+
+        TValue* slot = luaH_set(L, h, L->top - 2);
+        setobj2t(L, slot, L->top - 1);
+        luaC_barriert(L, h, L->top - 1);
+        L->top -= 2;
+    }
+
+    D.depth--;
+}
+
+static void readvalue(Deserializer& D)
+{
+    lua_State* L = D.L;
+
+    if (D.data == D.end)
+        malformed(D);
+
+    switch (*D.data++)
+    {
+    case Serialize_Nil:
+        setnilvalue(L->top);
+        L->top++;
+        break;
+
+    case Serialize_False:
+    case Serialize_True:
+        setbvalue(L->top, D.data[-1] == Serialize_True);
+        L->top++;
+        break;
+
+    case Serialize_Integer:
+    {
+        uint32_t z = uint32_t(readvarint(D));
+        setnvalue(L->top, double(int32_t((z >> 1) ^ (0u - (z & 1)))));
+        L->top++;
+        break;
+    }
+
+    case Serialize_Number:
+    {
+        double d;
+        readbytes(D, &d, sizeof(d));
+        setnvalue(L->top, d);
+        L->top++;
+        break;
+    }
+
+    case Serialize_String:
+    {
+        size_t len = readvarint(D);
+        if (size_t(D.end - D.data) < len)
+            malformed(D);
+
+        TString* ts = luaS_newlstr(L, D.data, len);
+        D.data += len;
+        D.strings.push_back(ts);
+
+        setsvalue2s(L, L->top, ts);
+        L->top++;
+        break;
+    }
+
+    case Serialize_StringRef:
+    {
+        size_t id = readvarint(D);
+        if (id >= D.strings.size())
+            malformed(D);
+
+        setsvalue2s(L, L->top, D.strings[id]);
+        L->top++;
+        break;
+    }
+
+    case Serialize_Vector:
+    {
+        float v[4] = {};
+        readbytes(D, v, sizeof(float) * LUA_VECTOR_SIZE);
+        setvvalue(L->top, v[0], v[1], v[2], v[3]);
+        L->top++;
+        break;
+    }
+
+    case Serialize_Table:
+        readtable(D);
+        break;
+
+    case Serialize_TableRef:
+    {
+        size_t id = readvarint(D);
+        if (id >= D.tables.size())
+            malformed(D);
+
+        sethvalue2s(L, L->top, D.tables[id]);
+        L->top++;
+        break;
+    }
+
+    default:
+        malformed(D);
+    }
+}
+
+int luaU_deserialize(lua_State* L, const char* data, size_t size)
+{
+    Deserializer D = {L, data, data + size, {}, {}, 0};
+
+    size_t count = readvarint(D);
+    if (count > size_t(D.end - D.data))
+        malformed(D);
+
+    luaL_checkstack(L, int(count) + 3, "too many serialized values");
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        // the array and hash parts reserve their slots in readtable; top level values need one each
+        readvalue(D);
+    }
+
+    if (D.data != D.end)
+        malformed(D);
+
+    return int(count);
+}
+
+/* }====================================================== */
+
+static int serialize_encode(lua_State* L)
+{
+    std::string out;
+    luaU_serialize(L, 1, lua_gettop(L), out);
+
+    lua_pushlstring(L, out.data(), out.size());
+    return 1;
+}
+
+static int serialize_decode(lua_State* L)
+{
+    size_t size = 0;
+    const char* data = luaL_checklstring(L, 1, &size);
+
+    return luaU_deserialize(L, data, size);
+}
+
+static const luaL_Reg serializelib[] = {
+    {"encode", serialize_encode},
+    {"decode", serialize_decode},
+    {NULL, NULL},
+};
+
+int luaopen_serialize(lua_State* L)
+{
+    luaL_register(L, LUA_SERIALIZELIBNAME, serializelib);
+
+    return 1;
+}
@@ -0,0 +1,1182 @@
+// This file is part of the Luau programming language and is licensed under MIT License; see LICENSE.txt for details
+#include "lua.h"
+
+#include "lstate.h"
+#include "ltable.h"
+#include "lfunc.h"
+#include "lstring.h"
+#include "ludata.h"
+#include "lgc.h"
+#include "lmem.h"
+#include "ldo.h"
+#include "ldebug.h"
+#include "lvm.h"
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <stdlib.h>
+#include <string.h>
+
+// A snapshot holds the objects reachable from the registry, the globals and the basic type metatables of a state. Objects are numbered by
+// kind, so a restore allocates all of them in one pass over their shapes (sizes, strings, instructions, line info, userdata bytes) and then
+// connects them in a second pass that turns ids back into pointers. Protos come before closures, so a closure can be created next to its
+// proto in the first pass.
+//
+// C functions, continuations and debug names are stored as offsets from a function in this file, so a snapshot only loads into the
+// executable that wrote it; the header carries a fingerprint of the build to catch mismatches. The fingerprint only covers the VM, so the
+// header also lists every host address the snapshot uses with a checksum of the code or the name found there, and a snapshot whose host
+// functions moved or changed is rejected before any of them can be called. Native state can't be captured: coroutines,
+// light userdata, userdata with destructors and upvalues that still point into a stack are rejected. Registry entries with string keys that
+// hold userdata with destructors, which is how libraries keep their native state (task scheduler, cpr queue, worker state), are left out and
+// the libraries create their state again on first use. Multi-byte values are stored in host byte order.
+
+enum SnapshotKind
+{
+    Snapshot_String,
+    Snapshot_Proto,
+    Snapshot_Closure,
+    Snapshot_Table,
+    Snapshot_Upval,
+    Snapshot_Userdata,
+
+    Snapshot_KindCount
+};
+
+static const char kSnapshotMagic[] = "\x1bLSN";
+static const uint8_t kSnapshotVersion = 2;
+
+// number of bytes of code at the start of a host function that its checksum covers
+static const size_t kHostCodeSize = 16;
+
+static SnapshotKind getkind(uint8_t tt)
+{
+    switch (tt)
+    {
+    case LUA_TSTRING:
+        return Snapshot_String;
+    case LUA_TPROTO:
+        return Snapshot_Proto;
+    case LUA_TFUNCTION:
+        return Snapshot_Closure;
+    case LUA_TTABLE:
+        return Snapshot_Table;
+    case LUA_TUPVAL:
+        return Snapshot_Upval;
+    case LUA_TUSERDATA:
+        return Snapshot_Userdata;
+    default:
+        LUAU_ASSERT(!"unexpected object type");
+        return Snapshot_KindCount;
+    }
+}
+
+static uintptr_t getanchor()
+{
+    return uintptr_t(&lua_loadsnapshot);
+}
+
+// offsets of functions from different parts of the VM change whenever the executable is built differently
+static uint64_t getfingerprint()
+{
+    uintptr_t anchor = getanchor();
+    uint64_t values[] = {
+        uintptr_t(&luau_execute) - anchor,
+        uintptr_t(&luau_load) - anchor,
+        uintptr_t(&luaH_new) - anchor,
+        uintptr_t(&luaS_newlstr) - anchor,
+        uintptr_t(&lua_pushcclosurek) - anchor,
+        sizeof(TValue),
+        sizeof(Instruction),
+        LUA_T_COUNT,
+        LUA_UTAG_LIMIT,
+    };
+
+    uint64_t hash = 14695981039346656037ull;
+
+    for (uint64_t value : values)
+        hash = (hash ^ value) * 1099511628211ull;
+
+    return hash;
+}
+
+static uint64_t hashbytes(const char* data, size_t size)
+{
+    uint64_t hash = 14695981039346656037ull;
+
+    for (size_t i = 0; i < size; ++i)
+        hash = (hash ^ uint8_t(data[i])) * 1099511628211ull;
+
+    return hash;
+}
+
+static bool hasdtor(global_State* g, Udata* u)
+{
+    return u->tag == UTAG_IDTOR || (u->tag < LUA_UTAG_LIMIT && g->udatagc[u->tag]);
+}
+
+/* {======================================================
+** Writer
+** =======================================================*/
+
+struct SnapshotWriter
+{
+    lua_State* L;
+    Table* registry;
+
+    std::unordered_map<GCObject*, unsigned> ids;
+    std::vector<GCObject*> objects[Snapshot_KindCount];
+    std::vector<GCObject*> pending; // objects whose references haven't been marked yet
+
+    std::unordered_map<uintptr_t, unsigned> hostids; // starting from 1; 0 stands for NULL
+    std::vector<std::pair<uintptr_t, bool>> hosts;   // address and whether it holds a name rather than code
+
+    std::string out;
+    char* result; // malloc'd copy of out
+};
+
+// registry entries that hold the native state of a library
+static bool isnativestate(SnapshotWriter& W, Table* h, const TValue* key, const TValue* value)
+{
+    return h == W.registry && ttisstring(key) && ttisuserdata(value) && hasdtor(W.L->global, uvalue(value));
+}
+
+static bool keepnode(SnapshotWriter& W, Table* h, LuaNode* n)
+{
+    if (ttisnil(gval(n)))
+        return false;
+
+    TValue key;
+    getnodekey(W.L, &key, n);
+    return !isnativestate(W, h, &key, gval(n));
+}
+
+static void markobject(SnapshotWriter& W, GCObject* o)
+{
+    if (o == obj2gco(W.L->global->mainthread))
+        return;
+
+    if (!W.ids.insert(std::make_pair(o, 0u)).second)
+        return;
+
+    switch (o->gch.tt)
+    {
+    case LUA_TTHREAD:
+        luaG_runerror(W.L, "cannot snapshot coroutines");
+
+    case LUA_TUSERDATA:
+        if (hasdtor(W.L->global, gco2u(o)))
+            luaG_runerror(W.L, "cannot snapshot userdata with destructors");
+        break;
+
+    case LUA_TUPVAL:
+        if (gco2uv(o)->v != &gco2uv(o)->u.value)
+            luaG_runerror(W.L, "cannot snapshot upvalues of running functions");
+        break;
+    }
+
+    W.objects[getkind(o->gch.tt)].push_back(o);
+    W.pending.push_back(o);
+}
+
+static void markvalue(SnapshotWriter& W, const TValue* v)
+{
+    if (ttislightuserdata(v))
+        luaG_runerror(W.L, "cannot snapshot light userdata");
+
+    if (iscollectable(v))
+        markobject(W, gcvalue(v));
+}
+
+static void markobjectopt(SnapshotWriter& W, void* o)
+{
+    if (o)
+        markobject(W, cast_to(GCObject*, o));
+}
+
+static void markhost(SnapshotWriter& W, uintptr_t address, bool name)
+{
+    if (address && W.hostids.insert(std::make_pair(address, unsigned(W.hosts.size() + 1))).second)
+        W.hosts.push_back(std::make_pair(address, name));
+}
+
+static void markreferences(SnapshotWriter& W, GCObject* o)
+{
+    switch (o->gch.tt)
+    {
+    case LUA_TSTRING:
+        break;
+
+    case LUA_TTABLE:
+    {
+        Table* h = gco2h(o);
+
+        markobjectopt(W, h->metatable);
+
+        for (int i = 0; i < h->sizearray; ++i)
+            markvalue(W, &h->array[i]);
+
+        for (int i = 0; i < sizenode(h); ++i)
+        {
+            LuaNode* n = gnode(h, i);
+
+            if (keepnode(W, h, n))
+            {
+                TValue key;
+                getnodekey(W.L, &key, n);
+                markvalue(W, &key);
+                markvalue(W, gval(n));
+            }
+        }
+        break;
+    }
+
+    case LUA_TFUNCTION:
+    {
+        Closure* cl = gco2cl(o);
+
+        markobjectopt(W, cl->env);
+
+        if (cl->isC)
+        {
+            markhost(W, uintptr_t(cl->c.f), false);
+            markhost(W, uintptr_t(cl->c.cont), false);
+            markhost(W, uintptr_t(cl->c.debugname), true);
+
+            for (int i = 0; i < cl->nupvalues; ++i)
+                markvalue(W, &cl->c.upvals[i]);
+        }
+        else
+        {
+            markobject(W, obj2gco(cl->l.p));
+
+            for (int i = 0; i < cl->nupvalues; ++i)
+                markvalue(W, &cl->l.uprefs[i]);
+        }
+        break;
+    }
+
+    case LUA_TPROTO:
+    {
+        Proto* p = gco2p(o);
+
+        for (int i = 0; i < p->sizek; ++i)
+            markvalue(W, &p->k[i]);
+
+        for (int i = 0; i < p->sizep; ++i)
+            markobject(W, obj2gco(p->p[i]));
+
+        for (int i = 0; i < p->sizelocvars; ++i)
+            markobjectopt(W, p->locvars[i].varname);
+
+        for (int i = 0; i < p->sizeupvalues; ++i)
+            markobjectopt(W, p->upvalues[i]);
+
+        markobjectopt(W, p->source);
+        markobjectopt(W, p->debugname);
+        break;
+    }
+
+    case LUA_TUPVAL:
+        markvalue(W, gco2uv(o)->v);
+        break;
+
+    case LUA_TUSERDATA:
+        markobjectopt(W, gco2u(o)->metatable);
+        break;
+
+    default:
+        LUAU_ASSERT(!"unexpected object type");
+    }
+}
+
+static void writebyte(SnapshotWriter& W, uint8_t value)
+{
+    W.out += char(value);
+}
+
+static void writevarint(SnapshotWriter& W, size_t value)
+{
+    while (value >= 0x80)
+    {
+        W.out += char((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+
+    W.out += char(value);
+}
+
+static void writeraw(SnapshotWriter& W, const void* data, size_t size)
+{
+    W.out.append(static_cast<const char*>(data), size);
+}
+
+// functions and debug names are stored relative to the anchor, with a checksum of what the host has there
+static void writehost(SnapshotWriter& W, uintptr_t address, bool name)
+{
+    const char* data = reinterpret_cast<const char*>(address);
+    size_t size = name ? strlen(data) : kHostCodeSize;
+
+    int64_t offset = int64_t(address - getanchor());
+    uint64_t checksum = hashbytes(data, size);
+
+    writebyte(W, name);
+    writeraw(W, &offset, sizeof(offset));
+    writevarint(W, size);
+    writeraw(W, &checksum, sizeof(checksum));
+}
+
+static void writeaddress(SnapshotWriter& W, uintptr_t address)
+{
+    if (address == 0)
+    {
+        writevarint(W, 0);
+        return;
+    }
+
+    std::unordered_map<uintptr_t, unsigned>::iterator it = W.hostids.find(address);
+    LUAU_ASSERT(it != W.hostids.end());
+
+    writevarint(W, it->second);
+}
+
+static void writeref(SnapshotWriter& W, GCObject* o)
+{
+    if (o == obj2gco(W.L->global->mainthread))
+    {
+        writevarint(W, 0);
+        return;
+    }
+
+    std::unordered_map<GCObject*, unsigned>::iterator it = W.ids.find(o);
+    LUAU_ASSERT(it != W.ids.end());
+
+    writevarint(W, it->second);
+}
+
+// optional references to strings and tables use id 0, which belongs to the main thread, for NULL
+static void writerefopt(SnapshotWriter& W, void* o)
+{
+    if (o)
+        writeref(W, cast_to(GCObject*, o));
+    else
+        writevarint(W, 0);
+}
+
+static void writevalue(SnapshotWriter& W, const TValue* v)
+{
+    writebyte(W, uint8_t(ttype(v)));
+
+    switch (ttype(v))
+    {
+    case LUA_TNIL:
+        break;
+
+    case LUA_TBOOLEAN:
+        writebyte(W, bvalue(v) != 0);
+        break;
+
+    case LUA_TNUMBER:
+        writeraw(W, &v->value.n, sizeof(double));
+        break;
+
+    case LUA_TVECTOR:
+        writeraw(W, vvalue(v), sizeof(float) * LUA_VECTOR_SIZE);
+        break;
+
+    default:
+        writeref(W, gcvalue(v));
+        break;
+    }
+}
+
+// everything a restore needs to allocate the object
+static void writeshape(SnapshotWriter& W, GCObject* o)
+{
+    switch (o->gch.tt)
+    {
+    case LUA_TSTRING:
+    {
+        TString* ts = gco2ts(o);
+        writevarint(W, ts->len);
+        writeraw(W, ts->data, ts->len);
+        break;
+    }
+
+    case LUA_TPROTO:
+    {
+        Proto* p = gco2p(o);
+
+        writebyte(W, p->memcat);
+        writevarint(W, p->sizecode);
+        writevarint(W, p->sizek);
+        writevarint(W, p->sizep);
+        writevarint(W, p->sizelocvars);
+        writevarint(W, p->sizeupvalues);
+        writevarint(W, p->sizelineinfo);
+        writevarint(W, p->linegaplog2);
+        writevarint(W, p->linedefined);
+        writebyte(W, p->nups);
+        writebyte(W, p->numparams);
+        writebyte(W, p->is_vararg);
+        writebyte(W, p->maxstacksize);
+
+        if (p->debuginsn)
+        {
+            // breakpoints replace opcodes in place; the original ones are kept in debuginsn
+            for (int i = 0; i < p->sizecode; ++i)
+            {
+                Instruction insn = (p->code[i] & ~0xffu) | p->debuginsn[i];
+                writeraw(W, &insn, sizeof(insn));
+            }
+        }
+        else
+        {
+            writeraw(W, p->code, sizeof(Instruction) * p->sizecode);
+        }
+
+        // abslineinfo lives in the same allocation, after lineinfo
+        writeraw(W, p->lineinfo, p->sizelineinfo);
+        break;
+    }
+
+    case LUA_TFUNCTION:
+    {
+        Closure* cl = gco2cl(o);
+
+        writebyte(W, cl->memcat);
+        writebyte(W, cl->isC);
+        writebyte(W, cl->nupvalues);
+
+        if (!cl->isC)
+            writeref(W, obj2gco(cl->l.p));
+        break;
+    }
+
+    case LUA_TTABLE:
+    {
+        Table* h = gco2h(o);
+
+        int count = 0;
+        for (int i = 0; i < sizenode(h); ++i)
+            count += keepnode(W, h, gnode(h, i));
+
+        writebyte(W, h->memcat);
+        writevarint(W, h->sizearray);
+        writevarint(W, count);
+        break;
+    }
+
+    case LUA_TUPVAL:
+        writebyte(W, gco2uv(o)->memcat);
+        break;
+
+    case LUA_TUSERDATA:
+    {
+        Udata* u = gco2u(o);
+
+        writebyte(W, u->memcat);
+        writebyte(W, u->tag);
+        writevarint(W, u->len);
+        writeraw(W, u->data, u->len);
+        break;
+    }
+
+    default:
+        LUAU_ASSERT(!"unexpected object type");
+    }
+}
+
+// references to other objects
+static void writecontents(SnapshotWriter& W, GCObject* o)
+{
+    switch (o->gch.tt)
+    {
+    case LUA_TSTRING:
+        break;
+
+    case LUA_TPROTO:
+    {
+        Proto* p = gco2p(o);
+
+        for (int i = 0; i < p->sizek; ++i)
+            writevalue(W, &p->k[i]);
+
+        for (int i = 0; i < p->sizep; ++i)
+            writeref(W, obj2gco(p->p[i]));
+
+        for (int i = 0; i < p->sizelocvars; ++i)
+        {
+            LocVar* var = &p->locvars[i];
+
+            writerefopt(W, var->varname);
+            writevarint(W, var->startpc);
+            writevarint(W, var->endpc);
+            writebyte(W, var->reg);
+        }
+
+        for (int i = 0; i < p->sizeupvalues; ++i)
+            writerefopt(W, p->upvalues[i]);
+
+        writerefopt(W, p->source);
+        writerefopt(W, p->debugname);
+        break;
+    }
+
+    case LUA_TFUNCTION:
+    {
+        Closure* cl = gco2cl(o);
+
+        writerefopt(W, cl->env);
+
+        if (cl->isC)
+        {
+            writeaddress(W, uintptr_t(cl->c.f));
+            writeaddress(W, uintptr_t(cl->c.cont));
+            writeaddress(W, uintptr_t(cl->c.debugname));
+
+            for (int i = 0; i < cl->nupvalues; ++i)
+                writevalue(W, &cl->c.upvals[i]);
+        }
+        else
+        {
+            for (int i = 0; i < cl->nupvalues; ++i)
+                writevalue(W, &cl->l.uprefs[i]);
+        }
+        break;
+    }
+
+    case LUA_TTABLE:
+    {
+        Table* h = gco2h(o);
+
+        writerefopt(W, h->metatable);
+        writebyte(W, h->readonly);
+        writebyte(W, h->safeenv);
+
+        for (int i = 0; i < h->sizearray; ++i)
+            writevalue(W, &h->array[i]);
+
+        for (int i = 0; i < sizenode(h); ++i)
+        {
+            LuaNode* n = gnode(h, i);
+
+            if (keepnode(W, h, n))
+            {
+                TValue key;
+                getnodekey(W.L, &key, n);
+                writevalue(W, &key);
+                writevalue(W, gval(n));
+            }
+        }
+        break;
+    }
+
+    case LUA_TUPVAL:
+        writevalue(W, gco2uv(o)->v);
+        break;
+
+    case LUA_TUSERDATA:
+        writerefopt(W, gco2u(o)->metatable);
+        break;
+
+    default:
+        LUAU_ASSERT(!"unexpected object type");
+    }
+}
+
+static void savesnapshot(lua_State* L, void* ud)
+{
+    SnapshotWriter& W = *static_cast<SnapshotWriter*>(ud);
+    global_State* g = L->global;
+
+    // clears weak tables and drops everything that only the collector still knew about
+    luaC_fullgc(L);
+
+    markobject(W, obj2gco(W.registry));
+    markobject(W, obj2gco(g->mainthread->gt));
+
+    for (int i = 0; i < LUA_T_COUNT; ++i)
+        markobjectopt(W, g->mt[i]);
+
+    while (!W.pending.empty())
+    {
+        GCObject* o = W.pending.back();
+        W.pending.pop_back();
+
+        markreferences(W, o);
+    }
+
+    for (int i = 0; i < LUA_UTAG_LIMIT; ++i)
+        markhost(W, uintptr_t(g->udatagc[i]), false);
+
+    // id 0 is the main thread
+    unsigned id = 1;
+
+    for (int kind = 0; kind < Snapshot_KindCount; ++kind)
+        for (GCObject* o : W.objects[kind])
+            W.ids[o] = id++;
+
+    writeraw(W, kSnapshotMagic, 4);
+    writebyte(W, kSnapshotVersion);
+
+    uint64_t fingerprint = getfingerprint();
+    writeraw(W, &fingerprint, sizeof(fingerprint));
+
+    writevarint(W, W.hosts.size());
+
+    for (size_t i = 0; i < W.hosts.size(); ++i)
+        writehost(W, W.hosts[i].first, W.hosts[i].second);
+
+    for (int kind = 0; kind < Snapshot_KindCount; ++kind)
+        writevarint(W, W.objects[kind].size());
+
+    for (int kind = 0; kind < Snapshot_KindCount; ++kind)
+        for (GCObject* o : W.objects[kind])
+            writeshape(W, o);
+
+    for (int kind = 0; kind < Snapshot_KindCount; ++kind)
+        for (GCObject* o : W.objects[kind])
+            writecontents(W, o);
+
+    writeref(W, obj2gco(W.registry));
+    writeref(W, obj2gco(g->mainthread->gt));
+    writevarint(W, g->registryfree);
+
+    for (int i = 0; i < LUA_T_COUNT; ++i)
+        writerefopt(W, g->mt[i]);
+
+    for (int i = 0; i < LUA_UTAG_LIMIT; ++i)
+        writeaddress(W, uintptr_t(g->udatagc[i]));
+
+    W.result = (char*)malloc(W.out.size());
+    if (!W.result)
+        luaD_throw(L, LUA_ERRMEM);
+
+    memcpy(W.result, W.out.data(), W.out.size());
+}
+
+/* }====================================================== */
+
+/* {======================================================
+** Reader
+** =======================================================*/
+
+struct SnapshotReader
+{
+    const char* data;
+    size_t size;
+    size_t offset;
+
+    std::vector<GCObject*> objects; // by id; NULL until the object is allocated
+    std::vector<uintptr_t> hosts;   // by id, starting from 1
+
+    std::vector<int> tableentries; // number of hash entries of each table, in id order
+    size_t nexttable;
+};
+
+static l_noret malformed(lua_State* L)
+{
+    luaG_runerror(L, "malformed snapshot");
+}
+
+static const char* readraw(lua_State* L, SnapshotReader& R, size_t size)
+{
+    if (size > R.size - R.offset)
+        malformed(L);
+
+    const char* result = R.data + R.offset;
+    R.offset += size;
+    return result;
+}
+
+static uint8_t readbyte(lua_State* L, SnapshotReader& R)
+{
+    return uint8_t(*readraw(L, R, 1));
+}
+
+static size_t readvarint(lua_State* L, SnapshotReader& R)
+{
+    size_t result = 0;
+
+    for (unsigned shift = 0;; shift += 7)
+    {
+        uint8_t byte = readbyte(L, R);
+
+        if (shift >= sizeof(size_t) * 8)
+            malformed(L);
+
+        result |= size_t(byte & 0x7f) << shift;
+
+        if (!(byte & 0x80))
+            return result;
+    }
+}
+
+// element counts; every element takes at least a byte, which keeps malformed sizes from turning into huge allocations
+static int readcount(lua_State* L, SnapshotReader& R)
+{
+    size_t count = readvarint(L, R);
+
+    if (count > R.size - R.offset || count > INT_MAX)
+        malformed(L);
+
+    return int(count);
+}
+
+static uintptr_t readhost(lua_State* L, SnapshotReader& R)
+{
+    uint8_t name = readbyte(L, R);
+
+    int64_t offset;
+    memcpy(&offset, readraw(L, R, sizeof(offset)), sizeof(offset));
+
+    size_t size = readvarint(L, R);
+
+    uint64_t checksum;
+    memcpy(&checksum, readraw(L, R, sizeof(checksum)), sizeof(checksum));
+
+    if (name > 1 || (!name && size != kHostCodeSize))
+        malformed(L);
+
+    uintptr_t address = getanchor() + uintptr_t(offset);
+    const char* data = reinterpret_cast<const char*>(address);
+
+    if (hashbytes(data, size) != checksum || (name && data[size] != 0))
+        luaG_runerror(L, "snapshot refers to host functions that don't match this executable");
+
+    return address;
+}
+
+static uintptr_t readaddress(lua_State* L, SnapshotReader& R)
+{
+    size_t id = readvarint(L, R);
+
+    if (id > R.hosts.size())
+        malformed(L);
+
+    return id == 0 ? 0 : R.hosts[id - 1];
+}
+
+// objects are only referred to after they were allocated
+static GCObject* getobject(lua_State* L, SnapshotReader& R, size_t id, uint8_t tt)
+{
+    if (id >= R.objects.size() || R.objects[id]->gch.tt != tt)
+        malformed(L);
+
+    return R.objects[id];
+}
+
+static GCObject* readref(lua_State* L, SnapshotReader& R, uint8_t tt)
+{
+    return getobject(L, R, readvarint(L, R), tt);
+}
+
+static Table* readtableopt(lua_State* L, SnapshotReader& R)
+{
+    size_t id = readvarint(L, R);
+
+    return id == 0 ? NULL : gco2h(getobject(L, R, id, LUA_TTABLE));
+}
+
+static TString* readstringopt(lua_State* L, SnapshotReader& R)
+{
+    size_t id = readvarint(L, R);
+
+    return id == 0 ? NULL : gco2ts(getobject(L, R, id, LUA_TSTRING));
+}
+
+static void readvalue(lua_State* L, SnapshotReader& R, TValue* v)
+{
+    uint8_t tt = readbyte(L, R);
+
+    switch (tt)
+    {
+    case LUA_TNIL:
+        setnilvalue(v);
+        break;
+
+    case LUA_TBOOLEAN:
+        setbvalue(v, readbyte(L, R) != 0);
+        break;
+
+    case LUA_TNUMBER:
+    {
+        double n;
+        memcpy(&n, readraw(L, R, sizeof(n)), sizeof(n));
+        setnvalue(v, n);
+        break;
+    }
+
+    case LUA_TVECTOR:
+    {
+        float f[4] = {};
+        memcpy(f, readraw(L, R, sizeof(float) * LUA_VECTOR_SIZE), sizeof(float) * LUA_VECTOR_SIZE);
+        setvvalue(v, f[0], f[1], f[2], f[3]);
+        break;
+    }
+
+    case LUA_TSTRING:
+    case LUA_TTABLE:
+    case LUA_TFUNCTION:
+    case LUA_TUSERDATA:
+    case LUA_TTHREAD:
+    case LUA_TUPVAL:
+        v->value.gc = readref(L, R, tt);
+        v->tt = tt;
+        break;
+
+    default:
+        malformed(L);
+    }
+}
+
+static GCObject* readshape(lua_State* L, SnapshotReader& R, SnapshotKind kind)
+{
+    if (kind == Snapshot_String)
+    {
+        size_t len = readvarint(L, R);
+        const char* data = readraw(L, R, len);
+
+        return obj2gco(luaS_newlstr(L, data, len));
+    }
+
+    L->activememcat = readbyte(L, R);
+
+    switch (kind)
+    {
+    case Snapshot_Proto:
+    {
+        Proto* p = luaF_newproto(L);
+
+        int sizecode = readcount(L, R);
+        int sizek = readcount(L, R);
+        int sizep = readcount(L, R);
+        int sizelocvars = readcount(L, R);
+        int sizeupvalues = readcount(L, R);
+        int sizelineinfo = readcount(L, R);
+        int linegaplog2 = int(readvarint(L, R));
+
+        p->linedefined = int(readvarint(L, R));
+        p->nups = readbyte(L, R);
+        p->numparams = readbyte(L, R);
+        p->is_vararg = readbyte(L, R);
+        p->maxstacksize = readbyte(L, R);
+
+        const char* code = readraw(L, R, sizeof(Instruction) * sizecode);
+
+        p->code = luaM_newarray(L, sizecode, Instruction, p->memcat);
+        p->sizecode = sizecode;
+        memcpy(p->code, code, sizeof(Instruction) * sizecode);
+
+        if (sizelineinfo)
+        {
+            int intervals = ((sizecode - 1) >> linegaplog2) + 1;
+            int absoffset = (sizecode + 3) & ~3;
+
+            if (sizecode == 0 || linegaplog2 > 24 || sizelineinfo != absoffset + intervals * int(sizeof(int)))
+                malformed(L);
+
+            const char* lineinfo = readraw(L, R, sizelineinfo);
+
+            p->lineinfo = luaM_newarray(L, sizelineinfo, uint8_t, p->memcat);
+            p->sizelineinfo = sizelineinfo;
+            p->linegaplog2 = linegaplog2;
+            memcpy(p->lineinfo, lineinfo, sizelineinfo);
+
+            p->abslineinfo = (int*)(p->lineinfo + absoffset);
+        }
+
+        p->k = luaM_newarray(L, sizek, TValue, p->memcat);
+        p->sizek = sizek;
+        for (int i = 0; i < sizek; ++i)
+            setnilvalue(&p->k[i]);
+
+        p->p = luaM_newarray(L, sizep, Proto*, p->memcat);
+        p->sizep = sizep;
+        for (int i = 0; i < sizep; ++i)
+            p->p[i] = NULL;
+
+        p->locvars = luaM_newarray(L, sizelocvars, LocVar, p->memcat);
+        p->sizelocvars = sizelocvars;
+        for (int i = 0; i < sizelocvars; ++i)
+            p->locvars[i].varname = NULL;
+
+        p->upvalues = luaM_newarray(L, sizeupvalues, TString*, p->memcat);
+        p->sizeupvalues = sizeupvalues;
+        for (int i = 0; i < sizeupvalues; ++i)
+            p->upvalues[i] = NULL;
+
+        return obj2gco(p);
+    }
+
+    case Snapshot_Closure:
+    {
+        uint8_t isC = readbyte(L, R);
+        uint8_t nupvalues = readbyte(L, R);
+
+        Closure* cl;
+
+        if (isC)
+        {
+            cl = luaF_newCclosure(L, nupvalues, NULL);
+
+            for (int i = 0; i < nupvalues; ++i)
+                setnilvalue(&cl->c.upvals[i]);
+        }
+        else
+        {
+            cl = luaF_newLclosure(L, nupvalues, NULL, gco2p(readref(L, R, LUA_TPROTO)));
+        }
+
+        return obj2gco(cl);
+    }
+
+    case Snapshot_Table:
+    {
+        int sizearray = readcount(L, R);
+        int count = readcount(L, R);
+
+        R.tableentries.push_back(count);
+
+        return obj2gco(luaH_new(L, sizearray, count));
+    }
+
+    case Snapshot_Upval:
+    {
+        UpVal* uv = luaM_newgco(L, UpVal, sizeof(UpVal), L->activememcat);
+        luaC_init(L, uv, LUA_TUPVAL);
+        uv->v = &uv->u.value;
+        setnilvalue(uv->v);
+
+        return obj2gco(uv);
+    }
+
+    case Snapshot_Userdata:
+    {
+        uint8_t tag = readbyte(L, R);
+        int len = readcount(L, R);
+
+        // the destructor of an inline dtor userdata is a pointer at the end of its data
+        if (tag == UTAG_IDTOR)
+            malformed(L);
+
+        Udata* u = luaU_newudata(L, len, tag);
+        memcpy(u->data, readraw(L, R, len), len);
+
+        return obj2gco(u);
+    }
+
+    default:
+        LUAU_ASSERT(!"unexpected object kind");
+        return NULL;
+    }
+}
+
+static void readcontents(lua_State* L, SnapshotReader& R, GCObject* o)
+{
+    switch (o->gch.tt)
+    {
+    case LUA_TSTRING:
+        break;
+
+    case LUA_TPROTO:
+    {
+        Proto* p = gco2p(o);
+
+        for (int i = 0; i < p->sizek; ++i)
+            readvalue(L, R, &p->k[i]);
+
+        for (int i = 0; i < p->sizep; ++i)
+            p->p[i] = gco2p(readref(L, R, LUA_TPROTO));
+
+        for (int i = 0; i < p->sizelocvars; ++i)
+        {
+            LocVar* var = &p->locvars[i];
+
+            var->varname = readstringopt(L, R);
+            var->startpc = int(readvarint(L, R));
+            var->endpc = int(readvarint(L, R));
+            var->reg = readbyte(L, R);
+        }
+
+        for (int i = 0; i < p->sizeupvalues; ++i)
+            p->upvalues[i] = readstringopt(L, R);
+
+        p->source = readstringopt(L, R);
+        p->debugname = readstringopt(L, R);
+        break;
+    }
+
+    case LUA_TFUNCTION:
+    {
+        Closure* cl = gco2cl(o);
+
+        cl->env = readtableopt(L, R);
+
+        if (cl->isC)
+        {
+            cl->c.f = (lua_CFunction)readaddress(L, R);
+            cl->c.cont = (lua_Continuation)readaddress(L, R);
+            cl->c.debugname = (const char*)readaddress(L, R);
+
+            for (int i = 0; i < cl->nupvalues; ++i)
+                readvalue(L, R, &cl->c.upvals[i]);
+        }
+        else
+        {
+            for (int i = 0; i < cl->nupvalues; ++i)
+                readvalue(L, R, &cl->l.uprefs[i]);
+        }
+        break;
+    }
+
+    case LUA_TTABLE:
+    {
+        Table* h = gco2h(o);
+
+        h->metatable = readtableopt(L, R);
+        uint8_t readonly = readbyte(L, R);
+        h->safeenv = readbyte(L, R);
+
+        for (int i = 0; i < h->sizearray; ++i)
+            readvalue(L, R, &h->array[i]);
+
+        // the node part was sized for the entries when the table was allocated, so none of these rehash
+        int count = R.tableentries[R.nexttable++];
+
+        for (int i = 0; i < count; ++i)
+        {
+            TValue key;
+            readvalue(L, R, &key);
+            readvalue(L, R, luaH_set(L, h, &key));
+        }
+
+        h->readonly = readonly;
+        break;
+    }
+
+    case LUA_TUPVAL:
+        readvalue(L, R, gco2uv(o)->v);
+        break;
+
+    case LUA_TUSERDATA:
+        gco2u(o)->metatable = readtableopt(L, R);
+        break;
+
+    default:
+        LUAU_ASSERT(!"unexpected object type");
+    }
+}
+
+static void loadsnapshot(lua_State* L, void* ud)
+{
+    SnapshotReader& R = *static_cast<SnapshotReader*>(ud);
+    global_State* g = L->global;
+
+    if (memcmp(readraw(L, R, 4), kSnapshotMagic, 4) != 0)
+        malformed(L);
+
+    uint8_t version = readbyte(L, R);
+    if (version != kSnapshotVersion)
+        luaG_runerror(L, "snapshot version mismatch (expected %d, got %d)", kSnapshotVersion, version);
+
+    uint64_t fingerprint;
+    memcpy(&fingerprint, readraw(L, R, sizeof(fingerprint)), sizeof(fingerprint));
+
+    if (fingerprint != getfingerprint())
+        luaG_runerror(L, "snapshot was created by a different build");
+
+    int nhosts = readcount(L, R);
+    R.hosts.reserve(nhosts);
+
+    for (int i = 0; i < nhosts; ++i)
+        R.hosts.push_back(readhost(L, R));
+
+    int counts[Snapshot_KindCount];
+    size_t total = 1;
+
+    for (int kind = 0; kind < Snapshot_KindCount; ++kind)
+    {
+        counts[kind] = readcount(L, R);
+        total += counts[kind];
+    }
+
+    R.objects.reserve(total);
+    R.objects.push_back(obj2gco(g->mainthread));
+
+    for (int kind = 0; kind < Snapshot_KindCount; ++kind)
+        for (int i = 0; i < counts[kind]; ++i)
+            R.objects.push_back(readshape(L, R, SnapshotKind(kind)));
+
+    for (size_t id = 1; id < R.objects.size(); ++id)
+        readcontents(L, R, R.objects[id]);
+
+    Table* registry = gco2h(readref(L, R, LUA_TTABLE));
+    Table* gt = gco2h(readref(L, R, LUA_TTABLE));
+    int registryfree = int(readvarint(L, R));
+
+    Table* mt[LUA_T_COUNT];
+    for (int i = 0; i < LUA_T_COUNT; ++i)
+        mt[i] = readtableopt(L, R);
+
+    uintptr_t udatagc[LUA_UTAG_LIMIT];
+    for (int i = 0; i < LUA_UTAG_LIMIT; ++i)
+        udatagc[i] = readaddress(L, R);
+
+    if (R.offset != R.size)
+        malformed(L);
+
+    // the roots are replaced last, so a snapshot that fails to load leaves the state as it was
+    sethvalue(L, registry(L), registry);
+    g->registryfree = registryfree;
+    g->mainthread->gt = gt;
+
+    for (int i = 0; i < LUA_T_COUNT; ++i)
+        g->mt[i] = mt[i];
+
+    for (int i = 0; i < LUA_UTAG_LIMIT; ++i)
+        g->udatagc[i] = (void (*)(lua_State*, void*))udatagc[i];
+}
+
+/* }====================================================== */
+
+char* lua_savesnapshot(lua_State* L, size_t* outsize)
+{
+    SnapshotWriter W;
+    W.L = L;
+    W.registry = hvalue(registry(L));
+
+    if (luaD_pcall(L, savesnapshot, &W, savestack(L, L->top), 0) != 0)
+        return NULL;
+
+    *outsize = W.out.size();
+    return W.result;
+}
+
+int lua_loadsnapshot(lua_State* L, const char* data, size_t size)
+{
+    global_State* g = L->global;
+
+    // restored objects are linked without write barriers, which is only valid while the collector rests between cycles
+    luaC_fullgc(L);
+
+    size_t threshold = g->GCthreshold;
+    g->GCthreshold = SIZE_MAX;
+
+    uint8_t activememcat = L->activememcat;
+
+    SnapshotReader R;
+    R.data = data;
+    R.size = size;
+    R.offset = 0;
+    R.nexttable = 0;
+
+    int status = luaD_pcall(L, loadsnapshot, &R, savestack(L, L->top), 0);
+
+    L->activememcat = activememcat;
+    g->GCthreshold = threshold;
+
+    return status;
+}
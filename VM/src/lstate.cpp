@@ -87,6 +87,8 @@ static void close_state(lua_State* L)
     global_State* g = L->global;
     luaF_close(L, L->stack); /* close all upvalues for this thread */
     luaC_freeall(L);         /* collect all objects */
+    if (g->ecb.close)
+        g->ecb.close(L);
     LUAU_ASSERT(g->strbufgc == NULL);
     LUAU_ASSERT(g->strt.nuse == 0);
     luaM_freearray(L, L->global->strt.hash, L->global->strt.size, TString*, 0);
@@ -216,6 +218,7 @@ lua_State* lua_newstate(lua_Alloc f, void* ud)
     g->memcatbytes[0] = sizeof(LG);
 
     g->cb = lua_Callbacks();
+    g->ecb = lua_ExecutionCallbacks();
     g->gcstats = GCStats();
 
 #ifdef LUAI_GCMETRICS
@@ -146,6 +146,20 @@ struct GCMetrics
 };
 #endif
 
+/*
+** hooks that let native code generators run functions outside of the interpreter; see Proto::execdata
+*/
+typedef struct lua_ExecutionCallbacks
+{
+    void* context;
+    void (*close)(lua_State* L);                 /* called when the state is closed, after all objects have been freed */
+    void (*destroy)(lua_State* L, Proto* proto); /* called when a function with execdata is freed */
+    int (*enter)(lua_State* L, Proto* proto);    /* runs the function from L->ci->savedpc; returns 1 if the interpreter has to exit */
+    void (*hot)(lua_State* L, Proto* proto);     /* called when the function crosses hotthreshold; may set execdata but must not run Lua code */
+
+    unsigned int hotthreshold; /* calls and loop iterations that functions created from now on run in the interpreter before they are hot; 0 disables */
+} lua_ExecutionCallbacks;
+
 /*
 ** `global state', shared by all threads of this state
 */
@@ -204,6 +218,8 @@ typedef struct global_State
 
     lua_Callbacks cb;
 
+    lua_ExecutionCallbacks ecb;
+
     GCStats gcstats;
 
 #ifdef LUAI_GCMETRICS
@@ -0,0 +1,352 @@
+// This file is part of the Luau programming language and is licensed under MIT License; see LICENSE.txt for details
+#include "lualib.h"
+
+#include "lstate.h"
+
+#include <algorithm>
+#include <deque>
+#include <new>
+#include <vector>
+
+#include <limits.h>
+#include <stdint.h>
+
+// The scheduler keeps a binary heap of timers ordered by deadline and a queue of threads that are ready to run. Nothing runs on its own:
+// the host calls task.step (or luaL_runtasks) with the current time, which moves the timers that are due to the run queue and resumes the
+// threads in it. Threads are kept alive by registry references while they are scheduled.
+// Libraries that complete work on other threads, like async cpr requests, register as task sources: the scheduler polls them on every step
+// and hosts can wait on their file descriptors next to their own I/O.
+
+#define TASK_SCHEDULER "taskScheduler"
+
+struct TaskEntry
+{
+    int thread; // registry reference to the thread
+    int nargs;  // number of values on the thread's stack to resume it with, or -1 to resume it with the time it waited
+    double start;
+};
+
+struct TaskTimer
+{
+    double deadline;
+    uint64_t order; // timers with the same deadline run in the order they were scheduled
+    TaskEntry entry;
+};
+
+struct TaskTimerLater
+{
+    bool operator()(const TaskTimer& a, const TaskTimer& b) const
+    {
+        return a.deadline != b.deadline ? a.deadline > b.deadline : a.order > b.order;
+    }
+};
+
+struct TaskScheduler
+{
+    std::vector<TaskTimer> timers; // min-heap by deadline
+    std::deque<TaskEntry> ready;
+    std::vector<luaL_TaskSource> sources;
+    uint64_t order = 0;
+
+    void schedule(double deadline, const TaskEntry& entry)
+    {
+        TaskTimer timer = {deadline, order++, entry};
+        timers.push_back(timer);
+        std::push_heap(timers.begin(), timers.end(), TaskTimerLater());
+    }
+};
+
+static TaskScheduler* getscheduler(lua_State* L, bool create)
+{
+    lua_getfield(L, LUA_REGISTRYINDEX, TASK_SCHEDULER);
+    TaskScheduler* S = (TaskScheduler*)lua_touserdata(L, -1);
+    lua_pop(L, 1);
+
+    if (!S && create)
+    {
+        S = (TaskScheduler*)lua_newuserdatadtor(L, sizeof(TaskScheduler), [](void* ud) {
+            static_cast<TaskScheduler*>(ud)->~TaskScheduler();
+        });
+        new (S) TaskScheduler();
+
+        lua_setfield(L, LUA_REGISTRYINDEX, TASK_SCHEDULER);
+    }
+
+    return S;
+}
+
+// suspended threads are either yielded or haven't started yet
+static bool issuspended(lua_State* L, lua_State* co)
+{
+    if (co == L)
+        return false;
+    if (co->status == LUA_YIELD)
+        return true;
+
+    return co->status == 0 && co->ci == co->base_ci && co->top != co->base;
+}
+
+// turns the function or thread at 'first' and the values after it into a thread that is ready to resume; leaves the thread on the stack
+static int preparetask(lua_State* L, int first, lua_State** co)
+{
+    int nargs = lua_gettop(L) - first;
+
+    if (lua_isthread(L, first))
+    {
+        *co = lua_tothread(L, first);
+
+        if (!issuspended(L, *co))
+            luaL_argerror(L, first, "thread is not suspended");
+
+        lua_xmove(L, *co, nargs);
+    }
+    else
+    {
+        luaL_checktype(L, first, LUA_TFUNCTION);
+
+        *co = lua_newthread(L);
+        lua_insert(L, first);
+        lua_xmove(L, *co, nargs + 1);
+    }
+
+    return nargs;
+}
+
+// resumes a scheduled thread; errors raised by it propagate to the caller
+static bool resumetask(lua_State* L, const TaskEntry& entry, double now)
+{
+    lua_getref(L, entry.thread);
+    lua_unref(L, entry.thread);
+
+    lua_State* co = lua_tothread(L, -1);
+
+    // a thread that was resumed or closed by someone else in the meantime is no longer waiting for us
+    if (!issuspended(L, co))
+    {
+        lua_pop(L, 1);
+        return false;
+    }
+
+    int nargs = entry.nargs;
+
+    if (nargs < 0)
+    {
+        lua_pushnumber(co, now - entry.start);
+        nargs = 1;
+    }
+
+    int status = lua_resume(co, L, nargs);
+
+    if (status == LUA_OK)
+    {
+        lua_settop(co, 0);
+    }
+    else if (status != LUA_YIELD)
+    {
+        lua_xmove(co, L, 1);
+        lua_error(L);
+    }
+
+    lua_pop(L, 1);
+    return true;
+}
+
+static int task_spawn(lua_State* L)
+{
+    lua_State* co;
+    int nargs = preparetask(L, 1, &co);
+
+    int status = lua_resume(co, L, nargs);
+
+    if (status == LUA_OK)
+    {
+        lua_settop(co, 0);
+    }
+    else if (status != LUA_YIELD)
+    {
+        lua_xmove(co, L, 1);
+        lua_error(L);
+    }
+
+    return 1;
+}
+
+static int task_defer(lua_State* L)
+{
+    TaskScheduler* S = getscheduler(L, true);
+
+    lua_State* co;
+    int nargs = preparetask(L, 1, &co);
+
+    TaskEntry entry = {lua_ref(L, -1), nargs, 0};
+    S->ready.push_back(entry);
+
+    return 1;
+}
+
+static int task_delay(lua_State* L)
+{
+    double seconds = luaL_checknumber(L, 1);
+    TaskScheduler* S = getscheduler(L, true);
+
+    lua_State* co;
+    int nargs = preparetask(L, 2, &co);
+
+    double now = lua_clock();
+    TaskEntry entry = {lua_ref(L, -1), nargs, now};
+    S->schedule(now + std::max(seconds, 0.0), entry);
+
+    return 1;
+}
+
+static int task_wait(lua_State* L)
+{
+    return luaL_taskwait(L, luaL_optnumber(L, 1, 0));
+}
+
+// resumes up to 'budget' threads that are due at 'now'; a budget of 0 has no limit
+static int runtasks(lua_State* L, TaskScheduler* S, double now, int budget)
+{
+    int limit = budget > 0 ? budget : INT_MAX;
+    int resumed = 0;
+
+    for (size_t i = 0; i < S->sources.size() && resumed < limit; ++i)
+        resumed += S->sources[i].poll(L, limit - resumed);
+
+    // timers that are due join the run queue in deadline order
+    while (!S->timers.empty() && S->timers.front().deadline <= now)
+    {
+        std::pop_heap(S->timers.begin(), S->timers.end(), TaskTimerLater());
+        S->ready.push_back(S->timers.back().entry);
+        S->timers.pop_back();
+    }
+
+    // tasks deferred by the ones we run here wait for the next step, so a task that keeps deferring itself can't stall the host
+    size_t count = S->ready.size();
+
+    for (size_t i = 0; i < count && resumed < limit && !S->ready.empty(); ++i)
+    {
+        TaskEntry entry = S->ready.front();
+        S->ready.pop_front();
+
+        // if the task fails, the ones after it stay queued for the next step
+        resumed += resumetask(L, entry, now);
+    }
+
+    return resumed;
+}
+
+static int task_step(lua_State* L)
+{
+    double now = luaL_optnumber(L, 1, lua_clock());
+    TaskScheduler* S = getscheduler(L, true);
+
+    lua_pushinteger(L, runtasks(L, S, now, 0));
+    return 1;
+}
+
+static int task_runtasks(lua_State* L)
+{
+    TaskScheduler* S = (TaskScheduler*)lua_tolightuserdata(L, 1);
+    runtasks(L, S, lua_tonumber(L, 2), lua_tointeger(L, 3));
+    return 0;
+}
+
+int luaL_taskwait(lua_State* L, double seconds)
+{
+    if (!lua_isyieldable(L))
+        luaL_error(L, "attempt to yield across metamethod/C-call boundary");
+
+    TaskScheduler* S = getscheduler(L, true);
+
+    lua_pushthread(L);
+    int thread = lua_ref(L, -1);
+    lua_pop(L, 1);
+
+    double now = lua_clock();
+    TaskEntry entry = {thread, -1, now};
+    S->schedule(now + std::max(seconds, 0.0), entry);
+
+    return lua_yield(L, 0);
+}
+
+void luaL_addtasksource(lua_State* L, const luaL_TaskSource* source)
+{
+    getscheduler(L, true)->sources.push_back(*source);
+}
+
+double luaL_nextdeadline(lua_State* L)
+{
+    TaskScheduler* S = getscheduler(L, false);
+
+    if (!S || (S->ready.empty() && S->timers.empty()))
+        return -1;
+
+    return S->ready.empty() ? S->timers.front().deadline : 0;
+}
+
+int luaL_pendingtasks(lua_State* L)
+{
+    TaskScheduler* S = getscheduler(L, false);
+    if (!S)
+        return 0;
+
+    int pending = int(S->timers.size() + S->ready.size());
+
+    for (size_t i = 0; i < S->sources.size(); ++i)
+        pending += S->sources[i].pending(L);
+
+    return pending;
+}
+
+int luaL_pollfds(lua_State* L, int* fds, int size)
+{
+    TaskScheduler* S = getscheduler(L, false);
+    if (!S)
+        return 0;
+
+    int count = 0;
+
+    for (size_t i = 0; i < S->sources.size(); ++i)
+    {
+        if (S->sources[i].fd < 0)
+            continue;
+
+        if (count < size)
+            fds[count] = S->sources[i].fd;
+
+        count++;
+    }
+
+    return count;
+}
+
+int luaL_runtasks(lua_State* L, double now, int budget)
+{
+    TaskScheduler* S = getscheduler(L, false);
+    if (!S)
+        return 0;
+
+    lua_pushcfunction(L, task_runtasks, "runtasks");
+    lua_pushlightuserdata(L, S);
+    lua_pushnumber(L, now);
+    lua_pushinteger(L, budget);
+
+    return lua_pcall(L, 3, 0, 0);
+}
+
+static const luaL_Reg tasklib[] = {
+    {"spawn", task_spawn},
+    {"defer", task_defer},
+    {"delay", task_delay},
+    {"wait", task_wait},
+    {"step", task_step},
+    {NULL, NULL},
+};
+
+int luaopen_task(lua_State* L)
+{
+    luaL_register(L, LUA_TASKLIBNAME, tasklib);
+
+    return 1;
+}
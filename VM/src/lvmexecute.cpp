@@ -63,7 +63,13 @@
 #define VM_KV(i) (LUAU_ASSERT(unsigned(i) < unsigned(cl->l.p->sizek)), &k[i])
 #define VM_UV(i) (LUAU_ASSERT(unsigned(i) < unsigned(cl->nupvalues)), &cl->l.uprefs[i])
 
-#define VM_PATCH_C(pc, slot) *const_cast<Instruction*>(pc) = ((uint8_t(slot) << 24) | (0x00ffffffu & *(pc)))
+// slot hints are validated before use; code shared with other states, which may run on other threads, keeps the hints it was loaded with
+#define VM_PATCH_C(pc, slot) \
+    do \
+    { \
+        if (LUAU_INSN_C(*(pc)) != uint8_t(slot) && !cl->l.p->codereadonly) \
+            *const_cast<Instruction*>(pc) = ((uint8_t(slot) << 24) | (0x00ffffffu & *(pc))); \
+    } while (0)
 #define VM_PATCH_E(pc, slot) *const_cast<Instruction*>(pc) = ((uint32_t(slot) << 8) | (0x000000ffu & *(pc)))
 
 // NOTE: If debugging the Luau code, disable this macro to prevent timeouts from
@@ -86,6 +92,38 @@
     }
 #endif
 
+// hands the current frame over to native code when its function has any, see lua_ExecutionCallbacks; native code returns with the frame
+// that the interpreter has to continue with, which may be a different one if the function called or returned
+#define VM_ENTER_NATIVE() \
+    { \
+        if (!SingleStep && !Fallback && LUAU_UNLIKELY(cl->l.p->execdata != NULL)) \
+        { \
+            L->ci->savedpc = pc; \
+            if (L->global->ecb.enter(L, cl->l.p)) \
+                goto exit; \
+            pc = L->ci->savedpc; \
+            cl = clvalue(L->ci->func); \
+            base = L->base; \
+            k = cl->l.p->k; \
+        } \
+    }
+
+// counts calls and loop back edges of functions that don't have native code yet; once a function crosses ecb.hotthreshold, ecb.hot gets to
+// compile it and the frame moves to native code right away, in the middle of the loop if that's where it got hot
+#define VM_HOTCOUNT() \
+    { \
+        Proto* hp = cl->l.p; \
+        if (!SingleStep && !Fallback && LUAU_UNLIKELY(hp->hotcount != 0 && --hp->hotcount == 0) && hp->execdata == NULL) \
+        { \
+            if (L->global->ecb.hot) \
+                L->global->ecb.hot(L, hp); \
+            if (hp->execdata != NULL) \
+            { \
+                VM_ENTER_NATIVE(); \
+                VM_NEXT(); \
+            } \
+        } \
+    }
 
 #define VM_DISPATCH_OP(op) &&CASE_##op
 
@@ -108,7 +146,10 @@
         VM_DISPATCH_OP(LOP_FORGLOOP_NEXT), VM_DISPATCH_OP(LOP_GETVARARGS), VM_DISPATCH_OP(LOP_DUPCLOSURE), VM_DISPATCH_OP(LOP_PREPVARARGS), \
         VM_DISPATCH_OP(LOP_LOADKX), VM_DISPATCH_OP(LOP_JUMPX), VM_DISPATCH_OP(LOP_FASTCALL), VM_DISPATCH_OP(LOP_COVERAGE), \
         VM_DISPATCH_OP(LOP_CAPTURE), VM_DISPATCH_OP(LOP_JUMPIFEQK), VM_DISPATCH_OP(LOP_JUMPIFNOTEQK), VM_DISPATCH_OP(LOP_FASTCALL1), \
-        VM_DISPATCH_OP(LOP_FASTCALL2), VM_DISPATCH_OP(LOP_FASTCALL2K), VM_DISPATCH_OP(LOP_FORGPREP),
+        VM_DISPATCH_OP(LOP_FASTCALL2), VM_DISPATCH_OP(LOP_FASTCALL2K), VM_DISPATCH_OP(LOP_FORGPREP), VM_DISPATCH_OP(LOP_MOVE_MOVE), \
+        VM_DISPATCH_OP(LOP_MOVE_CALL), VM_DISPATCH_OP(LOP_LOADN_LOADN), VM_DISPATCH_OP(LOP_GETUPVAL_CALL), \
+        VM_DISPATCH_OP(LOP_GETUPVAL_GETTABLEKS), VM_DISPATCH_OP(LOP_GETIMPORT_MOVE), VM_DISPATCH_OP(LOP_GETTABLE_GETTABLE), \
+        VM_DISPATCH_OP(LOP_GETTABLE_ADD), VM_DISPATCH_OP(LOP_ADD_GETTABLE),
 
 #if defined(__GNUC__) || defined(__clang__)
 #define VM_USE_CGOTO 1
@@ -126,16 +167,27 @@
  */
 #if VM_USE_CGOTO
 #define VM_CASE(op) CASE_##op:
-#define VM_NEXT() goto*(SingleStep ? &&dispatch : kDispatchTable[LUAU_INSN_OP(*pc)])
+#define VM_NEXT() goto*((SingleStep || Fallback) ? &&dispatch : kDispatchTable[LUAU_INSN_OP(*pc)])
 #define VM_CONTINUE(op) goto* kDispatchTable[uint8_t(op)]
+#define VM_CONTINUE_FUSED(op) goto CASE_##op
 #else
 #define VM_CASE(op) case op:
 #define VM_NEXT() goto dispatch
 #define VM_CONTINUE(op) \
     dispatchOp = uint8_t(op); \
     goto dispatchContinue
+#define VM_CONTINUE_FUSED(op) VM_CONTINUE(op)
 #endif
 
+// finishes the first instruction of a fused pair by running the second one directly; single step and fallback modes stop after each
+// instruction, and a breakpoint may have replaced the second opcode, in which case it is dispatched as usual
+#define VM_NEXT_FUSED(op) \
+    { \
+        if (!SingleStep && !Fallback && LUAU_INSN_OP(*pc) == op) \
+            VM_CONTINUE_FUSED(op); \
+        VM_NEXT(); \
+    }
+
 LUAU_NOINLINE static void luau_prepareFORN(lua_State* L, StkId plimit, StkId pstep, StkId pinit)
 {
     if (!ttisnumber(pinit) && !luaV_tonumber(pinit, pinit))
@@ -297,7 +349,9 @@ inline bool luau_skipstep(uint8_t op)
     return op == LOP_PREPVARARGS || op == LOP_BREAK;
 }
 
-template<bool SingleStep>
+// Fallback mode runs just one instruction, at L->ci->savedpc, and stores the position of the next one there; native code uses it for the
+// instructions it doesn't implement
+template<bool SingleStep, bool Fallback>
 static void luau_execute(lua_State* L)
 {
 #if VM_USE_CGOTO
@@ -311,6 +365,8 @@ static void luau_execute(lua_State* L)
     TValue* k;
     const Instruction* pc;
 
+    bool fallbackdone = false;
+
     LUAU_ASSERT(isLua(L->ci));
     LUAU_ASSERT(luaC_threadactive(L));
     LUAU_ASSERT(!luaC_threadsleeping(L));
@@ -320,6 +376,9 @@ static void luau_execute(lua_State* L)
     base = L->base;
     k = cl->l.p->k;
 
+    VM_ENTER_NATIVE();
+    VM_HOTCOUNT();
+
     VM_NEXT(); // starts the interpreter "loop"
 
     {
@@ -341,6 +400,21 @@ static void luau_execute(lua_State* L)
                     goto exit;
             }
 
+#if VM_USE_CGOTO
+            VM_CONTINUE(LUAU_INSN_OP(*pc));
+#endif
+        }
+
+        if (Fallback)
+        {
+            if (fallbackdone)
+            {
+                L->ci->savedpc = pc;
+                goto exit;
+            }
+
+            fallbackdone = true;
+
 #if VM_USE_CGOTO
             VM_CONTINUE(LUAU_INSN_OP(*pc));
 #endif
@@ -1046,6 +1120,8 @@ static void luau_execute(lua_State* L)
                     cl = ccl;
                     base = L->base;
                     k = p->k;
+                    VM_ENTER_NATIVE();
+                    VM_HOTCOUNT();
                     VM_NEXT();
                 }
                 else
@@ -1129,6 +1205,7 @@ static void luau_execute(lua_State* L)
                 cl = clvalue(cip->func);
                 base = L->base;
                 k = cl->l.p->k;
+                VM_ENTER_NATIVE();
                 VM_NEXT();
             }
 
@@ -2179,6 +2256,7 @@ static void luau_execute(lua_State* L)
             VM_CASE(LOP_FORNLOOP)
             {
                 VM_INTERRUPT();
+                VM_HOTCOUNT();
                 Instruction insn = *pc++;
                 StkId ra = VM_REG(LUAU_INSN_A(insn));
                 LUAU_ASSERT(ttisnumber(ra + 0) && ttisnumber(ra + 1) && ttisnumber(ra + 2));
@@ -2250,9 +2328,119 @@ static void luau_execute(lua_State* L)
                 VM_NEXT();
             }
 
+            // fused instructions only handle the fast path of the first instruction; otherwise it runs on its own like the unfused one
+            VM_CASE(LOP_MOVE_MOVE)
+            {
+                Instruction insn = *pc++;
+                StkId ra = VM_REG(LUAU_INSN_A(insn));
+                StkId rb = VM_REG(LUAU_INSN_B(insn));
+
+                setobj2s(L, ra, rb);
+                VM_NEXT_FUSED(LOP_MOVE);
+            }
+
+            VM_CASE(LOP_MOVE_CALL)
+            {
+                Instruction insn = *pc++;
+                StkId ra = VM_REG(LUAU_INSN_A(insn));
+                StkId rb = VM_REG(LUAU_INSN_B(insn));
+
+                setobj2s(L, ra, rb);
+                VM_NEXT_FUSED(LOP_CALL);
+            }
+
+            VM_CASE(LOP_LOADN_LOADN)
+            {
+                Instruction insn = *pc++;
+                StkId ra = VM_REG(LUAU_INSN_A(insn));
+
+                setnvalue(ra, LUAU_INSN_D(insn));
+                VM_NEXT_FUSED(LOP_LOADN);
+            }
+
+            VM_CASE(LOP_GETUPVAL_CALL)
+            {
+                Instruction insn = *pc++;
+                StkId ra = VM_REG(LUAU_INSN_A(insn));
+                TValue* ur = VM_UV(LUAU_INSN_B(insn));
+                TValue* v = ttisupval(ur) ? upvalue(ur)->v : ur;
+
+                setobj2s(L, ra, v);
+                VM_NEXT_FUSED(LOP_CALL);
+            }
+
+            VM_CASE(LOP_GETUPVAL_GETTABLEKS)
+            {
+                Instruction insn = *pc++;
+                StkId ra = VM_REG(LUAU_INSN_A(insn));
+                TValue* ur = VM_UV(LUAU_INSN_B(insn));
+                TValue* v = ttisupval(ur) ? upvalue(ur)->v : ur;
+
+                setobj2s(L, ra, v);
+                VM_NEXT_FUSED(LOP_GETTABLEKS);
+            }
+
+            VM_CASE(LOP_GETIMPORT_MOVE)
+            {
+                Instruction insn = *pc;
+                StkId ra = VM_REG(LUAU_INSN_A(insn));
+                TValue* kv = VM_KV(LUAU_INSN_D(insn));
+
+                if (LUAU_UNLIKELY(ttisnil(kv) || !cl->env->safeenv))
+                    VM_CONTINUE_FUSED(LOP_GETIMPORT);
+
+                setobj2s(L, ra, kv);
+                pc += 2; // skip over AUX
+                VM_NEXT_FUSED(LOP_MOVE);
+            }
+
+            VM_CASE(LOP_GETTABLE_GETTABLE)
+            VM_CASE(LOP_GETTABLE_ADD)
+            {
+                Instruction insn = *pc;
+                StkId ra = VM_REG(LUAU_INSN_A(insn));
+                StkId rb = VM_REG(LUAU_INSN_B(insn));
+                StkId rc = VM_REG(LUAU_INSN_C(insn));
+
+                if (LUAU_UNLIKELY(!ttistable(rb) || !ttisnumber(rc)))
+                    VM_CONTINUE_FUSED(LOP_GETTABLE);
+
+                Table* h = hvalue(rb);
+
+                double indexd = nvalue(rc);
+                int index = int(indexd);
+
+                if (LUAU_UNLIKELY(unsigned(index - 1) >= unsigned(h->sizearray) || h->metatable || double(index) != indexd))
+                    VM_CONTINUE_FUSED(LOP_GETTABLE);
+
+                setobj2s(L, ra, &h->array[unsigned(index - 1)]);
+                pc++;
+
+                if (LUAU_INSN_OP(insn) == LOP_GETTABLE_GETTABLE)
+                    VM_NEXT_FUSED(LOP_GETTABLE);
+
+                VM_NEXT_FUSED(LOP_ADD);
+            }
+
+            VM_CASE(LOP_ADD_GETTABLE)
+            {
+                Instruction insn = *pc;
+                StkId ra = VM_REG(LUAU_INSN_A(insn));
+                StkId rb = VM_REG(LUAU_INSN_B(insn));
+                StkId rc = VM_REG(LUAU_INSN_C(insn));
+
+                if (LUAU_UNLIKELY(!ttisnumber(rb) || !ttisnumber(rc)))
+                    VM_CONTINUE_FUSED(LOP_ADD);
+
+                setnvalue(ra, nvalue(rb) + nvalue(rc));
+                pc++;
+                VM_NEXT_FUSED(LOP_GETTABLE);
+            }
+
             VM_CASE(LOP_FORGLOOP)
             {
                 VM_INTERRUPT();
+                VM_HOTCOUNT();
                 Instruction insn = *pc++;
                 StkId ra = VM_REG(LUAU_INSN_A(insn));
                 uint32_t aux = *pc;
@@ -2362,6 +2550,7 @@ static void luau_execute(lua_State* L)
             VM_CASE(LOP_FORGLOOP_INEXT)
             {
                 VM_INTERRUPT();
+                VM_HOTCOUNT();
                 Instruction insn = *pc++;
                 StkId ra = VM_REG(LUAU_INSN_A(insn));
 
@@ -2434,6 +2623,7 @@ static void luau_execute(lua_State* L)
             VM_CASE(LOP_FORGLOOP_NEXT)
             {
                 VM_INTERRUPT();
+                VM_HOTCOUNT();
                 Instruction insn = *pc++;
                 StkId ra = VM_REG(LUAU_INSN_A(insn));
 
@@ -2614,6 +2804,7 @@ static void luau_execute(lua_State* L)
             VM_CASE(LOP_JUMPBACK)
             {
                 VM_INTERRUPT();
+                VM_HOTCOUNT();
                 Instruction insn = *pc++;
 
                 pc += LUAU_INSN_D(insn);
@@ -2971,9 +3162,14 @@ exit:;
 void luau_execute(lua_State* L)
 {
     if (L->singlestep)
-        luau_execute<true>(L);
+        luau_execute<true, false>(L);
     else
-        luau_execute<false>(L);
+        luau_execute<false, false>(L);
+}
+
+void luau_executefallback(lua_State* L)
+{
+    luau_execute<false, true>(L);
 }
 
 int luau_precall(lua_State* L, StkId func, int nresults)
@@ -11,6 +11,12 @@
 #include "lbytecode.h"
 #include "lapi.h"
 
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
 #include <string.h>
 
 // TODO: RAII deallocation doesn't work for longjmp builds if a memory error happens
@@ -139,7 +145,72 @@ static void resolveImportSafe(lua_State* L, Table* env, TValue* k, uint32_t id)
     }
 }
 
-int luau_load(lua_State* L, const char* chunkname, const char* data, size_t size, int env)
+// Shared modules keep one copy of the instructions and line info of every proto, in the order the protos appear in the bytecode.
+// The first load decodes the arrays into the module; later loads skip over them and point their protos at the shared copies.
+// Instructions that are 4-byte aligned in the bytecode are used in place, which version 3 guarantees for images at aligned addresses.
+struct luau_Module
+{
+    struct SharedProto
+    {
+        Instruction* code; // points into the bytecode or into storage
+        std::unique_ptr<Instruction[]> storage;
+        std::unique_ptr<uint8_t[]> lineinfo; // same layout as Proto::lineinfo, with abslineinfo after it
+
+        // coverage counters are kept in the instructions, so protos that have them get a private copy in every state
+        bool patched;
+    };
+
+    std::atomic<int> refs;
+
+    // bytecode is either a private copy or an image owned by the caller that stays unchanged until unmap is called
+    std::string copy;
+    const char* data;
+    size_t size;
+
+    bool mapped;
+    void (*unmap)(void* context);
+    void* context;
+
+    std::mutex mutex;
+    std::atomic<bool> ready;
+    std::vector<SharedProto> protos;
+};
+
+static void readCode(Instruction* code, int sizecode, const char* data, size_t size, size_t& offset)
+{
+    for (int j = 0; j < sizecode; ++j)
+        code[j] = read<uint32_t>(data, size, offset);
+}
+
+static void readLineInfo(uint8_t* lineinfo, int* abslineinfo, int sizecode, int intervals, const char* data, size_t size, size_t& offset)
+{
+    uint8_t lastoffset = 0;
+    for (int j = 0; j < sizecode; ++j)
+    {
+        lastoffset += read<uint8_t>(data, size, offset);
+        lineinfo[j] = lastoffset;
+    }
+
+    int lastline = 0;
+    for (int j = 0; j < intervals; ++j)
+    {
+        lastline += read<int32_t>(data, size, offset);
+        abslineinfo[j] = lastline;
+    }
+}
+
+// an aux word can look like a coverage instruction as well, which only costs an unnecessary copy
+static bool hasCoverage(const Instruction* code, int sizecode)
+{
+    for (int j = 0; j < sizecode; ++j)
+        if (LUAU_INSN_OP(code[j]) == LOP_COVERAGE)
+            return true;
+
+    return false;
+}
+
+// when 'module' is set, code and line info come from the module; 'fill' is set for the load that decodes them into it
+static int loadBytecode(lua_State* L, const char* chunkname, const char* data, size_t size, int env, luau_Module* module, bool fill)
 {
     size_t offset = 0;
 
@@ -188,6 +259,13 @@ int luau_load(lua_State* L, const char* chunkname, const char* data, size_t size
     unsigned int protoCount = readVarInt(data, size, offset);
     TempBuffer<Proto*> protos(L, protoCount);
 
+    if (module && fill)
+    {
+        // a previous attempt may have failed half-way
+        module->protos.clear();
+        module->protos.resize(protoCount);
+    }
+
     for (unsigned int i = 0; i < protoCount; ++i)
     {
         Proto* p = luaF_newproto(L);
@@ -199,9 +277,52 @@ int luau_load(lua_State* L, const char* chunkname, const char* data, size_t size
         p->is_vararg = read<uint8_t>(data, size, offset);
 
         p->sizecode = readVarInt(data, size, offset);
-        p->code = luaM_newarray(L, p->sizecode, Instruction, p->memcat);
-        for (int j = 0; j < p->sizecode; ++j)
-            p->code[j] = read<uint32_t>(data, size, offset);
+
+        luau_Module::SharedProto* shared = module ? &module->protos[i] : NULL;
+
+        // version 3 aligns the instructions relative to the start of the bytecode
+        if (version >= 3)
+            offset = (offset + 3) & ~size_t(3);
+
+        if (shared && fill)
+        {
+            if ((uintptr_t(data + offset) & (sizeof(Instruction) - 1)) == 0)
+            {
+                shared->code = reinterpret_cast<Instruction*>(const_cast<char*>(data + offset));
+                offset += sizeof(Instruction) * p->sizecode;
+            }
+            else
+            {
+                shared->storage.reset(new Instruction[p->sizecode]);
+                shared->code = shared->storage.get();
+                readCode(shared->code, p->sizecode, data, size, offset);
+            }
+
+            shared->patched = hasCoverage(shared->code, p->sizecode);
+        }
+        else if (shared)
+        {
+            offset += sizeof(Instruction) * p->sizecode;
+        }
+        else
+        {
+            p->code = luaM_newarray(L, p->sizecode, Instruction, p->memcat);
+            readCode(p->code, p->sizecode, data, size, offset);
+        }
+
+        if (shared && shared->patched)
+        {
+            p->code = luaM_newarray(L, p->sizecode, Instruction, p->memcat);
+            memcpy(p->code, shared->code, sizeof(Instruction) * p->sizecode);
+        }
+        else if (shared)
+        {
+            p->code = shared->code;
+            p->codereadonly = 1;
+
+            p->module = module;
+            luau_retainmodule(module);
+        }
 
         p->sizek = readVarInt(data, size, offset);
         p->k = luaM_newarray(L, p->sizek, TValue, p->memcat);
@@ -302,22 +423,32 @@ int luau_load(lua_State* L, const char* chunkname, const char* data, size_t size
             int absoffset = (p->sizecode + 3) & ~3;
 
             p->sizelineinfo = absoffset + intervals * sizeof(int);
-            p->lineinfo = luaM_newarray(L, p->sizelineinfo, uint8_t, p->memcat);
-            p->abslineinfo = (int*)(p->lineinfo + absoffset);
 
-            uint8_t lastoffset = 0;
-            for (int j = 0; j < p->sizecode; ++j)
+            if (shared && fill)
             {
-                lastoffset += read<uint8_t>(data, size, offset);
-                p->lineinfo[j] = lastoffset;
+                shared->lineinfo.reset(new uint8_t[p->sizelineinfo]);
+                readLineInfo(shared->lineinfo.get(), (int*)(shared->lineinfo.get() + absoffset), p->sizecode, intervals, data, size, offset);
+            }
+            else if (shared)
+            {
+                offset += p->sizecode + sizeof(int32_t) * intervals;
             }
 
-            int lastline = 0;
-            for (int j = 0; j < intervals; ++j)
+            if (shared && !shared->patched)
             {
-                lastline += read<int32_t>(data, size, offset);
-                p->abslineinfo[j] = lastline;
+                p->lineinfo = shared->lineinfo.get();
+            }
+            else
+            {
+                p->lineinfo = luaM_newarray(L, p->sizelineinfo, uint8_t, p->memcat);
+
+                if (shared)
+                    memcpy(p->lineinfo, shared->lineinfo.get(), p->sizelineinfo);
+                else
+                    readLineInfo(p->lineinfo, (int*)(p->lineinfo + absoffset), p->sizecode, intervals, data, size, offset);
             }
+
+            p->abslineinfo = (int*)(p->lineinfo + absoffset);
         }
 
         uint8_t debuginfo = read<uint8_t>(data, size, offset);
@@ -361,3 +492,77 @@ int luau_load(lua_State* L, const char* chunkname, const char* data, size_t size
 
     return 0;
 }
+
+int luau_load(lua_State* L, const char* chunkname, const char* data, size_t size, int env)
+{
+    return loadBytecode(L, chunkname, data, size, env, NULL, false);
+}
+
+luau_Module* luau_newmodule(const char* data, size_t size)
+{
+    luau_Module* module = new luau_Module();
+    module->refs = 1;
+    module->copy.assign(data, size);
+    module->data = module->copy.data();
+    module->size = size;
+    module->mapped = false;
+    module->unmap = NULL;
+    module->context = NULL;
+    module->ready = false;
+
+    return module;
+}
+
+luau_Module* luau_mapmodule(const char* data, size_t size, void (*unmap)(void* context), void* context)
+{
+    luau_Module* module = new luau_Module();
+    module->refs = 1;
+    module->data = data;
+    module->size = size;
+    module->mapped = true;
+    module->unmap = unmap;
+    module->context = context;
+    module->ready = false;
+
+    return module;
+}
+
+int luau_loadmodule(lua_State* L, const char* chunkname, luau_Module* module, int env)
+{
+    if (!module->ready.load(std::memory_order_acquire))
+    {
+        std::unique_lock<std::mutex> lock(module->mutex);
+
+        if (!module->ready.load(std::memory_order_relaxed))
+        {
+            int status = loadBytecode(L, chunkname, module->data, module->size, env, module, /* fill= */ true);
+
+            // bytecode that carries a compile error or has the wrong version is reported again by every load
+            if (status == 0)
+                module->ready.store(true, std::memory_order_release);
+
+            return status;
+        }
+    }
+
+    return loadBytecode(L, chunkname, module->data, module->size, env, module, /* fill= */ false);
+}
+
+void luau_retainmodule(luau_Module* module)
+{
+    module->refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+void luau_releasemodule(luau_Module* module)
+{
+    if (module->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        void (*unmap)(void*) = module->unmap;
+        void* context = module->context;
+
+        delete module;
+
+        if (unmap)
+            unmap(context);
+    }
+}
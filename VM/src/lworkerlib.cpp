@@ -0,0 +1,556 @@
+// This file is part of the Luau programming language and is licensed under MIT License; see LICENSE.txt for details
+#include "lualib.h"
+
+#include "lserialize.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+
+#include <math.h>
+
+#ifndef _WIN32
+#include <poll.h>
+#endif
+
+// Workers are independent VMs, each with its own global state, running on their own OS thread. They share nothing: values are deep-copied
+// into a byte string when sent and decoded on the receiving side. Every VM has one mailbox that its parent and all of its children
+// push into, so mailboxes are multi-producer single-consumer queues that producers never block on.
+
+#define WORKER_HANDLE "workerHandle"
+#define WORKER_STATE "workerState"
+#define WORKER_HANDLES "workerHandles"
+
+// values cross VMs in the structured clone format, which keeps cycles and shared tables
+static std::string writemessage(lua_State* L, int first)
+{
+    std::string out;
+    luaU_serialize(L, first, lua_gettop(L), out);
+    return out;
+}
+
+static int readmessage(lua_State* L, const std::string& message)
+{
+    return luaU_deserialize(L, message.data(), message.size());
+}
+
+/* {======================================================
+** Mailboxes
+** =======================================================*/
+
+struct Worker;
+
+struct WorkerMessage
+{
+    std::atomic<WorkerMessage*> next{nullptr};
+    std::string data;
+    std::shared_ptr<Worker> from; // the child that sent the message, or null for the parent
+};
+
+// Intrusive MPSC queue (D. Vyukov): producers only exchange the head pointer, the single consumer walks from the tail. A consumer with an
+// empty queue sleeps on a condition variable, which producers only touch when someone is sleeping.
+class WorkerMailbox
+{
+public:
+    WorkerMailbox()
+        : head(&stub)
+        , tail(&stub)
+    {
+    }
+
+    ~WorkerMailbox()
+    {
+        while (WorkerMessage* message = pop())
+            delete message;
+    }
+
+    void push(WorkerMessage* message)
+    {
+        link(message);
+
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if (sleeping.load(std::memory_order_relaxed))
+            wake();
+    }
+
+    // wakes up the consumer for good; messages that are already queued can still be received
+    void close()
+    {
+        closed = true;
+        wake();
+    }
+
+    // consumer only; returns null if nothing arrives within 'timeout' seconds (negative waits forever) or the mailbox is closed
+    WorkerMessage* receive(double timeout)
+    {
+        if (WorkerMessage* message = pop())
+            return message;
+
+        if (timeout == 0)
+            return nullptr;
+
+        auto deadline = std::chrono::steady_clock::now() +
+                        std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(timeout < 0 ? 0 : timeout));
+
+        std::unique_lock<std::mutex> lock(mutex);
+        WorkerMessage* message = nullptr;
+
+        for (;;)
+        {
+            sleeping.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            // a producer either sees 'sleeping' or finished linking its message before this pop
+            if ((message = pop()) || closed)
+                break;
+
+            if (timeout < 0)
+                wakeup.wait(lock);
+            else if (wakeup.wait_until(lock, deadline) == std::cv_status::timeout)
+                break;
+        }
+
+        sleeping.store(false, std::memory_order_relaxed);
+        return message ? message : pop();
+    }
+
+private:
+    void link(WorkerMessage* message)
+    {
+        message->next.store(nullptr, std::memory_order_relaxed);
+        WorkerMessage* prev = head.exchange(message);
+        prev->next.store(message, std::memory_order_release);
+    }
+
+    void wake()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        wakeup.notify_one();
+    }
+
+    WorkerMessage* pop()
+    {
+        WorkerMessage* t = tail;
+        WorkerMessage* next = t->next.load(std::memory_order_acquire);
+
+        if (t == &stub)
+        {
+            // the stub is only a placeholder, skip it
+            if (!next)
+                return nullptr;
+
+            tail = next;
+            t = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+
+        if (next)
+        {
+            tail = next;
+            return t;
+        }
+
+        // t is the last message; a producer may be half-way through linking a new one
+        if (t != head.load(std::memory_order_acquire))
+            return nullptr;
+
+        // put the stub back behind the last message so that it can be unlinked
+        link(&stub);
+
+        next = t->next.load(std::memory_order_acquire);
+        if (next)
+        {
+            tail = next;
+            return t;
+        }
+
+        return nullptr;
+    }
+
+    std::atomic<WorkerMessage*> head;
+    WorkerMessage* tail;
+    WorkerMessage stub;
+
+    std::atomic<bool> sleeping{false};
+    std::atomic<bool> closed{false};
+    std::mutex mutex;
+    std::condition_variable wakeup;
+};
+
+/* }====================================================== */
+
+/* {======================================================
+** Workers
+** =======================================================*/
+
+typedef void (*WorkerInit)(lua_State* L);
+
+struct Worker
+{
+    std::shared_ptr<WorkerMailbox> mailbox = std::make_shared<WorkerMailbox>();
+    std::thread thread;
+
+    // written by the worker thread before it exits
+    bool ok = false;
+    std::string result; // message with the values returned by the script, or the error
+};
+
+// per-VM state, kept in the registry
+struct WorkerState
+{
+    std::shared_ptr<WorkerMailbox> mailbox = std::make_shared<WorkerMailbox>();
+    std::shared_ptr<WorkerMailbox> parent; // null unless this VM is a worker
+    std::shared_ptr<Worker> self;
+    WorkerInit init = nullptr;
+};
+
+static WorkerState* getworkerstate(lua_State* L)
+{
+    lua_getfield(L, LUA_REGISTRYINDEX, WORKER_STATE);
+    WorkerState* S = (WorkerState*)lua_touserdata(L, -1);
+    lua_pop(L, 1);
+
+    if (!S)
+    {
+        S = (WorkerState*)lua_newuserdatadtor(L, sizeof(WorkerState), [](void* ud) {
+            static_cast<WorkerState*>(ud)->~WorkerState();
+        });
+        new (S) WorkerState();
+
+        lua_setfield(L, LUA_REGISTRYINDEX, WORKER_STATE);
+    }
+
+    return S;
+}
+
+void luaL_setworkerinit(lua_State* L, void (*init)(lua_State* L))
+{
+    getworkerstate(L)->init = init;
+}
+
+// calls the script and hands its results to the worker; yields made by the script resume through the task scheduler
+static const char* const kWorkerMain = "local done, worker, main = ... return done(worker, main(select(4, ...)))";
+
+static int finishworker(lua_State* L)
+{
+    Worker* worker = (Worker*)lua_tolightuserdata(L, 1);
+    worker->result = writemessage(L, 2);
+    worker->ok = true;
+    return 0;
+}
+
+static int loadworker(lua_State* L)
+{
+    Worker* worker = (Worker*)lua_tolightuserdata(L, 1);
+    const std::string* source = (const std::string*)lua_tolightuserdata(L, 2);
+    const std::string* args = (const std::string*)lua_tolightuserdata(L, 3);
+    lua_settop(L, 0);
+
+    for (int i = 0; i < 2; ++i)
+    {
+        lua_getglobal(L, "loadstring");
+
+        if (i == 0)
+            lua_pushstring(L, kWorkerMain);
+        else
+            lua_pushlstring(L, source->data(), source->size());
+
+        lua_pushstring(L, i == 0 ? "=workermain" : "=worker");
+        lua_call(L, 2, 2);
+
+        if (lua_isnil(L, -2))
+            lua_error(L);
+
+        lua_pop(L, 1);
+
+        if (i == 0)
+        {
+            lua_pushcfunction(L, finishworker, "finishworker");
+            lua_pushlightuserdata(L, worker);
+        }
+    }
+
+    return lua_gettop(L) + readmessage(L, *args);
+}
+
+// waits until a task source has work or 'timeout' seconds pass; a negative timeout waits for the sources only
+static void waittasks(lua_State* L, double timeout)
+{
+    int fds[16];
+    int count = std::min(luaL_pollfds(L, fds, 16), 16);
+
+#ifndef _WIN32
+    if (count > 0)
+    {
+        pollfd pfds[16];
+        for (int i = 0; i < count; ++i)
+        {
+            pfds[i].fd = fds[i];
+            pfds[i].events = POLLIN;
+            pfds[i].revents = 0;
+        }
+
+        poll(pfds, count, timeout < 0 ? -1 : int(ceil(timeout * 1000)));
+        return;
+    }
+#endif
+
+    // without descriptors to wait on, check back on the sources every millisecond
+    if (count > 0 || timeout < 0)
+        timeout = timeout < 0 ? 0.001 : std::min(timeout, 0.001);
+
+    std::this_thread::sleep_for(std::chrono::duration<double>(timeout));
+}
+
+// the state is set up by the spawning thread, so that a missing compiler is reported by worker.spawn; the worker thread takes it over
+static lua_State* newworkerstate(lua_State* P, const std::shared_ptr<Worker>& worker)
+{
+    WorkerState* PS = getworkerstate(P);
+
+    lua_State* L = luaL_newstate();
+
+    if (PS->init)
+        PS->init(L);
+    else
+        luaL_openlibs(L);
+
+    lua_getglobal(L, "loadstring");
+    bool compiler = lua_isfunction(L, -1);
+    lua_pop(L, 1);
+
+    if (!compiler)
+    {
+        lua_close(L);
+        luaL_error(P, "workers need a global 'loadstring' to compile their source; provide one with luaL_setworkerinit");
+    }
+
+    WorkerState* S = getworkerstate(L);
+    S->mailbox = worker->mailbox;
+    S->parent = PS->mailbox;
+    S->self = worker;
+    S->init = PS->init;
+
+    return L;
+}
+
+static void runworker(std::shared_ptr<Worker> worker, lua_State* L, std::string source, std::string args)
+{
+    // the script runs in a thread of its own so that it can wait for tasks and async requests
+    lua_State* T = lua_newthread(L);
+    luaL_sandboxthread(T);
+
+    lua_pushcfunction(T, loadworker, "worker");
+    lua_pushlightuserdata(T, worker.get());
+    lua_pushlightuserdata(T, &source);
+    lua_pushlightuserdata(T, &args);
+
+    lua_State* E = T; // thread that holds the error, if any
+    int status = lua_pcall(T, 3, LUA_MULTRET, 0);
+
+    if (status == LUA_OK)
+        status = lua_resume(T, NULL, lua_gettop(T) - 1);
+
+    while ((status == LUA_OK || status == LUA_YIELD) && luaL_pendingtasks(L) > 0)
+    {
+        double next = luaL_nextdeadline(L);
+
+        if (next != 0)
+            waittasks(L, next < 0 ? -1 : std::max(next - lua_clock(), 0.0));
+
+        status = luaL_runtasks(L, lua_clock(), 0);
+        E = L;
+    }
+
+    if (status == LUA_OK || status == LUA_YIELD)
+    {
+        if (!worker->ok)
+            worker->result = "worker yielded unexpectedly";
+    }
+    else
+    {
+        size_t len = 0;
+        const char* error = lua_tolstring(E, -1, &len);
+        worker->result = error ? std::string(error, len) : std::string("error object is not a string");
+        worker->ok = false;
+    }
+
+    lua_close(L);
+}
+
+static std::shared_ptr<Worker>& checkhandle(lua_State* L, int idx)
+{
+    return *(std::shared_ptr<Worker>*)luaL_checkudata(L, idx, WORKER_HANDLE);
+}
+
+static int worker_spawn(lua_State* L)
+{
+    size_t len = 0;
+    const char* source = luaL_checklstring(L, 1, &len);
+
+    std::string args = writemessage(L, 2);
+
+    std::shared_ptr<Worker> worker = std::make_shared<Worker>();
+    lua_State* WL = newworkerstate(L, worker);
+
+    void* ud = lua_newuserdatadtor(L, sizeof(std::shared_ptr<Worker>), [](void* ud) {
+        std::shared_ptr<Worker>& worker = *(std::shared_ptr<Worker>*)ud;
+
+        // nobody can send to or join the worker anymore; it finishes on its own
+        worker->mailbox->close();
+
+        if (worker->thread.joinable())
+            worker->thread.detach();
+
+        worker.~shared_ptr();
+    });
+    new (ud) std::shared_ptr<Worker>(worker);
+
+    luaL_getmetatable(L, WORKER_HANDLE);
+    lua_setmetatable(L, -2);
+
+    // messages from the worker find their handle through this table while the handle is alive
+    lua_getfield(L, LUA_REGISTRYINDEX, WORKER_HANDLES);
+    lua_pushlightuserdata(L, worker.get());
+    lua_pushvalue(L, -3);
+    lua_rawset(L, -3);
+    lua_pop(L, 1);
+
+    worker->thread = std::thread(runworker, worker, WL, std::string(source, len), std::move(args));
+
+    return 1;
+}
+
+static void post(lua_State* L, WorkerMailbox& mailbox, int first, const std::shared_ptr<Worker>& from)
+{
+    std::unique_ptr<WorkerMessage> message(new WorkerMessage());
+    message->data = writemessage(L, first);
+    message->from = from;
+
+    mailbox.push(message.release());
+}
+
+static int worker_send(lua_State* L)
+{
+    WorkerState* S = getworkerstate(L);
+
+    if (!S->parent)
+        luaL_error(L, "worker.send can only be used inside a worker");
+
+    post(L, *S->parent, 1, S->self);
+    return 0;
+}
+
+static int worker_receive(lua_State* L)
+{
+    double timeout = luaL_optnumber(L, 1, -1);
+    WorkerState* S = getworkerstate(L);
+
+    std::unique_ptr<WorkerMessage> message(S->mailbox->receive(timeout));
+    if (!message)
+        return 0;
+
+    int count = readmessage(L, message->data);
+
+    // the sender goes first: the handle of the worker that sent the message, or nil for the parent
+    if (message->from)
+    {
+        lua_getfield(L, LUA_REGISTRYINDEX, WORKER_HANDLES);
+        lua_pushlightuserdata(L, message->from.get());
+        lua_rawget(L, -2);
+        lua_remove(L, -2);
+    }
+    else
+    {
+        lua_pushnil(L);
+    }
+
+    lua_insert(L, -count - 1);
+    return count + 1;
+}
+
+static int worker_cores(lua_State* L)
+{
+    unsigned cores = std::thread::hardware_concurrency();
+    lua_pushinteger(L, cores ? int(cores) : 1);
+    return 1;
+}
+
+static int handle_send(lua_State* L)
+{
+    std::shared_ptr<Worker>& worker = checkhandle(L, 1);
+
+    post(L, *worker->mailbox, 2, std::shared_ptr<Worker>());
+    return 0;
+}
+
+static int handle_join(lua_State* L)
+{
+    std::shared_ptr<Worker>& worker = checkhandle(L, 1);
+
+    if (worker->thread.joinable())
+        worker->thread.join();
+
+    lua_pushboolean(L, worker->ok);
+
+    if (!worker->ok)
+    {
+        lua_pushlstring(L, worker->result.data(), worker->result.size());
+        return 2;
+    }
+
+    return 1 + readmessage(L, worker->result);
+}
+
+static int handle_tostring(lua_State* L)
+{
+    checkhandle(L, 1);
+    lua_pushstring(L, WORKER_HANDLE);
+    return 1;
+}
+
+static const luaL_Reg handle_methods[] = {
+    {"send", handle_send},
+    {"join", handle_join},
+    {NULL, NULL},
+};
+
+/* }====================================================== */
+
+static const luaL_Reg workerlib[] = {
+    {"spawn", worker_spawn},
+    {"send", worker_send},
+    {"receive", worker_receive},
+    {"cores", worker_cores},
+    {NULL, NULL},
+};
+
+int luaopen_worker(lua_State* L)
+{
+    luaL_register(L, LUA_WORKERLIBNAME, workerlib);
+
+    luaL_newmetatable(L, WORKER_HANDLE);
+    lua_createtable(L, 0, 2);
+    luaL_register(L, NULL, handle_methods);
+    lua_setfield(L, -2, "__index");
+    lua_pushcfunction(L, handle_tostring, "__tostring");
+    lua_setfield(L, -2, "__tostring");
+    lua_pop(L, 1);
+
+    lua_newtable(L);
+    lua_createtable(L, 0, 1);
+    lua_pushliteral(L, "v");
+    lua_setfield(L, -2, "__mode");
+    lua_setmetatable(L, -2);
+    lua_setfield(L, LUA_REGISTRYINDEX, WORKER_HANDLES);
+
+    getworkerstate(L);
+
+    return 1;
+}
@@ -0,0 +1,54 @@
+local bench = script and require(script.Parent.bench_support) or require("bench_support")
+
+local bytes = {}
+for i = 1, 1024 * 1024 do
+	bytes[i] = string.char((i * 7919) % 256)
+end
+
+local data = table.concat(bytes)
+local encoded = base64.encode(data)
+
+local function reportThroughput(name, f, input, size)
+	local ts0 = os.clock()
+	for i = 1, 20 do
+		f(input)
+	end
+	local ts1 = os.clock()
+
+	print(string.format("%s: %.1f MB/s", name, size * 20 / 1e6 / (ts1 - ts0)))
+end
+
+reportThroughput("base64.encode", base64.encode, data, #data)
+reportThroughput("base64.decode", base64.decode, encoded, #encoded)
+
+bench.runCode(function()
+	for i = 1, 20 do
+		base64.encode(data)
+	end
+end, "base64: encode 1 MB")
+
+bench.runCode(function()
+	for i = 1, 20 do
+		base64.decode(encoded)
+	end
+end, "base64: decode 1 MB")
+
+bench.runCode(function()
+	for i = 1, 20 do
+		local e = base64.encoder()
+		for pos = 1, #data, 65536 do
+			e:update(string.sub(data, pos, pos + 65535))
+		end
+		e:finish()
+	end
+end, "base64: encoder 1 MB (64 KB chunks)")
+
+bench.runCode(function()
+	for i = 1, 20 do
+		local d = base64.decoder()
+		for pos = 1, #encoded, 65536 do
+			d:update(string.sub(encoded, pos, pos + 65535))
+		end
+		d:finish()
+	end
+end, "base64: decoder 1 MB (64 KB chunks)")
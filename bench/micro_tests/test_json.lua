@@ -0,0 +1,444 @@
+local bench = script and require(script.Parent.bench_support) or require("bench_support")
+
+-- Reference implementation: rxi/json.lua 0.1.2 (Copyright (c) 2020 rxi, MIT License), which the json library used to be translated from
+local luajson = {}
+
+do
+	local encode
+
+	local escape_char_map = {
+		[ "\\" ] = "\\",
+		[ "\"" ] = "\"",
+		[ "\b" ] = "b",
+		[ "\f" ] = "f",
+		[ "\n" ] = "n",
+		[ "\r" ] = "r",
+		[ "\t" ] = "t",
+	}
+
+	local escape_char_map_inv = { [ "/" ] = "/" }
+	for k, v in pairs(escape_char_map) do
+		escape_char_map_inv[v] = k
+	end
+
+	local function escape_char(c)
+		return "\\" .. (escape_char_map[c] or string.format("u%04x", c:byte()))
+	end
+
+	local function encode_nil(val)
+		return "null"
+	end
+
+	local function encode_table(val, stack)
+		local res = {}
+		stack = stack or {}
+		if stack[val] then error("circular reference") end
+		stack[val] = true
+		if rawget(val, 1) ~= nil or next(val) == nil then
+			local n = 0
+			for k in pairs(val) do
+				if type(k) ~= "number" then
+					error("invalid table: mixed or invalid key types")
+				end
+				n = n + 1
+			end
+			if n ~= #val then
+				error("invalid table: sparse array")
+			end
+			for i, v in ipairs(val) do
+				table.insert(res, encode(v, stack))
+			end
+			stack[val] = nil
+			return "[" .. table.concat(res, ",") .. "]"
+		else
+			for k, v in pairs(val) do
+				if type(k) ~= "string" then
+					error("invalid table: mixed or invalid key types")
+				end
+				table.insert(res, encode(k, stack) .. ":" .. encode(v, stack))
+			end
+			stack[val] = nil
+			return "{" .. table.concat(res, ",") .. "}"
+		end
+	end
+
+	local function encode_string(val)
+		return '"' .. val:gsub('[%z\1-\31\\"]', escape_char) .. '"'
+	end
+
+	local function encode_number(val)
+		if val ~= val or val <= -math.huge or val >= math.huge then
+			error("unexpected number value '" .. tostring(val) .. "'")
+		end
+		return string.format("%.14g", val)
+	end
+
+	local type_func_map = {
+		[ "nil"     ] = encode_nil,
+		[ "table"   ] = encode_table,
+		[ "string"  ] = encode_string,
+		[ "number"  ] = encode_number,
+		[ "boolean" ] = tostring,
+	}
+
+	encode = function(val, stack)
+		local t = type(val)
+		local f = type_func_map[t]
+		if f then
+			return f(val, stack)
+		end
+		error("unexpected type '" .. t .. "'")
+	end
+
+	function luajson.encode(val)
+		return ( encode(val) )
+	end
+
+	local parse
+
+	local function create_set(...)
+		local res = {}
+		for i = 1, select("#", ...) do
+			res[ select(i, ...) ] = true
+		end
+		return res
+	end
+
+	local space_chars   = create_set(" ", "\t", "\r", "\n")
+	local delim_chars   = create_set(" ", "\t", "\r", "\n", "]", "}", ",")
+	local escape_chars  = create_set("\\", "/", '"', "b", "f", "n", "r", "t", "u")
+	local literals      = create_set("true", "false", "null")
+
+	local literal_map = {
+		[ "true"  ] = true,
+		[ "false" ] = false,
+		[ "null"  ] = nil,
+	}
+
+	local function next_char(str, idx, set, negate)
+		for i = idx, #str do
+			if set[str:sub(i, i)] ~= negate then
+				return i
+			end
+		end
+		return #str + 1
+	end
+
+	local function decode_error(str, idx, msg)
+		local line_count = 1
+		local col_count = 1
+		for i = 1, idx - 1 do
+			col_count = col_count + 1
+			if str:sub(i, i) == "\n" then
+				line_count = line_count + 1
+				col_count = 1
+			end
+		end
+		error( string.format("%s at line %d col %d", msg, line_count, col_count) )
+	end
+
+	local function codepoint_to_utf8(n)
+		local f = math.floor
+		if n <= 0x7f then
+			return string.char(n)
+		elseif n <= 0x7ff then
+			return string.char(f(n / 64) + 192, n % 64 + 128)
+		elseif n <= 0xffff then
+			return string.char(f(n / 4096) + 224, f(n % 4096 / 64) + 128, n % 64 + 128)
+		elseif n <= 0x10ffff then
+			return string.char(f(n / 262144) + 240, f(n % 262144 / 4096) + 128,
+				f(n % 4096 / 64) + 128, n % 64 + 128)
+		end
+		error( string.format("invalid unicode codepoint '%x'", n) )
+	end
+
+	local function parse_unicode_escape(s)
+		local n1 = tonumber( s:sub(1, 4),  16 )
+		local n2 = tonumber( s:sub(7, 10), 16 )
+		if n2 then
+			return codepoint_to_utf8((n1 - 0xd800) * 0x400 + (n2 - 0xdc00) + 0x10000)
+		else
+			return codepoint_to_utf8(n1)
+		end
+	end
+
+	local function parse_string(str, i)
+		local res = ""
+		local j = i + 1
+		local k = j
+
+		while j <= #str do
+			local x = str:byte(j)
+
+			if x < 32 then
+				decode_error(str, j, "control character in string")
+			elseif x == 92 then
+				res = res .. str:sub(k, j - 1)
+				j = j + 1
+				local c = str:sub(j, j)
+				if c == "u" then
+					local hex = str:match("^[dD][89aAbB]%x%x\\u%x%x%x%x", j + 1)
+						or str:match("^%x%x%x%x", j + 1)
+						or decode_error(str, j - 1, "invalid unicode escape in string")
+					res = res .. parse_unicode_escape(hex)
+					j = j + #hex
+				else
+					if not escape_chars[c] then
+						decode_error(str, j - 1, "invalid escape char '" .. c .. "' in string")
+					end
+					res = res .. escape_char_map_inv[c]
+				end
+				k = j + 1
+			elseif x == 34 then
+				res = res .. str:sub(k, j - 1)
+				return res, j + 1
+			end
+
+			j = j + 1
+		end
+
+		decode_error(str, i, "expected closing quote for string")
+	end
+
+	local function parse_number(str, i)
+		local x = next_char(str, i, delim_chars)
+		local s = str:sub(i, x - 1)
+		local n = tonumber(s)
+		if not n then
+			decode_error(str, i, "invalid number '" .. s .. "'")
+		end
+		return n, x
+	end
+
+	local function parse_literal(str, i)
+		local x = next_char(str, i, delim_chars)
+		local word = str:sub(i, x - 1)
+		if not literals[word] then
+			decode_error(str, i, "invalid literal '" .. word .. "'")
+		end
+		return literal_map[word], x
+	end
+
+	local function parse_array(str, i)
+		local res = {}
+		local n = 1
+		i = i + 1
+		while 1 do
+			local x
+			i = next_char(str, i, space_chars, true)
+			if str:sub(i, i) == "]" then
+				i = i + 1
+				break
+			end
+			x, i = parse(str, i)
+			res[n] = x
+			n = n + 1
+			i = next_char(str, i, space_chars, true)
+			local chr = str:sub(i, i)
+			i = i + 1
+			if chr == "]" then break end
+			if chr ~= "," then decode_error(str, i, "expected ']' or ','") end
+		end
+		return res, i
+	end
+
+	local function parse_object(str, i)
+		local res = {}
+		i = i + 1
+		while 1 do
+			local key, val
+			i = next_char(str, i, space_chars, true)
+			if str:sub(i, i) == "}" then
+				i = i + 1
+				break
+			end
+			if str:sub(i, i) ~= '"' then
+				decode_error(str, i, "expected string for key")
+			end
+			key, i = parse(str, i)
+			i = next_char(str, i, space_chars, true)
+			if str:sub(i, i) ~= ":" then
+				decode_error(str, i, "expected ':' after key")
+			end
+			i = next_char(str, i + 1, space_chars, true)
+			val, i = parse(str, i)
+			res[key] = val
+			i = next_char(str, i, space_chars, true)
+			local chr = str:sub(i, i)
+			i = i + 1
+			if chr == "}" then break end
+			if chr ~= "," then decode_error(str, i, "expected '}' or ','") end
+		end
+		return res, i
+	end
+
+	local char_func_map = {
+		[ '"' ] = parse_string,
+		[ "0" ] = parse_number,
+		[ "1" ] = parse_number,
+		[ "2" ] = parse_number,
+		[ "3" ] = parse_number,
+		[ "4" ] = parse_number,
+		[ "5" ] = parse_number,
+		[ "6" ] = parse_number,
+		[ "7" ] = parse_number,
+		[ "8" ] = parse_number,
+		[ "9" ] = parse_number,
+		[ "-" ] = parse_number,
+		[ "t" ] = parse_literal,
+		[ "f" ] = parse_literal,
+		[ "n" ] = parse_literal,
+		[ "[" ] = parse_array,
+		[ "{" ] = parse_object,
+	}
+
+	parse = function(str, idx)
+		local chr = str:sub(idx, idx)
+		local f = char_func_map[chr]
+		if f then
+			return f(str, idx)
+		end
+		decode_error(str, idx, "unexpected character '" .. chr .. "'")
+	end
+
+	function luajson.decode(str)
+		if type(str) ~= "string" then
+			error("expected argument of type string, got " .. type(str))
+		end
+		local res, idx = parse(str, next_char(str, 1, space_chars, true))
+		idx = next_char(str, idx, space_chars, true)
+		if idx <= #str then
+			decode_error(str, idx, "trailing garbage")
+		end
+		return res
+	end
+end
+
+-- Typical API payload: an array of records with a mix of strings, numbers, booleans and nested values
+local function makeDocument(count)
+	local items = {}
+
+	for i = 1, count do
+		items[i] = {
+			id = i,
+			name = "item number " .. i,
+			description = "line one\nline \"two\" with a tab\tand a unicode char é",
+			price = i * 1.25,
+			available = i % 3 ~= 0,
+			tags = {"alpha", "beta", "gamma"},
+			dimensions = {width = i % 17, height = i % 31, depth = 0.5},
+		}
+	end
+
+	return {items = items, total = count, page = 1}
+end
+
+local document = makeDocument(1000)
+local text = json.encode(document)
+
+assert(luajson.encode(document) ~= nil)
+assert(#luajson.encode(luajson.decode(text)) == #text)
+
+local function reportThroughput(name, encode, decode)
+	local ts0 = os.clock()
+	for i = 1, 10 do
+		encode(document)
+	end
+	local ts1 = os.clock()
+	for i = 1, 10 do
+		decode(text)
+	end
+	local ts2 = os.clock()
+
+	local mb = #text * 10 / 1e6
+	print(string.format("%s: encode %.1f MB/s, decode %.1f MB/s", name, mb / (ts1 - ts0), mb / (ts2 - ts1)))
+end
+
+reportThroughput("json", json.encode, json.decode)
+reportThroughput("json.lua", luajson.encode, luajson.decode)
+
+-- String-heavy payload where decoding time is dominated by scanning string contents
+local strings = {}
+for i = 1, 1000 do
+	strings[i] = string.rep("lorem ipsum dolor sit amet ", 40) .. (i % 10 == 0 and "\n" or "")
+end
+
+local stringsText = json.encode(strings)
+
+do
+	local ts0 = os.clock()
+	for i = 1, 10 do
+		json.encode(strings)
+	end
+	local ts1 = os.clock()
+	for i = 1, 10 do
+		json.decode(stringsText)
+	end
+	local ts2 = os.clock()
+
+	local mb = #stringsText * 10 / 1e6
+	print(string.format("json (strings): encode %.1f MB/s, decode %.1f MB/s", mb / (ts1 - ts0), mb / (ts2 - ts1)))
+end
+
+bench.runCode(function()
+	for i = 1, 10 do
+		json.decode(text)
+	end
+end, "json: decode")
+
+bench.runCode(function()
+	for i = 1, 10 do
+		luajson.decode(text)
+	end
+end, "json: decode (json.lua)")
+
+bench.runCode(function()
+	for i = 1, 10 do
+		local d = json.decoder({depth = 2})
+		for pos = 1, #text, 65536 do
+			d:update(string.sub(text, pos, pos + 65535))
+		end
+		d:finish()
+	end
+end, "json: decoder (64 KB chunks)")
+
+bench.runCode(function()
+	for i = 1, 10 do
+		json.encode(document)
+	end
+end, "json: encode")
+
+bench.runCode(function()
+	for i = 1, 10 do
+		luajson.encode(document)
+	end
+end, "json: encode (json.lua)")
+
+bench.runCode(function()
+	for i = 1, 10 do
+		json.encode(document, {sortKeys = true, pretty = true})
+	end
+end, "json: encode (sortKeys, pretty)")
+
+bench.runCode(function()
+	for i = 1, 10 do
+		json.decode(stringsText)
+	end
+end, "json: decode strings")
+
+-- Reading a few fields out of a large document
+local recordText = json.encode(makeDocument(200))
+
+bench.runCode(function()
+	for i = 1, 100 do
+		local doc = json.decode(recordText)
+		assert(doc.total == 200 and doc.items[100].name == "item number 100")
+	end
+end, "json: read fields (decode)")
+
+bench.runCode(function()
+	for i = 1, 100 do
+		local doc = json.parse_lazy(recordText)
+		assert(doc.total == 200 and doc.items[100].name == "item number 100")
+	end
+end, "json: read fields (parse_lazy)")
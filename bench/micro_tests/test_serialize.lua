@@ -0,0 +1,36 @@
+local bench = script and require(script.Parent.bench_support) or require("bench_support")
+
+-- the same records go through json and the structured clone format
+local records = {}
+for i = 1, 10000 do
+	records[i] = {id = i, name = "record" .. i, score = i * 0.25, active = i % 2 == 0, tags = {"alpha", "beta", "gamma"}}
+end
+
+local encodedJson = json.encode(records)
+local encodedClone = serialize.encode(records)
+
+print(string.format("json: %d bytes, serialize: %d bytes", #encodedJson, #encodedClone))
+
+bench.runCode(function()
+	for i = 1, 5 do
+		json.encode(records)
+	end
+end, "serialize: json.encode 10k records")
+
+bench.runCode(function()
+	for i = 1, 5 do
+		serialize.encode(records)
+	end
+end, "serialize: serialize.encode 10k records")
+
+bench.runCode(function()
+	for i = 1, 5 do
+		json.decode(encodedJson)
+	end
+end, "serialize: json.decode 10k records")
+
+bench.runCode(function()
+	for i = 1, 5 do
+		serialize.decode(encodedClone)
+	end
+end, "serialize: serialize.decode 10k records")
@@ -0,0 +1,33 @@
+#!/usr/bin/python3
+# This file is part of the Luau programming language and is licensed under MIT License; see LICENSE.txt for details
+
+# Keep-alive HTTP/1.1 stand-in upstream for the network benchmarks in this folder
+# Usage: python3 loopback_server.py [port], then python3 ../bench.py --folder network
+import http.server
+import sys
+
+class Handler(http.server.BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+    # headers and body go out in separate writes; don't let Nagle hold back the body on reused connections
+    disable_nagle_algorithm = True
+
+    def respond(self):
+        length = int(self.headers.get("Content-Length", 0))
+        if length:
+            self.rfile.read(length)
+
+        body = b'{"ok": true}'
+        self.send_response(200)
+        self.send_header("Content-Type", "application/json")
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+    do_GET = respond
+    do_POST = respond
+
+    def log_message(self, format, *args):
+        pass
+
+port = int(sys.argv[1]) if len(sys.argv) > 1 else 8642
+http.server.ThreadingHTTPServer(("127.0.0.1", port), Handler).serve_forever()
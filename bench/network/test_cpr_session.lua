@@ -0,0 +1,34 @@
+local bench = script and require(script.Parent.bench_support) or require("bench_support")
+
+-- expects network/loopback_server.py to be listening
+local base = "http://127.0.0.1:8642"
+local count = 200
+
+local session = cpr.session(base)
+
+local function reportLatency(name, f)
+	f() -- warm up the pool
+
+	local ts0 = os.clock()
+	for i = 1, count do
+		f()
+	end
+	local ts1 = os.clock()
+
+	print(string.format("%s: %.1f us/request", name, (ts1 - ts0) * 1e6 / count))
+end
+
+reportLatency("cpr.get", function() return cpr.get(base .. "/get") end)
+reportLatency("session:get", function() return session:get("/get") end)
+
+bench.runCode(function()
+	for i = 1, count do
+		cpr.get(base .. "/get")
+	end
+end, "cpr: 200 sequential requests, new connection each")
+
+bench.runCode(function()
+	for i = 1, count do
+		session:get("/get")
+	end
+end, "cpr: 200 sequential requests, pooled session")
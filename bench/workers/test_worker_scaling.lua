@@ -0,0 +1,65 @@
+local bench = script and require(script.Parent.bench_support) or require("bench_support")
+
+-- a fixed amount of CPU-bound work is split between 1, 2, 4, ... workers; on an idle machine the time drops until workers outnumber cores
+local work = 4000000
+local cores = worker.cores()
+
+local source = [[
+	local first, last = ...
+	local sum = 0
+	for i = first, last do
+		sum += math.sqrt(i) % 7
+	end
+	return sum
+]]
+
+local function run(count)
+	local chunk = math.floor(work / count)
+	local handles = {}
+
+	for i = 1, count do
+		handles[i] = worker.spawn(source, (i - 1) * chunk + 1, i * chunk)
+	end
+
+	for i = 1, count do
+		assert(handles[i]:join())
+	end
+end
+
+-- messages round-trip through two mailboxes
+local function pingpong(messages)
+	local echo = worker.spawn([[
+		while true do
+			local _, msg = worker.receive()
+			if msg == nil then
+				return
+			end
+			worker.send(msg)
+		end
+	]])
+
+	local payload = {name = "payload", values = {1, 2, 3, 4, 5, 6, 7, 8}}
+
+	for i = 1, messages do
+		echo:send(payload)
+		worker.receive()
+	end
+
+	echo:send(nil)
+	echo:join()
+end
+
+print(string.format("%d cores", cores))
+
+local count = 1
+while count <= cores * 2 do
+	local n = count
+	bench.runCode(function()
+		run(n)
+	end, string.format("worker: %d workers", n))
+	count *= 2
+end
+
+bench.runCode(function()
+	pingpong(10000)
+end, "worker: 10000 message round trips")
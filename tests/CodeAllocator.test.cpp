@@ -0,0 +1,199 @@
+// This file is part of the Luau programming language and is licensed under MIT License; see LICENSE.txt for details
+#include "Luau/AssemblyBuilderX64.h"
+#include "Luau/CodeAllocator.h"
+#include "Luau/UnwindBuilder.h"
+
+#include "doctest.h"
+
+#include <stdexcept>
+#include <string>
+
+#include <string.h>
+
+using namespace Luau::CodeGen;
+
+TEST_SUITE_BEGIN("CodeAllocation");
+
+TEST_CASE("SizeClasses")
+{
+    CodeAllocator allocator(1024 * 1024, nullptr);
+
+    allocator.beginWrite();
+
+    uint8_t* a = allocator.allocate(10);
+    uint8_t* b = allocator.allocate(64);
+    uint8_t* c = allocator.allocate(100);
+    uint8_t* d = allocator.allocate(5000);
+
+    REQUIRE(a);
+    REQUIRE(b);
+    REQUIRE(c);
+    REQUIRE(d);
+
+    // small allocations of the same class share a page, other classes and large allocations get their own pages
+    CHECK(b == a + 64);
+    CHECK(uintptr_t(c) / CodeAllocator::kPageSize != uintptr_t(a) / CodeAllocator::kPageSize);
+    CHECK(uintptr_t(d) % CodeAllocator::kPageSize == 0);
+
+    memset(d, 0xcc, 5000);
+
+    CHECK(allocator.getAllocatedSize() == 64 + 64 + 128 + 2 * CodeAllocator::kPageSize);
+
+    CHECK(allocator.endWrite());
+
+    allocator.deallocate(a, 10);
+    allocator.deallocate(b, 64);
+    allocator.deallocate(c, 100);
+    allocator.deallocate(d, 5000);
+
+    CHECK(allocator.getAllocatedSize() == 0);
+}
+
+TEST_CASE("LiveCodeIsNeverWritable")
+{
+    CodeAllocator allocator(1024 * 1024, nullptr);
+
+    allocator.beginWrite();
+    uint8_t* a = allocator.allocate(64);
+    uint8_t* b = allocator.allocate(64);
+    CHECK(allocator.endWrite());
+
+    // the page holding 'a' and 'b' has live code, so the next batch opens a new page even though there is room left
+    allocator.beginWrite();
+    uint8_t* c = allocator.allocate(64);
+    CHECK(allocator.endWrite());
+
+    CHECK(uintptr_t(c) / CodeAllocator::kPageSize != uintptr_t(a) / CodeAllocator::kPageSize);
+
+    // once all of its code is gone, the page is reused for any size
+    allocator.deallocate(a, 64);
+    allocator.deallocate(b, 64);
+
+    allocator.beginWrite();
+    uint8_t* d = allocator.allocate(2048);
+    CHECK(allocator.endWrite());
+
+    CHECK(d == a);
+
+    allocator.deallocate(c, 64);
+    allocator.deallocate(d, 2048);
+}
+
+TEST_CASE("Exhaustion")
+{
+    CodeAllocator allocator(4 * CodeAllocator::kPageSize, nullptr);
+
+    allocator.beginWrite();
+
+    uint8_t* a = allocator.allocate(3 * CodeAllocator::kPageSize);
+    uint8_t* b = allocator.allocate(2 * CodeAllocator::kPageSize);
+    uint8_t* c = allocator.allocate(CodeAllocator::kPageSize);
+
+    CHECK(a);
+    CHECK(!b);
+    CHECK(c);
+    CHECK(!allocator.allocate(1));
+
+    CHECK(allocator.endWrite());
+
+    allocator.deallocate(a, 3 * CodeAllocator::kPageSize);
+    allocator.deallocate(c, CodeAllocator::kPageSize);
+}
+
+static int nearbyFunction()
+{
+    return 42;
+}
+
+TEST_CASE("Reachability")
+{
+    CodeAllocator allocator(16 * 1024 * 1024, reinterpret_cast<const void*>(&nearbyFunction));
+
+    allocator.beginWrite();
+    uint8_t* code = allocator.allocate(64);
+    REQUIRE(code);
+    CHECK(allocator.endWrite());
+
+    // placement near the target is only a hint, but if the allocator claims the target is reachable, it has to be
+    if (allocator.isReachable(reinterpret_cast<const void*>(&nearbyFunction)))
+    {
+        int64_t distance = int64_t(uintptr_t(&nearbyFunction)) - int64_t(uintptr_t(code));
+        CHECK((distance > INT32_MIN && distance < INT32_MAX));
+    }
+
+    CHECK(!allocator.isReachable(reinterpret_cast<const void*>(uintptr_t(code) ^ (uintptr_t(1) << 46))));
+
+    allocator.deallocate(code, 64);
+}
+
+static void throwing(int64_t value)
+{
+    throw std::runtime_error(std::to_string(value));
+}
+
+TEST_CASE("ThrowThroughNativeCode")
+{
+    AssemblyBuilderX64 build(/* logText= */ false);
+    UnwindBuilder unwind;
+    unwind.start();
+
+    // a frame like the one of native Luau functions, with callee-saved registers pushed and clobbered
+    for (RegisterX64 reg : {rbx, r12, r13})
+    {
+        build.push(reg);
+        unwind.push(build.setLabel().location, reg);
+    }
+
+    // registration is only supported with the System V calling convention
+    build.mov(rdi, 42);
+
+    build.mov(rbx, 1);
+    build.mov(r12, 2);
+    build.mov(r13, 3);
+    build.mov64(rax, int64_t(uintptr_t(&throwing)));
+    build.call(rax);
+
+    for (RegisterX64 reg : {r13, r12, rbx})
+    {
+        build.pop(reg);
+        unwind.pop(build.setLabel().location);
+    }
+
+    build.ret();
+    build.finalize();
+    unwind.finish();
+
+    CodeAllocator allocator(1024 * 1024, nullptr);
+
+    allocator.beginWrite();
+    uint8_t* code = allocator.allocate(build.code.size());
+    REQUIRE(code);
+    memcpy(code, build.code.data(), build.code.size());
+    REQUIRE(allocator.endWrite());
+
+    unwind.setCodeRange(code, build.code.size());
+
+    if (!registerUnwindInfo(unwind.data.data()))
+    {
+        allocator.deallocate(code, build.code.size());
+        return;
+    }
+
+    bool caught = false;
+
+    try
+    {
+        reinterpret_cast<void (*)()>(code)();
+    }
+    catch (std::runtime_error& e)
+    {
+        caught = strcmp(e.what(), "42") == 0;
+    }
+
+    CHECK(caught);
+
+    unregisterUnwindInfo(unwind.data.data());
+    allocator.deallocate(code, build.code.size());
+}
+
+TEST_SUITE_END();
@@ -5756,4 +5756,78 @@ RETURN R0 2
 )");
 }
 
+static std::string buildFusionTest(bool fusion)
+{
+    Luau::BytecodeBuilder bcb;
+    bcb.setDumpFlags(Luau::BytecodeBuilder::Dump_Code);
+    bcb.setInstructionFusion(fusion);
+
+    uint32_t fid = bcb.beginFunction(1);
+
+    bcb.emitABC(LOP_MOVE, 1, 0, 0);
+    bcb.emitABC(LOP_MOVE, 2, 0, 0);
+    bcb.emitABC(LOP_CALL, 1, 2, 1);
+    bcb.emitABC(LOP_RETURN, 0, 1, 0);
+
+    bcb.endFunction(3, 0);
+
+    bcb.setMainFunction(fid);
+    bcb.finalize();
+
+    // fusion is done during serialization, so dumps keep the original pairs
+    CHECK_EQ("\n" + bcb.dumpFunction(0), R"(
+MOVE R1 R0
+MOVE R2 R0
+CALL R1 1 0
+RETURN R0 0
+)");
+
+    return bcb.getBytecode();
+}
+
+static bool hasInstruction(const std::string& bytecode, LuauOpcode op, uint8_t a, uint8_t b, uint8_t c)
+{
+    char insn[4] = {char(op), char(a), char(b), char(c)};
+    return bytecode.find(std::string(insn, 4)) != std::string::npos;
+}
+
+TEST_CASE("InstructionFusion")
+{
+    std::string fused = buildFusionTest(true);
+
+    CHECK_EQ(LBC_VERSION_FUSED, int(fused[0]));
+    CHECK(hasInstruction(fused, LOP_MOVE_MOVE, 1, 0, 0));
+    CHECK(!hasInstruction(fused, LOP_MOVE, 1, 0, 0));
+
+    // pairs don't overlap, so the second MOVE stays as is even though it could be fused with the CALL
+    CHECK(hasInstruction(fused, LOP_MOVE, 2, 0, 0));
+    CHECK(!hasInstruction(fused, LOP_MOVE_CALL, 2, 0, 0));
+
+    std::string plain = buildFusionTest(false);
+
+    CHECK_EQ(LBC_VERSION_TARGET, int(plain[0]));
+    CHECK(hasInstruction(plain, LOP_MOVE, 1, 0, 0));
+    CHECK(!hasInstruction(plain, LOP_MOVE_MOVE, 1, 0, 0));
+
+    // the compiler enables fusion from -O1
+    Luau::CompileOptions options;
+    Luau::BytecodeBuilder bcb1;
+    options.optimizationLevel = 1;
+    Luau::compileOrThrow(bcb1, "local a = ... print(a)", options);
+    CHECK_EQ(LBC_VERSION_FUSED, int(bcb1.getBytecode()[0]));
+
+    Luau::BytecodeBuilder bcb0;
+    options.optimizationLevel = 0;
+    Luau::compileOrThrow(bcb0, "local a = ... print(a)", options);
+    CHECK_EQ(LBC_VERSION_TARGET, int(bcb0.getBytecode()[0]));
+
+    CHECK_EQ(LOP_MOVE_CALL, Luau::BytecodeBuilder::getFusedOpcode(LOP_MOVE, LOP_CALL));
+    CHECK_EQ(LOP_GETIMPORT_MOVE, Luau::BytecodeBuilder::getFusedOpcode(LOP_GETIMPORT, LOP_MOVE));
+    CHECK_EQ(LOP_ADD_GETTABLE, Luau::BytecodeBuilder::getFusedOpcode(LOP_ADD, LOP_GETTABLE));
+
+    // the VM reads the instruction after a fast call, so calls can't be fused with what follows them
+    CHECK_EQ(LOP__COUNT, Luau::BytecodeBuilder::getFusedOpcode(LOP_CALL, LOP_MOVE));
+    CHECK_EQ(LOP__COUNT, Luau::BytecodeBuilder::getFusedOpcode(LOP_MOVE, LOP_RETURN));
+}
+
 TEST_SUITE_END();
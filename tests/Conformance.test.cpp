@@ -2,6 +2,7 @@
 #include "lua.h"
 #include "lualib.h"
 #include "luacode.h"
+#include "luacodegen.h"
 
 #include "Luau/BuiltinDefinitions.h"
 #include "Luau/ModuleResolver.h"
@@ -11,11 +12,19 @@
 
 #include "doctest.h"
 #include "ScopedFlags.h"
+#include "LoopbackServer.h"
 
+#include <atomic>
 #include <fstream>
+#include <thread>
 #include <vector>
 #include <math.h>
 
+#ifndef _WIN32
+#include <poll.h>
+#include <sys/mman.h>
+#endif
+
 extern bool verbose;
 
 static int lua_collectgarbage(lua_State* L)
@@ -127,7 +136,7 @@ int lua_silence(lua_State* L)
 using StateRef = std::unique_ptr<lua_State, void (*)(lua_State*)>;
 
 static StateRef runConformance(const char* name, void (*setup)(lua_State* L) = nullptr, void (*yield)(lua_State* L) = nullptr,
-    lua_State* initialLuaState = nullptr, lua_CompileOptions* copts = nullptr)
+    lua_State* initialLuaState = nullptr, lua_CompileOptions* copts = nullptr, bool codegen = false)
 {
     std::string path = __FILE__;
     path.erase(path.find_last_of("\\/"));
@@ -194,6 +203,9 @@ static StateRef runConformance(const char* name, void (*setup)(lua_State* L) = n
     int result = luau_load(L, chunkname.c_str(), bytecode, bytecodeSize, 0);
     free(bytecode);
 
+    if (result == 0 && codegen)
+        lua_codegen_compile(L, -1);
+
     int status = (result == 0) ? lua_resume(L, nullptr, 0) : LUA_ERRSYNTAX;
 
     while (yield && (status == LUA_YIELD || status == LUA_BREAK))
@@ -349,6 +361,484 @@ TEST_CASE("CPR")
     runConformance("cpr.lua");
 }
 
+static LoopbackServer* loopbackServer = nullptr;
+
+TEST_CASE("CPRLoopback")
+{
+    LoopbackServer server;
+    loopbackServer = &server;
+
+    StateRef globalState = runConformance("cprloopback.lua", [](lua_State* L) {
+        lua_pushstring(L, loopbackServer->url().c_str());
+        lua_setglobal(L, "loopback");
+    });
+    lua_State* L = globalState.get();
+
+    // the script leaves requests in flight for the host's event loop
+    CHECK(luaL_pendingtasks(L) == 2);
+    CHECK(luaL_nextdeadline(L) == -1);
+
+#ifndef _WIN32
+    int fd = -1;
+    REQUIRE(luaL_pollfds(L, &fd, 1) == 1);
+#endif
+
+    while (luaL_pendingtasks(L) > 0)
+    {
+#ifndef _WIN32
+        pollfd pfd = {fd, POLLIN, 0};
+        REQUIRE(poll(&pfd, 1, 5000) == 1);
+#endif
+
+        // a budget of one resumes the coroutines one by one
+        REQUIRE(luaL_runtasks(L, lua_clock(), 1) == 0);
+    }
+
+    lua_getglobal(L, "eventloop");
+    CHECK(lua_tointeger(L, -1) == 2);
+    lua_pop(L, 1);
+
+    loopbackServer = nullptr;
+}
+
+TEST_CASE("JSON")
+{
+    runConformance("json.lua");
+}
+
+TEST_CASE("Base64")
+{
+    runConformance("base64.lua");
+}
+
+TEST_CASE("Serialize")
+{
+    runConformance("serialize.lua", [](lua_State* L) {
+        lua_pushcfunction(L, lua_vector, "vector");
+        lua_setglobal(L, "vector");
+    });
+}
+
+TEST_CASE("Tasks")
+{
+    StateRef globalState = runConformance("tasks.lua");
+    lua_State* L = globalState.get();
+
+    // the script leaves a delayed task behind for the host
+    double next = luaL_nextdeadline(L);
+    CHECK(next > 0);
+    CHECK(luaL_pendingtasks(L) == 1);
+
+    CHECK(luaL_runtasks(L, next - 1, 0) == 0);
+    lua_getglobal(L, "delayed");
+    CHECK(lua_isnil(L, -1));
+    lua_pop(L, 1);
+
+    CHECK(luaL_runtasks(L, next, 0) == 0);
+    lua_getglobal(L, "delayed");
+    CHECK(std::string(lua_tostring(L, -1)) == "done");
+    lua_pop(L, 1);
+
+    CHECK(luaL_nextdeadline(L) == -1);
+    CHECK(luaL_pendingtasks(L) == 0);
+
+    // the budget bounds the number of threads resumed per call
+    lua_getglobal(L, "task");
+    for (int i = 0; i < 3; ++i)
+    {
+        lua_getfield(L, -1, "defer");
+        lua_pushcfunction(L, [](lua_State* L) -> int { return 0; }, "noop");
+        lua_call(L, 1, 0);
+    }
+    lua_pop(L, 1);
+
+    CHECK(luaL_runtasks(L, lua_clock(), 2) == 0);
+    CHECK(luaL_pendingtasks(L) == 1);
+    CHECK(luaL_nextdeadline(L) == 0);
+    CHECK(luaL_runtasks(L, lua_clock(), 2) == 0);
+    CHECK(luaL_pendingtasks(L) == 0);
+
+    // errors are returned with the message on the stack
+    lua_getglobal(L, "task");
+    lua_getfield(L, -1, "defer");
+    lua_pushcfunction(L, [](lua_State* L) -> int { luaL_error(L, "oops"); }, "oops");
+    lua_call(L, 1, 0);
+    lua_pop(L, 1);
+
+    CHECK(luaL_nextdeadline(L) == 0);
+    CHECK(luaL_runtasks(L, lua_clock(), 0) == LUA_ERRRUN);
+    CHECK(std::string(lua_tostring(L, -1)).find("oops") != std::string::npos);
+    lua_pop(L, 1);
+}
+
+static size_t gcbytes(lua_State* L)
+{
+    return size_t(lua_gc(L, LUA_GCCOUNT, 0)) * 1024 + lua_gc(L, LUA_GCCOUNTB, 0);
+}
+
+TEST_CASE("SharedModules")
+{
+    std::string source = "local function add(a, b) return a + b end\n"
+                         "local function fail() local t = nil; return t.x end\n"
+                         "local function big(x)\n";
+    for (int i = 0; i < 1000; ++i)
+        source += "x = x + " + std::to_string(i) + "\n";
+    source += "return x end\nreturn add, fail, big\n";
+
+    size_t bytecodeSize = 0;
+    char* bytecode = luau_compile(source.data(), source.size(), nullptr, &bytecodeSize);
+    luau_Module* module = luau_newmodule(bytecode, bytecodeSize);
+
+    // every state that loads the module gets functions of its own that behave like the ones luau_load creates
+    auto check = [](lua_State* L) {
+        REQUIRE(lua_gettop(L) == 1);
+        lua_call(L, 0, 3);
+
+        lua_pushvalue(L, -3);
+        lua_pushnumber(L, 2);
+        lua_pushnumber(L, 3);
+        lua_call(L, 2, 1);
+        CHECK(lua_tonumber(L, -1) == 5);
+        lua_pop(L, 1);
+
+        lua_pushvalue(L, -2);
+        CHECK(lua_pcall(L, 0, 0, 0) == LUA_ERRRUN);
+        CHECK(std::string(lua_tostring(L, -1)) == "shared:2: attempt to index nil with 'x'");
+        lua_pop(L, 1);
+
+        lua_pushvalue(L, -1);
+        lua_pushnumber(L, 0);
+        lua_call(L, 1, 1);
+        CHECK(lua_tonumber(L, -1) == 999 * 1000 / 2);
+        lua_pop(L, 4);
+    };
+
+    StateRef loaded(luaL_newstate(), lua_close);
+    REQUIRE(luau_load(loaded.get(), "=shared", bytecode, bytecodeSize, 0) == 0);
+    size_t loadedBytes = gcbytes(loaded.get());
+    check(loaded.get());
+
+    free(bytecode);
+
+    std::vector<StateRef> states;
+    for (int i = 0; i < 2; ++i)
+    {
+        states.emplace_back(luaL_newstate(), lua_close);
+        REQUIRE(luau_loadmodule(states.back().get(), "=shared", module, 0) == 0);
+    }
+
+    // the instructions are owned by the module, not by the states
+    CHECK(gcbytes(states[1].get()) + 1000 * sizeof(uint32_t) < loadedBytes);
+
+    // states keep the module alive
+    luau_releasemodule(module);
+
+    for (StateRef& state : states)
+        check(state.get());
+
+    // modules can be loaded from several threads at once
+    bytecode = luau_compile(source.data(), source.size(), nullptr, &bytecodeSize);
+    module = luau_newmodule(bytecode, bytecodeSize);
+    free(bytecode);
+
+    std::vector<std::thread> threads;
+    std::atomic<int> failures{0};
+
+    for (int i = 0; i < 4; ++i)
+    {
+        threads.emplace_back([module, &failures]() {
+            for (int j = 0; j < 10; ++j)
+            {
+                lua_State* L = luaL_newstate();
+
+                if (luau_loadmodule(L, "=shared", module, 0) != 0 || lua_pcall(L, 0, 3, 0) != 0)
+                {
+                    failures++;
+                }
+                else
+                {
+                    lua_pushnumber(L, 1);
+                    failures += lua_pcall(L, 1, 1, 0) != 0 || lua_tonumber(L, -1) != 1 + 999 * 1000 / 2;
+                }
+
+                lua_close(L);
+            }
+        });
+    }
+
+    for (std::thread& t : threads)
+        t.join();
+
+    CHECK(failures == 0);
+    luau_releasemodule(module);
+
+    // bytecode with compile errors reports them on every load
+    bytecode = luau_compile("local x = ", 10, nullptr, &bytecodeSize);
+    module = luau_newmodule(bytecode, bytecodeSize);
+    free(bytecode);
+
+    for (int i = 0; i < 2; ++i)
+    {
+        StateRef state(luaL_newstate(), lua_close);
+        CHECK(luau_loadmodule(state.get(), "=broken", module, 0) == 1);
+        CHECK(std::string(lua_tostring(state.get(), -1)).find("broken:1:") == 0);
+    }
+
+    luau_releasemodule(module);
+}
+
+TEST_CASE("MappedModules")
+{
+    // field accesses that miss the slot hints chosen by the compiler would patch the instructions of a private copy
+    std::string source = "local t = {}\n"
+                         "for i = 1, 300 do t['k' .. i] = i end\n"
+                         "local function sum() local s = 0; for i = 1, 100 do s += t.k300 + t.k1 + (gx or 0) end; return s end\n"
+                         "for i = 1, 300 do _G['g' .. i] = i end\n"
+                         "gx = 1\n"
+                         "return sum()\n";
+
+    size_t bytecodeSize = 0;
+    char* bytecode = luau_compile(source.data(), source.size(), nullptr, &bytecodeSize);
+    std::string original(bytecode, bytecodeSize);
+    free(bytecode);
+
+#ifdef _WIN32
+    char* image = static_cast<char*>(malloc(original.size()));
+    memcpy(image, original.data(), original.size());
+#else
+    void* mapping = mmap(nullptr, original.size(), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    REQUIRE(mapping != MAP_FAILED);
+    char* image = static_cast<char*>(mapping);
+    memcpy(image, original.data(), original.size());
+
+    // instructions are executed in place, so the image can be made read-only
+    REQUIRE(mprotect(mapping, original.size(), PROT_READ) == 0);
+#endif
+
+    struct Image
+    {
+        char* data;
+        size_t size;
+        bool unmapped;
+    };
+
+    Image mapped = {image, original.size(), false};
+
+    luau_Module* module = luau_mapmodule(mapped.data, mapped.size, [](void* context) {
+        Image* mapped = static_cast<Image*>(context);
+#ifdef _WIN32
+        free(mapped->data);
+#else
+        munmap(mapped->data, mapped->size);
+#endif
+        mapped->unmapped = true;
+    }, &mapped);
+
+    std::vector<StateRef> states;
+    for (int i = 0; i < 2; ++i)
+    {
+        states.emplace_back(luaL_newstate(), lua_close);
+        luaL_openlibs(states.back().get());
+        REQUIRE(luau_loadmodule(states.back().get(), "=mapped", module, 0) == 0);
+    }
+
+    luau_releasemodule(module);
+
+    for (StateRef& state : states)
+    {
+        REQUIRE(lua_pcall(state.get(), 0, 1, 0) == 0);
+        CHECK(lua_tonumber(state.get(), -1) == 100 * 302);
+    }
+
+    CHECK(memcmp(image, original.data(), original.size()) == 0);
+
+    // the image stays alive until the last state that uses it is closed
+    states[0].reset();
+    CHECK(!mapped.unmapped);
+    states[1].reset();
+    CHECK(mapped.unmapped);
+
+    // images without aligned instructions are still accepted and use private copies of them
+    std::string unaligned = " " + original;
+    module = luau_mapmodule(unaligned.data() + 1, original.size(), nullptr, nullptr);
+
+    StateRef state(luaL_newstate(), lua_close);
+    luaL_openlibs(state.get());
+    REQUIRE(luau_loadmodule(state.get(), "=unaligned", module, 0) == 0);
+    luau_releasemodule(module);
+
+    REQUIRE(lua_pcall(state.get(), 0, 1, 0) == 0);
+    CHECK(lua_tonumber(state.get(), -1) == 100 * 302);
+}
+
+TEST_CASE("CodeGen")
+{
+    if (!lua_codegen_supported())
+        return;
+
+    runConformance("codegen.lua", nullptr, nullptr, nullptr, nullptr, /* codegen= */ true);
+
+    // native code has to behave exactly like the interpreter, including for the instructions it leaves to the interpreter
+    for (const char* name : {"basic.lua", "calls.lua", "closure.lua", "constructs.lua", "coroutine.lua", "errors.lua", "events.lua",
+             "gc.lua", "literals.lua", "locals.lua", "sort.lua", "vararg.lua", "bitwise.lua"})
+    {
+        INFO(name);
+        runConformance(name, nullptr, nullptr, nullptr, nullptr, /* codegen= */ true);
+    }
+}
+
+TEST_CASE("CodeGenTiering")
+{
+    if (!lua_codegen_supported())
+        return;
+
+    // a low threshold moves most functions to native code while they are running, at a call or in the middle of a loop
+    for (const char* name : {"codegen.lua", "basic.lua", "calls.lua", "closure.lua", "coroutine.lua", "errors.lua", "events.lua", "gc.lua",
+             "sort.lua", "vararg.lua"})
+    {
+        INFO(name);
+        runConformance(name, [](lua_State* L) {
+            lua_codegen_settiering(L, 3);
+        });
+    }
+}
+
+static void setupWorker(lua_State* L)
+{
+    luaL_openlibs(L);
+
+    lua_pushcfunction(L, lua_loadstring, "loadstring");
+    lua_setglobal(L, "loadstring");
+}
+
+static void runSnapshotChunk(lua_State* L, const char* chunkname, const char* source)
+{
+    size_t bytecodeSize = 0;
+    char* bytecode = luau_compile(source, strlen(source), nullptr, &bytecodeSize);
+    int result = luau_load(L, chunkname, bytecode, bytecodeSize, 0);
+    free(bytecode);
+
+    REQUIRE(result == 0);
+    if (lua_pcall(L, 0, 0, 0) != 0)
+        FAIL(lua_tostring(L, -1));
+}
+
+TEST_CASE("Snapshot")
+{
+    StateRef initial(luaL_newstate(), lua_close);
+    lua_State* L = initial.get();
+
+    luaL_openlibs(L);
+    lua_pushcfunction(L, lua_vector, "vector");
+    lua_setglobal(L, "vector");
+
+    runSnapshotChunk(L, "=init", R"(
+        local squares = {}
+        for i = 1, 100 do squares[i] = i * i end
+        lookup = setmetatable({squares = squares, [squares] = "key"}, {__index = function(t, k) return "missing " .. k end})
+        local count = 0
+        function counter() count += 1 return count end
+        function fail() error("boom") end
+        cycle = {}
+        cycle.self = cycle
+        frozen = table.freeze({1, 2, 3})
+        point = vector(1, 2, 3)
+        function string.shout(s) return s:upper() .. "!" end
+        co = coroutine.create(print)
+    )");
+
+    // coroutines can't be saved
+    size_t size = 0;
+    CHECK(lua_savesnapshot(L, &size) == nullptr);
+    CHECK(std::string(lua_tostring(L, -1)) == "cannot snapshot coroutines");
+    lua_pop(L, 1);
+
+    runSnapshotChunk(L, "=drop", "co = nil");
+
+    char* snapshot = lua_savesnapshot(L, &size);
+    REQUIRE(snapshot);
+
+    // restored states share nothing with the original one or with each other
+    for (int i = 0; i < 2; ++i)
+    {
+        StateRef restored(luaL_newstate(), lua_close);
+        REQUIRE(lua_loadsnapshot(restored.get(), snapshot, size) == 0);
+
+        extern void luaC_validate(lua_State * L); // internal function, declared in lgc.h - not exposed via lua.h
+        luaC_validate(restored.get());
+
+        runSnapshotChunk(restored.get(), "=check", R"(
+            assert(lookup.squares[10] == 100 and lookup[lookup.squares] == "key" and lookup.other == "missing other")
+            assert(counter() == 1 and counter() == 2)
+            assert(cycle.self == cycle and table.isfrozen(frozen) and frozen[3] == 3)
+            assert(point == vector(1, 2, 3))
+            assert(("hi"):shout() == "HI!" and math.sqrt(16) == 4 and string.format("%d", 5) == "5")
+            assert(debug.info(counter, "s") == "init" and debug.info(counter, "n") == "counter")
+
+            local ok, err = pcall(fail)
+            assert(not ok and err == "init:7: boom")
+
+            -- libraries recreate their native state on first use
+            local deferred = false
+            task.defer(function() deferred = true end)
+            assert(task.step() == 1 and deferred)
+            assert(cpr.pending() == 0)
+
+            lookup.squares = nil
+        )");
+
+        // the worker init hook is native state as well, so the host sets it again
+        runSnapshotChunk(restored.get(), "=noinit", "assert(not pcall(worker.spawn, 'return 1'))");
+        luaL_setworkerinit(restored.get(), setupWorker);
+        runSnapshotChunk(restored.get(), "=workers", "local ok, r = worker.spawn('return ... + 1', 1):join() assert(ok and r == 2)");
+
+        lua_gc(restored.get(), LUA_GCCOLLECT, 0);
+    }
+
+    runSnapshotChunk(L, "=original", "assert(counter() == 1 and lookup.squares[2] == 4)");
+
+    // a snapshot that fails to load leaves the state untouched
+    StateRef broken(luaL_newstate(), lua_close);
+    luaL_openlibs(broken.get());
+    CHECK(lua_loadsnapshot(broken.get(), snapshot, size - 1) != 0);
+    CHECK(std::string(lua_tostring(broken.get(), -1)) == "malformed snapshot");
+    lua_pop(broken.get(), 1);
+    runSnapshotChunk(broken.get(), "=broken", "assert(lookup == nil and math.abs(-1) == 1)");
+
+    // the first host function, which follows the header and the host count, is moved by a byte
+    std::string moved(snapshot, size);
+    size_t offset = 13;
+    while (moved[offset++] & 0x80)
+        ;
+    moved[offset + 1] ^= 1;
+    CHECK(lua_loadsnapshot(broken.get(), moved.data(), moved.size()) != 0);
+    CHECK(std::string(lua_tostring(broken.get(), -1)) == "snapshot refers to host functions that don't match this executable");
+    lua_pop(broken.get(), 1);
+
+    free(snapshot);
+}
+
+TEST_CASE("Workers")
+{
+    runConformance("workers.lua", [](lua_State* L) {
+        lua_pushcfunction(L, lua_vector, "vector");
+        lua_setglobal(L, "vector");
+
+        luaL_setworkerinit(L, setupWorker);
+    });
+
+    // the default libraries can't compile the worker's source, which spawn reports right away
+    StateRef globalState(luaL_newstate(), lua_close);
+    lua_State* L = globalState.get();
+    luaL_openlibs(L);
+
+    lua_getglobal(L, "worker");
+    lua_getfield(L, -1, "spawn");
+    lua_pushstring(L, "return 1");
+    REQUIRE(lua_pcall(L, 1, 1, 0) != 0);
+    CHECK(strstr(lua_tostring(L, -1), "loadstring") != nullptr);
+}
+
 static int cxxthrow(lua_State* L)
 {
 #if LUA_USE_LONGJMP
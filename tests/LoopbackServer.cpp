@@ -0,0 +1,295 @@
+// This file is part of the Luau programming language and is licensed under MIT License; see LICENSE.txt for details
+#include "LoopbackServer.h"
+
+#include <chrono>
+#include <stdexcept>
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+#define poll WSAPoll
+#define closesocket_ closesocket
+typedef int socklen_t;
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#define closesocket_ close
+#endif
+
+// how often blocked accept/recv calls wake up to check for shutdown
+static const int kPollInterval = 50;
+
+static bool waitReadable(int fd, const std::atomic<bool>& stopping)
+{
+    while (!stopping)
+    {
+        pollfd pfd = {};
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+
+        int rc = poll(&pfd, 1, kPollInterval);
+        if (rc > 0)
+            return true;
+        if (rc < 0)
+            return false;
+    }
+
+    return false;
+}
+
+static bool sendAll(int fd, const char* data, size_t size)
+{
+    while (size > 0)
+    {
+        int n = int(send(fd, data, int(size), 0));
+        if (n <= 0)
+            return false;
+
+        data += n;
+        size -= n;
+    }
+
+    return true;
+}
+
+static void appendJsonString(std::string& out, const std::string& s)
+{
+    out += '"';
+
+    for (unsigned char ch : s)
+    {
+        if (ch == '"' || ch == '\\')
+        {
+            out += '\\';
+            out += char(ch);
+        }
+        else if (ch < 0x20)
+        {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\u%04x", ch);
+            out += buf;
+        }
+        else
+        {
+            out += char(ch);
+        }
+    }
+
+    out += '"';
+}
+
+LoopbackServer::LoopbackServer()
+{
+#ifdef _WIN32
+    WSADATA wsa;
+    WSAStartup(MAKEWORD(2, 2), &wsa);
+#endif
+
+    listener = int(socket(AF_INET, SOCK_STREAM, 0));
+    if (listener < 0)
+        throw std::runtime_error("loopback server: socket failed");
+
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+
+    if (bind(listener, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(listener, 128) != 0)
+    {
+        closesocket_(listener);
+        throw std::runtime_error("loopback server: bind failed");
+    }
+
+    socklen_t len = sizeof(addr);
+    getsockname(listener, (sockaddr*)&addr, &len);
+    port = ntohs(addr.sin_port);
+
+    acceptor = std::thread(&LoopbackServer::acceptLoop, this);
+}
+
+LoopbackServer::~LoopbackServer()
+{
+    stopping = true;
+    acceptor.join();
+
+    // workers notice the flag within one poll interval; no new workers can appear once the acceptor is gone
+    for (std::thread& t : workers)
+        t.join();
+
+    closesocket_(listener);
+}
+
+std::string LoopbackServer::url() const
+{
+    return "http://127.0.0.1:" + std::to_string(port);
+}
+
+int LoopbackServer::connections() const
+{
+    return accepted;
+}
+
+void LoopbackServer::acceptLoop()
+{
+    while (waitReadable(listener, stopping))
+    {
+        int fd = int(accept(listener, nullptr, nullptr));
+        if (fd < 0)
+            continue;
+
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, (const char*)&one, sizeof(one));
+
+        int connection = ++accepted;
+
+        std::unique_lock<std::mutex> lock(workersMutex);
+        workers.emplace_back(&LoopbackServer::serve, this, fd, connection);
+    }
+}
+
+void LoopbackServer::serve(int fd, int connection)
+{
+    std::string input;
+    char chunk[16384];
+
+    for (;;)
+    {
+        // read the request head
+        size_t headEnd;
+        while ((headEnd = input.find("\r\n\r\n")) == std::string::npos)
+        {
+            if (!waitReadable(fd, stopping))
+                return (void)closesocket_(fd);
+
+            int n = int(recv(fd, chunk, sizeof(chunk), 0));
+            if (n <= 0)
+                return (void)closesocket_(fd);
+
+            input.append(chunk, n);
+        }
+
+        std::string head = input.substr(0, headEnd + 2);
+        input.erase(0, headEnd + 4);
+
+        size_t lineEnd = head.find("\r\n");
+        std::string requestLine = head.substr(0, lineEnd);
+
+        size_t sp1 = requestLine.find(' ');
+        size_t sp2 = requestLine.find(' ', sp1 + 1);
+        std::string method = requestLine.substr(0, sp1);
+        std::string path = requestLine.substr(sp1 + 1, sp2 - sp1 - 1);
+
+        std::vector<std::pair<std::string, std::string>> headers;
+        size_t contentLength = 0;
+        bool keepAlive = true;
+
+        for (size_t pos = lineEnd + 2; pos < head.size();)
+        {
+            size_t end = head.find("\r\n", pos);
+            std::string line = head.substr(pos, end - pos);
+            pos = end + 2;
+
+            size_t colon = line.find(':');
+            if (colon == std::string::npos)
+                continue;
+
+            std::string name = line.substr(0, colon);
+            for (char& ch : name)
+                ch = char(tolower((unsigned char)ch));
+
+            size_t valueStart = line.find_first_not_of(' ', colon + 1);
+            std::string value = valueStart == std::string::npos ? "" : line.substr(valueStart);
+
+            if (name == "content-length")
+                contentLength = strtoul(value.c_str(), nullptr, 10);
+            else if (name == "connection" && value == "close")
+                keepAlive = false;
+            else if (name == "expect" && value == "100-continue")
+                sendAll(fd, "HTTP/1.1 100 Continue\r\n\r\n", 25);
+
+            headers.push_back({name, value});
+        }
+
+        // read the request body
+        while (input.size() < contentLength)
+        {
+            if (!waitReadable(fd, stopping))
+                return (void)closesocket_(fd);
+
+            int n = int(recv(fd, chunk, sizeof(chunk), 0));
+            if (n <= 0)
+                return (void)closesocket_(fd);
+
+            input.append(chunk, n);
+        }
+
+        std::string body = input.substr(0, contentLength);
+        input.erase(0, contentLength);
+
+        int status = 200;
+        std::string extraHeaders;
+        std::string payload;
+
+        if (path.compare(0, 7, "/delay/") == 0)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(atoi(path.c_str() + 7)));
+        }
+        else if (path.compare(0, 8, "/status/") == 0)
+        {
+            status = atoi(path.c_str() + 8);
+        }
+        else if (path == "/cookie")
+        {
+            extraHeaders += "Set-Cookie: session=loopback; Path=/\r\n";
+        }
+        else if (path.compare(0, 7, "/bytes/") == 0)
+        {
+            size_t size = strtoul(path.c_str() + 7, nullptr, 10);
+            payload.resize(size);
+            for (size_t i = 0; i < size; ++i)
+                payload[i] = char('a' + i % 26);
+        }
+
+        if (path.compare(0, 7, "/bytes/") != 0)
+        {
+            payload = "{\"method\": ";
+            appendJsonString(payload, method);
+            payload += ", \"path\": ";
+            appendJsonString(payload, path);
+            payload += ", \"body\": ";
+            appendJsonString(payload, body);
+            payload += ", \"connection\": " + std::to_string(connection);
+            payload += ", \"headers\": {";
+            for (size_t i = 0; i < headers.size(); ++i)
+            {
+                payload += i ? ", " : "";
+                appendJsonString(payload, headers[i].first);
+                payload += ": ";
+                appendJsonString(payload, headers[i].second);
+            }
+            payload += "}}";
+        }
+
+        std::string response = "HTTP/1.1 " + std::to_string(status) + (status == 200 ? " OK" : " Status") + "\r\n";
+        response += "Content-Type: " + std::string(path.compare(0, 7, "/bytes/") == 0 ? "text/plain" : "application/json") + "\r\n";
+        response += "Content-Length: " + std::to_string(method == "HEAD" ? 0 : payload.size()) + "\r\n";
+        response += extraHeaders;
+        response += keepAlive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+
+        if (method != "HEAD")
+            response += payload;
+
+        if (!sendAll(fd, response.data(), response.size()) || !keepAlive)
+            return (void)closesocket_(fd);
+    }
+}
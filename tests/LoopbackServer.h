@@ -0,0 +1,47 @@
+// This file is part of the Luau programming language and is licensed under MIT License; see LICENSE.txt for details
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Minimal HTTP/1.1 server bound to 127.0.0.1 on an ephemeral port, used as a stand-in upstream for cpr tests and benchmarks
+// Connections are kept alive and every response carries a JSON body describing the request:
+//   {"method": "GET", "path": "/get?x=1", "body": "...", "connection": 3, "headers": {"x-name": "value", ...}}
+// where 'connection' is the serial number of the TCP connection that served the request
+// Routes:
+//   /delay/<ms>   responds after sleeping for the given number of milliseconds
+//   /bytes/<n>    responds with n bytes of 'a'..'z' instead of the JSON description
+//   /status/<n>   responds with the given status code
+//   /cookie       sets a 'session' cookie
+//   anything else responds with 200
+class LoopbackServer
+{
+public:
+    LoopbackServer();
+    ~LoopbackServer();
+
+    LoopbackServer(const LoopbackServer&) = delete;
+    LoopbackServer& operator=(const LoopbackServer&) = delete;
+
+    // base url without a trailing slash, e.g. "http://127.0.0.1:41234"
+    std::string url() const;
+
+    // number of TCP connections accepted so far
+    int connections() const;
+
+private:
+    void acceptLoop();
+    void serve(int fd, int connection);
+
+    int listener = -1;
+    int port = 0;
+    std::atomic<bool> stopping{false};
+    std::atomic<int> accepted{0};
+
+    std::thread acceptor;
+    std::mutex workersMutex;
+    std::vector<std::thread> workers;
+};
@@ -6,6 +6,8 @@
 
 #include "doctest.h"
 
+#include <filesystem>
+#include <fstream>
 #include <iostream>
 #include <memory>
 #include <set>
@@ -404,3 +406,60 @@ t60 = makeChainedTable(60)
 }
 
 TEST_SUITE_END();
+
+TEST_SUITE_BEGIN("ReplBytecodeCache");
+
+TEST_CASE("CompiledChunksAreReused")
+{
+    std::filesystem::path cache = std::filesystem::temp_directory_path() / "luau-bytecode-cache-test";
+    std::filesystem::remove_all(cache);
+    std::filesystem::create_directory(cache);
+
+    auto getEntries = [&cache]() {
+        std::vector<std::filesystem::path> result;
+        for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(cache))
+            result.push_back(entry.path());
+        return result;
+    };
+
+    auto readEntry = [](const std::filesystem::path& path) {
+        std::ifstream stream(path, std::ios::in | std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(stream), {});
+    };
+
+    auto writeEntry = [](const std::filesystem::path& path, const std::string& contents) {
+        std::ofstream stream(path, std::ios::out | std::ios::binary | std::ios::trunc);
+        stream << contents;
+    };
+
+    const std::string source = "return 1 + 2";
+    std::string bytecode = compileWithCache(source, cache.string());
+
+    std::vector<std::filesystem::path> entries = getEntries();
+    REQUIRE(entries.size() == 1);
+
+    // later compiles of the same source read the stored chunk instead of compiling it
+    std::string entry = readEntry(entries[0]);
+    std::string header = entry.substr(0, entry.find('\n') + 1);
+    CHECK(entry == header + bytecode);
+
+    std::string other = compileWithCache("return 4", "");
+    writeEntry(entries[0], header + other);
+    CHECK(compileWithCache(source, cache.string()) == other);
+
+    // entries that don't start with their key are compiled again and replaced
+    writeEntry(entries[0], "garbage");
+    CHECK(compileWithCache(source, cache.string()) == bytecode);
+    CHECK(readEntry(entries[0]) == header + bytecode);
+
+    // other sources get entries of their own, except for the ones that don't compile
+    compileWithCache("return 5", cache.string());
+    CHECK(getEntries().size() == 2);
+
+    CHECK(compileWithCache("return +", cache.string())[0] == 0);
+    CHECK(getEntries().size() == 2);
+
+    std::filesystem::remove_all(cache);
+}
+
+TEST_SUITE_END();
@@ -447,6 +447,10 @@ TEST_CASE_FIXTURE(BuiltinsFixture, "lua_51_exported_globals_all_exist")
         local v_cpr_delete = cpr.delete
         local v_cpr_options = cpr.options
         local v_cpr_head = cpr.head
+        local v_cpr_poll = cpr.poll
+        local v_cpr_pending = cpr.pending
+        local v_cpr_session = cpr.session
+        local v_cpr_batch = cpr.batch
 
         local v_select = select
         local v_gcinfo = gcinfo
@@ -1000,7 +1004,7 @@ TEST_CASE_FIXTURE(BuiltinsFixture, "dont_add_definitions_to_persistent_types")
     REQUIRE(gtv->definition);
 }
 
-TEST_CASE_FIXTURE(Fixture, "cpr_things_are_defined")
+TEST_CASE_FIXTURE(BuiltinsFixture, "cpr_things_are_defined")
 {
     CheckResult result = check(R"(
         local a00 = cpr.request
@@ -1011,26 +1015,79 @@ TEST_CASE_FIXTURE(Fixture, "cpr_things_are_defined")
         local a05 = cpr.delete
         local a06 = cpr.options
         local a07 = cpr.head
+
+        local r = cpr.get("http://localhost")
+        local a08: number = r.status.code + r.elapsed + r.redirects
+        local a09: string = r.text .. r.reason .. r.url .. r.rawHeader .. r.error.message
+        local a10: string? = r.header["content-type"]
+        local a11: string = tostring(r)
+    )");
+
+    LUAU_REQUIRE_NO_ERRORS(result);
+}
+
+TEST_CASE_FIXTURE(BuiltinsFixture, "json_things_are_defined")
+{
+    CheckResult result = check(R"(
+        local a00: string = json.encode({1, 2}, {sortKeys = true, pretty = true})
+        local a01 = json.decode(a00)
+        local d = json.decoder({depth = 1, value = function(v) end})
+        local a02 = d:update("[1")
+        local a03 = d.finish("]")
+        local a04 = json.parse_lazy(a00)
+        local a05: string = json._version
+    )");
+
+    LUAU_REQUIRE_NO_ERRORS(result);
+}
+
+TEST_CASE_FIXTURE(BuiltinsFixture, "base64_things_are_defined")
+{
+    CheckResult result = check(R"(
+        local a00: string = base64.encode("data", {urlSafe = true, padding = false})
+        local a01: string = base64.decode(a00, {urlSafe = true})
+        local e = base64.encoder()
+        local a02: string = e:update("da") .. e:finish("ta")
+        local d = base64.decoder({padding = false})
+        local a03: string = d:update(a02) .. d:finish()
+    )");
+
+    LUAU_REQUIRE_NO_ERRORS(result);
+}
+
+TEST_CASE_FIXTURE(BuiltinsFixture, "task_things_are_defined")
+{
+    CheckResult result = check(R"(
+        local t1 = task.spawn(function(a: number) end, 1)
+        local t2 = task.defer(t1)
+        local t3 = task.delay(0.5, function() end)
+        local a00: number = task.wait()
+        local a01: number = task.step(os.clock())
+        local a02: number = wait(1)
     )");
 
     LUAU_REQUIRE_NO_ERRORS(result);
 }
 
-TEST_CASE_FIXTURE(Fixture, "json_things_are_defined")
+TEST_CASE_FIXTURE(BuiltinsFixture, "serialize_things_are_defined")
 {
     CheckResult result = check(R"(
-        local a00 = json.encode
-        local a01 = json.decode
+        local a00: string = serialize.encode(1, "two", {3})
+        local a01, a02 = serialize.decode(a00)
     )");
 
     LUAU_REQUIRE_NO_ERRORS(result);
 }
 
-TEST_CASE_FIXTURE(Fixture, "base64_things_are_defined")
+TEST_CASE_FIXTURE(BuiltinsFixture, "worker_things_are_defined")
 {
     CheckResult result = check(R"(
-        local a00 = base64.encode
-        local a01 = base64.decode
+        local w = worker.spawn("return ...", 1, "two")
+        w:send({x = 1})
+        local a00: boolean = w:join()
+        local a01: number = worker.cores()
+        local from = worker.receive(0.5)
+        worker.send("reply")
     )");
 
     LUAU_REQUIRE_NO_ERRORS(result);
@@ -0,0 +1,138 @@
+-- This file is part of the Luau programming language and is licensed under MIT License; see LICENSE.txt for details
+print("testing base64 library")
+
+local function checkerror(msg, f, ...)
+  local s, err = pcall(f, ...)
+  assert(not s and string.find(err, msg, 1, true), err)
+end
+
+-- RFC 4648 test vectors
+local vectors = {
+  {"", ""},
+  {"f", "Zg=="},
+  {"fo", "Zm8="},
+  {"foo", "Zm9v"},
+  {"foob", "Zm9vYg=="},
+  {"fooba", "Zm9vYmE="},
+  {"foobar", "Zm9vYmFy"},
+}
+
+for _, v in ipairs(vectors) do
+  assert(base64.encode(v[1]) == v[2])
+  assert(base64.decode(v[2]) == v[1])
+
+  -- padding is optional when decoding
+  local unpadded = string.gsub(v[2], "=", "")
+  assert(base64.encode(v[1], {padding = false}) == unpadded)
+  assert(base64.decode(unpadded) == v[1])
+end
+
+assert(base64.encode() == "")
+assert(base64.decode() == "")
+assert(base64.encode(123) == "MTIz")
+
+-- binary data and the url safe alphabet
+do
+  local bytes = {}
+  for i = 0, 255 do
+    bytes[i + 1] = string.char(i)
+  end
+  local all = table.concat(bytes)
+
+  local std = base64.encode(all)
+  local url = base64.encode(all, {urlSafe = true})
+  assert(#std == 344 and string.find(std, "+", 1, true) and string.find(std, "/", 1, true))
+  assert(not string.find(url, "[+/]") and string.find(url, "-", 1, true) and string.find(url, "_", 1, true))
+  assert(string.gsub(string.gsub(std, "+", "-"), "/", "_") == url)
+
+  assert(base64.decode(std) == all)
+  assert(base64.decode(url, {urlSafe = true}) == all)
+  assert(base64.decode(base64.encode(all, {urlSafe = true, padding = false}), {urlSafe = true}) == all)
+
+  checkerror("invalid base64 character '-' at position", base64.decode, url)
+  checkerror("invalid base64 character '+' at position", base64.decode, std, {urlSafe = true})
+
+  -- every length and offset roundtrips
+  for len = 0, 64 do
+    local s = string.sub(string.rep(all, 2), 100, 100 + len - 1)
+    assert(base64.decode(base64.encode(s)) == s)
+    assert(base64.decode(base64.encode(s, {padding = false})) == s)
+  end
+
+  local big = string.rep(all, 4096)
+  assert(base64.decode(base64.encode(big)) == big)
+end
+
+-- invalid input
+checkerror("invalid base64 character '!' at position 3", base64.decode, "ab!d")
+checkerror("invalid base64 character ' ' at position 5", base64.decode, "abcd efg")
+checkerror("invalid base64 character '=' at position 2", base64.decode, "a===")
+checkerror("invalid base64 character '*' at position 3", base64.decode, "ab*")
+checkerror("invalid base64 length", base64.decode, "abcde")
+checkerror("invalid base64 padding", base64.decode, "abc==")
+checkerror("invalid base64 padding", base64.decode, "ab=")
+
+-- streaming
+do
+  local function encodechunks(s, size, options)
+    local e = base64.encoder(options)
+    local parts = {}
+    for i = 1, #s, size do
+      table.insert(parts, e:update(string.sub(s, i, i + size - 1)))
+    end
+    table.insert(parts, e:finish())
+    return table.concat(parts)
+  end
+
+  local function decodechunks(s, size, options)
+    local d = base64.decoder(options)
+    local parts = {}
+    for i = 1, #s, size do
+      table.insert(parts, d:update(string.sub(s, i, i + size - 1)))
+    end
+    table.insert(parts, d:finish())
+    return table.concat(parts)
+  end
+
+  local data = {}
+  for i = 1, 1000 do
+    data[i] = string.char((i * 31) % 256)
+  end
+  data = table.concat(data)
+
+  for _, options in ipairs({{}, {urlSafe = true}, {padding = false}, {urlSafe = true, padding = false}}) do
+    local expected = base64.encode(data, options)
+
+    for _, size in ipairs({1, 2, 3, 4, 5, 7, 64, 1000}) do
+      assert(encodechunks(data, size, options) == expected)
+      assert(decodechunks(expected, size, options) == data)
+
+      -- short inputs exercise every amount of leftover data
+      for len = 0, 7 do
+        local s = string.sub(data, 1, len)
+        assert(encodechunks(s, size, options) == base64.encode(s, options))
+        assert(decodechunks(base64.encode(s, options), size, options) == s)
+      end
+    end
+  end
+
+  -- finish accepts a last chunk
+  local e = base64.encoder()
+  assert(e:update("fo") == "" and e:update("ob") == "Zm9v" and e:finish("ar") == "YmFy")
+  checkerror("encoder has already finished", e.update, e, "x")
+
+  local d = base64.decoder()
+  assert(d:update("Zm9vY") == "foo" and d:finish("g==") == "b")
+  checkerror("decoder has already finished", d.finish, d)
+
+  -- errors report positions in the whole stream
+  checkerror("invalid base64 character '!' at position 7", decodechunks, "Zm9vYm!y", 3)
+  checkerror("invalid base64 character '!' at position 7", decodechunks, "Zm9vYm!y", 100)
+  checkerror("invalid base64 character '!' at position 6", decodechunks, "Zm9vY!", 1)
+  checkerror("invalid base64 padding", decodechunks, "Zg==Zg==", 1)
+  checkerror("invalid base64 padding", decodechunks, "Zg==Zg==", 8)
+  checkerror("invalid base64 padding", decodechunks, "Zg=", 2)
+  checkerror("invalid base64 length", decodechunks, "Zm9vY", 2)
+end
+
+return "OK"
@@ -0,0 +1,278 @@
+-- This file is part of the Luau programming language and is licensed under MIT License; see LICENSE.txt for details
+print("testing native code generation")
+
+-- numeric loops
+local function sum(a, b, c)
+    local s = 0
+    for i = a, b, c do
+        s = s + i
+    end
+    return s
+end
+
+assert(sum(1, 100, 1) == 5050)
+assert(sum(100, 1, -1) == 5050)
+assert(sum(1, 0, 1) == 0)
+assert(sum(0, 1, 0.25) == 2.5)
+assert(sum(1, 10, 0/0) == 0)
+assert(sum(1, 0/0, 1) == 0)
+assert(sum("1", "3", "1") == 6) -- loop arguments are converted by the interpreter
+assert(not pcall(sum, {}, 1, 1))
+
+local function nested(n)
+    local count = 0
+    for i = 1, n do
+        for j = i, n do
+            count += 1
+        end
+    end
+    return count
+end
+
+assert(nested(10) == 55)
+
+-- arithmetic
+local function arith(a, b)
+    return a + b, a - b, a * b, a / b, a % b, a ^ b, -a
+end
+
+local function pack(...) return {...} end
+
+local r = pack(arith(7, 2))
+assert(r[1] == 9 and r[2] == 5 and r[3] == 14 and r[4] == 3.5 and r[5] == 1 and r[6] == 49 and r[7] == -7)
+
+r = pack(arith("7", 2)) -- string coercion runs in the interpreter
+assert(r[1] == 9 and r[2] == 5 and r[3] == 14 and r[4] == 3.5 and r[7] == -7)
+
+local vmt = {__add = function(a, b) return "add" end, __unm = function(a) return "unm" end}
+local obj = setmetatable({}, vmt)
+assert(obj + 1 == "add" and 1 + obj == "add" and -obj == "unm")
+assert(not pcall(arith, {}, 1))
+
+local function arithk(a)
+    return a + 1, a - 1, a * 2, a / 2
+end
+
+r = pack(arithk(10))
+assert(r[1] == 11 and r[2] == 9 and r[3] == 20 and r[4] == 5)
+assert(1 / -(0) == -math.huge)
+
+-- comparisons, including unordered ones
+local function compare(a, b)
+    return a < b, a <= b, a > b, a >= b, a == b, a ~= b
+end
+
+local function cmpstr(a, b)
+    local t = {compare(a, b)}
+    for i = 1, #t do t[i] = tostring(t[i]) end
+    return table.concat(t, " ")
+end
+
+assert(cmpstr(1, 2) == "true true false false false true")
+assert(cmpstr(2, 2) == "false true false true true false")
+assert(cmpstr(3, 2) == "false false true true false true")
+assert(cmpstr(0/0, 1) == "false false false false false true")
+assert(cmpstr(1, 0/0) == "false false false false false true")
+assert(cmpstr("a", "b") == "true true false false false true")
+assert(not pcall(compare, 1, "1"))
+
+local function branches(a, b)
+    if a < b then return 1 end
+    if not (a <= b) then return 2 end
+    return 3
+end
+
+assert(branches(1, 2) == 1 and branches(2, 1) == 2 and branches(1, 1) == 3)
+assert(branches(0/0, 0/0) == 2)
+
+local function equal(a, b)
+    if a == b then return true else return false end
+end
+
+local f1, t1, co1 = function() end, {}, coroutine.create(function() end)
+assert(equal(nil, nil) and equal(true, true) and not equal(true, false) and equal("x", "x") and not equal("x", "y"))
+assert(equal(f1, f1) and not equal(f1, function() end) and equal(t1, t1) and not equal(t1, {}) and equal(co1, co1))
+assert(not equal(1, "1") and not equal(nil, false) and not equal(0/0, 0/0) and equal(0, -0))
+
+local eqmt = {__eq = function() return true end}
+assert(equal(setmetatable({}, eqmt), setmetatable({}, eqmt)))
+
+local function constants(v)
+    if v == nil then return "nil" end
+    if v == true then return "true" end
+    if v == false then return "false" end
+    if v == 42 then return "42" end
+    if v == "str" then return "str" end
+    if v ~= 1 then return "other" end
+    return "1"
+end
+
+assert(constants(nil) == "nil" and constants(true) == "true" and constants(false) == "false")
+assert(constants(42) == "42" and constants("str") == "str" and constants(1) == "1")
+assert(constants(0/0) == "other" and constants("42") == "other" and constants({}) == "other")
+
+-- truthiness
+local function truth(v)
+    local a = not v
+    if v then return a, 1 else return a, 2 end
+end
+
+assert(select(2, truth(nil)) == 2 and select(2, truth(false)) == 2 and select(2, truth(0)) == 1 and select(2, truth("")) == 1)
+assert(truth(nil) == true and truth(false) == true and truth(0) == false)
+
+-- upvalues, while open and after the frame is gone
+local function counter()
+    local c = 0
+    local function get() return c end
+    local function inc() c += 1 end
+    inc()
+    assert(get() == 1)
+    return get, inc
+end
+
+local get, inc = counter()
+inc()
+inc()
+assert(get() == 3)
+
+-- calls and recursion
+local function fib(n)
+    if n < 2 then return n end
+    return fib(n - 1) + fib(n - 2)
+end
+
+assert(fib(20) == 6765)
+
+-- errors raised by instructions that run in the interpreter propagate through native code
+local function thrower(n)
+    for i = 1, n do
+        if i == 5 then error("stop at " .. i) end
+    end
+end
+
+local ok, err = pcall(thrower, 10)
+assert(not ok and err:find("stop at 5"))
+
+ok, err = pcall(function() local t = nil; return t.x end)
+assert(not ok)
+
+-- coroutines yield and resume in the middle of native loops
+local co = coroutine.wrap(function(n)
+    local s = 0
+    for i = 1, n do
+        s += i
+        coroutine.yield(s)
+    end
+    return -1
+end)
+
+assert(co(3) == 1 and co() == 3 and co() == 6 and co() == -1)
+
+-- and/or select values without converting them
+local function andor(a, b)
+    return a and b, a or b, a and 1, a or 2
+end
+
+r = pack(andor(nil, 5))
+assert(r[1] == nil and r[2] == 5 and r[3] == nil and r[4] == 2)
+r = pack(andor(false, nil))
+assert(r[1] == false and r[2] == nil and r[3] == false and r[4] == 2)
+r = pack(andor("x", false))
+assert(r[1] == false and r[2] == "x" and r[3] == 1 and r[4] == "x")
+
+-- table fields, including misses of the cached slot and metatables
+local function fields(t)
+    t.x = t.x + 1
+    return t.y
+end
+
+local ft = {x = 1, y = 2}
+assert(fields(ft) == 2 and ft.x == 2)
+ft = {a = 1, b = 2, c = 3, x = 10}
+assert(fields(ft) == nil and ft.x == 11)
+ft = setmetatable({x = 0}, {__index = function(t, k) return k end})
+assert(fields(ft) == "y" and ft.x == 1)
+assert(not pcall(fields, table.freeze({x = 1})))
+assert(not pcall(fields, 42))
+
+-- array accesses with constant and computed indices
+local function arrays(t, i)
+    t[1] = t[2]
+    t[i] = t[i + 1]
+    return t[i], t[3]
+end
+
+local at = {1, 2, 3, 4}
+local a1, a2 = arrays(at, 2)
+assert(a1 == 3 and a2 == 3 and at[1] == 2)
+a1, a2 = arrays({1, 2, 3}, 1.5)
+assert(a1 == nil and a2 == 3)
+a1, a2 = arrays({1, 2, 3}, 10)
+assert(a1 == nil and a2 == 3)
+at = setmetatable({}, {__index = function(t, k) return k * 2 end})
+a1, a2 = arrays(at, 2)
+assert(a1 == 6 and a2 == 6 and rawget(at, 1) == 4)
+assert(not pcall(arrays, table.freeze({1, 2, 3}), 1))
+
+-- tables written from native code stay reachable across collections
+local function fill(n)
+    local t = {}
+    for i = 1, n do
+        t[i] = {}
+        t[i].v = tostring(i)
+        collectgarbage("step", 1)
+    end
+    return t
+end
+
+local filled = fill(1000)
+collectgarbage()
+for i = 1, 1000 do assert(filled[i].v == tostring(i)) end
+
+-- globals and imports
+gcounter = 0
+local function globals()
+    gcounter = gcounter + 1
+    return math.abs(-gcounter)
+end
+
+assert(globals() == 1 and globals() == 2 and gcounter == 2)
+
+-- builtins called directly, and through the regular call when their fast path doesn't apply
+local function builtins(a, b)
+    return bit32.bxor(a, b), bit32.band(a, 0xff), math.abs(a), math.max(a, b, 0)
+end
+
+r = pack(builtins(0x1234, 0x0ff0))
+assert(r[1] == 0x1dc4 and r[2] == 0x34 and r[3] == 0x1234 and r[4] == 0x1234)
+r = pack(builtins("3", "5"))
+assert(r[1] == 6 and r[2] == 3 and r[3] == 3 and r[4] == 5)
+assert(not pcall(builtins, {}, 1))
+
+-- a numeric kernel similar to the mandelbrot benchmark
+local function mandel(size)
+    local count = 0
+    for y = 0, size - 1 do
+        local ci = 2 * y / size - 1
+        for x = 0, size - 1 do
+            local cr = 2 * x / size - 1.5
+            local zr, zi = 0, 0
+            local inside = true
+            for iter = 1, 50 do
+                local zr2, zi2 = zr * zr, zi * zi
+                if zr2 + zi2 > 4 then
+                    inside = false
+                    break
+                end
+                zi = 2 * zr * zi + ci
+                zr = zr2 - zi2 + cr
+            end
+            if inside then count += 1 end
+        end
+    end
+    return count
+end
+
+assert(mandel(32) == 416)
+
+return 'OK'
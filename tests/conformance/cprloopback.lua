@@ -0,0 +1,324 @@
+-- This file is part of the Luau programming language and is licensed under MIT License; see LICENSE.txt for details
+print("testing cpr lib against a loopback server")
+
+local base = loopback
+
+local function drain()
+  while cpr.pending() > 0 do
+    cpr.poll(1)
+  end
+end
+
+-- synchronous requests
+do
+  local r = cpr.get(base .. "/get", nil, nil, {parameters = {{"hello", "world"}}})
+  assert(r.status.code == 200)
+  local echo = json.decode(r.text)
+  assert(echo.method == "GET" and echo.path == "/get?hello=world")
+
+  echo = json.decode(cpr.post(base .. "/post", {{"Content-Type", "text/plain"}}, "raw data").text)
+  assert(echo.method == "POST" and echo.body == "raw data" and echo.headers["content-type"] == "text/plain")
+
+  -- options no longer clobber an explicit body
+  echo = json.decode(cpr.post(base .. "/post", nil, "raw data", {timeout = 5000}).text)
+  assert(echo.body == "raw data")
+
+  echo = json.decode(cpr.post(base .. "/post", nil, nil, {payload = {{"key", "value"}}}).text)
+  assert(echo.body == "key=value")
+
+  assert(cpr.get(base .. "/status/404").status.code == 404)
+end
+
+-- async requests suspend the calling coroutine until the transfer finishes
+do
+  local results = {}
+  local co = coroutine.create(function(i)
+    local r = cpr.get(base .. "/get?i=" .. i, nil, nil, {async = true})
+    results[i] = json.decode(r.text).path
+    return "done"
+  end)
+
+  assert(coroutine.resume(co, 1))
+  assert(coroutine.status(co) == "suspended")
+  assert(cpr.pending() == 1)
+  assert(results[1] == nil)
+
+  drain()
+  assert(coroutine.status(co) == "dead")
+  assert(results[1] == "/get?i=1")
+  assert(cpr.pending() == 0)
+  assert(cpr.poll() == 0)
+end
+
+-- many transfers are in flight at once, so the wall time is close to that of a single one
+do
+  local count = 16
+  local done = 0
+  local start = os.clock()
+
+  for i = 1, count do
+    coroutine.wrap(function()
+      local r = cpr.post(base .. "/delay/200", nil, tostring(i), {async = true})
+      assert(json.decode(r.text).body == tostring(i))
+      done += 1
+    end)()
+  end
+
+  assert(cpr.pending() == count)
+  drain()
+  assert(done == count)
+  assert(os.clock() - start < count * 0.2 / 2)
+end
+
+-- a coroutine can issue several requests in sequence
+do
+  local log = {}
+  coroutine.wrap(function()
+    for i = 1, 3 do
+      local r = cpr.get(base .. "/get?step=" .. i, nil, nil, {async = true})
+      table.insert(log, json.decode(r.text).path)
+    end
+  end)()
+
+  drain()
+  assert(#log == 3 and log[3] == "/get?step=3")
+end
+
+-- errors raised after the resume surface from poll
+do
+  coroutine.wrap(function()
+    cpr.get(base .. "/get", nil, nil, {async = true})
+    error("after response", 0)
+  end)()
+
+  local ok, err = pcall(drain)
+  assert(not ok and err == "after response")
+  assert(cpr.pending() == 0)
+end
+
+-- async requests need a yieldable caller
+do
+  local ok, err = pcall(table.sort, {1, 2}, function(a, b)
+    cpr.get(base .. "/get", nil, nil, {async = true})
+    return a < b
+  end)
+  assert(not ok and err:find("attempt to yield"))
+  assert(cpr.pending() == 0)
+end
+
+-- sessions keep connections alive between requests
+do
+  local s = cpr.session(base, {headers = {{"X-Client", "loopback"}}, parameters = {{"k", "v"}}, timeout = 5000})
+  assert(tostring(s) == "cprSession")
+
+  local first = json.decode(s:get("/get").text)
+  assert(first.path == "/get?k=v" and first.headers["x-client"] == "loopback")
+
+  for i = 1, 5 do
+    local echo = json.decode(s:get("get", {{"X-Step", tostring(i)}}).text)
+    assert(echo.connection == first.connection)
+    assert(echo.headers["x-client"] == "loopback" and echo.headers["x-step"] == tostring(i))
+  end
+
+  -- per-request headers and bodies don't stick to the pooled handle
+  local echo = json.decode(s:post("/post", nil, "data").text)
+  assert(echo.method == "POST" and echo.body == "data" and echo.headers["x-step"] == nil)
+  echo = json.decode(s:post("/post", nil, "more").text)
+  assert(echo.body == "more" and echo.connection == json.decode(s:post("/post", nil, "x").text).connection)
+  echo = json.decode(s:get("/get").text)
+  assert(echo.method == "GET" and echo.body == "" and echo.connection == first.connection)
+
+  assert(json.decode(s:request("PUT", "/put", nil, "put").text).method == "PUT")
+  assert(s:get("/status/404").status.code == 404)
+
+  -- absolute urls bypass the base
+  assert(json.decode(s:get(base .. "/absolute").text).path == "/absolute?k=v")
+
+  -- request options override the session ones
+  assert(json.decode(s:get("/get", nil, nil, {parameters = {{"a", "b"}}}).text).path == "/get?a=b")
+
+  -- requests without a session open a connection each
+  local c1 = json.decode(cpr.get(base .. "/get").text).connection
+  local c2 = json.decode(cpr.get(base .. "/get").text).connection
+  assert(c1 ~= c2)
+
+  -- close drops idle connections, the session reconnects on demand
+  s:close()
+  assert(json.decode(s:get("/get").text).connection ~= first.connection)
+
+  -- sessions work with async requests
+  local done = 0
+  for i = 1, 4 do
+    coroutine.wrap(function()
+      assert(s:get("/delay/50", nil, nil, {async = true}).status.code == 200)
+      done += 1
+    end)()
+  end
+  drain()
+  assert(done == 4)
+
+  -- the pool keeps up to poolSize idle connections per host
+  local s0 = cpr.session(base, {poolSize = 0})
+  assert(json.decode(s0:get("/get").text).connection ~= json.decode(s0:get("/get").text).connection)
+end
+
+-- batches run their requests concurrently and return the responses in order
+do
+  local requests = {}
+  for i = 1, 10 do
+    requests[i] = {"GET", base .. "/delay/200?i=" .. i}
+  end
+  table.insert(requests, {"POST", base .. "/post", {{"Content-Type", "text/plain"}}, "body", {parameters = {{"p", "1"}}}})
+  table.insert(requests, {"get", base .. "/status/404"})
+
+  local start = os.clock()
+  local responses = cpr.batch(requests)
+  assert(os.clock() - start < 10 * 0.2 / 2)
+
+  assert(#responses == 12)
+  for i = 1, 10 do
+    assert(json.decode(responses[i].text).path == "/delay/200?i=" .. i)
+  end
+  local echo = json.decode(responses[11].text)
+  assert(echo.method == "POST" and echo.body == "body" and echo.path == "/post?p=1" and echo.headers["content-type"] == "text/plain")
+  assert(responses[12].status.code == 404)
+
+  -- the concurrency limit bounds the number of requests in flight
+  start = os.clock()
+  responses = cpr.batch({{"GET", base .. "/delay/100"}, {"GET", base .. "/delay/100"}, {"GET", base .. "/delay/100"}}, {concurrency = 1})
+  assert(os.clock() - start >= 0.3 and #responses == 3)
+
+  assert(#cpr.batch({}) == 0)
+
+  -- async batches suspend the calling coroutine until every request finished
+  local result
+  coroutine.wrap(function()
+    result = cpr.batch({{"GET", base .. "/get?a"}, {"GET", base .. "/get?b"}}, {async = true})
+  end)()
+  assert(result == nil and cpr.pending() == 1)
+  drain()
+  assert(#result == 2 and json.decode(result[2].text).path == "/get?b")
+
+  local ok, err = pcall(cpr.batch, {{"FETCH", base}})
+  assert(not ok and err:find("invalid request method"))
+  ok, err = pcall(cpr.batch, {{"GET"}})
+  assert(not ok and err:find("URL"))
+  ok, err = pcall(cpr.batch, {{"GET", base}}, {concurrency = 0})
+  assert(not ok and err:find("concurrency"))
+end
+
+-- credentials passed to a session request replace the session's, whatever their kind
+do
+  local s = cpr.session(base, {auth = {"user", "pass"}})
+  local headers = json.decode(s:get("/auth", nil, nil, {bearer = "token"}).text).headers
+  assert(headers.authorization == "Bearer token")
+  headers = json.decode(s:get("/auth").text).headers
+  assert(headers.authorization == "Basic dXNlcjpwYXNz")
+end
+
+-- stream passes the body to a function chunk by chunk instead of buffering it
+do
+  local size, chunks = 0, 0
+  local r = cpr.get(base .. "/bytes/1000000", nil, nil, {stream = function(chunk)
+    size += #chunk
+    chunks += 1
+  end})
+  assert(r.status.code == 200 and r.text == "")
+  assert(size == 1000000 and chunks > 1)
+
+  -- incremental decoders make convenient sinks
+  local d = json.decoder({depth = 0})
+  local results = {}
+  cpr.post(base .. "/post", nil, "streamed", {stream = function(chunk)
+    for _, v in ipairs(d:update(chunk)) do
+      table.insert(results, v)
+    end
+  end})
+  for _, v in ipairs(d:finish()) do
+    table.insert(results, v)
+  end
+  assert(#results == 1 and results[1].body == "streamed")
+
+  -- update also works as the sink itself, with values going to the decoder's callbacks
+  local keys = {}
+  d = json.decoder({depth = 1, key = function(k) table.insert(keys, k) end, value = function() end})
+  cpr.post(base .. "/post", nil, "direct", {stream = d.update})
+  d.finish()
+  assert(table.concat(keys, ",") == "method,path,body,connection,headers")
+
+  -- returning false cancels the transfer
+  size = 0
+  r = cpr.get(base .. "/bytes/1000000", nil, nil, {stream = function(chunk)
+    size += #chunk
+    return false
+  end})
+  assert(r.error.code ~= "OK" and size < 1000000)
+
+  -- errors raised by the sink stop the transfer and propagate to the caller
+  local ok, err = pcall(cpr.get, base .. "/bytes/1000", nil, nil, {stream = function() error("sink failed", 0) end})
+  assert(not ok and err == "sink failed")
+
+  -- async sinks run inside poll, one chunk at a time
+  size = 0
+  local status
+  coroutine.wrap(function()
+    status = cpr.get(base .. "/bytes/1000000", nil, nil, {async = true, stream = function(chunk) size += #chunk end}).status.code
+  end)()
+  drain()
+  assert(status == 200 and size == 1000000)
+
+  coroutine.wrap(function()
+    ok, err = pcall(cpr.get, base .. "/bytes/1000000", nil, nil, {async = true, stream = function() error("async sink failed", 0) end})
+  end)()
+  drain()
+  assert(not ok and err == "async sink failed")
+
+  -- streamed requests still work through sessions
+  local s = cpr.session(base)
+  size = 0
+  s:get("/bytes/5000", nil, nil, {stream = function(chunk) size += #chunk end})
+  assert(size == 5000 and json.decode(s:get("/get").text).method == "GET")
+
+  ok, err = pcall(cpr.get, base, nil, nil, {stream = 1})
+  assert(not ok and err:find("stream"))
+  ok, err = pcall(cpr.batch, {{"GET", base, nil, nil, {stream = print}}})
+  assert(not ok and err:find("not supported"))
+end
+
+-- responses convert their fields on first access and keep the converted values
+do
+  local r = cpr.get(base .. "/cookie")
+  assert(type(r) == "userdata" and tostring(r) == "cprResponse")
+  assert(r.status.code == 200 and r.status == r.status)
+  assert(r.header == r.header and r.header["Content-Type"] == "application/json")
+  assert(r.cookies.session == "loopback")
+  assert(r.error.code == "OK" and r.redirects == 0 and r.downloaded > 0 and r.elapsed >= 0)
+  assert(r.url == base .. "/cookie" and r.rawHeader:find("Set-Cookie", 1, true) and #r.certInfo == 0)
+  assert(r.missing == nil and r[1] == nil)
+
+  local ok = pcall(function() r.text = "" end)
+  assert(not ok)
+  ok = pcall(function() r.header.x = "" end)
+  assert(not ok)
+
+  local fields = 0
+  for k, v in r do
+    assert(r[k] == v)
+    fields += 1
+  end
+  assert(fields == 13)
+
+  -- text keeps embedded zeros
+  assert(#cpr.post(base .. "/bytes/16", nil, "a\0b").text == 16)
+end
+
+-- leave requests in flight for the host's event loop
+eventloop = 0
+for i = 1, 2 do
+  coroutine.wrap(function()
+    cpr.get(base .. "/delay/50", nil, nil, {async = true})
+    eventloop += 1
+  end)()
+end
+
+return "OK"
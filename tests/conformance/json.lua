@@ -0,0 +1,413 @@
+-- This file is part of the Luau programming language and is licensed under MIT License; see LICENSE.txt for details
+print("testing json library")
+
+local function checkerror(msg, f, ...)
+  local s, err = pcall(f, ...)
+  assert(not s and string.find(err, msg, 1, true), err)
+end
+
+-- encode: scalars
+assert(json.encode(nil) == "null")
+assert(json.encode() == "null")
+assert(json.encode(true) == "true")
+assert(json.encode(false) == "false")
+assert(json.encode(0) == "0")
+assert(json.encode(-0) == "-0")
+assert(json.encode(42) == "42")
+assert(json.encode(-42) == "-42")
+assert(json.encode(1.5) == "1.5")
+assert(json.encode(1e100) == "1e+100")
+assert(json.encode(0.1) == "0.1")
+assert(json.encode(1/3) == "0.3333333333333333")
+assert(json.encode(99999999999999) == "99999999999999")
+assert(json.encode(100000000000000) == "100000000000000")
+assert(json.encode(2^53) == "9007199254740992")
+assert(json.encode(2^53 + 2) == "9007199254740994")
+assert(json.encode(1e21) == "1e+21")
+assert(json.encode(-1.5e-10) == "-1.5e-10")
+assert(json.encode(5e-324) == "5e-324")
+
+-- numbers roundtrip exactly
+for _, n in ipairs({0.1, 1/3, math.pi, -2^-1074, 1.7976931348623157e308, 123456789.123456789}) do
+  assert(json.decode(json.encode(n)) == n)
+end
+
+checkerror("unexpected number value 'nan'", json.encode, 0/0)
+checkerror("unexpected number value 'inf'", json.encode, math.huge)
+checkerror("unexpected number value '-inf'", json.encode, -math.huge)
+
+-- encode: strings
+assert(json.encode("") == '""')
+assert(json.encode("hello") == '"hello"')
+assert(json.encode("a\"b\\c/d") == '"a\\"b\\\\c/d"')
+assert(json.encode("\b\f\n\r\t") == '"\\b\\f\\n\\r\\t"')
+assert(json.encode("\0\1\31") == '"\\u0000\\u0001\\u001f"')
+assert(json.encode("\127\128\255") == '"\127\128\255"')
+assert(json.encode("привет") == '"привет"')
+assert(json.encode(string.rep("x\n", 1000)) == '"' .. string.rep("x\\n", 1000) .. '"')
+
+-- encode: arrays
+assert(json.encode({}) == "[]")
+assert(json.encode({1, 2, 3}) == "[1,2,3]")
+assert(json.encode({"a", {true, false}, {}}) == '["a",[true,false],[]]')
+assert(json.encode(table.create(1000, 1)) == "[" .. string.rep("1,", 999) .. "1]")
+
+checkerror("invalid table: sparse array", json.encode, {1, nil, 3})
+checkerror("invalid table: sparse array", json.encode, {[1] = 1, [3] = 3})
+checkerror("invalid table: sparse array", json.encode, {1, 2, [2.5] = 3})
+checkerror("invalid table: mixed or invalid key types", json.encode, {1, 2, x = 3})
+
+-- encode: objects
+assert(json.encode({a = 1}) == '{"a":1}')
+assert(json.encode({["a\nb"] = "c"}) == '{"a\\nb":"c"}')
+assert(json.encode({a = {b = {c = {}}}}) == '{"a":{"b":{"c":[]}}}')
+
+do
+  local obj = json.decode(json.encode({x = 1, y = "two", z = {3}}))
+  assert(obj.x == 1 and obj.y == "two" and obj.z[1] == 3)
+end
+
+checkerror("invalid table: mixed or invalid key types", json.encode, {[2] = 1})
+checkerror("invalid table: mixed or invalid key types", json.encode, {[true] = 1})
+
+-- encode: options
+assert(json.encode({b = 1, a = 2, c = {z = 1, y = 2}}, {sortKeys = true}) == '{"a":2,"b":1,"c":{"y":2,"z":1}}')
+assert(json.encode({["b"] = 1, ["a"] = 2, ["ab"] = 3, ["\255"] = 4, ["A"] = 5}, {sortKeys = true}) == '{"A":5,"a":2,"ab":3,"b":1,"\255":4}')
+assert(json.encode({1, 2}, {}) == "[1,2]")
+
+do
+  local value = {b = {1, {}, {x = true}}, a = "s"}
+  assert(json.encode(value, {pretty = true, sortKeys = true}) == '{\n  "a": "s",\n  "b": [\n    1,\n    [],\n    {\n      "x": true\n    }\n  ]\n}')
+  assert(json.encode(value, {indent = "\t", sortKeys = true}) == '{\n\t"a": "s",\n\t"b": [\n\t\t1,\n\t\t[],\n\t\t{\n\t\t\t"x": true\n\t\t}\n\t]\n}')
+  assert(json.encode(42, {pretty = true}) == "42")
+  assert(json.encode({}, {pretty = true}) == "[]")
+  assert(json.encode(value, {pretty = false, sortKeys = true}) == '{"a":"s","b":[1,[],{"x":true}]}')
+
+  -- sorted keys of nested objects are kept separately from the keys of their parents
+  local wide = {}
+  for i = 1, 200 do
+    wide["k" .. i] = {["n" .. i] = i, ["m" .. i] = i}
+  end
+  local text = json.encode(wide, {sortKeys = true})
+  assert(string.find(text, '^{"k1":{"m1":1,"n1":1},"k10":{"m10":10,"n10":10},"k100":'))
+  assert(json.encode(json.decode(text), {sortKeys = true}) == text)
+
+  checkerror("invalid table: mixed or invalid key types", json.encode, {a = 1, [true] = 2}, {sortKeys = true})
+  checkerror("invalid option 'indent'", json.encode, {}, {indent = 2})
+end
+
+-- encode: unsupported values
+checkerror("unexpected type 'function'", json.encode, print)
+checkerror("unexpected type 'thread'", json.encode, coroutine.create(print))
+checkerror("unexpected type 'userdata'", json.encode, newproxy())
+checkerror("unexpected type 'function'", json.encode, {print})
+
+-- encode: references
+do
+  local t = {}
+  t[1] = t
+  checkerror("circular reference", json.encode, t)
+
+  local o = {}
+  o.self = {o}
+  checkerror("circular reference", json.encode, o)
+
+  -- shared references are fine
+  local s = {1}
+  assert(json.encode({s, s, {s}}) == "[[1],[1],[[1]]]")
+end
+
+do
+  local deep = {}
+  for i = 1, 1000 do
+    deep = {deep}
+  end
+  checkerror("maximum nesting depth exceeded", json.encode, deep)
+end
+
+-- decode: scalars
+assert(json.decode("null") == nil)
+assert(json.decode("true") == true)
+assert(json.decode("false") == false)
+assert(json.decode("0") == 0)
+assert(1 / json.decode("-0") == -math.huge)
+assert(json.decode("42") == 42)
+assert(json.decode("-42") == -42)
+assert(json.decode("1.5") == 1.5)
+assert(json.decode("1e3") == 1000)
+assert(json.decode("-2.5E-3") == -0.0025)
+assert(json.decode("123456789012345") == 123456789012345)
+assert(json.decode("12345678901234567890") == 12345678901234567890)
+assert(json.decode("0x10") == 16)
+assert(json.decode(" \t\r\n 7 \t\r\n ") == 7)
+
+-- decode: strings
+assert(json.decode('""') == "")
+assert(json.decode('"hello"') == "hello")
+assert(json.decode('"a\\"b\\\\c\\/d"') == 'a"b\\c/d')
+assert(json.decode('"\\b\\f\\n\\r\\t"') == "\b\f\n\r\t")
+assert(json.decode('"\\u0041\\u00e9\\u20AC"') == "Aé€")
+assert(json.decode('"\\ud83d\\ude00"') == "😀")
+assert(json.decode('"\\uD83D\\uDE00x"') == "😀x")
+assert(json.decode('"\\u0000"') == "\0")
+assert(json.decode('"привет"') == "привет")
+assert(json.decode('"' .. string.rep("ab\\n", 1000) .. '"') == string.rep("ab\n", 1000))
+
+-- decode: arrays
+do
+  local a = json.decode("[1, 2, [3, [4]], []]")
+  assert(#a == 4 and a[1] == 1 and a[2] == 2 and a[3][1] == 3 and a[3][2][1] == 4 and next(a[4]) == nil)
+
+  -- nulls leave holes
+  local b = json.decode("[1, null, 3]")
+  assert(b[1] == 1 and b[2] == nil and b[3] == 3)
+
+  -- trailing commas are accepted
+  assert(#json.decode("[1,2,]") == 2)
+
+  local big = json.decode("[" .. string.rep("1,", 9999) .. "1]")
+  assert(#big == 10000)
+end
+
+-- decode: objects
+do
+  local o = json.decode('{"a": 1, "b": {"c": [true]}, "d": null}')
+  assert(o.a == 1 and o.b.c[1] == true and o.d == nil)
+
+  -- later keys win, and null removes earlier values
+  assert(json.decode('{"a": 1, "a": 2}').a == 2)
+  assert(json.decode('{"a": 1, "a": null}').a == nil)
+
+  assert(json.decode('{"a": 1,}').a == 1)
+  assert(next(json.decode("{}")) == nil)
+
+  local parts = {}
+  for i = 1, 9999 do
+    parts[i] = string.format('"k%d": %d', i, i)
+  end
+  local big = json.decode("{" .. table.concat(parts, ",") .. "}")
+  assert(big.k1 == 1 and big.k5000 == 5000 and big.k9999 == 9999)
+end
+
+do
+  local deep = string.rep("[", 150) .. string.rep("]", 150)
+  assert(type(json.decode(deep)) == "table")
+
+  checkerror("maximum nesting depth exceeded", json.decode, string.rep("[", 1000) .. string.rep("]", 1000))
+end
+
+-- decode: errors
+checkerror("expected argument of type string, got number", json.decode, 1)
+checkerror("expected argument of type string, got nil", json.decode)
+checkerror("unexpected character '' at line 1 col 1", json.decode, "")
+checkerror("unexpected character 'x' at line 1 col 1", json.decode, "x")
+checkerror("unexpected character '}' at line 2 col 3", json.decode, "[\n1,}")
+checkerror("trailing garbage at line 1 col 3", json.decode, "1 2")
+checkerror("invalid number '1.2.3' at line 1 col 1", json.decode, "1.2.3")
+checkerror("invalid number '-' at line 1 col 2", json.decode, "[-]")
+checkerror("invalid literal 'nul' at line 1 col 1", json.decode, "nul")
+checkerror("invalid literal 'truex' at line 1 col 1", json.decode, "truex")
+checkerror("expected closing quote for string at line 1 col 1", json.decode, '"abc')
+checkerror("expected closing quote for string at line 1 col 1", json.decode, '"abc\\n')
+checkerror("control character in string at line 1 col 3", json.decode, '"a\nb"')
+checkerror("invalid escape char 'x' in string at line 1 col 3", json.decode, '"a\\xb"')
+checkerror("invalid unicode escape in string at line 1 col 2", json.decode, '"\\u12"')
+checkerror("invalid unicode escape in string at line 1 col 2", json.decode, '"\\u12g4"')
+checkerror("invalid unicode codepoint '111fff'", json.decode, '"\\udbff\\uffff"')
+checkerror("expected ']' or ',' at line 1 col 5", json.decode, "[1 2]")
+checkerror("expected ']' or ',' at line 1 col 4", json.decode, "[1")
+checkerror("expected string for key at line 1 col 2", json.decode, "{1: 2}")
+checkerror("expected ':' after key at line 1 col 6", json.decode, '{"a" 1}')
+checkerror("expected '}' or ',' at line 1 col 10", json.decode, '{"a": 1 "b": 2}')
+
+-- long strings are scanned in blocks; check special characters at every position around block boundaries
+do
+  for len = 0, 70 do
+    local plain = string.rep("a", len)
+    assert(json.decode('"' .. plain .. '"') == plain)
+    assert(json.encode(plain) == '"' .. plain .. '"')
+
+    for _, ch in ipairs({'"', "\\", "\n", "\0", "\31", "\127", "\255"}) do
+      local s = plain .. ch .. "bcd"
+      assert(json.decode(json.encode(s)) == s)
+    end
+
+    checkerror("control character in string at line 1 col " .. len + 2, json.decode, '"' .. plain .. '\1"')
+    checkerror("expected closing quote for string at line 1 col 1", json.decode, '"' .. plain)
+    assert(json.decode(string.rep(" ", len) .. "1" .. string.rep("\n", len)) == 1)
+  end
+
+  local indented = "[\n" .. string.rep(" ", 40) .. "1,\n" .. string.rep("\t", 40) .. "2\r\n]"
+  local a = json.decode(indented)
+  assert(a[1] == 1 and a[2] == 2)
+  checkerror("unexpected character 'x' at line 2 col 41", json.decode, "[\n" .. string.rep(" ", 40) .. "x]")
+end
+
+-- incremental decoding
+local function feed(d, text, size)
+  local results = {}
+  for i = 1, #text, size do
+    local r = d:update(string.sub(text, i, i + size - 1))
+    if r then
+      for _, v in pairs(r) do
+        table.insert(results, v)
+      end
+    end
+  end
+  local r = d:finish()
+  if r then
+    for _, v in pairs(r) do
+      table.insert(results, v)
+    end
+  end
+  return results
+end
+
+do
+  local doc = '{"name": "luau", "tags": ["fast", "small", "\\u00e9\\n"], "n": [1.5, -2, 1e3, true, false, {"a": [[]]}], "e": {}, "z": null}'
+  local expected = json.encode(json.decode(doc))
+
+  for _, size in ipairs({1, 2, 3, 7, 1000}) do
+    -- depth 0 decodes the whole document
+    local r = feed(json.decoder({depth = 0}), doc, size)
+    assert(#r == 1 and json.encode(r[1]) == expected)
+
+    -- events are reported for containers above the requested depth
+    local events = {}
+    local d = json.decoder({
+      depth = 2,
+      start_object = function() table.insert(events, "{") end,
+      end_object = function() table.insert(events, "}") end,
+      start_array = function() table.insert(events, "[") end,
+      end_array = function() table.insert(events, "]") end,
+      key = function(k) table.insert(events, k .. ":") end,
+      value = function(v) table.insert(events, json.encode(v)) end,
+    })
+    assert(#feed(d, doc, size) == 0)
+    assert(table.concat(events, " ") == '{ name: "luau" tags: [ "fast" "small" "é\\n" ] n: [ 1.5 -2 1000 true false {"a":[[]]} ] e: { } z: null }')
+  end
+
+  -- without callbacks, values are returned from update and finish
+  local d = json.decoder({depth = 1})
+  local r = d:update('[1, {"a": 2}, "x')
+  assert(#r == 2 and r[1] == 1 and r[2].a == 2)
+  r = d:update('yz", [3')
+  assert(#r == 1 and r[1] == "xyz")
+  r = d:finish("]]")
+  assert(#r == 1 and r[1][1] == 3)
+
+  -- scalars at the top level and numbers split across chunks
+  r = feed(json.decoder(), " 12345.5 ", 1)
+  assert(#r == 1 and r[1] == 12345.5)
+  r = feed(json.decoder(), '"abc"', 1)
+  assert(#r == 1 and r[1] == "abc")
+
+  -- update and finish can be called as plain functions, e.g. as a stream sink
+  d = json.decoder({depth = 1})
+  local update, finish = d.update, d.finish
+  r = update("[1, 2")
+  assert(#r == 1 and r[1] == 1)
+  r = finish("]")
+  assert(#r == 1 and r[1] == 2)
+
+  -- update can't be called after finish, or from a callback
+  d = json.decoder()
+  d:finish("1")
+  checkerror("decoder has already finished", d.update, d, "2")
+
+  local inner
+  inner = json.decoder({value = function() inner:update("1") end})
+  checkerror("decoder can't be used after an error or from its own callbacks", inner.update, inner, "[1]")
+
+  checkerror("invalid option 'depth'", json.decoder, {depth = "x"})
+end
+
+-- incremental decoding reports the same errors as decode, regardless of how the input is split
+do
+  local bad = {
+    "", "x", "[\n1,}", "1 2", "1.2.3", "[-]", "nul", "truex", '"abc', '"abc\\n', '"a\nb"', '"a\\xb"', '"\\u12"', '"\\u12g4"',
+    '"\\udbff\\uffff"', "[1 2]", "[1", "[1,", "{1: 2}", '{"a" 1}', '{"a": 1 "b": 2}', '{"a"', '{"a":', "{", "[" .. string.rep("[", 250),
+  }
+
+  for _, text in ipairs(bad) do
+    local _, expected = pcall(json.decode, text)
+
+    for _, depth in ipairs({0, 1, 1000}) do
+      for _, size in ipairs({1, 2, 1000}) do
+        local ok, err = pcall(feed, json.decoder({depth = depth}), text, size)
+        assert(not ok and string.sub(err, -#expected) == expected, text)
+      end
+    end
+  end
+end
+
+-- lazy documents
+do
+  local doc = '{"name": "luau", "n": 1.5, "esc": "a\\nb", "\\u0041": 1, "tags": ["fast", null, "small"], "nested": {"list": [[], [1], [1, 2]]}, "x": 1, "x": null, "y": 1, "y": 2}'
+  local v = json.parse_lazy(doc)
+
+  assert(type(v) == "userdata")
+  assert(v.name == "luau" and v.n == 1.5 and v.esc == "a\nb" and v.A == 1)
+  assert(v.missing == nil and v[1] == nil and #v == 0)
+
+  -- duplicate keys and nulls behave like json.decode
+  assert(v.x == nil and v.y == 2)
+
+  local tags = v.tags
+  assert(type(tags) == "userdata" and #tags == 3)
+  assert(tags[1] == "fast" and tags[2] == nil and tags[3] == "small" and tags[4] == nil and tags[0] == nil and tags[1.5] == nil and tags.x == nil)
+  assert(tags[3] == "small" and tags[1] == "fast")
+
+  assert(v.tags == tags and v.nested ~= tags)
+  assert(#v.nested.list == 3 and #v.nested.list[1] == 0 and v.nested.list[3][2] == 2)
+
+  local items = {}
+  for i, t in tags do
+    table.insert(items, i .. "=" .. t)
+  end
+  assert(table.concat(items, ",") == "1=fast,3=small")
+
+  local keys = {}
+  for k, val in v.nested do
+    table.insert(keys, k)
+    assert(type(val) == "userdata")
+  end
+  assert(table.concat(keys, ",") == "list")
+
+  -- views keep the document alive on their own
+  local inner = json.parse_lazy('[[1, [2, "three"]]]')[1][2]
+  collectgarbage()
+  assert(inner[2] == "three")
+
+  -- sequential access of large arrays
+  local big = json.parse_lazy("[" .. string.rep("1,", 9999) .. "2]")
+  local sum = 0
+  for i = 1, #big do
+    sum += big[i]
+  end
+  assert(sum == 10001 and big[10000] == 2 and big[5000] == 1)
+
+  -- scalars are returned as values
+  assert(json.parse_lazy(" 42 ") == 42)
+  assert(json.parse_lazy('"s"') == "s")
+  assert(json.parse_lazy("null") == nil)
+
+  -- the whole document is validated upfront with the same errors as decode
+  for _, text in ipairs({"", "[1 2]", '{"a": [1, tru]}', '["\\x"]', "[1] 2", string.rep("[", 1000)}) do
+    local _, expected = pcall(json.decode, text)
+    local ok, err = pcall(json.parse_lazy, text)
+    assert(not ok and err == expected, text)
+  end
+
+  checkerror("expected argument of type string, got nil", json.parse_lazy)
+end
+
+-- roundtrip
+do
+  local doc = '{"name":"luau","tags":["fast","small"],"version":0.5,"nested":{"ok":true,"list":[[],[1],[1,2]]}}'
+  local v = json.decode(doc)
+  local w = json.decode(json.encode(v))
+  assert(w.name == "luau" and w.tags[2] == "small" and w.version == 0.5 and w.nested.ok == true and #w.nested.list[3] == 2)
+end
+
+return "OK"
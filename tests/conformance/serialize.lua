@@ -0,0 +1,133 @@
+-- This file is part of the Luau programming language and is licensed under MIT License; see LICENSE.txt for details
+print("testing serialize library")
+
+local function roundtrip(...)
+  return serialize.decode(serialize.encode(...))
+end
+
+-- scalars keep their exact values
+do
+  assert(select("#", roundtrip()) == 0)
+  assert(select("#", roundtrip(nil, nil)) == 2)
+
+  local a, b, c = roundtrip(true, false, nil)
+  assert(a == true and b == false and c == nil)
+
+  for _, n in {0, 1, -1, 127, 128, -129, 2^31 - 1, -2^31, 2^31, 2^53, 0.5, -1e308, 1e-300, math.huge, -math.huge, math.pi} do
+    assert(roundtrip(n) == n)
+  end
+
+  local nan = roundtrip(0/0)
+  assert(nan ~= nan)
+  assert(1 / roundtrip(-0) == -math.huge)
+
+  assert(roundtrip("") == "" and roundtrip("a\0b\255") == "a\0b\255")
+  assert(roundtrip(string.rep("x", 100000)) == string.rep("x", 100000))
+  assert(roundtrip(vector(1, 2.5, -3)) == vector(1, 2.5, -3))
+end
+
+-- tables keep array holes, mixed keys, cycles and shared references
+do
+  local shared = {tag = "shared"}
+  local t = {1, nil, 3, [100] = "far", [1.5] = "half", [true] = false, [-1] = "negative", a = shared, b = shared, nested = {{{"deep"}}}}
+  t.self = t
+  shared.parent = t
+  t[vector(1, 2, 3)] = "vector key"
+
+  local r = roundtrip(t)
+  assert(r ~= t)
+  assert(r[1] == 1 and r[2] == nil and r[3] == 3)
+  assert(r[100] == "far" and r[1.5] == "half" and r[true] == false and r[-1] == "negative")
+  assert(r.a == r.b and r.a.tag == "shared" and r.a.parent == r)
+  assert(r.self == r and r.nested[1][1][1] == "deep")
+  assert(r[vector(1, 2, 3)] == "vector key")
+
+  -- references work across top level values
+  local x, y = roundtrip(shared, shared)
+  assert(x == y and x.parent.a == x)
+
+  local count = 0
+  for k, v in r do
+    count += 1
+  end
+  local expected = 0
+  for k, v in t do
+    expected += 1
+  end
+  assert(count == expected)
+
+  -- big tables come back with every element
+  local big = {}
+  for i = 1, 10000 do
+    big[i] = {id = i, name = "item" .. i}
+  end
+  local copy = roundtrip(big)
+  assert(#copy == 10000 and copy[5000].id == 5000 and copy[10000].name == "item10000")
+
+  -- metatables are not part of the copy
+  assert(getmetatable(roundtrip(setmetatable({}, {}))) == nil)
+end
+
+-- repeated strings and integers are stored compactly
+do
+  local records = {}
+  for i = 1, 100 do
+    records[i] = {name = "name", value = i}
+  end
+  assert(#serialize.encode(records) < #json.encode(records) / 2)
+end
+
+-- values that can't be copied are rejected
+do
+  local ok, err = pcall(serialize.encode, print)
+  assert(not ok and err:find("cannot serialize a value of type function"))
+  ok, err = pcall(serialize.encode, {coroutine.create(print)})
+  assert(not ok and err:find("thread"))
+
+  local deep = {}
+  for i = 1, 2000 do
+    deep = {deep}
+  end
+  ok, err = pcall(serialize.encode, deep)
+  assert(not ok and err:find("nested"))
+
+  -- a reference back up the chain doesn't add a level, even at the limit
+  local root = {}
+  local last = root
+  for i = 1, 999 do
+    last[1] = {}
+    last = last[1]
+  end
+  last[1] = root
+  local copy = roundtrip(root)
+  local r = copy
+  for i = 1, 1000 do
+    r = r[1]
+  end
+  assert(r == copy)
+end
+
+-- malformed input raises an error instead of crashing
+do
+  local encoded = serialize.encode({1, 2, {x = "string", y = 1.5}}, "tail")
+  for i = 0, #encoded - 1 do
+    local ok, err = pcall(serialize.decode, encoded:sub(1, i))
+    assert(not ok and err:find("malformed"))
+  end
+  assert(not pcall(serialize.decode, encoded .. "x"))
+
+  for _, bad in {"\1\99", "\1\6\0", "\1\9\0", "\1\8\255\255\255\255\15\0", "\1\8\0\1\0\1"} do
+    local ok, err = pcall(serialize.decode, bad)
+    assert(not ok and err:find("malformed"))
+  end
+
+  -- random corruption either decodes to something or fails cleanly
+  for seed = 1, 200 do
+    local bytes = {string.byte(encoded, 1, -1)}
+    local pos = seed % #bytes + 1
+    bytes[pos] = (bytes[pos] + seed) % 256
+    pcall(serialize.decode, string.char(table.unpack(bytes)))
+  end
+end
+
+return "OK"
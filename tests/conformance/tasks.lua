@@ -0,0 +1,157 @@
+-- This file is part of the Luau programming language and is licensed under MIT License; see LICENSE.txt for details
+print("testing task scheduler")
+
+local function checkerror(msg, f, ...)
+  local s, err = pcall(f, ...)
+  assert(not s and string.find(err, msg))
+end
+
+-- spawn runs the function right away, up to its first yield
+do
+  local log = {}
+  local t = task.spawn(function(a, b)
+    table.insert(log, a + b)
+    coroutine.yield()
+    table.insert(log, "resumed")
+  end, 1, 2)
+
+  assert(type(t) == "thread" and coroutine.status(t) == "suspended")
+  assert(#log == 1 and log[1] == 3)
+
+  -- threads can be spawned again with new arguments
+  task.spawn(t)
+  assert(log[2] == "resumed" and coroutine.status(t) == "dead")
+
+  checkerror("thread is not suspended", task.spawn, t)
+  checkerror("spawned", task.spawn, function() error("spawned") end)
+end
+
+-- defer runs the function on the next step, in the order the tasks were deferred
+do
+  local log = {}
+  for i = 1, 3 do
+    task.defer(function(v) table.insert(log, v) end, i)
+  end
+  assert(#log == 0)
+
+  assert(task.step() == 3)
+  assert(table.concat(log, ",") == "1,2,3")
+
+  -- tasks deferred while a step runs wait for the next one
+  local count = 0
+  local function again()
+    count += 1
+    if count < 3 then
+      task.defer(again)
+    end
+  end
+  task.defer(again)
+  task.step()
+  task.step()
+  assert(count == 2)
+  task.step()
+  assert(count == 3)
+end
+
+-- wait yields the calling thread until the scheduler resumes it, returning the time it waited
+do
+  local log = {}
+  local now = os.clock()
+
+  local t = task.spawn(function()
+    table.insert(log, "start")
+    local waited = task.wait(10)
+    table.insert(log, waited)
+    table.insert(log, wait())
+  end)
+
+  assert(#log == 1)
+  assert(task.step(now) == 0)
+  assert(#log == 1)
+
+  task.step(now + 10.5)
+  assert(#log == 2 and log[2] >= 10)
+
+  -- waiting for nothing takes until the next step
+  assert(coroutine.status(t) == "suspended")
+  task.step(now + 11)
+  assert(#log == 3 and coroutine.status(t) == "dead")
+
+  -- waiting needs a yieldable caller
+  checkerror("attempt to yield", table.sort, {1, 2}, function(a, b) task.wait() return a < b end)
+  checkerror("attempt to yield", table.sort, {1, 2}, function(a, b) wait(1) return a < b end)
+end
+
+-- delay runs the function once its deadline passes, earliest deadline first
+do
+  local log = {}
+  local now = os.clock()
+
+  task.delay(3, function(v) table.insert(log, v) end, "c")
+  task.delay(1, function(v) table.insert(log, v) end, "a")
+  task.delay(2, function(v) table.insert(log, v) end, "b")
+  task.delay(1, function(v) table.insert(log, v) end, "a2")
+
+  task.step(now + 1.5)
+  assert(table.concat(log, ",") == "a,a2")
+  task.step(now + 10)
+  assert(table.concat(log, ",") == "a,a2,b,c")
+end
+
+-- thousands of timers
+do
+  local now = os.clock()
+  local fired = 0
+  local order = {}
+
+  for i = 1, 5000 do
+    local d = (i * 7919) % 5000 / 100
+    task.delay(d, function()
+      table.insert(order, d)
+      fired += 1
+    end)
+  end
+
+  -- delays count from the moment each timer was scheduled, which can reorder timers that are closer than the time the loop took
+  local spread = os.clock() - now
+
+  task.step(now + 25)
+  assert(fired > 2000 and fired < 3000)
+  task.step(now + 60)
+  assert(fired == 5000)
+
+  for i = 2, #order do
+    assert(order[i] >= order[i - 1] - spread)
+  end
+end
+
+-- errors propagate out of step, and the remaining tasks stay scheduled
+do
+  local log = {}
+  task.defer(function() error("task failed", 0) end)
+  task.defer(function() table.insert(log, "after") end)
+
+  local ok, err = pcall(task.step)
+  assert(not ok and err == "task failed" and #log == 0)
+
+  task.step()
+  assert(log[1] == "after")
+end
+
+-- threads resumed by someone else while scheduled are skipped
+do
+  local resumed = 0
+  local t = coroutine.create(function()
+    task.wait(1)
+    resumed += 1
+  end)
+  coroutine.resume(t)
+  coroutine.resume(t)
+  assert(resumed == 1 and coroutine.status(t) == "dead")
+  assert(task.step(os.clock() + 2) == 0)
+end
+
+-- leave a task for the host to run
+task.delay(0.01, function(v) delayed = v end, "done")
+
+return "OK"
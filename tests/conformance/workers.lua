@@ -0,0 +1,140 @@
+-- This file is part of the Luau programming language and is licensed under MIT License; see LICENSE.txt for details
+print("testing workers")
+
+-- workers run a script with copies of the arguments and hand back copies of its results
+do
+  local w = worker.spawn("local a, b, t = ... return a + b, t.name, #t.list, t.list[3], t.v", 1, 2, {name = "x", list = {1, 2, 3}, v = vector(1, 2, 3)})
+  assert(tostring(w) == "workerHandle")
+  local ok, sum, name, len, third, v = w:join()
+  assert(ok and sum == 3 and name == "x" and len == 3 and third == 3 and v == vector(1, 2, 3))
+
+  -- joining again returns the same results
+  assert(select("#", w:join()) == 6)
+end
+
+-- values keep their types, including holes, mixed keys and embedded zeros
+do
+  local t = {1, nil, 3, [10] = "ten", [1.5] = true, key = {nested = {false}}, ["a\0b"] = "z\0"}
+  local ok, r = worker.spawn("return ...", t):join()
+  assert(ok and r ~= t)
+  assert(r[1] == 1 and r[2] == nil and r[3] == 3 and r[10] == "ten" and r[1.5] == true)
+  assert(r.key.nested[1] == false and r["a\0b"] == "z\0")
+
+  -- cycles and shared tables survive the copy
+  local shared = {}
+  local cycle = {shared, shared}
+  cycle.self = cycle
+  ok, r = worker.spawn("return ...", cycle):join()
+  assert(ok and r.self == r and r[1] == r[2] and r[1] ~= shared)
+
+  ok = worker.spawn("return"):join()
+  assert(ok)
+  assert(select("#", worker.spawn("return nil, nil"):join()) == 3)
+end
+
+-- workers are separate VMs: globals and tables aren't shared
+do
+  shared = {count = 1}
+  local ok, seen = worker.spawn("return shared"):join()
+  assert(ok and seen == nil)
+
+  local t = {count = 1}
+  ok = worker.spawn("local t = ... t.count = 2", t):join()
+  assert(ok and t.count == 1)
+end
+
+-- errors are returned by join
+do
+  local ok, err = worker.spawn("error('boom', 0)"):join()
+  assert(not ok and err == "boom")
+
+  ok, err = worker.spawn("local x = "):join()
+  assert(not ok and err:find("worker"))
+
+  ok, err = worker.spawn("return function() end"):join()
+  assert(not ok and err:find("function"))
+
+  ok, err = pcall(worker.spawn, "", print)
+  assert(not ok and err:find("cannot serialize a value of type function"))
+
+  ok, err = pcall(worker.send, 1)
+  assert(not ok and err:find("inside a worker"))
+end
+
+-- parents and workers exchange messages through their mailboxes
+do
+  local echo = worker.spawn([[
+    while true do
+      local from, msg = worker.receive()
+      if msg == "stop" then
+        return "stopped"
+      end
+      worker.send(msg, msg * 2)
+    end
+  ]])
+
+  for i = 1, 100 do
+    echo:send(i)
+  end
+
+  for i = 1, 100 do
+    local from, a, b = worker.receive()
+    assert(from == echo and a == i and b == i * 2)
+  end
+
+  echo:send("stop")
+  local ok, result = echo:join()
+  assert(ok and result == "stopped")
+
+  -- receive returns nothing when the timeout expires
+  assert(select("#", worker.receive(0)) == 0)
+  assert(select("#", worker.receive(0.01)) == 0)
+  assert(worker.cores() >= 1)
+end
+
+-- many producers share a mailbox
+do
+  local workers = {}
+  for i = 1, 4 do
+    workers[i] = worker.spawn("local id = ... for j = 1, 1000 do worker.send(id, j) end", i)
+  end
+
+  local last = {0, 0, 0, 0}
+  for i = 1, 4000 do
+    local from, id, j = worker.receive()
+    assert(from == workers[id])
+    -- messages from one producer arrive in order
+    assert(j == last[id] + 1)
+    last[id] = j
+  end
+
+  for i = 1, 4 do
+    assert(workers[i]:join())
+  end
+end
+
+-- workers can spawn workers and wait for tasks
+do
+  local ok, a, b = worker.spawn([[
+    task.wait(0.01)
+    local ok, r = worker.spawn("return ... * 2", 21):join()
+    local got
+    task.delay(0.01, function() got = r end)
+    task.wait(0.02)
+    return ok, got
+  ]]):join()
+  assert(ok and a == true and b == 42)
+
+  ok, a = worker.spawn("task.delay(0, error, 'late', 0)"):join()
+  assert(not ok and a == "late")
+end
+
+-- a worker whose handle is collected keeps running on its own, and stops waiting for messages
+do
+  worker.spawn("worker.receive() worker.send('orphan')")
+  collectgarbage()
+  local from, msg = worker.receive(5)
+  assert(msg == "orphan")
+end
+
+return "OK"